@@ -60,8 +60,17 @@ int main(int argc, char* argv[])
   set_log_filter(g);
   g.load(tree);
 
-  ssl::context ssl_ctx{ssl::context::tlsv12};
+  ssl::context ssl_ctx{ssl::context::tls_server};
   systemicai::common::certificate::load(ssl_ctx, g.ssl_certificate, g.ssl_key, g.ssl_dh);
   systemicai::http::server::service httpd(g, ssl_ctx);
+
+  // SIGHUP rereads the settings file for the connections accepted after it
+  httpd.reload_on_hangup([path = std::string(argv[1])] {
+    pt::ptree tree;
+    pt::json_parser::read_json(path, tree);
+    settings s(tree);
+    set_log_filter(s);
+    return s;
+  });
   return httpd.start();
 }
@@ -25,7 +25,7 @@ public:
    * @param ctx The ASIO context to put the certificate in
    * @param ssl_certificate The path to the SSL certificate
    * @param ssl_key The path to the SSL key
-   * @param ssl_dh The path to the diffie hellman data
+   * @param ssl_dh The path to the diffie hellman data, empty when only ECDHE key exchanges are offered
    */
   static void load(
       boost::asio::ssl::context& ctx,
@@ -45,6 +45,10 @@ public:
       throw std::filesystem::filesystem_error("Not Found", f_ks, std::make_error_code(std::errc::io_error));
     }
 
+    if(ssl_dh.empty()) {
+      load(ctx, cs, ks);
+      return;
+    }
     std::filesystem::path f_ds(ssl_dh);
     ifstream ds(f_ds);
     if(!ds) {
@@ -63,6 +67,25 @@ public:
       std::istream& istream_ssl_certificate,
       std::istream& istream_ssl_key,
       std::istream& istream_ssl_dh)
+  {
+    load(ctx, istream_ssl_certificate, istream_ssl_key);
+
+    if(!istream_ssl_dh) {
+      throw std::system_error(std::make_error_code(std::errc::io_error), "istream_ssl_dh is invalid");
+    }
+    std::string const dh(istreambuf_iterator<char>{istream_ssl_dh}, {});
+    ctx.set_options(boost::asio::ssl::context::single_dh_use);
+    ctx.use_tmp_dh(boost::asio::buffer(dh.data(), dh.size()));
+  }
+
+  /**
+   * Load a certificate and its key without diffie hellman data, DHE cipher suites are then unavailable
+   * @param ctx The ASIO context to put the certificate in
+   */
+  static void load(
+      boost::asio::ssl::context& ctx,
+      std::istream& istream_ssl_certificate,
+      std::istream& istream_ssl_key)
   {
     ctx.set_password_callback([](std::size_t, boost::asio::ssl::context_base::password_purpose) {
         return "Not Implemented";
@@ -70,8 +93,7 @@ public:
 
     ctx.set_options(
       boost::asio::ssl::context::default_workarounds |
-      boost::asio::ssl::context::no_sslv2 |
-      boost::asio::ssl::context::single_dh_use);
+      boost::asio::ssl::context::no_sslv2);
 
     if(!istream_ssl_certificate) {
       throw std::system_error(std::make_error_code(std::errc::io_error), "istream_ssl_certificate is invalid");
@@ -87,12 +109,6 @@ public:
       boost::asio::buffer(key.data(), key.size()),
       boost::asio::ssl::context::file_format::pem
     );
-
-    if(!istream_ssl_dh) {
-      throw std::system_error(std::make_error_code(std::errc::io_error), "istream_ssl_dh is invalid");
-    }
-    std::string const dh(istreambuf_iterator<char>{istream_ssl_dh}, {});
-    ctx.use_tmp_dh(boost::asio::buffer(dh.data(), dh.size()));
   }
 };
 
@@ -0,0 +1,237 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_ARENA_H
+#define SYSTEMICAI_HTTP_SERVER_ARENA_H
+
+/**
+  Connection scoped memory.
+
+  Every http_session owns an arena.  The request parser's fields and body, the responses built by the handlers,
+  the queued work items and the state of the asynchronous operations are allocated from it, so once a keep-alive
+  connection has served a few requests it stops calling into the global heap.
+ */
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <systemicai/http/server/namespace.h>
+
+namespace systemicai::http::server {
+
+/**
+ * A slab allocator with one free list per power of two size class from 16 bytes to 8 KiB.  Blocks are carved from
+ * 16 KiB chunks that are kept until the arena is destroyed, larger and over-aligned requests go to the global heap.
+ *
+ * An arena is not thread safe, it belongs to a single connection and is used from that connection's strand.
+ */
+class arena {
+public:
+  static constexpr std::size_t min_block = 16;
+  static constexpr std::size_t max_block = 8192;
+  static constexpr std::size_t chunk_size = 16384;
+
+  arena() = default;
+  arena(const arena&) = delete;
+  arena& operator=(const arena&) = delete;
+
+  ~arena() {
+    while(chunks_ != nullptr) {
+      auto const next = chunks_->next;
+      ::operator delete(chunks_);
+      chunks_ = next;
+    }
+  }
+
+  void* allocate(std::size_t bytes, std::size_t alignment = alignof(std::max_align_t)) {
+    if(alignment > alignof(std::max_align_t))
+      return ::operator new(bytes, std::align_val_t{alignment});
+    if(bytes > max_block)
+      return ::operator new(bytes);
+    auto const c = size_class(bytes);
+    if(auto const b = free_[c]) {
+      free_[c] = b->next;
+      return b;
+    }
+    auto const size = min_block << c;
+    if(left_ < size)
+      grow();
+    auto const p = top_;
+    top_ += size;
+    left_ -= size;
+    return p;
+  }
+
+  void deallocate(void* p, std::size_t bytes, std::size_t alignment = alignof(std::max_align_t)) noexcept {
+    if(alignment > alignof(std::max_align_t))
+      return ::operator delete(p, std::align_val_t{alignment});
+    if(bytes > max_block)
+      return ::operator delete(p);
+    auto const c = size_class(bytes);
+    auto const b = static_cast<block*>(p);
+    b->next = free_[c];
+    free_[c] = b;
+  }
+
+  // Bytes held in chunks, used or free
+  std::size_t capacity() const {
+    return chunk_count_ * chunk_size;
+  }
+
+  // Forget every block and keep only the most recent chunk, for reuse by another connection.  Nothing allocated from
+  // the arena may be in use any more.
+  void reset() noexcept {
+    if(chunks_ == nullptr)
+      return;
+    while(chunks_->next != nullptr) {
+      auto const next = chunks_->next->next;
+      ::operator delete(chunks_->next);
+      chunks_->next = next;
+    }
+    chunk_count_ = 1;
+    top_ = reinterpret_cast<char*>(chunks_) + header_size();
+    left_ = chunk_size;
+    for(auto& f : free_)
+      f = nullptr;
+  }
+
+private:
+  struct block {
+    block* next;
+  };
+
+  static constexpr std::size_t classes = 10;
+  static_assert((min_block << (classes - 1)) == max_block, "size classes must cover min_block to max_block");
+  static_assert(min_block % alignof(std::max_align_t) == 0, "blocks must be suitably aligned");
+
+  static std::size_t size_class(std::size_t bytes) {
+    std::size_t c = 0;
+    for(auto size = min_block; size < bytes; size <<= 1)
+      ++c;
+    return c;
+  }
+
+  // The link at the start of every chunk, rounded up to keep blocks aligned
+  static constexpr std::size_t header_size() {
+    return (sizeof(block) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+  }
+
+  void grow() {
+    // The remainder of the current chunk is given to the free lists before it is abandoned
+    while(left_ >= min_block) {
+      std::size_t c = classes - 1;
+      while((min_block << c) > left_)
+        --c;
+      deallocate(top_, min_block << c);
+      top_ += min_block << c;
+      left_ -= min_block << c;
+    }
+    auto const c = static_cast<block*>(::operator new(chunk_size + header_size()));
+    c->next = chunks_;
+    chunks_ = c;
+    ++chunk_count_;
+    top_ = reinterpret_cast<char*>(c) + header_size();
+    left_ = chunk_size;
+  }
+
+  block* free_[classes] = {};
+  block* chunks_ = nullptr;
+  std::size_t chunk_count_ = 0;
+  char* top_ = nullptr;
+  std::size_t left_ = 0;
+};
+
+/**
+ * Standard allocator drawing from an arena.  Every copy shares ownership of the arena, so memory handed out by it
+ * stays valid for as long as a container or a pending operation still holds the allocator.
+ */
+template<class T>
+class arena_allocator {
+public:
+  using value_type = T;
+
+  explicit arena_allocator(std::shared_ptr<arena> a) noexcept : arena_(std::move(a)) {
+  }
+
+  template<class U>
+  arena_allocator(const arena_allocator<U>& other) noexcept : arena_(other.get_arena()) {
+  }
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* p, std::size_t n) noexcept {
+    arena_->deallocate(p, n * sizeof(T), alignof(T));
+  }
+
+  const std::shared_ptr<arena>& get_arena() const noexcept {
+    return arena_;
+  }
+
+  template<class U>
+  bool operator==(const arena_allocator<U>& other) const noexcept {
+    return arena_ == other.get_arena();
+  }
+
+  template<class U>
+  bool operator!=(const arena_allocator<U>& other) const noexcept {
+    return arena_ != other.get_arena();
+  }
+
+private:
+  std::shared_ptr<arena> arena_;
+};
+
+/**
+ * Associates an allocator with a completion handler, so Asio and Beast allocate the state of the operation it
+ * completes from that allocator instead of the global heap.  The handler's associated executor is kept.
+ */
+template<class Handler, class Allocator>
+class allocator_binder {
+public:
+  using allocator_type = Allocator;
+
+  allocator_binder(Handler&& h, const Allocator& a) : handler_(std::move(h)), allocator_(a) {
+  }
+
+  allocator_type get_allocator() const noexcept {
+    return allocator_;
+  }
+
+  const Handler& handler() const noexcept {
+    return handler_;
+  }
+
+  template<class... Args>
+  void operator()(Args&&... args) {
+    handler_(std::forward<Args>(args)...);
+  }
+
+private:
+  Handler handler_;
+  Allocator allocator_;
+};
+
+template<class Handler, class Allocator>
+allocator_binder<typename std::decay<Handler>::type, Allocator>
+bind_allocator(const Allocator& a, Handler&& h) {
+  return allocator_binder<typename std::decay<Handler>::type, Allocator>(std::forward<Handler>(h), a);
+}
+
+} // namespace systemicai::http::server
+
+namespace boost::asio {
+
+template<class Handler, class Allocator, class Executor>
+struct associated_executor<systemicai::http::server::allocator_binder<Handler, Allocator>, Executor> {
+  using type = typename associated_executor<Handler, Executor>::type;
+
+  static type get(const systemicai::http::server::allocator_binder<Handler, Allocator>& b, const Executor& ex = Executor()) noexcept {
+    return associated_executor<Handler, Executor>::get(b.handler(), ex);
+  }
+};
+
+} // namespace boost::asio
+
+#endif // SYSTEMICAI_HTTP_SERVER_ARENA_H
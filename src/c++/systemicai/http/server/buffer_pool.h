@@ -0,0 +1,214 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_BUFFER_POOL_H
+#define SYSTEMICAI_HTTP_SERVER_BUFFER_POOL_H
+
+/**
+  I/O buffers of the sessions.
+
+  A session's read buffer takes its memory from the pool of the thread it runs on and gives it back whenever the
+  session is idle, so buffer memory tracks the requests being read rather than the open connections.  Every io thread
+  keeps the blocks given back to it, up to a byte limit, for the next session to read a request.  A block given back
+  on another thread goes to the heap, as the storage of the recycler does.
+ */
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/recycler.h>
+
+namespace systemicai::http::server {
+
+class buffer_pool {
+public:
+  // Blocks are cached in power of two sizes from min_block to max_block, larger ones go straight back to the heap
+  static constexpr std::size_t min_block = 1024;
+  static constexpr std::size_t classes = 7;
+  static constexpr std::size_t max_block = min_block << (classes - 1);
+
+  // The buffer memory of one thread
+  struct usage {
+    std::thread::id thread;
+    // False once the thread exited, buffers it lent may still be in use
+    bool running;
+    // Bytes in the buffers borrowed from this thread
+    std::size_t lent;
+    // Bytes given back and kept for reuse
+    std::size_t cached;
+  };
+
+  buffer_pool(const buffer_pool&) = delete;
+  buffer_pool& operator=(const buffer_pool&) = delete;
+
+  // The pool of the calling thread
+  static buffer_pool& local() {
+    thread_local holder h;
+    return *h.pool;
+  }
+
+  void* allocate(std::size_t n) {
+    auto const size = block_size(n);
+    lent_.fetch_add(size, std::memory_order_relaxed);
+    block* b = nullptr;
+    if(size <= max_block && (b = free_[index(size)]) != nullptr) {
+      free_[index(size)] = b->next;
+      cached_.fetch_sub(size, std::memory_order_relaxed);
+    } else {
+      b = static_cast<block*>(::operator new(sizeof(block) + size));
+    }
+    b->origin = this;
+    return b + 1;
+  }
+
+  // Give back to the calling thread's pool, whichever thread lent it, or to the heap when it is not an io thread
+  static void deallocate(void* p, std::size_t n) {
+    auto const size = block_size(n);
+    auto const b = static_cast<block*>(p) - 1;
+    b->origin->lent_.fetch_sub(size, std::memory_order_relaxed);
+    if(!recycler::on_io_thread())
+      return ::operator delete(b);
+    auto& pool = local();
+    if(size > max_block || pool.cached_.load(std::memory_order_relaxed) + size > cache_limit_.load(std::memory_order_relaxed))
+      return ::operator delete(b);
+    b->next = pool.free_[index(size)];
+    pool.free_[index(size)] = b;
+    pool.cached_.fetch_add(size, std::memory_order_relaxed);
+  }
+
+  // The most bytes each thread keeps cached
+  static void cache_limit(std::size_t bytes) {
+    cache_limit_.store(bytes, std::memory_order_relaxed);
+  }
+
+  // The buffer memory of every thread that used buffers, including the threads that exited with buffers still lent
+  static std::vector<usage> report() {
+    std::lock_guard<std::mutex> lg(registry_mutex());
+    std::vector<usage> v;
+    for(auto& p : registry())
+      if(p->running_ || p->lent_.load(std::memory_order_relaxed) != 0)
+        v.push_back({p->thread_, p->running_, p->lent_.load(std::memory_order_relaxed), p->cached_.load(std::memory_order_relaxed)});
+    return v;
+  }
+
+private:
+  // The header of every block, the next free block while cached
+  struct alignas(std::max_align_t) block {
+    union {
+      buffer_pool* origin;
+      block* next;
+    };
+  };
+
+  // Adopts the pool of an exited thread, pools live as long as the process since their buffers may outlive a thread
+  struct holder {
+    buffer_pool* pool = nullptr;
+
+    holder() {
+      std::lock_guard<std::mutex> lg(registry_mutex());
+      for(auto& p : registry())
+        if(!p->running_)
+          pool = p.get();
+      if(pool == nullptr) {
+        registry().emplace_back(new buffer_pool());
+        pool = registry().back().get();
+      }
+      pool->running_ = true;
+      pool->thread_ = std::this_thread::get_id();
+    }
+
+    ~holder() {
+      pool->trim();
+      std::lock_guard<std::mutex> lg(registry_mutex());
+      pool->running_ = false;
+    }
+  };
+
+  buffer_pool() = default;
+
+  static std::size_t block_size(std::size_t n) {
+    std::size_t size = min_block;
+    while(size < n && size < max_block)
+      size <<= 1;
+    return n > max_block ? n : size;
+  }
+
+  static std::size_t index(std::size_t size) {
+    std::size_t i = 0;
+    while((min_block << i) < size)
+      ++i;
+    return i;
+  }
+
+  // Free every cached block
+  void trim() {
+    for(auto& head : free_)
+      while(head != nullptr) {
+        auto const next = head->next;
+        ::operator delete(head);
+        head = next;
+      }
+    cached_.store(0, std::memory_order_relaxed);
+  }
+
+  static std::mutex& registry_mutex() {
+    static std::mutex m;
+    return m;
+  }
+
+  static std::vector<std::unique_ptr<buffer_pool>>& registry() {
+    static std::vector<std::unique_ptr<buffer_pool>> r;
+    return r;
+  }
+
+  inline static std::atomic<std::size_t> cache_limit_{1 << 20};
+
+  std::array<block*, classes> free_{};
+  std::atomic<std::size_t> lent_{0};
+  std::atomic<std::size_t> cached_{0};
+  // Guarded by the registry mutex
+  std::thread::id thread_;
+  bool running_ = false;
+};
+
+// Allocates from the calling thread's buffer_pool
+template<class T>
+class pool_allocator {
+public:
+  using value_type = T;
+
+  pool_allocator() = default;
+
+  template<class U>
+  pool_allocator(const pool_allocator<U>&) noexcept {
+  }
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(buffer_pool::local().allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, std::size_t n) noexcept {
+    buffer_pool::deallocate(p, n * sizeof(T));
+  }
+
+  template<class U>
+  bool operator==(const pool_allocator<U>&) const noexcept {
+    return true;
+  }
+
+  template<class U>
+  bool operator!=(const pool_allocator<U>&) const noexcept {
+    return false;
+  }
+};
+
+// The read buffer of a session, shrink_to_fit() when empty gives its memory back to the pool
+using session_buffer = beast::basic_flat_buffer<pool_allocator<char>>;
+
+} // namespace systemicai::http::server
+
+#endif // SYSTEMICAI_HTTP_SERVER_BUFFER_POOL_H
@@ -0,0 +1,147 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_BYTE_RANGES_H
+#define SYSTEMICAI_HTTP_SERVER_BYTE_RANGES_H
+
+/**
+  The byte ranges of a Range request field, RFC 7233.
+
+  Ranges are resolved against the size of the representation and kept sorted, overlapping and adjacent ones merged,
+  in a fixed array: a request asking for more ranges than it holds, or with a malformed field, is answered whole as
+  if it had none, so a client cannot make the server send a file many times over in one response.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include <systemicai/http/server/namespace.h>
+
+namespace systemicai::http::server {
+
+struct byte_range {
+  std::uint64_t first;
+  // Inclusive, as in the field
+  std::uint64_t last;
+
+  std::uint64_t size() const {
+    return last - first + 1;
+  }
+};
+
+class byte_ranges {
+public:
+  static constexpr std::size_t max_ranges = 16;
+
+  enum class outcome {
+    // No ranges apply, the whole representation is sent
+    whole,
+    partial,
+    // Only ranges beyond the end of the representation, answered with 416
+    unsatisfiable
+  };
+
+  // Resolve the ranges of the field `value` against a representation of `size` bytes
+  outcome parse(beast::string_view value, std::uint64_t size) {
+    count_ = 0;
+    if(value.size() < 6 || !beast::iequals(value.substr(0, 6), "bytes="))
+      return outcome::whole;
+    value.remove_prefix(6);
+    bool any = false;
+    while(!value.empty()) {
+      auto const comma = value.find(',');
+      auto element = value.substr(0, comma);
+      value = comma == beast::string_view::npos ? beast::string_view{} : value.substr(comma + 1);
+      while(!element.empty() && (element.front() == ' ' || element.front() == '\t'))
+        element.remove_prefix(1);
+      while(!element.empty() && (element.back() == ' ' || element.back() == '\t'))
+        element.remove_suffix(1);
+      if(element.empty())
+        continue;
+      auto const dash = element.find('-');
+      if(dash == beast::string_view::npos)
+        return outcome::whole;
+      any = true;
+      std::uint64_t first, last;
+      if(dash == 0) {
+        // The last n bytes
+        std::uint64_t n;
+        if(!number(element.substr(1), n))
+          return outcome::whole;
+        if(n == 0 || size == 0)
+          continue;
+        first = n < size ? size - n : 0;
+        last = size - 1;
+      } else {
+        if(!number(element.substr(0, dash), first))
+          return outcome::whole;
+        if(dash + 1 == element.size())
+          last = std::numeric_limits<std::uint64_t>::max();
+        else if(!number(element.substr(dash + 1), last) || last < first)
+          return outcome::whole;
+        if(first >= size)
+          continue;
+        last = std::min(last, size - 1);
+      }
+      if(count_ == max_ranges)
+        return outcome::whole;
+      ranges_[count_++] = byte_range{first, last};
+    }
+    if(count_ == 0)
+      return any ? outcome::unsatisfiable : outcome::whole;
+    merge();
+    return outcome::partial;
+  }
+
+  std::size_t size() const {
+    return count_;
+  }
+
+  const byte_range* begin() const {
+    return ranges_.data();
+  }
+
+  const byte_range* end() const {
+    return ranges_.data() + count_;
+  }
+
+  const byte_range& operator[](std::size_t i) const {
+    return ranges_[i];
+  }
+
+private:
+  // Reads decimal digits, saturating instead of overflowing
+  static bool number(beast::string_view digits, std::uint64_t& value) {
+    if(digits.empty())
+      return false;
+    value = 0;
+    for(auto c : digits) {
+      if(c < '0' || c > '9')
+        return false;
+      auto const d = std::uint64_t(c - '0');
+      value = value > (std::numeric_limits<std::uint64_t>::max() - d) / 10 ? std::numeric_limits<std::uint64_t>::max()
+                                                                           : value * 10 + d;
+    }
+    return true;
+  }
+
+  void merge() {
+    std::sort(ranges_.begin(), ranges_.begin() + count_,
+              [](const byte_range& a, const byte_range& b) { return a.first < b.first; });
+    std::size_t n = 0;
+    for(std::size_t i = 1; i < count_; ++i) {
+      if(ranges_[i].first <= ranges_[n].last + 1)
+        ranges_[n].last = std::max(ranges_[n].last, ranges_[i].last);
+      else
+        ranges_[++n] = ranges_[i];
+    }
+    count_ = n + 1;
+  }
+
+  std::array<byte_range, max_ranges> ranges_;
+  std::size_t count_ = 0;
+};
+
+} // namespace systemicai::http::server
+
+#endif // SYSTEMICAI_HTTP_SERVER_BYTE_RANGES_H
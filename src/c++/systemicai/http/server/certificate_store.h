@@ -0,0 +1,279 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_CERTIFICATE_STORE_H
+#define SYSTEMICAI_HTTP_SERVER_CERTIFICATE_STORE_H
+
+/**
+  The certificates served by the TLS listeners, selected per server name and reloaded while the service runs.
+
+  Every certificate of the settings is loaded into an immutable table of its DNS names.  The servername callback of
+  the shared context looks the name a client asks for up in the current table and sets that certificate and key on
+  the connection alone, so nothing of the context itself changes after the start.  A reload builds a new table on a
+  thread of its own and swaps it in; handshakes in progress and established connections keep the certificate they
+  took, and a table that fails to load leaves the current one serving.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
+
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/settings.h>
+#include <systemicai/common/exception.h>
+
+namespace systemicai::http::server {
+
+class certificate_store {
+public:
+  // A certificate with its chain and private key, and the names it is served for
+  struct entry {
+    std::unique_ptr<X509, decltype(&X509_free)> certificate{nullptr, &X509_free};
+    std::unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> key{nullptr, &EVP_PKEY_free};
+    std::unique_ptr<STACK_OF(X509), void(*)(STACK_OF(X509)*)> chain{nullptr, [](STACK_OF(X509)* c) { sk_X509_pop_free(c, X509_free); }};
+    std::vector<std::string> names;
+  };
+
+  /**
+   * Load the certificates of `s` and select them for the handshakes of `ctx` from now on
+   * @throws systemicai::common::exception when a certificate or key cannot be read, or they do not match
+   */
+  certificate_store(ssl::context& ctx, const settings& s)
+          : ctx_(ctx.native_handle())
+  {
+    reload(s);
+    SSL_CTX_set_ex_data(ctx_, index(), this);
+    SSL_CTX_set_tlsext_servername_callback(ctx_, &certificate_store::on_servername);
+  }
+
+  certificate_store(const certificate_store&) = delete;
+  certificate_store& operator=(const certificate_store&) = delete;
+
+  // Waits for a reload in progress, the context serves the certificate it was loaded with again
+  ~certificate_store() {
+    std::lock_guard<std::mutex> lg(reload_mutex_);
+    if(pending_.valid())
+      pending_.wait();
+    if(SSL_CTX_get_ex_data(ctx_, index()) == this) {
+      SSL_CTX_set_tlsext_servername_callback(ctx_, nullptr);
+      SSL_CTX_set_ex_data(ctx_, index(), nullptr);
+    }
+  }
+
+  /**
+   * Load settings::ssl_certificate and settings::ssl_certificates of `s` and swap them in for new handshakes
+   * @throws systemicai::common::exception as the constructor, the current certificates are kept
+   */
+  void reload(const settings& s) {
+    // Stamped before reading, a file written meanwhile is seen as changed by the next check
+    auto stamps = stamp(s);
+    {
+      std::lock_guard<std::mutex> lg(mutex_);
+      stamps_ = stamps;
+    }
+    auto next = std::make_shared<table>();
+    next->fallback = read(s.ssl_certificate, s.ssl_key);
+    for(auto& c : s.ssl_certificates) {
+      std::shared_ptr<const entry> e = read(c.certificate, c.key);
+      for(auto& name : e->names)
+        next->names.emplace(name, e);
+    }
+    std::shared_ptr<const table> current = std::move(next);
+    {
+      std::lock_guard<std::mutex> lg(mutex_);
+      current_.swap(current);
+    }
+    generation_.fetch_add(1, std::memory_order_release);
+  }
+
+  /**
+   * Reload on a thread of its own, logging a failure.  Called from the io threads, which never wait for the files.
+   * @return False when the previous reload is still running, this one is then left out
+   */
+  bool reload_async(const settings& s) {
+    std::lock_guard<std::mutex> lg(reload_mutex_);
+    if(pending_.valid() && pending_.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+      return false;
+    pending_ = std::async(std::launch::async, [this, s] {
+      try {
+        reload(s);
+        BOOST_LOG_TRIVIAL(info) << "Reloaded the certificates";
+      } catch(const std::exception& e) {
+        BOOST_LOG_TRIVIAL(error) << "Keeping the current certificates, reloading failed: " << e.what();
+      }
+    });
+    return true;
+  }
+
+  // True when a certificate or key file was modified, created or removed since the last reload started
+  bool changed() const {
+    std::vector<std::pair<std::string, std::filesystem::file_time_type>> stamps;
+    {
+      std::lock_guard<std::mutex> lg(mutex_);
+      stamps = stamps_;
+    }
+    for(auto& [path, time] : stamps)
+      if(modified(path) != time)
+        return true;
+    return false;
+  }
+
+  // Number of tables swapped in, the first one by the constructor
+  std::uint64_t generation() const {
+    return generation_.load(std::memory_order_acquire);
+  }
+
+  // The certificate served for `name`: an exact match, then a wildcard one level up, then the fallback
+  std::shared_ptr<const entry> select(std::string name) const {
+    std::shared_ptr<const table> t;
+    {
+      std::lock_guard<std::mutex> lg(mutex_);
+      t = current_;
+    }
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+    auto found = t->names.find(name);
+    if(found == t->names.end()) {
+      auto const dot = name.find('.');
+      if(dot != std::string::npos)
+        found = t->names.find("*" + name.substr(dot));
+    }
+    return found == t->names.end() ? t->fallback : found->second;
+  }
+
+  /**
+   * Read a PEM certificate chain and its private key
+   * @throws systemicai::common::exception when either cannot be read, or the key is not the certificate's
+   */
+  static std::shared_ptr<entry> read(const std::string& certificate, const std::string& key) {
+    auto e = std::make_shared<entry>();
+    auto const chain = slurp(certificate);
+    auto const bio = std::unique_ptr<BIO, decltype(&BIO_free)>(BIO_new_mem_buf(chain.data(), int(chain.size())), &BIO_free);
+    e->certificate.reset(PEM_read_bio_X509(bio.get(), nullptr, nullptr, nullptr));
+    if(!e->certificate) {
+      ERR_clear_error();
+      throw systemicai::common::exception("No certificate in: [" + certificate + "]");
+    }
+    e->chain.reset(sk_X509_new_null());
+    while(auto const c = PEM_read_bio_X509(bio.get(), nullptr, nullptr, nullptr))
+      sk_X509_push(e->chain.get(), c);
+    ERR_clear_error();
+
+    auto const pem = slurp(key);
+    auto const kbio = std::unique_ptr<BIO, decltype(&BIO_free)>(BIO_new_mem_buf(pem.data(), int(pem.size())), &BIO_free);
+    e->key.reset(PEM_read_bio_PrivateKey(kbio.get(), nullptr, &certificate_store::no_password, nullptr));
+    if(!e->key) {
+      ERR_clear_error();
+      throw systemicai::common::exception("No private key in: [" + key + "]");
+    }
+    if(X509_check_private_key(e->certificate.get(), e->key.get()) != 1) {
+      ERR_clear_error();
+      throw systemicai::common::exception("The key [" + key + "] is not the key of the certificate [" + certificate + "]");
+    }
+    e->names = names(e->certificate.get());
+    return e;
+  }
+
+private:
+  struct table {
+    std::shared_ptr<const entry> fallback;
+    std::unordered_map<std::string, std::shared_ptr<const entry>> names;
+  };
+
+  static int index() {
+    static int const i = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return i;
+  }
+
+  // Encrypted keys are refused rather than prompted for
+  static int no_password(char*, int, int, void*) {
+    return 0;
+  }
+
+  static std::string slurp(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if(!in)
+      throw systemicai::common::exception("Unable to read: [" + path + "]");
+    return std::string(std::istreambuf_iterator<char>{in}, {});
+  }
+
+  // The subjectAltName DNS names of `x`, or its common name when it has none, in lower case
+  static std::vector<std::string> names(X509* x) {
+    std::vector<std::string> out;
+    auto const sans = static_cast<GENERAL_NAMES*>(X509_get_ext_d2i(x, NID_subject_alt_name, nullptr, nullptr));
+    for(int i = 0; sans && i < sk_GENERAL_NAME_num(sans); ++i) {
+      auto const n = sk_GENERAL_NAME_value(sans, i);
+      if(n->type == GEN_DNS)
+        out.emplace_back(reinterpret_cast<const char*>(ASN1_STRING_get0_data(n->d.dNSName)), ASN1_STRING_length(n->d.dNSName));
+    }
+    GENERAL_NAMES_free(sans);
+    if(out.empty()) {
+      char cn[256];
+      auto const length = X509_NAME_get_text_by_NID(X509_get_subject_name(x), NID_commonName, cn, sizeof(cn));
+      if(length > 0)
+        out.emplace_back(cn, std::size_t(length));
+    }
+    for(auto& n : out)
+      std::transform(n.begin(), n.end(), n.begin(), [](unsigned char c) { return std::tolower(c); });
+    return out;
+  }
+
+  static std::filesystem::file_time_type modified(const std::string& path) {
+    std::error_code ec;
+    auto const t = std::filesystem::last_write_time(path, ec);
+    return ec ? std::filesystem::file_time_type::min() : t;
+  }
+
+  static std::vector<std::pair<std::string, std::filesystem::file_time_type>> stamp(const settings& s) {
+    std::vector<std::pair<std::string, std::filesystem::file_time_type>> out;
+    for(auto const& path : {s.ssl_certificate, s.ssl_key})
+      out.emplace_back(path, modified(path));
+    for(auto& c : s.ssl_certificates)
+      for(auto const& path : {c.certificate, c.key})
+        out.emplace_back(path, modified(path));
+    return out;
+  }
+
+  // Replaces every certificate the connection took from the context with the one selected for its server name
+  static int on_servername(SSL* ssl, int* alert, void*) {
+    auto const self = static_cast<certificate_store*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), index()));
+    if(!self)
+      return SSL_TLSEXT_ERR_NOACK;
+    auto const name = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
+    auto const e = self->select(name ? name : "");
+    SSL_certs_clear(ssl);
+    if(SSL_use_cert_and_key(ssl, e->certificate.get(), e->key.get(), e->chain.get(), 1) != 1) {
+      *alert = SSL_AD_INTERNAL_ERROR;
+      return SSL_TLSEXT_ERR_ALERT_FATAL;
+    }
+    return SSL_TLSEXT_ERR_OK;
+  }
+
+  SSL_CTX* ctx_;
+  // Guards current_ and stamps_, held for a pointer copy by the handshakes
+  mutable std::mutex mutex_;
+  std::shared_ptr<const table> current_;
+  std::vector<std::pair<std::string, std::filesystem::file_time_type>> stamps_;
+  std::atomic<std::uint64_t> generation_{0};
+  // Guards pending_, the reload running in the background
+  std::mutex reload_mutex_;
+  std::future<void> pending_;
+};
+
+} // namespace systemicai::http::server
+
+#endif // SYSTEMICAI_HTTP_SERVER_CERTIFICATE_STORE_H
@@ -0,0 +1,205 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_COMPRESSED_CACHE_H
+#define SYSTEMICAI_HTTP_SERVER_COMPRESSED_CACHE_H
+
+/**
+  Document root files compressed on demand.
+
+  A text asset requested with Accept-Encoding: gzip, and without a precompressed .gz sibling, is compressed with zlib
+  by the io thread of the first such request.  The result is kept up to a byte budget shared by every io thread, the
+  least recently used evicted first, so the file is not compressed again for every client.  The requests missing it
+  while the first compresses it are served the file as it is.
+
+  An entry remembers the identity of the file it was compressed from, and is used only while the open_file of the
+  request still has that identity: a change of the file is noticed when the open_file_cache revalidates it, without a
+  watcher of its own.  Entries are immutable and reference counted like those of the file_cache.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#include <unistd.h>
+#include <zlib.h>
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/open_file_cache.h>
+
+namespace systemicai::http::server {
+
+class compressed_cache {
+public:
+  // The gzip encoding of a file, with what identified the file when it was read
+  struct entry {
+    std::string path;
+    std::string data;
+    std::uint64_t inode;
+    std::uint64_t size;
+    // Modification time in nanoseconds since the epoch
+    std::int64_t mtime;
+
+    // True when the encoding failed or saves nothing, and the file is better sent as it is
+    bool useless() const {
+      return data.empty() || data.size() >= size;
+    }
+  };
+
+  struct counters {
+    std::uint64_t hits;
+    std::uint64_t misses;
+    std::uint64_t evictions;
+    std::size_t files;
+    std::size_t bytes;
+  };
+
+  // The cache of the process, configured by the service from settings::limit_compressed_cache
+  static compressed_cache& global() {
+    static compressed_cache cache;
+    return cache;
+  }
+
+  compressed_cache() = default;
+  compressed_cache(const compressed_cache&) = delete;
+  compressed_cache& operator=(const compressed_cache&) = delete;
+
+  /**
+   * Keep up to `bytes` of compressed files, compressing none larger than `file_bytes` at zlib `level`.  A smaller
+   * budget evicts down to it, 0 empties and disables the cache, and with it compression on demand.
+   */
+  void limit(std::size_t bytes, std::size_t file_bytes, int level) {
+    std::lock_guard<std::mutex> lg(mutex_);
+    budget_ = bytes;
+    file_limit_ = file_bytes;
+    level_ = level;
+    while(bytes_ > budget_)
+      evict();
+  }
+
+  /**
+   * The encoding of `path` as `file` is now, compressed from it and cached on a miss.
+   * @return Null when the file cannot be read whole, is not admitted, or another request is compressing it
+   */
+  std::shared_ptr<const entry> get(std::string_view path, const open_file& file) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if(budget_ == 0 || file.size > file_limit_)
+      return nullptr;
+    if(auto const found = index_.find(path); found != index_.end()) {
+      auto const& e = *found->second;
+      if(e->inode == file.inode && e->mtime == file.mtime && e->size == file.size) {
+        lru_.splice(lru_.begin(), lru_, found->second);
+        ++hits_;
+        return e;
+      }
+    }
+    ++misses_;
+    if(compressing_.find(path) != compressing_.end())
+      return nullptr;
+    auto const level = level_;
+
+    // Read and compress without the lock, the other misses of the file meanwhile go without.  Their insertions may
+    // rehash the set, so the path is erased by key rather than by an iterator kept across the unlock.
+    compressing_.emplace(path);
+    lock.unlock();
+    auto e = compress(path, file, level);
+    lock.lock();
+    compressing_.erase(compressing_.find(path));
+    if(!e)
+      return nullptr;
+    if(auto const found = index_.find(path); found != index_.end())
+      remove(found->second);
+    auto const bytes = e->data.size();
+    if(budget_ == 0 || bytes > budget_)
+      return e;
+    while(bytes_ + bytes > budget_)
+      evict();
+    lru_.push_front(e);
+    index_.emplace(e->path, lru_.begin());
+    bytes_ += bytes;
+    return e;
+  }
+
+  counters stats() const {
+    std::lock_guard<std::mutex> lg(mutex_);
+    return counters{hits_, misses_, evictions_, lru_.size(), bytes_};
+  }
+
+  // `content` in the gzip format of RFC 1952, empty on failure
+  static std::string gzip(std::string_view content, int level) {
+    z_stream z{};
+    // 16 added to the window bits asks for a gzip header and trailer instead of zlib's
+    if(::deflateInit2(&z, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      return {};
+    std::string out(::deflateBound(&z, uLong(content.size())), '\0');
+    z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(content.data()));
+    z.avail_in = uInt(content.size());
+    z.next_out = reinterpret_cast<Bytef*>(out.data());
+    z.avail_out = uInt(out.size());
+    auto const status = ::deflate(&z, Z_FINISH);
+    out.resize(z.total_out);
+    ::deflateEnd(&z);
+    if(status != Z_STREAM_END)
+      return {};
+    return out;
+  }
+
+private:
+  using list = std::list<std::shared_ptr<const entry>>;
+
+  struct path_hash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view s) const {
+      return std::hash<std::string_view>{}(s);
+    }
+  };
+
+  // Read `file` whole and compress it, null when it cannot be read
+  static std::shared_ptr<const entry> compress(std::string_view path, const open_file& file, int level) {
+    std::string content(file.size, '\0');
+    std::size_t read = 0;
+    while(read < content.size()) {
+      auto const n = ::pread(file.fd, content.data() + read, content.size() - read, off_t(read));
+      if(n <= 0)
+        return nullptr;
+      read += std::size_t(n);
+    }
+    return std::make_shared<const entry>(entry{std::string(path), gzip(content, level), file.inode, file.size, file.mtime});
+  }
+
+  void remove(list::iterator it) {
+    bytes_ -= (*it)->data.size();
+    index_.erase(index_.find(std::string_view((*it)->path)));
+    lru_.erase(it);
+  }
+
+  void evict() {
+    remove(std::prev(lru_.end()));
+    ++evictions_;
+  }
+
+  // Guards everything below, shared by the io threads
+  mutable std::mutex mutex_;
+  std::size_t budget_ = 0;
+  std::size_t file_limit_ = 0;
+  int level_ = Z_DEFAULT_COMPRESSION;
+  // Most recently used first
+  list lru_;
+  std::unordered_map<std::string, list::iterator, path_hash, std::equal_to<>> index_;
+  // The paths being compressed by a miss
+  std::unordered_set<std::string, path_hash, std::equal_to<>> compressing_;
+  std::size_t bytes_ = 0;
+  std::uint64_t hits_ = 0;
+  std::uint64_t misses_ = 0;
+  std::uint64_t evictions_ = 0;
+};
+
+} // namespace systemicai::http::server
+
+#endif // SYSTEMICAI_HTTP_SERVER_COMPRESSED_CACHE_H
@@ -0,0 +1,142 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_CONNECTION_LIMIT_H
+#define SYSTEMICAI_HTTP_SERVER_CONNECTION_LIMIT_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace systemicai::http::server {
+
+/**
+ * Counts the open connections of a service and caps them.
+ *
+ * Listeners acquire a slot for every connection they accept.  When no slot is available a listener registers
+ * a resume callback with wait() and stops accepting, the callback is invoked once a session releases its slot.
+ * A single instance is shared by all the listeners of a service.
+ */
+class connection_limit {
+public:
+  /**
+   * @param max Maximum number of concurrent connections, 0 for no limit
+   */
+  explicit connection_limit(std::size_t max = 0) : count_(0), waiters_(0), max_(max) {
+  }
+
+  connection_limit(const connection_limit&) = delete;
+  connection_limit& operator=(const connection_limit&) = delete;
+
+  // Take a slot, returns false if the limit is reached
+  bool try_acquire() {
+    auto c = count_.load();
+    do {
+      if(max_ != 0 && c >= max_)
+        return false;
+    } while(!count_.compare_exchange_weak(c, c + 1));
+    return true;
+  }
+
+  // Give a slot back, resumes a waiting listener if there is one
+  void release() {
+    count_.fetch_sub(1);
+    if(waiters_.load() != 0)
+      resume_one();
+  }
+
+  /**
+   * Register a callback to be invoked once a slot may be available.  The callback is invoked at most once, possibly
+   * from within this call or from the thread that releases a slot, so it should only post work.
+   */
+  void wait(std::function<void()> resume) {
+    {
+      std::lock_guard<std::mutex> lg(mutex_);
+      waiting_.push_back(std::move(resume));
+      ++waiters_;
+    }
+    // A slot may have been released before we were registered
+    if(max_ == 0 || count_.load() < max_)
+      resume_one();
+  }
+
+  // Drop the waiting callbacks without invoking them, they own the paused listeners
+  void clear() {
+    std::lock_guard<std::mutex> lg(mutex_);
+    waiting_.clear();
+    waiters_ = 0;
+  }
+
+  // The number of open connections
+  std::size_t count() const {
+    return count_.load();
+  }
+
+  std::size_t max() const {
+    return max_;
+  }
+
+private:
+  void resume_one() {
+    std::function<void()> f;
+    {
+      std::lock_guard<std::mutex> lg(mutex_);
+      if(waiting_.empty())
+        return;
+      f = std::move(waiting_.front());
+      waiting_.erase(waiting_.begin());
+      --waiters_;
+    }
+    f();
+  }
+
+  std::atomic<std::size_t> count_;
+  std::atomic<std::size_t> waiters_;
+  const std::size_t max_;
+  std::mutex mutex_;
+  std::vector<std::function<void()>> waiting_;
+};
+
+/**
+ * Holds one slot of a connection_limit for the lifetime of a connection.  It is moved from session to session as
+ * the connection is handed off (detect -> http -> websocket) and releases the slot when the last owner is destroyed.
+ */
+class connection_token {
+public:
+  connection_token() = default;
+
+  // Adopts a slot which has already been acquired from `limit`
+  explicit connection_token(std::shared_ptr<connection_limit> limit) : limit_(std::move(limit)) {
+  }
+
+  connection_token(connection_token&& t) noexcept : limit_(std::move(t.limit_)) {
+  }
+
+  connection_token& operator=(connection_token&& t) noexcept {
+    if(this != &t) {
+      reset();
+      limit_ = std::move(t.limit_);
+    }
+    return *this;
+  }
+
+  connection_token(const connection_token&) = delete;
+  connection_token& operator=(const connection_token&) = delete;
+
+  ~connection_token() {
+    reset();
+  }
+
+  void reset() {
+    if(limit_) {
+      limit_->release();
+      limit_.reset();
+    }
+  }
+
+private:
+  std::shared_ptr<connection_limit> limit_;
+};
+
+} // namespace systemicai::http::server
+
+#endif // SYSTEMICAI_HTTP_SERVER_CONNECTION_LIMIT_H
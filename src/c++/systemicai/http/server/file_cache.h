@@ -0,0 +1,308 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_FILE_CACHE_H
+#define SYSTEMICAI_HTTP_SERVER_FILE_CACHE_H
+
+/**
+  Files of the document root kept in memory.
+
+  A few hundred small files make up most of the traffic of a site, and each GET of one opened, read and closed it.
+  The cache keeps the content of the files read by default_handle_request, keyed by their path, up to a byte budget
+  shared by every io thread.  Entries are immutable and reference counted: responses hold the entry they are sent
+  from, so an eviction or invalidation never waits for them and never changes bytes being written.
+
+  Eviction follows the CLOCK algorithm, a second chance approximation of LRU: a hit sets the referenced bit of its
+  entry, and the hand sweeping for room clears set bits and evicts the first entry found without one.
+
+  The directories of cached files are watched with inotify by a thread of the cache, any change to a file, its
+  replacement or removal drops its entry.  The notification is asynchronous, a response may still be sent from the
+  previous content until the watcher has read it.
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/open_file_cache.h>
+
+namespace systemicai::http::server {
+
+class file_cache {
+public:
+  // The content of a file as it was read, with what identified it then
+  struct entry {
+    std::string path;
+    std::string data;
+    std::uint64_t inode;
+    // Modification time in nanoseconds since the epoch
+    std::int64_t mtime;
+  };
+
+  struct counters {
+    std::uint64_t hits;
+    std::uint64_t misses;
+    std::uint64_t evictions;
+    std::uint64_t invalidations;
+    std::size_t files;
+    std::size_t bytes;
+  };
+
+  // The cache of the process, configured by the service from settings::limit_file_cache
+  static file_cache& global() {
+    static file_cache cache;
+    return cache;
+  }
+
+  // Disabled until limit() gives it a budget
+  file_cache()
+          : inotify_(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+          , stop_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+  {
+    if(inotify_ >= 0 && stop_ >= 0)
+      watcher_ = std::thread([this] { watch(); });
+  }
+
+  file_cache(const file_cache&) = delete;
+  file_cache& operator=(const file_cache&) = delete;
+
+  ~file_cache() {
+    if(watcher_.joinable()) {
+      std::uint64_t const one = 1;
+      [[maybe_unused]] auto const n = ::write(stop_, &one, sizeof(one));
+      watcher_.join();
+    }
+    if(inotify_ >= 0)
+      ::close(inotify_);
+    if(stop_ >= 0)
+      ::close(stop_);
+  }
+
+  /**
+   * Keep up to `bytes` of files, none larger than `file_bytes`.  A smaller budget evicts down to it, 0 empties and
+   * disables the cache.  The cache stays disabled where inotify is not available.
+   */
+  void limit(std::size_t bytes, std::size_t file_bytes) {
+    std::lock_guard<std::mutex> lg(mutex_);
+    budget_.store(watcher_.joinable() ? bytes : 0, std::memory_order_relaxed);
+    file_limit_.store(file_bytes, std::memory_order_relaxed);
+    while(bytes_ > budget_.load(std::memory_order_relaxed))
+      evict();
+  }
+
+  // True when a file of `size` bytes would be cached
+  bool admits(std::uint64_t size) const {
+    auto const budget = budget_.load(std::memory_order_relaxed);
+    return budget != 0 && size <= budget && size <= file_limit_.load(std::memory_order_relaxed);
+  }
+
+  // The cached content of `path`, null when it is not cached
+  std::shared_ptr<const entry> find(std::string_view path) {
+    if(budget_.load(std::memory_order_relaxed) == 0)
+      return nullptr;
+    std::lock_guard<std::mutex> lg(mutex_);
+    auto const found = index_.find(path);
+    if(found == index_.end()) {
+      ++misses_;
+      return nullptr;
+    }
+    auto& s = slots_[found->second];
+    s.referenced = true;
+    ++hits_;
+    return s.file;
+  }
+
+  /**
+   * Cache `data`, the content of `path` read from `file`.  Its directory is watched first, then the file checked to
+   * still be the one read, so no change goes unnoticed.
+   * @return The entry to respond with, cached or not when it is too large, or the file changed since it was read
+   */
+  std::shared_ptr<const entry> insert(std::string path, const open_file& file, std::string data) {
+    auto e = std::make_shared<entry>(entry{std::move(path), std::move(data), file.inode, file.mtime});
+    if(!admits(e->data.size()))
+      return e;
+
+    auto const slash = e->path.rfind('/');
+    auto const directory = slash == std::string::npos ? std::string(".") : slash == 0 ? std::string("/") : e->path.substr(0, slash);
+    auto const name = slash == std::string::npos ? e->path : e->path.substr(slash + 1);
+
+    std::lock_guard<std::mutex> lg(mutex_);
+    // limit() may have lowered the budget since
+    if(!admits(e->data.size()))
+      return e;
+    auto const wd = ::inotify_add_watch(inotify_, directory.c_str(), watched);
+    if(wd < 0)
+      return e;
+    struct stat now;
+    if(::stat(e->path.c_str(), &now) != 0 || !file.same(now) || file.size != e->data.size()) {
+      if(directories_.find(wd) == directories_.end())
+        ::inotify_rm_watch(inotify_, wd);
+      return e;
+    }
+
+    if(auto const found = index_.find(std::string_view(e->path)); found != index_.end())
+      remove(found->second);
+    while(bytes_ + e->data.size() > budget_.load(std::memory_order_relaxed))
+      evict();
+    std::size_t i;
+    if(free_.empty()) {
+      i = slots_.size();
+      slots_.emplace_back();
+    } else {
+      i = free_.back();
+      free_.pop_back();
+    }
+    slots_[i] = slot{e, wd, name, false};
+    index_.emplace(e->path, i);
+    directories_[wd].emplace(name, i);
+    bytes_ += e->data.size();
+    return e;
+  }
+
+  counters stats() const {
+    std::lock_guard<std::mutex> lg(mutex_);
+    return counters{hits_, misses_, evictions_, invalidations_, index_.size(), bytes_};
+  }
+
+private:
+  // Changes to a file of a watched directory, and to the directory itself
+  static constexpr std::uint32_t watched = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE |
+                                           IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+
+  struct slot {
+    std::shared_ptr<const entry> file;
+    int wd = -1;
+    std::string name;
+    bool referenced = false;
+  };
+
+  // Hashes std::string and std::string_view alike, so lookups by a path of the session's arena do not copy it
+  struct path_hash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view s) const {
+      return std::hash<std::string_view>{}(s);
+    }
+  };
+
+  // Drop slot `i`, and the watch of its directory with its last file
+  void remove(std::size_t i) {
+    auto& s = slots_[i];
+    bytes_ -= s.file->data.size();
+    index_.erase(index_.find(std::string_view(s.file->path)));
+    auto const d = directories_.find(s.wd);
+    if(d != directories_.end()) {
+      auto const [first, last] = d->second.equal_range(s.name);
+      for(auto it = first; it != last; ++it)
+        if(it->second == i) {
+          d->second.erase(it);
+          break;
+        }
+      if(d->second.empty()) {
+        ::inotify_rm_watch(inotify_, s.wd);
+        directories_.erase(d);
+      }
+    }
+    s = slot{};
+    free_.push_back(i);
+  }
+
+  // Advance the hand to the first entry not referenced since it last passed, and evict it
+  void evict() {
+    for(;;) {
+      if(hand_ >= slots_.size())
+        hand_ = 0;
+      auto& s = slots_[hand_];
+      auto const i = hand_++;
+      if(!s.file)
+        continue;
+      if(s.referenced) {
+        s.referenced = false;
+        continue;
+      }
+      remove(i);
+      ++evictions_;
+      return;
+    }
+  }
+
+  // Drop the files named `name` of the directory `wd`, every file of it when `name` is empty
+  void invalidate(int wd, std::string_view name) {
+    auto const d = directories_.find(wd);
+    if(d == directories_.end())
+      return;
+    std::vector<std::size_t> drop;
+    for(auto& [n, i] : d->second)
+      if(name.empty() || n == name)
+        drop.push_back(i);
+    for(auto i : drop) {
+      remove(i);
+      ++invalidations_;
+    }
+  }
+
+  // The watcher thread, until the destructor signals stop_
+  void watch() {
+    alignas(struct inotify_event) char buffer[16384];
+    for(;;) {
+      pollfd fds[2] = {{inotify_, POLLIN, 0}, {stop_, POLLIN, 0}};
+      if(::poll(fds, 2, -1) < 0)
+        continue;
+      if(fds[1].revents != 0)
+        return;
+      auto const n = ::read(inotify_, buffer, sizeof(buffer));
+      if(n <= 0)
+        continue;
+      std::lock_guard<std::mutex> lg(mutex_);
+      for(char* p = buffer; p < buffer + n;) {
+        auto const e = reinterpret_cast<const struct inotify_event*>(p);
+        if(e->mask & IN_Q_OVERFLOW) {
+          // Events were lost, any file may have changed
+          while(!index_.empty())
+            invalidate(slots_[index_.begin()->second].wd, {});
+        } else if(e->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT)) {
+          invalidate(e->wd, {});
+        } else if(e->len != 0) {
+          invalidate(e->wd, e->name);
+        }
+        p += sizeof(struct inotify_event) + e->len;
+      }
+    }
+  }
+
+  int inotify_;
+  int stop_;
+  std::thread watcher_;
+  std::atomic<std::size_t> budget_{0};
+  std::atomic<std::size_t> file_limit_{0};
+
+  // Guards everything below, shared by the io threads and the watcher
+  mutable std::mutex mutex_;
+  std::vector<slot> slots_;
+  std::vector<std::size_t> free_;
+  std::size_t hand_ = 0;
+  std::unordered_map<std::string, std::size_t, path_hash, std::equal_to<>> index_;
+  // The slots of each watched directory by file name
+  std::unordered_map<int, std::unordered_multimap<std::string, std::size_t>> directories_;
+  std::size_t bytes_ = 0;
+  std::uint64_t hits_ = 0;
+  std::uint64_t misses_ = 0;
+  std::uint64_t evictions_ = 0;
+  std::uint64_t invalidations_ = 0;
+};
+
+} // namespace systemicai::http::server
+
+#endif // SYSTEMICAI_HTTP_SERVER_FILE_CACHE_H
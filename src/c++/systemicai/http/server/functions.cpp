@@ -1,6 +1,10 @@
 #include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/functions.h>
 #include <iostream>
 
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace systemicai::http::server {
 
     // Return a reasonable mime type based on the extension of a file.
@@ -39,28 +43,61 @@ namespace systemicai::http::server {
         return "application/text";
     }
 
+    // True when a file of that path is text worth compressing, by its mime type.
+    bool compressible(beast::string_view path)
+    {
+        using beast::iequals;
+        auto const type = mime_type(path);
+        if(type.starts_with("text/"))
+            return true;
+        if(type == "image/svg+xml")
+            return !iequals(path.substr(path.size() - std::min<std::size_t>(path.size(), 5)), ".svgz");
+        return type == "application/javascript" || type == "application/json" || type == "application/xml";
+    }
+
+    // True when an Accept-Encoding field value accepts the gzip content coding,
+    // by name or by "*", with a quality other than 0.
+    bool accepts_gzip(beast::string_view accept_encoding)
+    {
+        using beast::iequals;
+        auto const trim = [](beast::string_view s)
+        {
+            while(!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+                s.remove_prefix(1);
+            while(!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+                s.remove_suffix(1);
+            return s;
+        };
+        // An explicit gzip takes precedence over "*", whatever their order
+        int gzip = -1, any = -1;
+        while(!accept_encoding.empty())
+        {
+            auto const comma = accept_encoding.find(',');
+            auto element = accept_encoding.substr(0, comma);
+            accept_encoding = comma == beast::string_view::npos ? beast::string_view{} : accept_encoding.substr(comma + 1);
+            auto const semicolon = element.find(';');
+            auto const coding = trim(element.substr(0, semicolon));
+            // The weight is 0 when its digits are all zeroes, as in "q=0" or "q=0.000"
+            bool accepted = true;
+            if(semicolon != beast::string_view::npos)
+            {
+                auto const weight = trim(element.substr(semicolon + 1));
+                if(weight.size() > 2 && (weight[0] == 'q' || weight[0] == 'Q') && weight[1] == '=')
+                    accepted = weight.substr(2).find_first_not_of("0.") != beast::string_view::npos;
+            }
+            if(iequals(coding, "gzip") || iequals(coding, "x-gzip"))
+                gzip = accepted;
+            else if(coding == "*")
+                any = accepted;
+        }
+        return gzip == -1 ? any == 1 : gzip == 1;
+    }
+
     // Append an HTTP rel-path to a local filesystem path.
     // The returned path is normalized for the platform.
     // cppcheck-suppress "unusedFunction"
     std::string path_cat( beast::string_view base, beast::string_view path) {
-        if(base.empty())
-            return std::string(path);
-        std::string result(base);
-    #ifdef BOOST_MSVC
-        char constexpr path_separator = '\\';
-        if(result.back() == path_separator)
-            result.resize(result.size() - 1);
-        result.append(path.data(), path.size());
-        for(auto& c : result)
-            if(c == '/')
-                c = path_separator;
-    #else
-        char constexpr path_separator = '/';
-        if(result.back() == path_separator)
-            result.resize(result.size() - 1);
-        result.append(path.data(), path.size());
-    #endif
-        return result;
+        return path_cat(base, path, std::allocator<char>());
     }
 
     // Report a failure
@@ -89,4 +126,53 @@ namespace systemicai::http::server {
         std::cerr << what << ": " << ec.message() << "\n";
     }
 
+    std::string upload_name(beast::string_view target)
+    {
+        auto const query = target.find('?');
+        if(query != beast::string_view::npos)
+            target = target.substr(0, query);
+
+        auto const hex = [](char c) -> int
+        {
+            if(c >= '0' && c <= '9') return c - '0';
+            if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return -1;
+        };
+        std::string name;
+        name.reserve(target.size());
+        for(std::size_t i = 0; i < target.size(); ++i)
+        {
+            char c = target[i];
+            if(c == '%')
+            {
+                if(i + 2 >= target.size())
+                    return {};
+                auto const high = hex(target[i + 1]);
+                auto const low = hex(target[i + 2]);
+                if(high < 0 || low < 0)
+                    return {};
+                c = static_cast<char>(high << 4 | low);
+                i += 2;
+            }
+            if(c == '/' || c == '\0')
+                return {};
+            name.push_back(c);
+        }
+        if(name.empty() || name.front() == '.')
+            return {};
+        return name;
+    }
+
+    bool remove_socket_file(std::string const& path)
+    {
+        struct stat st;
+        if(::lstat(path.c_str(), &st) != 0)
+            return true;
+        if(! S_ISSOCK(st.st_mode))
+            return false;
+        ::unlink(path.c_str());
+        return true;
+    }
+
 } // namespace systemicai::http::server
\ No newline at end of file
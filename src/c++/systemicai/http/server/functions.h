@@ -20,13 +20,53 @@ namespace systemicai::http::server {
     // Return a reasonable mime type based on the extension of a file.
     beast::string_view mime_type(beast::string_view path);
 
+    // True when a file of that path is text worth compressing, by its mime type.
+    bool compressible(beast::string_view path);
+
+    // True when an Accept-Encoding field value accepts the gzip content coding,
+    // by name or by "*", with a quality other than 0.
+    bool accepts_gzip(beast::string_view accept_encoding);
+
     // Append an HTTP rel-path to a local filesystem path.
     // The returned path is normalized for the platform.
     std::string path_cat( beast::string_view base, beast::string_view path);
 
+    // As above, the result is allocated with `alloc`
+    template<class Allocator>
+    std::basic_string<char, std::char_traits<char>, Allocator>
+    path_cat( beast::string_view base, beast::string_view path, Allocator const& alloc) {
+        std::basic_string<char, std::char_traits<char>, Allocator> result(alloc);
+        result.reserve(base.size() + path.size() + sizeof("index.html"));
+        result.append(base.data(), base.size());
+    #ifdef BOOST_MSVC
+        char constexpr path_separator = '\\';
+        if(!result.empty() && result.back() == path_separator)
+            result.resize(result.size() - 1);
+        result.append(path.data(), path.size());
+        for(auto& c : result)
+            if(c == '/')
+                c = path_separator;
+    #else
+        char constexpr path_separator = '/';
+        if(!result.empty() && result.back() == path_separator)
+            result.resize(result.size() - 1);
+        result.append(path.data(), path.size());
+    #endif
+        return result;
+    }
+
+    // The file name an upload target names after its route prefix, without the
+    // query and percent-decoded.  Empty unless it is a single file name: no '/'
+    // or NUL, and not starting with a dot, which also excludes "..".
+    std::string upload_name(beast::string_view target);
+
     // Report a failure
     void fail(beast::error_code ec, char const* what);
 
+    // Remove the unix domain socket file at `path`, anything else found there
+    // is left alone.  Returns false when `path` exists and is not a socket.
+    bool remove_socket_file(std::string const& path);
+
 } // namespace systemicai::http::server  
 
 #endif // SYSTEMICAI_HTTP_SERVER_FUNCTIONS_H
\ No newline at end of file
@@ -0,0 +1,189 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_HANDLER_WATCHDOG_H
+#define SYSTEMICAI_HTTP_SERVER_HANDLER_WATCHDOG_H
+
+/**
+  Deadlines of the request handlers.
+
+  Request handlers run inline on the io threads, which cannot expire their own deadline until the handler returns.
+  Every io thread publishes the deadline of the handler it runs in a slot of its own, with a few atomic stores and no
+  lock.  A watchdog thread scans the slots once per tick and answers for the handlers overrunning theirs.
+
+  A slot is claimed with a compare-and-swap by the watchdog expiring it, or by the io thread once its handler returns,
+  whichever comes first.  An io thread whose handler was claimed waits for the watchdog to be done with it before going
+  on, so the socket the watchdog writes to is held open by the session throughout.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include <systemicai/http/server/namespace.h>
+
+namespace systemicai::http::server {
+
+class handler_watchdog {
+public:
+  using clock = std::chrono::steady_clock;
+
+  static constexpr clock::duration tick = std::chrono::milliseconds(100);
+
+  /**
+   * The handler deadline of one io thread.  `state_` holds the number of the current handler above its phase, so the
+   * watchdog can never claim a later handler than the one it saw overrun.
+   */
+  class slot {
+  public:
+    slot() {
+      instance().add(*this);
+    }
+
+    ~slot() {
+      instance().remove(*this);
+    }
+
+    slot(const slot&) = delete;
+    slot& operator=(const slot&) = delete;
+
+    /**
+     * A handler starts on this thread and is due `d` from now, on the connected socket `fd` of its session
+     * @param answer Bytes written to `fd` reach the client as they are, and no response is partly written
+     */
+    void start(int fd, bool answer, clock::duration d) {
+      fd_ = fd;
+      answer_ = answer;
+      due_.store((clock::now() + d).time_since_epoch().count(), std::memory_order_relaxed);
+      auto const number = (state_.load(std::memory_order_relaxed) >> 2) + 1;
+      state_.store(number << 2 | running, std::memory_order_release);
+    }
+
+    // The handler returned, true if the watchdog answered for it
+    bool finish() {
+      auto const number = state_.load(std::memory_order_relaxed) & ~phase;
+      auto s = number | running;
+      if(state_.compare_exchange_strong(s, number | idle, std::memory_order_acq_rel))
+        return false;
+      // Claimed by the watchdog, the session must not close the socket before it is done
+      while((s & phase) == expiring) {
+        std::this_thread::yield();
+        s = state_.load(std::memory_order_acquire);
+      }
+      state_.store(number | idle, std::memory_order_relaxed);
+      return true;
+    }
+
+  private:
+    friend class handler_watchdog;
+
+    static constexpr std::uint64_t idle = 0;
+    static constexpr std::uint64_t running = 1;
+    static constexpr std::uint64_t expiring = 2;
+    static constexpr std::uint64_t expired = 3;
+    static constexpr std::uint64_t phase = 3;
+
+    // Called on the watchdog thread
+    void expire(clock::rep now) {
+      auto s = state_.load(std::memory_order_acquire);
+      if((s & phase) != running || now < due_.load(std::memory_order_relaxed))
+        return;
+      if(!state_.compare_exchange_strong(s, (s & ~phase) | expiring, std::memory_order_acq_rel))
+        return;
+
+      static constexpr char response[] =
+          "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+      // Never blocks the watchdog, a full socket buffer loses the 503 but not the shutdown
+      if(answer_)
+        ::send(fd_, response, sizeof(response) - 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+      ::shutdown(fd_, SHUT_RDWR);
+      state_.store((s & ~phase) | expired, std::memory_order_release);
+    }
+
+    // Written by the io thread before its handler is published in state_
+    int fd_ = -1;
+    bool answer_ = false;
+    std::atomic<clock::rep> due_{0};
+    std::atomic<std::uint64_t> state_{idle};
+  };
+
+  // The slot of the calling io thread
+  static slot& local() {
+    thread_local slot s;
+    return s;
+  }
+
+private:
+  static handler_watchdog& instance() {
+    static handler_watchdog w;
+    return w;
+  }
+
+  handler_watchdog() : thread_([this] { run(); }) {
+  }
+
+  ~handler_watchdog() {
+    {
+      std::lock_guard<std::mutex> lg(mutex_);
+      stopped_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+  }
+
+  // Only when an io thread starts or exits, a slot is removed once the watchdog is not scanning it
+  void add(slot& s) {
+    std::lock_guard<std::mutex> lg(mutex_);
+    slots_.push_back(&s);
+  }
+
+  void remove(slot& s) {
+    std::lock_guard<std::mutex> lg(mutex_);
+    slots_.erase(std::find(slots_.begin(), slots_.end(), &s));
+  }
+
+  void run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while(!wake_.wait_for(lock, tick, [this] { return stopped_; })) {
+      auto const now = clock::now().time_since_epoch().count();
+      for(auto s : slots_)
+        s->expire(now);
+    }
+  }
+
+  // Guards the list of slots, never taken by a request
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::vector<slot*> slots_;
+  bool stopped_ = false;
+  std::thread thread_;
+};
+
+/**
+ * The deadline of a request handler.  The session's thread is busy in the handler until it returns, so the watchdog
+ * expires it: it sends a 503 on the socket if nothing else is being written to it, and shuts the connection down.
+ * The session discards the late response of the handler.
+ */
+class handler_deadline {
+public:
+  /**
+   * Expire `d` from now, on the connected socket `fd` the session keeps open until finish() returns
+   * @param answer Bytes written to `fd` reach the client as they are, and no response is partly written
+   */
+  void start(int fd, bool answer, handler_watchdog::clock::duration d) {
+    handler_watchdog::local().start(fd, answer, d);
+  }
+
+  // The handler returned, true if it overran the deadline.  Called on the thread that started it.
+  bool finish() {
+    return handler_watchdog::local().finish();
+  }
+};
+
+} // namespace systemicai::http::server
+
+#endif // SYSTEMICAI_HTTP_SERVER_HANDLER_WATCHDOG_H
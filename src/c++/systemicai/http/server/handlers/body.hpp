@@ -0,0 +1,241 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_HANDLERS_BODY_HPP
+#define SYSTEMICAI_HTTP_SERVER_HANDLERS_BODY_HPP
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/settings.h>
+#include <systemicai/http/server/functions.h>
+#include "handler.hpp"
+
+namespace systemicai::http::server::handlers {
+
+// The session reading a streamed request body, a body_handler that returned false from on_body() calls resume()
+// once it is ready for the next chunk.  It may be called from any thread, once per pause, and the session stays
+// alive until it is.
+class body_source {
+public:
+  virtual ~body_source() = default;
+  virtual void resume() = 0;
+};
+
+/**
+ * Receives the body of a request in chunks as they arrive instead of buffered in the request.  It is chosen once the
+ * header is parsed and the session reads the next chunk only when the handler asks for it, so a connection holds one
+ * chunk of the body at a time however large it is.
+ */
+template<class Send>
+class body_handler {
+public:
+  virtual ~body_handler() = default;
+
+  // A chunk of the body, the data is only valid for the call.  Returns false to pause reading until
+  // body_source::resume().  Setting `ec` abandons the body, on_complete() is called with it.
+  virtual bool on_body(net::const_buffer chunk, beast::error_code& ec) = 0;
+
+  // Sends the response once the whole body arrived, or with `ec` set when it could not be read or handled.  The
+  // connection is closed after an error response, the rest of the body is not read.
+  virtual void on_complete(Send& send, beast::error_code ec) = 0;
+
+  // Called by the session before the first chunk
+  void attach(body_source& source) {
+    source_ = &source;
+  }
+
+protected:
+  // The session to resume after a pause
+  body_source& source() {
+    return *source_;
+  }
+
+private:
+  body_source* source_ = nullptr;
+};
+
+/**
+ * Body handlers added by the application at startup, before the service starts.  They are asked in order, before the
+ * upload routes, for the requests whose body is streamed: a factory returns nullptr for those it does not handle.
+ */
+template<class Send, class Allocator>
+class body_handler_registry {
+public:
+  using header_type = beast::http::request_header<beast::http::basic_fields<Allocator>>;
+  using factory = std::function<std::unique_ptr<body_handler<Send>>(const header_type&, const settings&)>;
+
+  static body_handler_registry& global() {
+    static body_handler_registry registry;
+    return registry;
+  }
+
+  void add(factory f) {
+    factories_.push_back(std::move(f));
+  }
+
+  std::unique_ptr<body_handler<Send>> select(const header_type& req, const settings& s) const {
+    for(auto& f : factories_)
+      if(auto handler = f(req, s))
+        return handler;
+    return nullptr;
+  }
+
+private:
+  std::vector<factory> factories_;
+};
+
+// Writes a PUT or POST body to a file under the route's upload directory.  The body goes to a temporary file of its
+// own, ".<name>.XXXXXX" which no upload name can clash with, renamed over the target once complete: readers never see
+// a partial upload, and of concurrent uploads of one name the last to complete wins.
+template<class Allocator, class Send>
+class upload : public body_handler<Send> {
+public:
+  using header_type = beast::http::request_header<beast::http::basic_fields<Allocator>>;
+  using path_type = std::basic_string<char, std::char_traits<char>,
+          typename std::allocator_traits<Allocator>::template rebind_alloc<char>>;
+
+  // `name` is the upload_name() of the target
+  upload(const header_type& req, const route_settings& route, const std::string& name, const settings& s)
+          : req_(req)
+          , s_(s)
+          , path_(route.upload.c_str(), route.upload.size(), typename path_type::allocator_type(req.get_allocator()))
+          , part_(path_.get_allocator())
+  {
+    if(!path_.empty() && path_.back() != '/')
+      path_.push_back('/');
+    part_.append(path_).append(".").append(name.data(), name.size()).append(".XXXXXX");
+    path_.append(name.data(), name.size());
+    auto const fd = ::mkostemp(part_.data(), O_CLOEXEC);
+    if(fd < 0) {
+      ec_ = beast::error_code(errno, beast::generic_category());
+      return;
+    }
+    // Readable like the files the service writes otherwise
+    ::fchmod(fd, 0644);
+    file_.native_handle(fd);
+  }
+
+  ~upload() override {
+    // Abandoned before it completed
+    if(file_.is_open()) {
+      beast::error_code ec;
+      file_.close(ec);
+      std::remove(part_.c_str());
+    }
+  }
+
+  bool on_body(net::const_buffer chunk, beast::error_code& ec) override {
+    if(ec_) {
+      ec = ec_;
+      return false;
+    }
+    auto p = static_cast<const char*>(chunk.data());
+    for(auto n = chunk.size(); n != 0 && !ec;) {
+      auto const written = file_.write(p, n, ec);
+      p += written;
+      n -= written;
+    }
+    return !ec;
+  }
+
+  void on_complete(Send& send, beast::error_code ec) override {
+    if(!ec)
+      ec = ec_;
+    if(!ec)
+      file_.close(ec);
+    if(!ec && std::rename(part_.c_str(), path_.c_str()) != 0)
+      ec = beast::error_code(errno, beast::generic_category());
+
+    if(!ec)
+      return send(text_response(req_, beast::http::status::created, {"Created '", req_.target(), "'"}, s_));
+
+    auto res = ec == beast::http::error::body_limit
+            ? text_response(req_, beast::http::status::payload_too_large, {"The request body is too large"}, s_)
+            : text_response(req_, beast::http::status::internal_server_error, {"An error occurred: '", ec.message(), "'"}, s_);
+    res.keep_alive(false);
+    send(std::move(res));
+  }
+
+private:
+  // A copy of the header, the request is gone by the time the body is complete
+  beast::http::request<beast::http::empty_body, beast::http::basic_fields<Allocator>> req_;
+  const settings& s_;
+  path_type path_;
+  path_type part_;
+  beast::file file_;
+  // Opening the file failed
+  beast::error_code ec_;
+};
+
+// Answers a request whose body its route cannot take with `status` and closes the connection.  The body is not kept:
+// the first chunk abandons it, and the session drains the rest.
+template<class Allocator, class Send>
+class refuse : public body_handler<Send> {
+public:
+  using header_type = beast::http::request_header<beast::http::basic_fields<Allocator>>;
+
+  refuse(const header_type& req, beast::http::status status, const char* message, const settings& s)
+          : req_(req)
+          , status_(status)
+          , message_(message)
+          , s_(s)
+  {
+  }
+
+  bool on_body(net::const_buffer, beast::error_code& ec) override {
+    ec = beast::errc::make_error_code(beast::errc::operation_not_permitted);
+    return false;
+  }
+
+  void on_complete(Send& send, beast::error_code) override {
+    auto res = text_response(req_, status_, {message_}, s_);
+    if(status_ == beast::http::status::method_not_allowed)
+      res.set(beast::http::field::allow, "PUT, POST");
+    res.keep_alive(false);
+    send(std::move(res));
+  }
+
+private:
+  beast::http::request<beast::http::empty_body, beast::http::basic_fields<Allocator>> req_;
+  beast::http::status status_;
+  const char* message_;
+  const settings& s_;
+};
+
+// The body handler of a request once its header is parsed, nullptr to read the body into the request as usual.  Every
+// body sent to an upload route is streamed, refused unless it is a PUT or POST of a valid name, so none is buffered
+// up to the route's limit.
+template<class Send, class Allocator>
+std::unique_ptr<body_handler<Send>>
+select_body_handler(
+        const beast::http::request_header<beast::http::basic_fields<Allocator>>& req,
+        const settings& s)
+{
+  if(auto handler = body_handler_registry<Send, Allocator>::global().select(req, s))
+    return handler;
+  auto const route = s.route(req.target());
+  if(route == nullptr || route->upload.empty())
+    return nullptr;
+  if(req.method() != beast::http::verb::put && req.method() != beast::http::verb::post)
+    return std::make_unique<refuse<Allocator, Send>>(req, beast::http::status::method_not_allowed,
+                                                     "Uploads are sent with PUT or POST", s);
+  // The rest of the target names a file directly in the upload directory, after the slash a prefix may leave out
+  auto rest = req.target().substr(route->prefix.size());
+  if(!route->prefix.empty() && route->prefix.back() != '/' && !rest.empty() && rest.front() == '/')
+    rest.remove_prefix(1);
+  auto const name = upload_name(rest);
+  if(name.empty())
+    return std::make_unique<refuse<Allocator, Send>>(req, beast::http::status::bad_request,
+                                                     "The target does not name a file of the upload directory", s);
+  return std::make_unique<upload<Allocator, Send>>(req, *route, name, s);
+}
+
+} // namespace systemicai::http::server::handlers
+
+#endif // SYSTEMICAI_HTTP_SERVER_HANDLERS_BODY_HPP
@@ -4,6 +4,15 @@
 #include <systemicai/http/server/namespace.h>
 #include <systemicai/http/server/settings.h>
 #include <systemicai/http/server/functions.h>
+#include <systemicai/http/server/compressed_cache.h>
+#include <systemicai/http/server/file_cache.h>
+#include <systemicai/http/server/open_file_cache.h>
+#include <systemicai/http/server/shared_buffer_body.h>
+#include <systemicai/http/server/shared_file_body.h>
+#include <systemicai/http/server/mmap_body.h>
+#include <systemicai/http/server/multipart_body.h>
+#include <systemicai/http/server/byte_ranges.h>
+#include <systemicai/http/server/validators.h>
 
 using namespace std;
 
@@ -87,6 +96,32 @@ private:
 
 static HandlerRegistry< class Body, class Allocator, class Send> Registry;
 
+// Returns a response to `req` with a text/html body made of `parts`, allocated like the request
+template<class Body, class Allocator>
+beast::http::response<
+        beast::http::basic_string_body<char, std::char_traits<char>,
+                typename std::allocator_traits<Allocator>::template rebind_alloc<char>>,
+        beast::http::basic_fields<Allocator>>
+text_response(
+        const beast::http::request<Body, beast::http::basic_fields<Allocator>>& req,
+        beast::http::status status,
+        std::initializer_list<beast::string_view> parts,
+        const settings& s)
+{
+    using string_body = beast::http::basic_string_body<char, std::char_traits<char>,
+            typename std::allocator_traits<Allocator>::template rebind_alloc<char>>;
+    auto const alloc = req.get_allocator();
+    beast::http::response<string_body, beast::http::basic_fields<Allocator>> res{
+            status, req.version(), typename string_body::value_type(alloc), alloc};
+    res.set(beast::http::field::server, s.service_version);
+    res.set(beast::http::field::content_type, "text/html");
+    res.keep_alive(req.keep_alive());
+    for(auto part : parts)
+        res.body().append(part.data(), part.size());
+    res.prepare_payload();
+    return res;
+}
+
 // This function produces an HTTP response for the given
 // request. The type of the response object depends on the
 // contents of the request, so the interface requires the
@@ -101,43 +136,31 @@ default_handle_request(
         Send&& send,
         const settings& s)
 {
+    // Responses are allocated like the request, from the session's arena
+    using fields_type = beast::http::basic_fields<Allocator>;
+    using string_body = beast::http::basic_string_body<char, std::char_traits<char>,
+            typename std::allocator_traits<Allocator>::template rebind_alloc<char>>;
+    auto const alloc = req.get_allocator();
+
     // Returns a bad request response
     auto const bad_request =
             [&req, &s](beast::string_view why)
             {
-                beast::http::response<beast::http::string_body> res{beast::http::status::bad_request, req.version()};
-                res.set(beast::http::field::server, s.service_version);
-                res.set(beast::http::field::content_type, "text/html");
-                res.keep_alive(req.keep_alive());
-                res.body() = std::string(why);
-                res.prepare_payload();
-                return res;
+                return text_response(req, beast::http::status::bad_request, {why}, s);
             };
 
     // Returns a not found response
     auto const not_found =
             [&req, &s](beast::string_view target)
             {
-                beast::http::response<beast::http::string_body> res{beast::http::status::not_found, req.version()};
-                res.set(beast::http::field::server, s.service_version);
-                res.set(beast::http::field::content_type, "text/html");
-                res.keep_alive(req.keep_alive());
-                res.body() = "The resource '" + std::string(target) + "' was not found.";
-                res.prepare_payload();
-                return res;
+                return text_response(req, beast::http::status::not_found, {"The resource '", target, "' was not found."}, s);
             };
 
     // Returns a server error response
     auto const server_error =
             [&req, &s](beast::string_view what)
             {
-                beast::http::response<beast::http::string_body> res{beast::http::status::internal_server_error, req.version()};
-                res.set(beast::http::field::server, s.service_version);
-                res.set(beast::http::field::content_type, "text/html");
-                res.keep_alive(req.keep_alive());
-                res.body() = "An error occurred: '" + std::string(what) + "'";
-                res.prepare_payload();
-                return res;
+                return text_response(req, beast::http::status::internal_server_error, {"An error occurred: '", what, "'"}, s);
             };
 
     // Make sure we can handle the method
@@ -152,47 +175,249 @@ default_handle_request(
         return send(bad_request("Illegal request-target"));
 
     // Build the path to the requested file
-    std::string path = path_cat(doc_root, req.target());
+    auto path = path_cat(doc_root, req.target(), typename string_body::value_type::allocator_type(alloc));
     if(req.target().back() == '/')
         path.append("index.html");
 
-    // Attempt to open the file
+    // Every response of a text file varies by Accept-Encoding, gzip is sent to the clients accepting it
+    auto const negotiated = s.compression && compressible(path);
+    auto const gzip = negotiated && accepts_gzip(req[beast::http::field::accept_encoding]);
+
+    // Sets the fields of a response with the representation `v` validates, gzip encoded or not
+    auto const prepare =
+            [&](auto& res, const validators& v, bool encoded)
+            {
+                res.set(beast::http::field::server, s.service_version);
+                res.set(beast::http::field::content_type, mime_type(path));
+                if(negotiated)
+                    res.set(beast::http::field::vary, "Accept-Encoding");
+                if(encoded)
+                    res.set(beast::http::field::content_encoding, "gzip");
+                res.set(beast::http::field::etag, v.etag());
+                res.set(beast::http::field::last_modified, v.last_modified());
+                res.set(beast::http::field::accept_ranges, "bytes");
+                res.keep_alive(req.keep_alive());
+            };
+
+    // The ranges of a GET to send of the representation `v` validates, of `size` bytes.  An If-Range not naming
+    // that representation exactly, by its strong tag or its date, asks for all of it.
+    byte_ranges ranges;
+    auto const select_ranges =
+            [&](const validators& v, std::uint64_t size)
+            {
+                auto const range = req[beast::http::field::range];
+                if(range.empty() || req.method() != beast::http::verb::get)
+                    return byte_ranges::outcome::whole;
+                auto const if_range = req[beast::http::field::if_range];
+                if(!if_range.empty() && if_range != v.etag() && if_range != v.last_modified())
+                    return byte_ranges::outcome::whole;
+                return ranges.parse(range, size);
+            };
+
+    // Sets the status and Content-Range of a response with one of the ranges of a representation of `size` bytes
+    auto const prepare_range =
+            [&](auto& res, const byte_range& r, std::uint64_t size)
+            {
+                char content_range[80];
+                auto const n = std::snprintf(content_range, sizeof(content_range), "bytes %" PRIu64 "-%" PRIu64 "/%" PRIu64,
+                        r.first, r.last, size);
+                res.result(beast::http::status::partial_content);
+                res.set(beast::http::field::content_range, beast::string_view(content_range, std::size_t(n)));
+                res.content_length(r.size());
+            };
+
+    // Respond to ranges all beyond the end of a representation of `size` bytes
+    auto const send_unsatisfiable =
+            [&](const validators& v, std::uint64_t size, bool encoded)
+            {
+                char content_range[32];
+                auto const n = std::snprintf(content_range, sizeof(content_range), "bytes */%" PRIu64, size);
+                beast::http::response<beast::http::empty_body, fields_type> res{beast::http::status::range_not_satisfiable, req.version(), beast::http::empty_body::value_type(), alloc};
+                prepare(res, v, encoded);
+                res.set(beast::http::field::content_range, beast::string_view(content_range, std::size_t(n)));
+                res.content_length(0);
+                return send(std::move(res));
+            };
+
+    // Respond with several ranges of a representation of `size` bytes, read from `body`'s file or memory
+    auto const send_multipart =
+            [&](multipart_body::value_type&& body, const validators& v, std::uint64_t size, bool encoded)
+            {
+                body.add(ranges, size, mime_type(path));
+                auto const content_type = body.content_type();
+                beast::http::response<multipart_body, fields_type> res{beast::http::status::partial_content, req.version(), std::move(body), alloc};
+                prepare(res, v, encoded);
+                res.set(beast::http::field::content_type, content_type);
+                res.content_length(multipart_body::size(res.body()));
+                return send(std::move(res));
+            };
+
+    // Respond to a conditional request for the representation the client has, with its validators and no body
+    auto const send_not_modified =
+            [&](const validators& v)
+            {
+                beast::http::response<beast::http::empty_body, fields_type> res{beast::http::status::not_modified, req.version(), beast::http::empty_body::value_type(), alloc};
+                prepare(res, v, false);
+                return send(std::move(res));
+            };
+
+    // Respond to HEAD request
+    auto const send_head =
+            [&](std::uint64_t size, const validators& v, bool encoded)
+            {
+                beast::http::response<beast::http::empty_body, fields_type> res{beast::http::status::ok, req.version(), beast::http::empty_body::value_type(), alloc};
+                prepare(res, v, encoded);
+                res.content_length(size);
+                return send(std::move(res));
+            };
+
+    // Respond with `res`, its body one of the ranges of a representation of `size` bytes, or all of it
+    auto const send_ranged =
+            [&](auto&& res, const validators& v, bool encoded, byte_ranges::outcome outcome, std::uint64_t size)
+            {
+                prepare(res, v, encoded);
+                if(outcome == byte_ranges::outcome::partial)
+                    prepare_range(res, ranges[0], size);
+                else
+                    res.content_length(size);
+                return send(std::move(res));
+            };
+
+    // Respond from bytes in memory held by `owner`, shared with every other response of them
+    auto const send_shared =
+            [&](std::shared_ptr<const void> owner, std::string_view data, const validators& v, bool encoded)
+            {
+                if(req.method() == beast::http::verb::head)
+                    return send_head(data.size(), v, encoded);
+                auto const outcome = select_ranges(v, data.size());
+                if(outcome == byte_ranges::outcome::unsatisfiable)
+                    return send_unsatisfiable(v, data.size(), encoded);
+                if(outcome == byte_ranges::outcome::partial && ranges.size() > 1)
+                    return send_multipart(multipart_body::value_type(std::move(owner), data.data()), v, data.size(), encoded);
+                // The one range selected, otherwise all of the data, which may be empty
+                auto const partial = outcome == byte_ranges::outcome::partial;
+                std::uint64_t const offset = partial ? ranges[0].first : 0;
+                std::uint64_t const count = partial ? ranges[0].size() : data.size();
+                return send_ranged(beast::http::response<shared_buffer_body, fields_type>{beast::http::status::ok, req.version(),
+                        shared_buffer_body::value_type{std::move(owner), data.data() + offset, std::size_t(count)}, alloc},
+                        v, encoded, outcome, data.size());
+            };
+
+    // Respond from an open file, or not modified.  A file up to limit_mmap_file is sent from its mapping, unless it
+    // cannot be mapped, a larger one streamed.  Only a session serializing the body reads the mapping, and only the
+    // open_file_cache keeps it for the next responses, otherwise the file is streamed as well.
+    auto const send_file =
+            [&](std::shared_ptr<const open_file> file, bool encoded)
+            {
+                validators const v(file->inode, file->size, file->mtime, encoded);
+                if(v.not_modified(req))
+                    return send_not_modified(v);
+                auto const size = file->size;
+                if(req.method() == beast::http::verb::head)
+                    return send_head(size, v, encoded);
+                auto const outcome = select_ranges(v, size);
+                if(outcome == byte_ranges::outcome::unsatisfiable)
+                    return send_unsatisfiable(v, size, encoded);
+                std::shared_ptr<const mapped_file> mapping;
+                if(size != 0 && mmap_body::admits(size, s) && s.limit_open_files != 0 && ! send.sends_files())
+                {
+                    beast::error_code ec;
+                    mapping = mmap_body::map(*file, ec);
+                }
+                if(outcome == byte_ranges::outcome::partial && ranges.size() > 1)
+                    return send_multipart(mapping ? multipart_body::value_type(mapping, mapping->data)
+                                                  : multipart_body::value_type(std::move(file)), v, size, encoded);
+                // The one range selected, otherwise the whole file, which may be empty
+                auto const partial = outcome == byte_ranges::outcome::partial;
+                std::uint64_t const offset = partial ? ranges[0].first : 0;
+                std::uint64_t const count = partial ? ranges[0].size() : size;
+                if(mapping)
+                    return send_ranged(beast::http::response<mmap_body, fields_type>{beast::http::status::ok, req.version(),
+                            mmap_body::value_type{std::move(file), std::move(mapping), offset, count}, alloc},
+                            v, encoded, outcome, size);
+                return send_ranged(beast::http::response<shared_file_body, fields_type>{beast::http::status::ok, req.version(),
+                        shared_file_body::value_type{std::move(file), offset, count}, alloc},
+                        v, encoded, outcome, size);
+            };
+
+    // Open files, or take them from the descriptors kept open
+    auto& files = open_file_cache::global();
     beast::error_code ec;
-    beast::http::file_body::value_type body;
-    body.open(path.c_str(), beast::file_mode::scan, ec);
+    std::shared_ptr<const open_file> file;
+    if(gzip)
+    {
+        // A precompressed sibling, then the file compressed on demand unless that saves nothing
+        auto sibling = path;
+        sibling.append(".gz");
+        if(auto const precompressed = files.open(sibling.c_str(), ec, alloc))
+            return send_file(precompressed, true);
+        file = files.open(path.c_str(), ec, alloc);
+        if(file)
+        {
+            // The conditions are evaluated against the representation sent: the encoding when there is one,
+            // otherwise the file as it is below
+            auto const encoded = compressed_cache::global().get(std::string_view(path.data(), path.size()), *file);
+            if(encoded && !encoded->useless())
+            {
+                validators const v(file->inode, file->size, file->mtime, true);
+                if(v.not_modified(req))
+                    return send_not_modified(v);
+                return send_shared(encoded, encoded->data, v, true);
+            }
+        }
+    }
+
+    // A copy in memory knows the identity of the file it was read from, a revalidation of it needs no syscall
+    auto& cache = file_cache::global();
+    if(auto const cached = cache.find(std::string_view(path.data(), path.size())))
+    {
+        validators const v(cached->inode, cached->data.size(), cached->mtime, false);
+        if(v.not_modified(req))
+            return send_not_modified(v);
+        return send_shared(cached, cached->data, v, false);
+    }
+
+    if(!gzip)
+        file = files.open(path.c_str(), ec, alloc);
 
     // Handle the case where the file doesn't exist
-    if(ec == beast::errc::no_such_file_or_directory)
+    if(ec == beast::errc::no_such_file_or_directory || ec == beast::errc::is_a_directory)
         return send(not_found(req.target()));
 
     // Handle an unknown error
     if(ec)
         return send(server_error(ec.message()));
 
-    // Cache the size since we need it after the move
-    auto const size = body.size();
-
-    // Respond to HEAD request
+    // Answered from the metadata alone
+    auto const size = file->size;
+    validators const v(file->inode, size, file->mtime, false);
+    if(v.not_modified(req))
+        return send_not_modified(v);
     if(req.method() == beast::http::verb::head)
+        return send_head(size, v, false);
+
+    // Read a file small enough into the cache, the next requests for it are served from there
+    if(cache.admits(size))
     {
-        beast::http::response<beast::http::empty_body> res{beast::http::status::ok, req.version()};
-        res.set(beast::http::field::server, s.service_version);
-        res.set(beast::http::field::content_type, mime_type(path));
-        res.content_length(size);
-        res.keep_alive(req.keep_alive());
-        return send(std::move(res));
+        std::string data(size, '\0');
+        std::size_t read = 0;
+        while(read < size)
+        {
+            auto const n = ::pread(file->fd, data.data() + read, size - read, off_t(read));
+            if(n <= 0)
+                break;
+            read += std::size_t(n);
+        }
+        // Otherwise the file changed while it was read, it is sent as it is now
+        if(read == size)
+        {
+            auto const cached = cache.insert(std::string(path.data(), path.size()), *file, std::move(data));
+            return send_shared(cached, cached->data, v, false);
+        }
     }
 
     // Respond to GET request
-    beast::http::response<beast::http::file_body> res{
-            std::piecewise_construct,
-            std::make_tuple(std::move(body)),
-            std::make_tuple(beast::http::status::ok, req.version())};
-    res.set(beast::http::field::server, s.service_version);
-    res.set(beast::http::field::content_type, mime_type(path));
-    res.content_length(size);
-    res.keep_alive(req.keep_alive());
-    return send(std::move(res));
+    return send_file(file, false);
 }
 
 // This handler allows override of the default handlers by overriding the assigned handler.
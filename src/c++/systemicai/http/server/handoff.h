@@ -0,0 +1,203 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_HANDOFF_H
+#define SYSTEMICAI_HTTP_SERVER_HANDOFF_H
+
+/**
+  Passing listening sockets between processes for a zero-downtime restart.
+
+  The running process serves a unix domain socket at settings::handoff_path.  A new process connects to it and
+  receives every listening socket of the old process in one SCM_RIGHTS message, followed by a description of each
+  socket, one line per descriptor in the order they were sent:
+
+    tcp <address> <port>
+    unix <path>
+
+  The old process then closes the connection, stops accepting and drains its sessions.
+
+  The handoff socket is only accessible to the user of the running process, and each side checks that its peer runs
+  as the same user before sockets change hands.
+ */
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <systemicai/http/server/namespace.h>
+
+namespace systemicai::http::server::handoff {
+
+// The most descriptors handed off in one message
+constexpr std::size_t max_descriptors = 253;
+
+// One listening socket received from the previous process
+struct descriptor {
+  int fd;
+  // "tcp" or "unix"
+  string type;
+  tcp::endpoint tcp_endpoint;
+  string path;
+};
+
+inline string describe(const tcp::endpoint& ep) {
+  return "tcp " + ep.address().to_string() + " " + std::to_string(ep.port()) + "\n";
+}
+
+inline string describe(const net::local::stream_protocol::endpoint& ep) {
+  return "unix " + ep.path() + "\n";
+}
+
+// Whether the peer of the connected unix socket `sock` runs as the effective user of this process
+inline bool same_user(int sock) {
+  ucred cred{};
+  socklen_t size = sizeof(cred);
+  return ::getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &size) == 0 && cred.uid == ::geteuid();
+}
+
+/**
+ * Send `fds` and their `description` over the connected unix socket `sock`, the descriptors stay open in this process.
+ * @return false on error, errno is set
+ */
+inline bool send(int sock, const std::vector<int>& fds, const string& description) {
+  if(fds.empty() || fds.size() > max_descriptors) {
+    errno = EINVAL;
+    return false;
+  }
+
+  // The descriptors travel with the first byte of the description
+  char first = description.empty() ? '\n' : description[0];
+  iovec iov{&first, 1};
+  std::vector<char> control(CMSG_SPACE(sizeof(int) * fds.size()));
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.data();
+  msg.msg_controllen = control.size();
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+  std::memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+  if(::sendmsg(sock, &msg, MSG_NOSIGNAL) != 1)
+    return false;
+
+  for(size_t sent = 1; sent < description.size();) {
+    auto const n = ::send(sock, description.data() + sent, description.size() - sent, MSG_NOSIGNAL);
+    if(n < 0) {
+      if(errno == EINTR)
+        continue;
+      return false;
+    }
+    sent += n;
+  }
+  return true;
+}
+
+/**
+ * Receive the listening sockets from the previous process over the connected unix socket `sock`, reads until the
+ * sender closes the connection.  The caller owns the returned descriptors.
+ * @return false on error or a malformed message, any descriptors received are closed
+ */
+inline bool receive(int sock, std::vector<descriptor>& out) {
+  std::vector<int> fds;
+  string description;
+  std::vector<char> control(CMSG_SPACE(sizeof(int) * max_descriptors));
+  char buffer[4096];
+  for(;;) {
+    iovec iov{buffer, sizeof(buffer)};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+    auto const n = ::recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    if(n < 0) {
+      if(errno == EINTR)
+        continue;
+      break;
+    }
+    for(cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+        continue;
+      auto const count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      auto const first = fds.size();
+      fds.resize(first + count);
+      std::memcpy(fds.data() + first, CMSG_DATA(cmsg), count * sizeof(int));
+    }
+    if(n == 0)
+      break;
+    description.append(buffer, n);
+  }
+
+  // Match every descriptor with its line of the description
+  std::istringstream is(description);
+  std::vector<descriptor> result;
+  string line;
+  while(std::getline(is, line) && result.size() < fds.size()) {
+    std::istringstream ls(line);
+    descriptor d{fds[result.size()], "", {}, ""};
+    ls >> d.type;
+    if(d.type == "tcp") {
+      string address;
+      unsigned short port = 0;
+      ls >> address >> port;
+      beast::error_code ec;
+      auto const a = net::ip::make_address(address, ec);
+      if(ec)
+        break;
+      d.tcp_endpoint = tcp::endpoint(a, port);
+    } else if(d.type == "unix") {
+      std::getline(ls >> std::ws, d.path);
+    } else {
+      break;
+    }
+    result.push_back(d);
+  }
+
+  if(fds.empty() || result.size() != fds.size()) {
+    for(auto fd : fds)
+      ::close(fd);
+    errno = EPROTO;
+    return false;
+  }
+  out = std::move(result);
+  return true;
+}
+
+/**
+ * Connect to the handoff socket of a running process and receive its listening sockets.
+ * @param timeout How long connecting, and each receive after it, may wait on a process that does not answer
+ * @return false if no process of this user is serving `path`, or the handoff failed or timed out
+ */
+inline bool request(const string& path, std::vector<descriptor>& out,
+                    std::chrono::milliseconds timeout = std::chrono::seconds(5)) {
+  sockaddr_un addr{};
+  if(path.empty() || path.size() >= sizeof(addr.sun_path))
+    return false;
+  addr.sun_family = AF_UNIX;
+  std::memcpy(addr.sun_path, path.data(), path.size());
+
+  int const sock = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if(sock < 0)
+    return false;
+  // A unix socket connect waits for room in the backlog for up to the send timeout
+  timeval const tv{static_cast<time_t>(timeout.count() / 1000), static_cast<suseconds_t>(timeout.count() % 1000 * 1000)};
+  bool const received =
+      ::setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) == 0 &&
+      ::setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) == 0 &&
+      ::connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0 &&
+      same_user(sock) &&
+      receive(sock, out);
+  ::close(sock);
+  return received;
+}
+
+}
+
+#endif // SYSTEMICAI_HTTP_SERVER_HANDOFF_H
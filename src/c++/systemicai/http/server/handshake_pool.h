@@ -0,0 +1,90 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_HANDSHAKE_POOL_H
+#define SYSTEMICAI_HTTP_SERVER_HANDSHAKE_POOL_H
+
+/**
+  Threads dedicated to TLS handshakes.
+
+  A full handshake spends a millisecond or more on the certificate signature and the key exchange, on the io thread
+  that accepted the connection it holds up every established connection of that thread.  With a handshake pool a new
+  TLS session binds its handshake to a strand of the pool: the socket stays on its io thread, which completes its
+  reads and writes, and OpenSSL runs on the pool.  The session then posts itself back to its io thread to serve
+  HTTP.  Sessions find the pool of their context through its ex_data, as the ticket callbacks find tls_resumption.
+ */
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+#include <openssl/ssl.h>
+
+#include <systemicai/http/server/namespace.h>
+
+namespace systemicai::http::server {
+
+class handshake_pool {
+public:
+  // Start `threads` threads handshaking for the sessions of `ctx`
+  handshake_pool(ssl::context& ctx, std::size_t threads)
+          : ctx_(ctx.native_handle())
+          , ioc_(static_cast<int>(threads))
+          , work_(net::make_work_guard(ioc_))
+  {
+    for(std::size_t i = 0; i < threads; ++i)
+      threads_.emplace_back([this] { ioc_.run(); });
+    SSL_CTX_set_ex_data(ctx_, index(), this);
+  }
+
+  handshake_pool(const handshake_pool&) = delete;
+  handshake_pool& operator=(const handshake_pool&) = delete;
+
+  ~handshake_pool() {
+    stop();
+  }
+
+  /**
+   * Stop the threads and abandon the handshakes in progress, their sessions are destroyed.  The io_contexts of their
+   * sockets must still exist.  The pool itself must outlive those io_contexts: the operations pending on the sockets
+   * refer to its strands.
+   */
+  void stop() {
+    if(SSL_CTX_get_ex_data(ctx_, index()) == this)
+      SSL_CTX_set_ex_data(ctx_, index(), nullptr);
+    work_.reset();
+    ioc_.stop();
+    for(auto& t : threads_)
+      t.join();
+    threads_.clear();
+    ioc_.shutdown();
+  }
+
+  // The pool handshaking for the context of `ssl`, null when handshakes run on the io threads
+  static handshake_pool* of(SSL* ssl) {
+    return static_cast<handshake_pool*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), index()));
+  }
+
+  // A new strand of the pool, one per handshake
+  net::any_io_executor executor() {
+    return net::make_strand(ioc_);
+  }
+
+private:
+  static int index() {
+    static int const i = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return i;
+  }
+
+  // An io_context whose handlers can be destroyed before it is
+  struct context : net::io_context {
+    using net::io_context::io_context;
+    using net::io_context::shutdown;
+  };
+
+  SSL_CTX* ctx_;
+  context ioc_;
+  net::executor_work_guard<net::io_context::executor_type> work_;
+  std::vector<std::thread> threads_;
+};
+
+} // namespace systemicai::http::server
+
+#endif // SYSTEMICAI_HTTP_SERVER_HANDSHAKE_POOL_H
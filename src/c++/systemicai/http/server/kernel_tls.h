@@ -0,0 +1,322 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_KERNEL_TLS_H
+#define SYSTEMICAI_HTTP_SERVER_KERNEL_TLS_H
+
+/**
+  Kernel TLS (kTLS) for the sending side of TLS sessions.
+
+  After the handshake the server's write key and record sequence are installed into the socket with the Linux "tls"
+  upper layer protocol.  The kernel then encrypts whatever is written to the socket, so responses skip the copy
+  through OpenSSL and file bodies go out with sendfile(2).  Receiving stays with OpenSSL, requests are small.
+
+  Asio runs OpenSSL over a memory BIO pair, which OpenSSL's own kTLS support does not handle, so the key is derived
+  here: from the traffic secret given to the keylog callback with TLS 1.3, from the master secret with TLS 1.2.  The
+  sequence number is the count of records written since the write key last changed, kept by a message callback.
+  AES-GCM suites only.  Any other cipher, or a kernel without the "tls" module, leaves the session in user space.
+
+  OpenSSL keeps reading, and whatever it would write in reply to a record it read, a KeyUpdate asking for ours or an
+  alert, is encrypted with a key the kernel no longer follows.  The socket is shut down before that is sent, the
+  session fails and the client sees the connection closed.
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <linux/tls.h>
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <openssl/ssl.h>
+
+#include <systemicai/http/server/namespace.h>
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+
+namespace systemicai::http::server {
+
+class kernel_tls {
+public:
+  struct counters {
+    std::uint64_t enabled;
+    std::uint64_t fallback;
+  };
+
+  // The write key of a session as the kernel takes it, wiped on destruction
+  struct send_key {
+    int version = 0;
+    std::size_t key_size = 0;
+    std::array<unsigned char, 32> key{};
+    std::array<unsigned char, 4> salt{};
+    // The rest of the TLS 1.3 nonce, or the first explicit nonce of TLS 1.2
+    std::array<unsigned char, 8> iv{};
+    // Big endian sequence number of the next record
+    std::array<unsigned char, 8> seq{};
+
+    ~send_key() {
+      OPENSSL_cleanse(key.data(), key.size());
+      OPENSSL_cleanse(salt.data(), salt.size());
+    }
+  };
+
+  // Have the sessions of `ctx` record the secrets and record counts derive() needs, before any handshake
+  static void prepare(ssl::context& ctx) {
+    SSL_CTX_set_keylog_callback(ctx.native_handle(), &kernel_tls::on_keylog);
+    SSL_CTX_set_msg_callback(ctx.native_handle(), &kernel_tls::on_message);
+  }
+
+  /**
+   * Derive the write key and next sequence number of a session whose handshake just completed
+   * @return False with a cipher or version the kernel is not given, or without the secrets recorded by prepare()
+   */
+  static bool derive(SSL* ssl, send_key& k) {
+    auto const st = state_of(ssl, false);
+    auto const cipher = SSL_get_current_cipher(ssl);
+    if(st == nullptr || cipher == nullptr)
+      return false;
+    switch(SSL_CIPHER_get_cipher_nid(cipher)) {
+      case NID_aes_128_gcm: k.key_size = 16; break;
+      case NID_aes_256_gcm: k.key_size = 32; break;
+      default: return false;
+    }
+    auto const md = SSL_CIPHER_get_handshake_digest(cipher);
+    k.version = SSL_version(ssl);
+    for(std::size_t i = 0; i < k.seq.size(); ++i)
+      k.seq[i] = static_cast<unsigned char>(st->records >> (56 - 8 * i));
+
+    bool ok = false;
+    if(k.version == TLS1_3_VERSION && st->secret_size != 0) {
+      std::array<unsigned char, 12> iv;
+      ok = expand_label(md, st->secret.data(), st->secret_size, "key", k.key.data(), k.key_size) &&
+           expand_label(md, st->secret.data(), st->secret_size, "iv", iv.data(), iv.size());
+      std::copy_n(iv.begin(), 4, k.salt.begin());
+      std::copy_n(iv.begin() + 4, 8, k.iv.begin());
+      OPENSSL_cleanse(iv.data(), iv.size());
+    } else if(k.version == TLS1_2_VERSION) {
+      // The key block holds the client and server write keys, then their 4 byte implicit nonces
+      std::array<unsigned char, 48> master;
+      std::array<unsigned char, 64> seed;
+      std::array<unsigned char, 2 * 32 + 2 * 4> block;
+      auto const n = SSL_SESSION_get_master_key(SSL_get_session(ssl), master.data(), master.size());
+      SSL_get_server_random(ssl, seed.data(), 32);
+      SSL_get_client_random(ssl, seed.data() + 32, 32);
+      auto const size = 2 * k.key_size + 2 * 4;
+      ok = n != 0 && prf(md, master.data(), n, seed.data(), seed.size(), block.data(), size);
+      std::copy_n(block.begin() + k.key_size, k.key_size, k.key.begin());
+      std::copy_n(block.begin() + 2 * k.key_size + 4, 4, k.salt.begin());
+      k.iv = k.seq;
+      OPENSSL_cleanse(master.data(), master.size());
+      OPENSSL_cleanse(block.data(), block.size());
+    }
+    OPENSSL_cleanse(st->secret.data(), st->secret.size());
+    st->secret_size = 0;
+    return ok;
+  }
+
+  /**
+   * Hand the sending side of a session to the kernel, once its handshake completed and all of its output is written.
+   * Nothing may be written through OpenSSL afterwards.
+   * @return False when the session stays in user space
+   */
+  static bool enable(SSL* ssl, int fd) {
+    send_key k;
+    auto ok = derive(ssl, k);
+    if(ok)
+      ok = install(fd, k);
+    // Nothing is counted any more, a session given to the kernel is watched for OpenSSL's writes instead
+    if(ok)
+      state_of(ssl, true)->fd = fd;
+    SSL_set_msg_callback(ssl, ok ? &kernel_tls::on_kernel_message : nullptr);
+    (ok ? enabled_ : fallback_).fetch_add(1, std::memory_order_relaxed);
+    return ok;
+  }
+
+  // Send a close_notify alert on a socket given to the kernel
+  static void close_notify(int fd) {
+    unsigned char alert[2] = {SSL3_AL_WARNING, SSL_AD_CLOSE_NOTIFY};
+    char control[CMSG_SPACE(sizeof(unsigned char))] = {};
+    iovec io{alert, sizeof(alert)};
+    msghdr msg{};
+    msg.msg_iov = &io;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    auto const cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_TLS;
+    cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+    *CMSG_DATA(cmsg) = SSL3_RT_ALERT;
+    ::sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+  }
+
+  // The sessions of the process given to the kernel, and left in user space
+  static counters sessions() {
+    return {enabled_.load(std::memory_order_relaxed), fallback_.load(std::memory_order_relaxed)};
+  }
+
+private:
+  struct state {
+    // Records written with the current write key
+    std::uint64_t records = 0;
+    // The TLS 1.3 server application traffic secret
+    std::array<unsigned char, 48> secret{};
+    std::size_t secret_size = 0;
+    // The socket once the kernel encrypts for the session
+    int fd = -1;
+  };
+
+  static void free_state(void*, void* p, CRYPTO_EX_DATA*, int, long, void*) {
+    auto const st = static_cast<state*>(p);
+    if(st != nullptr)
+      OPENSSL_cleanse(st->secret.data(), st->secret.size());
+    delete st;
+  }
+
+  static int index() {
+    static int const i = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, &kernel_tls::free_state);
+    return i;
+  }
+
+  static state* state_of(const SSL* ssl, bool create) {
+    auto st = static_cast<state*>(SSL_get_ex_data(ssl, index()));
+    if(st == nullptr && create) {
+      st = new state;
+      SSL_set_ex_data(const_cast<SSL*>(ssl), index(), st);
+    }
+    return st;
+  }
+
+  static void on_keylog(const SSL* ssl, const char* line) {
+    static constexpr char label[] = "SERVER_TRAFFIC_SECRET_0 ";
+    if(std::strncmp(line, label, sizeof(label) - 1) != 0)
+      return;
+    // The label, the client random and the secret, in hex
+    auto const hex = std::strrchr(line, ' ') + 1;
+    auto const digits = std::strlen(hex);
+    auto const st = state_of(ssl, true);
+    if(digits % 2 != 0 || digits / 2 > st->secret.size())
+      return;
+    for(std::size_t i = 0; i < digits / 2; ++i) {
+      auto const high = nibble(hex[2 * i]);
+      auto const low = nibble(hex[2 * i + 1]);
+      if(high < 0 || low < 0)
+        return;
+      st->secret[i] = static_cast<unsigned char>(high << 4 | low);
+    }
+    st->secret_size = digits / 2;
+  }
+
+  // The value of a hex digit, -1 for any other character
+  static int nibble(char c) {
+    if(c >= '0' && c <= '9')
+      return c - '0';
+    if(c >= 'a' && c <= 'f')
+      return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F')
+      return c - 'A' + 10;
+    return -1;
+  }
+
+  static void on_message(int write_p, int version, int content_type, const void* buf, size_t len, SSL* ssl, void*) {
+    if(write_p != 1)
+      return;
+    auto const st = state_of(ssl, true);
+    if(content_type == SSL3_RT_HEADER) {
+      ++st->records;
+      return;
+    }
+    // The write key changes after ChangeCipherSpec with TLS 1.2, after the server's Finished with TLS 1.3
+    auto const tls13 = SSL_version(ssl) == TLS1_3_VERSION;
+    if((content_type == SSL3_RT_CHANGE_CIPHER_SPEC && !tls13) ||
+       (content_type == SSL3_RT_HANDSHAKE && tls13 && len != 0 && *static_cast<const unsigned char*>(buf) == SSL3_MT_FINISHED))
+      st->records = 0;
+    (void)version;
+  }
+
+  // A record OpenSSL writes on a session given to the kernel, it is called before the record leaves OpenSSL
+  static void on_kernel_message(int write_p, int, int content_type, const void*, size_t, SSL* ssl, void*) {
+    if(write_p != 1 || content_type != SSL3_RT_HEADER)
+      return;
+    auto const st = state_of(ssl, false);
+    if(st != nullptr && st->fd >= 0)
+      ::shutdown(st->fd, SHUT_RDWR);
+  }
+
+  // HKDF-Expand-Label of RFC 8446 with an empty context
+  static bool expand_label(const EVP_MD* md, const unsigned char* secret, std::size_t size, const std::string& label,
+                           unsigned char* out, std::size_t out_size) {
+    std::string const full = "tls13 " + label;
+    std::string info;
+    info += static_cast<char>(out_size >> 8);
+    info += static_cast<char>(out_size & 0xff);
+    info += static_cast<char>(full.size());
+    info += full;
+    info += '\0';
+    auto const ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr);
+    auto ok = ctx != nullptr &&
+              EVP_PKEY_derive_init(ctx) == 1 &&
+              EVP_PKEY_CTX_hkdf_mode(ctx, EVP_PKEY_HKDEF_MODE_EXPAND_ONLY) == 1 &&
+              EVP_PKEY_CTX_set_hkdf_md(ctx, md) == 1 &&
+              EVP_PKEY_CTX_set1_hkdf_key(ctx, secret, static_cast<int>(size)) == 1 &&
+              EVP_PKEY_CTX_add1_hkdf_info(ctx, reinterpret_cast<const unsigned char*>(info.data()), static_cast<int>(info.size())) == 1 &&
+              EVP_PKEY_derive(ctx, out, &out_size) == 1;
+    EVP_PKEY_CTX_free(ctx);
+    return ok;
+  }
+
+  // The TLS 1.2 PRF with the "key expansion" label
+  static bool prf(const EVP_MD* md, const unsigned char* secret, std::size_t size, const unsigned char* seed,
+                  std::size_t seed_size, unsigned char* out, std::size_t out_size) {
+    static constexpr char label[] = "key expansion";
+    auto const ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_TLS1_PRF, nullptr);
+    auto ok = ctx != nullptr &&
+              EVP_PKEY_derive_init(ctx) == 1 &&
+              EVP_PKEY_CTX_set_tls1_prf_md(ctx, md) == 1 &&
+              EVP_PKEY_CTX_set1_tls1_prf_secret(ctx, secret, static_cast<int>(size)) == 1 &&
+              EVP_PKEY_CTX_add1_tls1_prf_seed(ctx, reinterpret_cast<const unsigned char*>(label), static_cast<int>(sizeof(label) - 1)) == 1 &&
+              EVP_PKEY_CTX_add1_tls1_prf_seed(ctx, seed, static_cast<int>(seed_size)) == 1 &&
+              EVP_PKEY_derive(ctx, out, &out_size) == 1;
+    EVP_PKEY_CTX_free(ctx);
+    return ok;
+  }
+
+  template<class Info>
+  static bool install(int fd, const send_key& k, Info& info, int cipher) {
+    info.info.version = k.version == TLS1_3_VERSION ? TLS_1_3_VERSION : TLS_1_2_VERSION;
+    info.info.cipher_type = cipher;
+    std::copy_n(k.key.begin(), sizeof(info.key), info.key);
+    std::copy_n(k.salt.begin(), sizeof(info.salt), info.salt);
+    std::copy_n(k.iv.begin(), sizeof(info.iv), info.iv);
+    std::copy_n(k.seq.begin(), sizeof(info.rec_seq), info.rec_seq);
+    auto const ok = ::setsockopt(fd, SOL_TLS, TLS_TX, &info, sizeof(info)) == 0;
+    OPENSSL_cleanse(&info, sizeof(info));
+    return ok;
+  }
+
+  // A socket the "tls" module attached to but without a key still sends in the clear, so any failure falls back
+  static bool install(int fd, const send_key& k) {
+    if(::setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) != 0)
+      return false;
+    if(k.key_size == 16) {
+      tls12_crypto_info_aes_gcm_128 info{};
+      return install(fd, k, info, TLS_CIPHER_AES_GCM_128);
+    }
+    tls12_crypto_info_aes_gcm_256 info{};
+    return install(fd, k, info, TLS_CIPHER_AES_GCM_256);
+  }
+
+  inline static std::atomic<std::uint64_t> enabled_{0};
+  inline static std::atomic<std::uint64_t> fallback_{0};
+};
+
+} // namespace systemicai::http::server
+
+#endif // SYSTEMICAI_HTTP_SERVER_KERNEL_TLS_H
@@ -0,0 +1,160 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_MMAP_BODY_H
+#define SYSTEMICAI_HTTP_SERVER_MMAP_BODY_H
+
+/**
+  A response body sent from a memory mapping of a file.
+
+  A file is mapped once, on the first response sent from it, and the mapping is kept with its open_file: every
+  response of a file of the open_file_cache shares the mapping until the file is evicted or changes, and the last
+  response or cache entry to let go of it unmaps it.  The serializer hands the mapped pages to the write as they are,
+  without the copy into a buffer of a read, so a TLS stream encrypts straight from the page cache.  Sessions sending
+  files with sendfile take the file range instead.
+
+  Mappings are advised MADV_WILLNEED, to read the file ahead of the first response, and are meant for hot assets up
+  to settings::limit_mmap_file: a larger file is refused with errc::file_too_large, and streamed with shared_file_body
+  instead of taking address space for its lifetime.
+
+  A mapped file truncated in place makes a read of its missing pages fault with SIGBUS.  The files of a document root
+  served this way must be replaced by renaming a new file over them, as deployments usually do, not rewritten.
+ */
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+#include <sys/mman.h>
+
+#include <boost/optional.hpp>
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/open_file_cache.h>
+#include <systemicai/http/server/settings.h>
+
+namespace systemicai::http::server {
+
+// A whole file mapped read only
+struct mapped_file {
+  const char* data = nullptr;
+  std::size_t size = 0;
+
+  mapped_file() = default;
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  ~mapped_file() {
+    if(data != nullptr)
+      ::munmap(const_cast<char*>(data), size);
+  }
+};
+
+struct mmap_body {
+  struct value_type {
+    // Sent with sendfile by the sessions using it
+    std::shared_ptr<const open_file> file;
+    std::shared_ptr<const mapped_file> mapping;
+    std::uint64_t offset = 0;
+    std::uint64_t size = 0;
+
+    /**
+     * Send the file at `path` whole, kept open by the open_file_cache, from its shared mapping
+     * @param ec As open_file::open(), errc::file_too_large when `s` does not admit the file, or the error of mmap
+     */
+    void open(const char* path, const settings& s, beast::error_code& ec) {
+      auto f = open_file_cache::global().open(path, ec);
+      if(ec)
+        return;
+      auto const bytes = f->size;
+      assign(std::move(f), 0, bytes, s, ec);
+    }
+
+    /**
+     * Send `bytes` bytes of `f` from `from`, from its shared mapping
+     * @param ec errc::file_too_large when `s` does not admit the file, or the error of mmap
+     */
+    void assign(std::shared_ptr<const open_file> f, std::uint64_t from, std::uint64_t bytes, const settings& s,
+                beast::error_code& ec) {
+      if(!admits(f->size, s)) {
+        ec = beast::errc::make_error_code(beast::errc::file_too_large);
+        return;
+      }
+      mapping = map(*f, ec);
+      if(ec)
+        return;
+      file = std::move(f);
+      offset = from;
+      size = bytes;
+    }
+
+    const char* data() const {
+      return mapping->data + offset;
+    }
+  };
+
+  // True when a file of `bytes` is mapped under `s`, up to settings::limit_mmap_file and none with 0
+  static bool admits(std::uint64_t bytes, const settings& s) {
+    return s.limit_mmap_file != 0 && bytes <= s.limit_mmap_file;
+  }
+
+  /**
+   * The mapping of `file`, made on the first call for it and shared by the next ones
+   * @param ec The error of mmap, the file is not mapped again
+   */
+  static std::shared_ptr<const mapped_file> map(const open_file& file, beast::error_code& ec) {
+    std::call_once(file.mapped, [&file] {
+      auto m = std::make_shared<mapped_file>();
+      file.mapping = m;
+      // An empty file has no pages to map
+      if(file.size == 0)
+        return;
+      auto const p = ::mmap(nullptr, std::size_t(file.size), PROT_READ, MAP_SHARED, file.fd, 0);
+      if(p == MAP_FAILED) {
+        file.mapping = nullptr;
+        file.map_error = errno;
+        return;
+      }
+      ::madvise(p, std::size_t(file.size), MADV_WILLNEED);
+      m->data = static_cast<const char*>(p);
+      m->size = std::size_t(file.size);
+    });
+    ec = {};
+    if(!file.mapping)
+      ec.assign(file.map_error, beast::system_category());
+    return file.mapping;
+  }
+
+  static std::uint64_t size(const value_type& body) {
+    return body.size;
+  }
+
+  class writer {
+  public:
+    using const_buffers_type = net::const_buffer;
+
+    template<bool isRequest, class Fields>
+    writer(const beast::http::header<isRequest, Fields>&, const value_type& body)
+            : body_(body)
+    {
+    }
+
+    void init(beast::error_code& ec) {
+      ec = {};
+    }
+
+    boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec) {
+      ec = {};
+      if(body_.size == 0)
+        return boost::none;
+      return {{const_buffers_type(body_.data(), std::size_t(body_.size)), false}};
+    }
+
+  private:
+    const value_type& body_;
+  };
+};
+
+} // namespace systemicai::http::server
+
+#endif // SYSTEMICAI_HTTP_SERVER_MMAP_BODY_H
@@ -0,0 +1,163 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_MULTIPART_BODY_H
+#define SYSTEMICAI_HTTP_SERVER_MULTIPART_BODY_H
+
+/**
+  A multipart/byteranges response body, RFC 7233 appendix A.
+
+  Each part is its header followed by a range of the representation, read from an open_file with pread or handed
+  from memory shared with other responses, as shared_file_body and shared_buffer_body do for a single range.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <unistd.h>
+
+#include <boost/optional.hpp>
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/byte_ranges.h>
+#include <systemicai/http/server/open_file_cache.h>
+
+namespace systemicai::http::server {
+
+struct multipart_body {
+  struct part {
+    std::string header;
+    std::uint64_t offset;
+    std::uint64_t size;
+  };
+
+  struct value_type {
+    // The representation: a file when set, otherwise `data` kept alive by `owner`
+    std::shared_ptr<const open_file> file;
+    std::shared_ptr<const void> owner;
+    const char* data = nullptr;
+    std::string boundary;
+    std::vector<part> parts;
+    std::string trailer;
+
+    value_type() = default;
+
+    // Parts of `file`
+    explicit value_type(std::shared_ptr<const open_file> f)
+            : file(std::move(f)) {}
+
+    // Parts of `d` in memory kept alive by `o`
+    value_type(std::shared_ptr<const void> o, const char* d)
+            : owner(std::move(o))
+            , data(d) {}
+
+    /**
+     * Add a part for each of `ranges` of a representation of `size` bytes of `content_type`, under a boundary of its
+     * own, random so that a client cannot have it appear in the content
+     */
+    void add(const byte_ranges& ranges, std::uint64_t size, beast::string_view content_type) {
+      thread_local std::mt19937_64 random{std::random_device{}()};
+      char b[40];
+      auto const high = random();
+      auto const low = random();
+      boundary.assign(b, std::size_t(std::snprintf(b, sizeof(b), "%016" PRIx64 "%016" PRIx64, high, low)));
+      for(auto& r : ranges) {
+        char range[80];
+        auto const n = std::snprintf(range, sizeof(range), "bytes %" PRIu64 "-%" PRIu64 "/%" PRIu64, r.first, r.last, size);
+        std::string header;
+        header.reserve(boundary.size() + content_type.size() + std::size_t(n) + 48);
+        header.append("\r\n--").append(boundary).append("\r\nContent-Type: ");
+        header.append(content_type.data(), content_type.size());
+        header.append("\r\nContent-Range: ").append(range, std::size_t(n)).append("\r\n\r\n");
+        parts.push_back(part{std::move(header), r.first, r.size()});
+      }
+      trailer.append("\r\n--").append(boundary).append("--\r\n");
+    }
+
+    // The value of the Content-Type of the response
+    std::string content_type() const {
+      return "multipart/byteranges; boundary=" + boundary;
+    }
+  };
+
+  static std::uint64_t size(const value_type& body) {
+    std::uint64_t n = body.trailer.size();
+    for(auto& p : body.parts)
+      n += p.header.size() + p.size;
+    return n;
+  }
+
+  class writer {
+  public:
+    using const_buffers_type = net::const_buffer;
+
+    template<bool isRequest, class Fields>
+    writer(const beast::http::header<isRequest, Fields>&, const value_type& body)
+            : body_(body)
+    {
+    }
+
+    void init(beast::error_code& ec) {
+      ec = {};
+    }
+
+    boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec) {
+      ec = {};
+      if(part_ == body_.parts.size()) {
+        if(done_)
+          return boost::none;
+        done_ = true;
+        return {{const_buffers_type(body_.trailer.data(), body_.trailer.size()), false}};
+      }
+      auto const& p = body_.parts[part_];
+      if(!in_range_) {
+        in_range_ = true;
+        sent_ = 0;
+        return {{const_buffers_type(p.header.data(), p.header.size()), true}};
+      }
+      if(!body_.file) {
+        next();
+        return {{const_buffers_type(body_.data + p.offset, std::size_t(p.size)), true}};
+      }
+      auto const n = ::pread(body_.file->fd, buffer_.data(), std::min<std::uint64_t>(p.size - sent_, buffer_.size()),
+                             off_t(p.offset + sent_));
+      if(n < 0) {
+        ec.assign(errno, beast::system_category());
+        return boost::none;
+      }
+      // The file was truncated since it was opened
+      if(n == 0) {
+        ec = beast::http::error::short_read;
+        return boost::none;
+      }
+      sent_ += std::uint64_t(n);
+      if(sent_ == p.size)
+        next();
+      return {{const_buffers_type(buffer_.data(), std::size_t(n)), true}};
+    }
+
+  private:
+    void next() {
+      ++part_;
+      in_range_ = false;
+    }
+
+    const value_type& body_;
+    std::size_t part_ = 0;
+    bool in_range_ = false;
+    bool done_ = false;
+    std::uint64_t sent_ = 0;
+    std::array<char, 4096> buffer_;
+  };
+};
+
+} // namespace systemicai::http::server
+
+#endif // SYSTEMICAI_HTTP_SERVER_MULTIPART_BODY_H
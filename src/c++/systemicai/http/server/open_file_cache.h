@@ -0,0 +1,223 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_OPEN_FILE_CACHE_H
+#define SYSTEMICAI_HTTP_SERVER_OPEN_FILE_CACHE_H
+
+/**
+  Descriptors of document root files kept open.
+
+  Each request for a file opened it, stat'ed it and closed it once sent, a HEAD only to learn its size.  The cache
+  keeps the descriptor and metadata of recently requested files, and that a file does not exist, up to a number of
+  files shared by every io thread.  An entry is trusted for a short time to live, then revalidated with one stat on
+  its next lookup: a HEAD, or a request for a missing file, is answered within the time to live without a syscall.
+
+  Descriptors are reference counted, a response holds the file it is sent from and reads it with pread or sendfile
+  at its own offset, so any number of them share one descriptor and an evicted one is closed after the last.
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <systemicai/http/server/namespace.h>
+
+namespace systemicai::http::server {
+
+struct mapped_file;
+
+// A regular file open for reading, with what identified it when opened
+struct open_file {
+  int fd = -1;
+  std::uint64_t size = 0;
+  std::uint64_t inode = 0;
+  // Modification time in nanoseconds since the epoch
+  std::int64_t mtime = 0;
+  // The mapping shared by the responses sent with mmap_body, made on the first, or the error of mmap
+  mutable std::once_flag mapped;
+  mutable std::shared_ptr<const mapped_file> mapping;
+  mutable int map_error = 0;
+
+  open_file() = default;
+  open_file(const open_file&) = delete;
+  open_file& operator=(const open_file&) = delete;
+
+  ~open_file() {
+    if(fd >= 0)
+      ::close(fd);
+  }
+
+  static std::int64_t nanoseconds(const struct timespec& t) {
+    return std::int64_t(t.tv_sec) * 1000000000 + t.tv_nsec;
+  }
+
+  // True when `st` describes the file as it was opened
+  bool same(const struct stat& st) const {
+    return std::uint64_t(st.st_ino) == inode && std::uint64_t(st.st_size) == size && nanoseconds(st.st_mtim) == mtime;
+  }
+
+  /**
+   * Open the regular file at `path`
+   * @param ec Set to no_such_file_or_directory when there is none, is_a_directory for anything else than a file
+   * @param alloc Allocates the file and its reference count, a session's arena for a file of a single response
+   */
+  template<class Allocator = std::allocator<open_file>>
+  static std::shared_ptr<const open_file> open(const char* path, beast::error_code& ec, const Allocator& alloc = {}) {
+    ec = {};
+    auto f = std::allocate_shared<open_file>(alloc);
+    f->fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if(f->fd < 0 || ::fstat(f->fd, &st) != 0) {
+      ec.assign(errno, beast::system_category());
+      return nullptr;
+    }
+    if(!S_ISREG(st.st_mode)) {
+      ec = beast::errc::make_error_code(beast::errc::is_a_directory);
+      return nullptr;
+    }
+    f->size = std::uint64_t(st.st_size);
+    f->inode = std::uint64_t(st.st_ino);
+    f->mtime = nanoseconds(st.st_mtim);
+    return f;
+  }
+};
+
+class open_file_cache {
+public:
+  struct counters {
+    std::uint64_t hits;
+    std::uint64_t misses;
+    std::uint64_t revalidations;
+    std::size_t files;
+  };
+
+  // The cache of the process, configured by the service from settings::limit_open_files
+  static open_file_cache& global() {
+    static open_file_cache cache;
+    return cache;
+  }
+
+  open_file_cache() = default;
+  open_file_cache(const open_file_cache&) = delete;
+  open_file_cache& operator=(const open_file_cache&) = delete;
+
+  /**
+   * Keep up to `files` files, each trusted for `ttl` after it was opened or last revalidated.  A smaller limit
+   * evicts the least recently used, 0 empties and disables the cache.
+   */
+  void limit(std::size_t files, std::chrono::milliseconds ttl) {
+    std::lock_guard<std::mutex> lg(mutex_);
+    limit_ = files;
+    ttl_ = ttl;
+    while(lru_.size() > limit_)
+      evict();
+  }
+
+  /**
+   * The file at `path`, from the cache while it is trusted.  Missing files are cached as well, other errors not.
+   * @param ec As open_file::open()
+   * @param alloc Allocates the file opened when the cache is disabled, files of the cache come from the heap
+   */
+  template<class Allocator = std::allocator<open_file>>
+  std::shared_ptr<const open_file> open(const char* path, beast::error_code& ec, const Allocator& alloc = {}) {
+    ec = {};
+    auto const now = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex_);
+    if(limit_ == 0) {
+      lock.unlock();
+      return open_file::open(path, ec, alloc);
+    }
+    auto const found = index_.find(std::string_view(path));
+    if(found != index_.end()) {
+      auto& e = *found->second;
+      lru_.splice(lru_.begin(), lru_, found->second);
+      if(now < e.expires) {
+        ++hits_;
+        ec = e.file ? beast::error_code() : beast::errc::make_error_code(beast::errc::no_such_file_or_directory);
+        return e.file;
+      }
+    }
+
+    // Expired or unknown, the syscalls are made without the lock
+    auto const ttl = ttl_;
+    auto const known = found != index_.end();
+    auto const current = known ? found->second->file : nullptr;
+    lock.unlock();
+    std::string key(path);
+    std::shared_ptr<const open_file> file;
+    struct stat st;
+    if(current && ::stat(key.c_str(), &st) == 0 && current->same(st)) {
+      file = current;
+    } else {
+      file = open_file::open(key.c_str(), ec);
+      if(ec && ec != beast::errc::no_such_file_or_directory)
+        return nullptr;
+    }
+
+    lock.lock();
+    if(known)
+      ++revalidations_;
+    else
+      ++misses_;
+    auto const again = index_.find(std::string_view(key));
+    if(again != index_.end()) {
+      again->second->file = file;
+      again->second->expires = now + ttl;
+    } else if(limit_ != 0) {
+      if(lru_.size() >= limit_)
+        evict();
+      lru_.push_front(entry{key, file, now + ttl});
+      index_.emplace(std::move(key), lru_.begin());
+    }
+    return file;
+  }
+
+  counters stats() const {
+    std::lock_guard<std::mutex> lg(mutex_);
+    return counters{hits_, misses_, revalidations_, lru_.size()};
+  }
+
+private:
+  struct entry {
+    std::string path;
+    // Null when there is no such file
+    std::shared_ptr<const open_file> file;
+    std::chrono::steady_clock::time_point expires;
+  };
+
+  struct path_hash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view s) const {
+      return std::hash<std::string_view>{}(s);
+    }
+  };
+
+  void evict() {
+    index_.erase(index_.find(std::string_view(lru_.back().path)));
+    lru_.pop_back();
+  }
+
+  // Guards everything below, shared by the io threads
+  mutable std::mutex mutex_;
+  std::size_t limit_ = 0;
+  std::chrono::milliseconds ttl_{0};
+  // Most recently used first
+  std::list<entry> lru_;
+  std::unordered_map<std::string, std::list<entry>::iterator, path_hash, std::equal_to<>> index_;
+  std::uint64_t hits_ = 0;
+  std::uint64_t misses_ = 0;
+  std::uint64_t revalidations_ = 0;
+};
+
+} // namespace systemicai::http::server
+
+#endif // SYSTEMICAI_HTTP_SERVER_OPEN_FILE_CACHE_H
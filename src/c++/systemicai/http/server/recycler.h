@@ -0,0 +1,216 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_RECYCLER_H
+#define SYSTEMICAI_HTTP_SERVER_RECYCLER_H
+
+/**
+  Recycled sessions.
+
+  Every accepted connection creates a detect_session or an http_session, a websocket_session when it upgrades, and
+  the arena its requests are allocated from.  When a session is destroyed its storage, and its arena with one chunk
+  kept, go on a free list of the thread destroying it and the next connection accepted on that thread reuses them,
+  so connection churn does not go through the global heap.
+
+  Only io threads keep storage, they are the ones accepting connections.  A session released on another thread, the
+  handshake_pool failing its handshake or a timer of the certificate_store, goes back to the heap instead of piling
+  up in a list no connection is ever allocated from.
+ */
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/arena.h>
+
+namespace systemicai::http::server {
+
+class recycler {
+public:
+  // The number of distinct sizes kept, one per session type and its shared_ptr control block
+  static constexpr std::size_t sizes = 16;
+
+  // Storage for a `bytes` sized object, reused from the calling thread's free list when there is one
+  static void* allocate(std::size_t bytes) {
+    auto& l = local();
+    for(auto& f : l.objects)
+      if(f.size == bytes && f.head != nullptr) {
+        auto const b = f.head;
+        f.head = b->next;
+        --f.count;
+        return b;
+      }
+    return ::operator new(bytes);
+  }
+
+  // Keep the storage for the next object of the same size, up to limit() of them
+  static void deallocate(void* p, std::size_t bytes) noexcept {
+    auto& l = local();
+    if(!l.io) {
+      ::operator delete(p);
+      return;
+    }
+    for(auto& f : l.objects) {
+      if(f.size == 0)
+        f.size = bytes;
+      if(f.size != bytes)
+        continue;
+      if(f.count >= limit_.load(std::memory_order_relaxed))
+        break;
+      auto const b = static_cast<node*>(p);
+      b->next = f.head;
+      f.head = b;
+      ++f.count;
+      return;
+    }
+    ::operator delete(p);
+  }
+
+  // An arena for a new session, the one a previous session released when there is one
+  static std::shared_ptr<arena> make_arena();
+
+  // The most objects of each size, and arenas, every thread keeps.  Zero disables recycling.
+  static void limit(std::size_t count) {
+    limit_.store(count, std::memory_order_relaxed);
+  }
+
+  // Makes the calling thread an io thread, which keeps the storage released on it, while in scope
+  class io_thread {
+  public:
+    io_thread() : was_(local().io) {
+      local().io = true;
+    }
+
+    ~io_thread() {
+      local().io = was_;
+    }
+
+    io_thread(const io_thread&) = delete;
+    io_thread& operator=(const io_thread&) = delete;
+
+  private:
+    bool was_;
+  };
+
+  // Whether the calling thread is an io thread
+  static bool on_io_thread() {
+    return local().io;
+  }
+
+  // The objects and arenas kept by the calling thread
+  static std::size_t cached() {
+    auto& l = local();
+    std::size_t n = l.arenas.size();
+    for(auto& f : l.objects)
+      n += f.count;
+    return n;
+  }
+
+private:
+  struct node {
+    node* next;
+  };
+
+  struct free_list {
+    std::size_t size = 0;
+    std::size_t count = 0;
+    node* head = nullptr;
+  };
+
+  struct thread_lists {
+    std::array<free_list, sizes> objects;
+    std::vector<arena*> arenas;
+    // Storage is kept only on io threads
+    bool io = false;
+
+    ~thread_lists() {
+      for(auto& f : objects)
+        while(f.head != nullptr) {
+          auto const next = f.head->next;
+          ::operator delete(f.head);
+          f.head = next;
+        }
+      for(auto a : arenas)
+        delete a;
+    }
+  };
+
+  static thread_lists& local() {
+    thread_local thread_lists l;
+    return l;
+  }
+
+  // The deleter of recycled arenas, they are reset once no allocator refers to them any more
+  static void release(arena* a) noexcept {
+    auto& l = local();
+    if(!l.io || l.arenas.size() >= limit_.load(std::memory_order_relaxed)) {
+      delete a;
+      return;
+    }
+    a->reset();
+    try {
+      l.arenas.push_back(a);
+    } catch(const std::bad_alloc&) {
+      delete a;
+    }
+  }
+
+  inline static std::atomic<std::size_t> limit_{64};
+};
+
+// Allocates from the calling thread's recycler
+template<class T>
+class recycling_allocator {
+public:
+  using value_type = T;
+
+  static_assert(alignof(T) <= alignof(std::max_align_t), "recycled objects must not be over-aligned");
+
+  recycling_allocator() = default;
+
+  template<class U>
+  recycling_allocator(const recycling_allocator<U>&) noexcept {
+  }
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(recycler::allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* p, std::size_t n) noexcept {
+    recycler::deallocate(p, n * sizeof(T));
+  }
+
+  template<class U>
+  bool operator==(const recycling_allocator<U>&) const noexcept {
+    return true;
+  }
+
+  template<class U>
+  bool operator!=(const recycling_allocator<U>&) const noexcept {
+    return false;
+  }
+};
+
+inline std::shared_ptr<arena> recycler::make_arena() {
+  auto& l = local();
+  arena* a = nullptr;
+  if(l.arenas.empty()) {
+    a = new arena();
+  } else {
+    a = l.arenas.back();
+    l.arenas.pop_back();
+  }
+  return std::shared_ptr<arena>(a, &recycler::release, recycling_allocator<arena>());
+}
+
+// Creates a session in recycled storage, its shared_ptr control block included
+template<class T, class... Args>
+std::shared_ptr<T> make_recycled(Args&&... args) {
+  return std::allocate_shared<T>(recycling_allocator<T>(), std::forward<Args>(args)...);
+}
+
+} // namespace systemicai::http::server
+
+#endif // SYSTEMICAI_HTTP_SERVER_RECYCLER_H
@@ -22,16 +22,22 @@
 #include <thread>
 #include <vector>
 
+#include <unistd.h>
+
 #include <systemicai/http/server/namespace.h>
 #include <systemicai/common/certificate.h>
 #include <systemicai/http/server/settings.h>
 #include <systemicai/http/server/handlers.hpp>
+#include <systemicai/common/exception.h>
 
 #include "functions.h"
 #include "server.h"
 #include "sessions.hpp"
 
 namespace systemicai::http::server {
+    // Lets several acceptors bind the same endpoint, the kernel balances new connections between them
+    using reuse_port = net::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
     //------------------------------------------------------------------------------
 
     // Detects SSL handshakes
@@ -39,22 +45,30 @@ namespace systemicai::http::server {
     {
         beast::tcp_stream stream_;
         ssl::context& ctx_;
-        std::shared_ptr<std::string const> doc_root_;
-        beast::flat_buffer buffer_;
-        settings settings_;
+        session_buffer buffer_;
+        settings_ptr settings_;
+        connection_token token_;
+        session_deadline<detect_session> deadline_;
 
     public:
         explicit
         detect_session(
                 tcp::socket&& socket,
                 ssl::context& ctx,
-                std::shared_ptr<std::string const> const& doc_root,
-                const settings& s)
+                settings_ptr const& s,
+                connection_token&& token)
                 : stream_(std::move(socket))
                 , ctx_(ctx)
-                , doc_root_(doc_root)
                 , settings_(s)
+                , token_(std::move(token))
+                , deadline_(*this)
+        {
+        }
+
+        beast::tcp_stream&
+        stream()
         {
+            return stream_;
         }
 
         // Launch the detector
@@ -75,8 +89,22 @@ namespace systemicai::http::server {
         void
         on_run()
         {
-            // Set the timeout.
-            stream_.expires_after(std::chrono::seconds(30));
+            // The first bytes of a handshake or request are due within the header timeout
+            deadline_.expires_after(std::chrono::milliseconds(settings_->timeout_header));
+
+            // Borrow no buffer until they arrive
+            stream_.socket().async_wait(
+                    net::socket_base::wait_read,
+                    beast::bind_front_handler(
+                            &detect_session::on_readable,
+                            this->shared_from_this()));
+        }
+
+        void
+        on_readable(beast::error_code ec)
+        {
+            if(ec)
+                return fail(ec, "detect");
 
             beast::async_detect_ssl(
                     stream_,
@@ -92,40 +120,61 @@ namespace systemicai::http::server {
             if(ec)
                 return fail(ec, "detect");
 
+            // The session taking over the stream sets its own timeout
+            deadline_.expires_never();
+
             if(result)
             {
                 // Launch SSL session
-                std::make_shared<ssl_http_session>(
+                make_recycled<ssl_http_session>(
                         std::move(stream_),
                         ctx_,
                         std::move(buffer_),
-                        doc_root_,
-                        settings_)->run();
+                        std::move(settings_),
+                        std::move(token_))->run();
                 return;
             }
 
             // Launch plain session
-            std::make_shared<plain_http_session>(
+            make_recycled<plain_http_session>(
                     std::move(stream_),
                     std::move(buffer_),
-                    doc_root_,
-                    settings_)->run();
+                    std::move(settings_),
+                    std::move(token_))->run();
         }
     };
 
-    listener::listener(
+    transport parse_transport(const std::string& type)
+    {
+        if(type == "plain")
+            return transport::plain;
+        if(type == "tls")
+            return transport::tls;
+        if(type == "auto")
+            return transport::detect;
+        throw systemicai::common::exception("Unknown listener type: [" + type + "] valid values are [plain, tls, auto, unix]");
+    }
+
+    template<class Protocol>
+    basic_listener<Protocol>::basic_listener(
             net::io_context& ioc,
             ssl::context& ctx,
-            tcp::endpoint endpoint,
-            std::shared_ptr<std::string const> const& doc_root,
-            const settings& s)
-            : std::enable_shared_from_this<listener>()
+            endpoint_type endpoint,
+            settings_source& s,
+            std::shared_ptr<connection_limit> const& limit,
+            transport type,
+            bool sharded)
+            : std::enable_shared_from_this<basic_listener>()
             , ioc_(ioc)
             , ctx_(ctx)
             , acceptor_(net::make_strand(ioc))
-            , doc_root_(doc_root)
-            , settings_(s)
-            
+            , source_(s)
+            , version_(s.version())
+            , settings_(s.load())
+            , limit_(limit)
+            , type_(type)
+            , sharded_(sharded)
+            , endpoint_(endpoint)
     {
         beast::error_code ec;
 
@@ -137,12 +186,36 @@ namespace systemicai::http::server {
             return;
         }
 
-        // Allow address reuse
-        acceptor_.set_option(net::socket_base::reuse_address(true), ec);
-        if(ec)
+        if constexpr(std::is_same_v<Protocol, tcp>)
         {
-            fail(ec, "set_option");
-            return;
+            // Allow address reuse
+            acceptor_.set_option(net::socket_base::reuse_address(true), ec);
+            if(ec)
+            {
+                fail(ec, "set_option");
+                return;
+            }
+
+            // Allow the other shards to bind the same address
+            if(sharded_)
+            {
+                acceptor_.set_option(reuse_port(true), ec);
+                if(ec)
+                {
+                    fail(ec, "set_option");
+                    return;
+                }
+            }
+        }
+        else
+        {
+            // A socket file left behind by a previous run would fail the bind,
+            // anything else at the path is not ours to remove
+            if(! remove_socket_file(endpoint.path()))
+            {
+                fail(beast::errc::make_error_code(beast::errc::file_exists), "bind");
+                return;
+            }
         }
 
         // Bind to the server address
@@ -161,42 +234,276 @@ namespace systemicai::http::server {
             fail(ec, "listen");
             return;
         }
+
+        // The port the system picked for port 0
+        if constexpr(std::is_same_v<Protocol, tcp>)
+            endpoint_ = acceptor_.local_endpoint(ec);
+
+        // Synchronous accepts drain the backlog, they must return would_block instead of waiting
+        acceptor_.non_blocking(true, ec);
+        if(ec)
+        {
+            fail(ec, "non_blocking");
+            return;
+        }
+    }
+
+    template<class Protocol>
+    basic_listener<Protocol>::basic_listener(
+            net::io_context& ioc,
+            ssl::context& ctx,
+            endpoint_type endpoint,
+            int fd,
+            settings_source& s,
+            std::shared_ptr<connection_limit> const& limit,
+            transport type,
+            bool sharded)
+            : std::enable_shared_from_this<basic_listener>()
+            , ioc_(ioc)
+            , ctx_(ctx)
+            , acceptor_(net::make_strand(ioc))
+            , source_(s)
+            , version_(s.version())
+            , settings_(s.load())
+            , limit_(limit)
+            , type_(type)
+            , sharded_(sharded)
+            , endpoint_(endpoint)
+    {
+        beast::error_code ec;
+
+        if(fd < 0)
+        {
+            fail(beast::error_code(errno, net::error::get_system_category()), "dup");
+            return;
+        }
+
+        acceptor_.assign(endpoint.protocol(), fd, ec);
+        if(ec)
+        {
+            ::close(fd);
+            fail(ec, "assign");
+            return;
+        }
+
+        // Synchronous accepts drain the backlog, they must return would_block instead of waiting
+        acceptor_.non_blocking(true, ec);
+        if(ec)
+        {
+            fail(ec, "non_blocking");
+            return;
+        }
+    }
+
+    // Every shard waits on the same listening socket, the one that wins
+    // the accept serves the connection and the others see would_block
+    template<class Protocol>
+    basic_listener<Protocol>::basic_listener(
+            net::io_context& ioc,
+            basic_listener& other)
+            : basic_listener(
+                    ioc,
+                    other.ctx_,
+                    other.endpoint_,
+                    ::dup(other.acceptor_.native_handle()),
+                    other.source_,
+                    other.limit_,
+                    other.type_,
+                    other.sharded_)
+    {
     }
 
     // Start accepting incoming connections
-    void listener::run()
+    template<class Protocol>
+    void basic_listener<Protocol>::run()
     {
         do_accept();
     }
 
-    void listener::do_accept()
+    template<class Protocol>
+    void basic_listener<Protocol>::stop()
+    {
+        net::dispatch(
+                acceptor_.get_executor(),
+                [self = this->shared_from_this()]
+                {
+                    beast::error_code ec;
+                    self->acceptor_.close(ec);
+                });
+    }
+
+    template<class Protocol>
+    typename basic_listener<Protocol>::endpoint_type basic_listener<Protocol>::endpoint() const
+    {
+        return endpoint_;
+    }
+
+    template<class Protocol>
+    int basic_listener<Protocol>::native_handle()
+    {
+        return acceptor_.native_handle();
+    }
+
+    // A shard's io_context is run by a single thread, so the connection
+    // stays on it from accept to close without the cost of a strand.
+    // Otherwise the new connection gets its own strand.
+    template<class Protocol>
+    net::any_io_executor basic_listener<Protocol>::connection_executor()
+    {
+        if(sharded_)
+            return ioc_.get_executor();
+        return net::make_strand(ioc_);
+    }
+
+    // The snapshot pinned by the sessions launched now, the source is only
+    // locked when a reload published a new one since the last connection
+    template<class Protocol>
+    const settings_ptr& basic_listener<Protocol>::current_settings()
+    {
+        auto const version = source_.version();
+        if(version != version_)
+        {
+            version_ = version;
+            settings_ = source_.load();
+        }
+        return settings_;
+    }
+
+    template<class Protocol>
+    void basic_listener<Protocol>::do_accept()
     {
-        // The new connection gets its own strand
         acceptor_.async_accept(
-                net::make_strand(ioc_),
+                connection_executor(),
                 beast::bind_front_handler(
-                        &listener::on_accept,
-                        shared_from_this()));
+                        &basic_listener::on_accept,
+                        this->shared_from_this()));
     }
 
-    void listener::on_accept(beast::error_code ec, tcp::socket socket)
+    template<class Protocol>
+    void basic_listener<Protocol>::on_accept(beast::error_code ec, socket_type socket)
     {
+        // The listener was stopped
+        if(! acceptor_.is_open())
+            return;
+
         if(ec)
         {
             fail(ec, "accept");
+
+            // Accept another connection
+            return do_accept();
         }
-        else
+
+        admit(std::move(socket));
+    }
+
+    template<class Protocol>
+    void basic_listener<Protocol>::admit(socket_type&& socket)
+    {
+        // At the connection limit, hold on to the socket and stop
+        // accepting until a session closes and gives back its slot
+        if(! limit_->try_acquire())
         {
-            // Create the detector http_session and run it
-            std::make_shared<detect_session>(
-                    std::move(socket),
-                    ctx_,
-                    doc_root_,
-                    settings_)->run();
+            waiting_.emplace(std::move(socket));
+            limit_->wait(
+                    [self = this->shared_from_this()]
+                    {
+                        net::post(
+                                self->acceptor_.get_executor(),
+                                beast::bind_front_handler(
+                                        &basic_listener::on_resume,
+                                        self));
+                    });
+            return;
+        }
+
+        launch(std::move(socket));
+
+        // Drain the connections already pending without another
+        // round-trip through the scheduler, up to the batch limit
+        for(size_t i = 1; i < current_settings()->limit_accept_batch && acceptor_.is_open(); ++i)
+        {
+            if(! limit_->try_acquire())
+                break;
+
+            beast::error_code ec;
+            socket_type next = acceptor_.accept(connection_executor(), ec);
+            if(ec)
+            {
+                limit_->release();
+                if(ec != net::error::would_block &&
+                   ec != net::error::try_again)
+                    fail(ec, "accept");
+                break;
+            }
+
+            launch(std::move(next));
         }
 
         // Accept another connection
-        do_accept();
+        if(acceptor_.is_open())
+            do_accept();
+    }
+
+    template<class Protocol>
+    void basic_listener<Protocol>::on_resume()
+    {
+        socket_type socket = std::move(*waiting_);
+        waiting_.reset();
+        admit(std::move(socket));
+    }
+
+    // Create the session for the listener's transport and run it, it owns the slot acquired for the connection
+    template<class Protocol>
+    void basic_listener<Protocol>::launch(socket_type&& socket)
+    {
+        if constexpr(std::is_same_v<Protocol, net::local::stream_protocol>)
+        {
+            // Unix domain sockets only carry plain HTTP
+            make_recycled<local_http_session>(
+                    local_stream(std::move(socket)),
+                    session_buffer(),
+                    current_settings(),
+                    connection_token(limit_))->run();
+        }
+        else
+        {
+            // Sessions gather pipelined responses into one write themselves,
+            // Nagle's algorithm would only hold back the next one
+            beast::error_code ec;
+            socket.set_option(tcp::no_delay(true), ec);
+
+            switch(type_)
+            {
+            case transport::plain:
+                make_recycled<plain_http_session>(
+                        beast::tcp_stream(std::move(socket)),
+                        session_buffer(),
+                        current_settings(),
+                        connection_token(limit_))->run();
+                break;
+
+            case transport::tls:
+                make_recycled<ssl_http_session>(
+                        beast::tcp_stream(std::move(socket)),
+                        ctx_,
+                        session_buffer(),
+                        current_settings(),
+                        connection_token(limit_))->run();
+                break;
+
+            case transport::detect:
+                make_recycled<detect_session>(
+                        std::move(socket),
+                        ctx_,
+                        current_settings(),
+                        connection_token(limit_))->run();
+                break;
+            }
+        }
     }
 
+    template class basic_listener<tcp>;
+    template class basic_listener<net::local::stream_protocol>;
+
 } // namespace systemicai::http::server
\ No newline at end of file
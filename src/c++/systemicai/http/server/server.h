@@ -30,29 +30,88 @@
 #include <systemicai/common/certificate.h>
 #include <systemicai/http/server/settings.h>
 #include <systemicai/http/server/handlers.hpp>
+#include <systemicai/http/server/connection_limit.h>
 
 #include "functions.h"
 
 namespace systemicai::http::server {
 
-    // Accepts incoming connections and launches the sessions
-    class listener : public std::enable_shared_from_this<listener>
+    // What a listener expects on its connections
+    enum class transport
+    {
+        plain,  // HTTP, sessions start reading the request immediately
+        tls,    // HTTPS, sessions start with the TLS handshake
+        detect  // Either, decided per connection by detect_session
+    };
+
+    // Map a listener_settings::type ("plain", "tls" or "auto") to its transport, throws on unknown types
+    transport parse_transport(const std::string& type);
+
+    // Accepts incoming connections and launches the sessions.
+    // `Protocol` is tcp for network ports or net::local::stream_protocol for
+    // unix domain sockets, which only support `transport::plain`.
+    template<class Protocol>
+    class basic_listener : public std::enable_shared_from_this<basic_listener<Protocol>>
     {
     public:
-        listener( net::io_context& ioc, ssl::context& ctx, tcp::endpoint endpoint, std::shared_ptr<std::string const> const& doc_root, const settings& s);
+        using endpoint_type = typename Protocol::endpoint;
+        using socket_type = typename Protocol::socket;
+
+        // When `sharded` is set the acceptor is bound with SO_REUSEPORT so one
+        // listener per io_context can share the endpoint, and accepted sockets
+        // stay on `ioc` (which is run by a single thread) instead of a strand.
+        // `limit` is shared by all the listeners of a service and caps the
+        // number of open connections.  `type` selects the session launched
+        // for an accepted connection, only `transport::detect` pays for
+        // detect_session.  Every session is started with the snapshot of `s`
+        // current when its connection was accepted.
+        basic_listener( net::io_context& ioc, ssl::context& ctx, endpoint_type endpoint, settings_source& s, std::shared_ptr<connection_limit> const& limit, transport type = transport::detect, bool sharded = false);
+
+        // Accept on `fd`, a socket already bound to `endpoint` and listening,
+        // the listener takes ownership of it.  Used for the sockets received
+        // from a previous process on a hot restart.
+        basic_listener( net::io_context& ioc, ssl::context& ctx, endpoint_type endpoint, int fd, settings_source& s, std::shared_ptr<connection_limit> const& limit, transport type = transport::detect, bool sharded = false);
+
+        // Accept from `ioc` on a duplicate of the listening socket of `other`,
+        // for shards of an endpoint that cannot be bound more than once.
+        basic_listener( net::io_context& ioc, basic_listener& other);
+
         void run();
 
+        // Stop accepting and close the listening socket, open sessions are not affected
+        void stop();
+
+        // The endpoint bound, with the port picked by the system when configured as 0
+        endpoint_type endpoint() const;
+        int native_handle();
+
     private:
         void do_accept();
-        void on_accept(beast::error_code ec, tcp::socket socket);
+        void on_accept(beast::error_code ec, socket_type socket);
+        void admit(socket_type&& socket);
+        void on_resume();
+        void launch(socket_type&& socket);
+        net::any_io_executor connection_executor();
+        const settings_ptr& current_settings();
 
         net::io_context& ioc_;
         ssl::context& ctx_;
-        tcp::acceptor acceptor_;
-        std::shared_ptr<std::string const> doc_root_;
-        const settings settings_;
+        typename Protocol::acceptor acceptor_;
+        settings_source& source_;
+        // The snapshot of `source_` at `version_`, refreshed by current_settings()
+        std::uint64_t version_;
+        settings_ptr settings_;
+        std::shared_ptr<connection_limit> limit_;
+        const transport type_;
+        // An accepted connection waiting for a slot in `limit_`
+        boost::optional<socket_type> waiting_;
+        const bool sharded_;
+        endpoint_type endpoint_;
     };
 
+    using listener = basic_listener<tcp>;
+    using local_listener = basic_listener<net::local::stream_protocol>;
+
 } // namespace systemicai::http::server
 
 #endif // SYSTEMICAI_HTTP_SERVER_SERVER_H
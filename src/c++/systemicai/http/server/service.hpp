@@ -1,9 +1,29 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_SERVICE_HPP
+#define SYSTEMICAI_HTTP_SERVER_SERVICE_HPP
+
 //------------------------------------------------------------------------------
 
+#include <functional>
+#include <mutex>
 #include <thread>
 
+#include <sys/stat.h>
+
+#include <boost/log/trivial.hpp>
+
 #include <systemicai/http/server/namespace.h>
 #include <systemicai/http/server/server.h>
+#include <systemicai/http/server/handoff.h>
+#include <systemicai/http/server/buffer_pool.h>
+#include <systemicai/http/server/certificate_store.h>
+#include <systemicai/http/server/file_cache.h>
+#include <systemicai/http/server/open_file_cache.h>
+#include <systemicai/http/server/compressed_cache.h>
+#include <systemicai/http/server/recycler.h>
+#include <systemicai/http/server/handshake_pool.h>
+#include <systemicai/http/server/kernel_tls.h>
+#include <systemicai/http/server/tls_profile.h>
+#include <systemicai/http/server/tls_resumption.h>
 #include <systemicai/common/certificate.h>
 #include <systemicai/common/exception.h>
 
@@ -12,93 +32,531 @@ namespace systemicai::http::server {
 
 class service {
   private:
-  // The io_context is required for all I/O
-  std::shared_ptr<boost::asio::io_context> _ioc;
+  // The io_contexts are required for all I/O, in shared mode there is exactly one.  Only start() changes them,
+  // under _iocs_mutex, running() and stop() read them under it from other threads.
+  std::vector<std::shared_ptr<boost::asio::io_context>> _iocs;
+  mutable std::mutex _iocs_mutex;
   ssl::context& _ssl_ctx;
+  // The listeners, io threads and handoff are set up from these, a reload does not change them
   const settings& settings_;
+  // The settings pinned by every new connection, replaced by reload()
+  settings_source source_;
+  // Called on SIGHUP for the settings to reload, empty to ignore SIGHUP
+  std::function<settings()> reloader_;
+  // Every listener of every io_context, kept to hand their sockets off on a hot restart
+  std::vector<std::shared_ptr<listener>> _listeners;
+  std::vector<std::shared_ptr<local_listener>> _local_listeners;
+  // Serves settings::handoff_path while running
+  std::unique_ptr<boost::asio::local::stream_protocol::acceptor> _handoff;
+  // Session caching and tickets of the TLS connections while running
+  std::unique_ptr<tls_resumption> _resumption;
+  // Selects and reloads the certificates when settings::ssl_certificates or settings::ssl_certificate_check is set
+  std::unique_ptr<certificate_store> _certificates;
+  // Runs the TLS handshakes when settings::ssl_handshake_threads is set
+  std::unique_ptr<handshake_pool> _handshakes;
+  // The endpoints bound for the network listeners, in the order of settings::listeners
+  std::vector<boost::asio::ip::tcp::endpoint> _endpoints;
+  // Called once every listener accepts, may be empty
+  std::function<void()> started_;
+  // Set once the listening sockets went to the next process, which owns the unix socket files from then on
+  bool handed_off_ = false;
+
+  /**
+   * Create the listeners of one endpoint, one per io_context or more when more sockets were inherited
+   * @param inherited Listening sockets received from the previous process for this endpoint, owned by this call
+   */
+  template<class Listener>
+  void listen(
+      std::vector<std::shared_ptr<Listener>>& out,
+      const typename Listener::endpoint_type& endpoint,
+      std::vector<int> inherited,
+      std::shared_ptr<connection_limit> const& limit,
+      transport type,
+      bool sharded,
+      bool bind_per_ioc)
+  {
+    if(inherited.empty()) {
+      if(bind_per_ioc) {
+        // The other shards bind the port the first one got, for port 0
+        auto const first = std::make_shared<Listener>(*_iocs.front(), _ssl_ctx, endpoint, source_, limit, type, sharded);
+        out.push_back(first);
+        for(size_t i = 1; i < _iocs.size(); ++i)
+          out.push_back(std::make_shared<Listener>(*_iocs[i], _ssl_ctx, first->endpoint(), source_, limit, type, sharded));
+        return;
+      }
+      // Bound once, every other io_context accepts on a duplicate of it
+      auto const first = std::make_shared<Listener>(*_iocs.front(), _ssl_ctx, endpoint, source_, limit, type, sharded);
+      out.push_back(first);
+      for(size_t i = 1; i < _iocs.size(); ++i)
+        out.push_back(std::make_shared<Listener>(*_iocs[i], *first));
+      return;
+    }
+
+    // Every inherited socket must be accepted on, and every io_context should accept, so cover both
+    auto const n = std::max(inherited.size(), _iocs.size());
+    for(size_t i = 0; i < n; ++i) {
+      int const fd = i < inherited.size() ? inherited[i] : ::dup(inherited[i % inherited.size()]);
+      out.push_back(std::make_shared<Listener>(*_iocs[i % _iocs.size()], _ssl_ctx, endpoint, fd, source_, limit, type, sharded));
+    }
+  }
+
+  // Serve settings::handoff_path, the next process connects to it to take over our listening sockets
+  void serve_handoff(std::shared_ptr<connection_limit> const& limit) {
+    auto const& path = settings_.handoff_path;
+    _handoff = std::make_unique<boost::asio::local::stream_protocol::acceptor>(*_iocs.front());
+    beast::error_code ec;
+    // A socket file belongs to the previous process, which has handed its listeners to us already, anything else at
+    // the path is not ours to remove
+    if(!remove_socket_file(path))
+      ec = beast::errc::make_error_code(beast::errc::file_exists);
+    if(!ec)
+      _handoff->open(boost::asio::local::stream_protocol(), ec);
+    if(!ec)
+      _handoff->bind(boost::asio::local::stream_protocol::endpoint(path), ec);
+    // Only our user may connect, made so before anyone can
+    if(!ec && ::chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0)
+      ec.assign(errno, boost::asio::error::get_system_category());
+    if(!ec)
+      _handoff->listen(boost::asio::socket_base::max_listen_connections, ec);
+    if(ec) {
+      fail(ec, "handoff");
+      _handoff.reset();
+      return;
+    }
+    accept_handoff(limit);
+  }
+
+  // Hand off to the next process of our user to connect
+  void accept_handoff(std::shared_ptr<connection_limit> const& limit) {
+    _handoff->async_accept(
+        [this, limit](beast::error_code ec, boost::asio::local::stream_protocol::socket socket)
+        {
+          if(ec)
+            return;
+          if(!handoff::same_user(socket.native_handle())) {
+            BOOST_LOG_TRIVIAL(warning) << "Refused to hand the listening sockets to a process of another user";
+            return accept_handoff(limit);
+          }
+          handoff_to(socket, limit);
+        });
+  }
+
+  // Send our listening sockets to the next process, then stop accepting and drain
+  void handoff_to(boost::asio::local::stream_protocol::socket& socket, std::shared_ptr<connection_limit> const& limit) {
+    std::vector<int> fds;
+    string description;
+    for(auto& l : _listeners) {
+      fds.push_back(l->native_handle());
+      description += handoff::describe(l->endpoint());
+    }
+    for(auto& l : _local_listeners) {
+      fds.push_back(l->native_handle());
+      description += handoff::describe(l->endpoint());
+    }
+    if(!handoff::send(socket.native_handle(), fds, description)) {
+      fail(beast::error_code(errno, boost::asio::error::get_system_category()), "handoff");
+      // Keep serving, the next process binds its own sockets
+      return serve_handoff(limit);
+    }
+    BOOST_LOG_TRIVIAL(info) << "Handed " << fds.size() << " listening sockets off, draining " << limit->count() << " connections";
+    handed_off_ = true;
+
+    // The next process owns the handoff path and the listening sockets now
+    beast::error_code ec;
+    socket.close(ec);
+    _handoff->close(ec);
+    for(auto& l : _listeners)
+      l->stop();
+    for(auto& l : _local_listeners)
+      l->stop();
+
+    auto const timer = std::make_shared<boost::asio::steady_timer>(*_iocs.front());
+    drain(timer, std::chrono::steady_clock::now() + std::chrono::seconds(settings_.handoff_drain), limit);
+  }
+
+  // Stop once every open session has finished or the deadline passes
+  void drain(
+      std::shared_ptr<boost::asio::steady_timer> const& timer,
+      std::chrono::steady_clock::time_point deadline,
+      std::shared_ptr<connection_limit> const& limit) {
+    if(limit->count() == 0 || std::chrono::steady_clock::now() >= deadline) {
+      BOOST_LOG_TRIVIAL(info) << "Drained, stopping with " << limit->count() << " open connections";
+      return stop();
+    }
+    timer->expires_after(std::chrono::milliseconds(50));
+    timer->async_wait(
+        [this, timer, deadline, limit](beast::error_code const& ec)
+        {
+          if(!ec)
+            drain(timer, deadline, limit);
+        });
+  }
+
+  // Reload the settings on every SIGHUP until the service stops
+  void await_hangup(boost::asio::signal_set& hangup) {
+    hangup.async_wait(
+        [this, &hangup](beast::error_code const& ec, int)
+        {
+          if(ec)
+            return;
+          try {
+            reload(reloader_());
+            BOOST_LOG_TRIVIAL(info) << "Reloaded the settings";
+          } catch(const std::exception& e) {
+            BOOST_LOG_TRIVIAL(error) << "Keeping the current settings, reloading failed: " << e.what();
+          }
+          reload_certificates();
+          await_hangup(hangup);
+        });
+  }
+
+  // Rotate the ticket keys each settings::ssl_ticket_rotate seconds
+  void rotate_tickets(std::shared_ptr<boost::asio::steady_timer> const& timer) {
+    timer->expires_after(std::chrono::seconds(settings_.ssl_ticket_rotate));
+    timer->async_wait(
+        [this, timer](beast::error_code const& ec)
+        {
+          if(ec)
+            return;
+          if(!_resumption->rotate())
+            BOOST_LOG_TRIVIAL(error) << "Keeping the current ticket keys, reading " << settings_.ssl_ticket_keys << " failed";
+          rotate_tickets(timer);
+        });
+  }
+
+  // Reload the certificates when one of their files changed, checked each settings::ssl_certificate_check seconds
+  void watch_certificates(std::shared_ptr<boost::asio::steady_timer> const& timer) {
+    timer->expires_after(std::chrono::seconds(settings_.ssl_certificate_check));
+    timer->async_wait(
+        [this, timer](beast::error_code const& ec)
+        {
+          if(ec)
+            return;
+          if(_certificates->changed())
+            reload_certificates();
+          watch_certificates(timer);
+        });
+  }
+
+  // Log the buffer memory of every io thread each settings::log_buffers seconds
+  void report_buffers(std::shared_ptr<boost::asio::steady_timer> const& timer) {
+    timer->expires_after(std::chrono::seconds(settings_.log_buffers));
+    timer->async_wait(
+        [this, timer](beast::error_code const& ec)
+        {
+          if(ec)
+            return;
+          for(auto& u : buffer_pool::report())
+            BOOST_LOG_TRIVIAL(info) << "Buffers of thread " << u.thread << (u.running ? "" : " (exited)") << ": "
+                                    << u.lent << " bytes lent, " << u.cached << " bytes cached";
+          report_buffers(timer);
+        });
+  }
+
+  /**
+   * Release what start() set up once its io_contexts stopped, or when setting up throws, so it can be started again
+   * @param limit The connection limit of the listeners
+   */
+  void teardown(connection_limit& limit) {
+    // Sessions still handshaking go before the io contexts of their sockets, the pool after them
+    if(_handshakes)
+      _handshakes->stop();
+
+    // Release the listeners paused at the connection limit
+    limit.clear();
+
+    // The socket files of the unix listeners go with them, unless the next process serves them now
+    if(!handed_off_)
+      for(auto& l : _local_listeners)
+        remove_socket_file(l->endpoint().path());
+
+    // Reset our io contexts so we can be started again
+    _handoff.reset();
+    _listeners.clear();
+    _local_listeners.clear();
+    _endpoints.clear();
+    {
+      std::lock_guard<std::mutex> lg(_iocs_mutex);
+      _iocs.clear();
+    }
+    _resumption.reset();
+    _certificates.reset();
+  }
 
   public:
-  explicit service(const settings& s, ssl::context& sslc) : _ssl_ctx(sslc), settings_(s) {
+  explicit service(const settings& s, ssl::context& sslc) : _ssl_ctx(sslc), settings_(s), source_(s) {
+  }
+
+  /**
+   * Publish new settings to the running service, it may be called from any thread.  Connections accepted from now on
+   * use them, open connections keep the settings they were accepted with.  Document root, routes, limits and timeouts
+   * change this way, the listeners, io threads and handoff path only on a restart.
+   */
+  void reload(const settings& s) {
+    source_.store(s);
+    buffer_pool::cache_limit(s.limit_buffer_cache);
+    recycler::limit(s.limit_session_cache);
+    file_cache::global().limit(s.limit_file_cache, s.limit_file_cache_entry);
+    open_file_cache::global().limit(s.limit_open_files, std::chrono::milliseconds(s.limit_open_file_ttl));
+    compressed_cache::global().limit(s.limit_compressed_cache, s.limit_compressed_file, s.compression_level);
+  }
+
+  /**
+   * Reload the certificates of the current settings in the background, as SIGHUP does.  New handshakes get them once
+   * they are loaded, nothing waits for the files.
+   * @return False when the certificates are not managed by the service, or a reload is already running
+   */
+  bool reload_certificates() {
+    return _certificates && _certificates->reload_async(*current_settings());
+  }
+
+  /**
+   * Rotate the ticket keys now, as is done each settings::ssl_ticket_rotate seconds
+   * @return False when the service issues no tickets, or the key file could not be read
+   */
+  bool rotate_ticket_keys() {
+    return _resumption && settings_.ssl_tickets && _resumption->rotate();
+  }
+
+  // The settings pinned by the connections accepted now
+  settings_ptr current_settings() const {
+    return source_.load();
+  }
+
+  /**
+   * Reload the settings returned by `load` on every SIGHUP while the service runs.  It is called on an io thread, and
+   * throws to keep the current settings.  Set before start().
+   */
+  void reload_on_hangup(std::function<settings()> load) {
+    reloader_ = std::move(load);
+  }
+
+  // Call `f` on an io thread once every listener accepts connections.  Set before start().
+  void on_started(std::function<void()> f) {
+    started_ = std::move(f);
+  }
+
+  /**
+   * The endpoints the network listeners are bound to, in the order of settings::listeners without the unix ones.  A
+   * port configured as 0 reads as the port the system picked.  Valid from on_started() until start() returns.
+   */
+  const std::vector<boost::asio::ip::tcp::endpoint>& endpoints() const {
+    return _endpoints;
   }
 
   /**
    * Start the http service and run until SIGSTOP, SIGTERM or @see this->stop() is called.
+   *
+   * In "shared" thread mode a single io_context is run by all of the io threads.  In "sharded" mode every
+   * io thread runs its own io_context with its own SO_REUSEPORT listener, so a connection is accepted,
+   * served and closed by the same thread.
+   *
+   * Every entry of settings::listeners gets a listening port.  "plain" and "tls" ports hand their connections
+   * straight to the matching http session, "auto" ports detect TLS on each connection first.  "unix" listeners
+   * serve plain HTTP on a unix domain socket path, whose socket file is removed when the service stops.
+   *
+   * With settings::handoff_path set, the listening sockets are first requested from a running process serving
+   * that path, so a restart never refuses a connection.  The running process then stops accepting, finishes its
+   * open sessions within settings::handoff_drain seconds and returns from start().  Either way this process then
+   * serves the path for the next restart.
    * @return Exit status of the http service (always excess), returns failure if the service is already started
    * @throws Exception on error (unknown type)
    */
   int start()
   {
-    if(_ioc) {
-      // If this is set, the service is already running
-      return EXIT_FAILURE;
+    {
+      std::lock_guard<std::mutex> lg(_iocs_mutex);
+      if(!_iocs.empty()) {
+        // If this is set, the service is already running
+        return EXIT_FAILURE;
+      }
     }
     auto const threads = std::max<int>(1, settings_.thread_io);
-    _ioc = std::make_shared<boost::asio::io_context>(threads);
-    auto const address = boost::asio::ip::make_address(settings_.interface_address.data());
-    auto const port = settings_.interface_port;
-    auto const doc_root = std::make_shared<string>(settings_.document_root);
-
-    // Create and launch a listening port
-    std::make_shared<listener>(
-        *_ioc,
-        _ssl_ctx,
-        boost::asio::ip::tcp::endpoint{address, port},
-        doc_root,
-        settings_)->run();
+    auto const sharded = settings_.thread_mode == "sharded";
+    handed_off_ = false;
+
+    // Resolve the listeners first, so a bad address or type throws before anything is started
+    std::vector<std::pair<boost::asio::ip::tcp::endpoint, transport>> endpoints;
+    std::vector<boost::asio::local::stream_protocol::endpoint> local_endpoints;
+    for(auto& ls : settings_.listeners) {
+      if(ls.type == "unix") {
+        if(ls.path.empty())
+          throw systemicai::common::exception("A unix listener needs a path");
+        local_endpoints.emplace_back(ls.path);
+        continue;
+      }
+      endpoints.emplace_back(
+          boost::asio::ip::tcp::endpoint{boost::asio::ip::make_address(ls.address.data()), ls.port},
+          parse_transport(ls.type));
+    }
+    // A bad TLS profile, ticket key file or certificate throws before anything is started as well
+    apply_tls_profile(_ssl_ctx, settings_);
+    _resumption = std::make_unique<tls_resumption>(_ssl_ctx, settings_);
+    if(!settings_.ssl_certificates.empty() || settings_.ssl_certificate_check != 0)
+      _certificates = std::make_unique<certificate_store>(_ssl_ctx, settings_);
+    if(settings_.ssl_ktls)
+      kernel_tls::prepare(_ssl_ctx);
+    _handshakes.reset();
+    if(settings_.ssl_handshake_threads != 0)
+      _handshakes = std::make_unique<handshake_pool>(_ssl_ctx, settings_.ssl_handshake_threads);
+
+    // Shared by every listener, so the cap applies to the service as a whole
+    auto const limit = std::make_shared<connection_limit>(settings_.limit_connections);
+
+    std::vector<std::shared_ptr<boost::asio::io_context>> iocs;
+    if(sharded) {
+      for(auto i = 0; i < threads; ++i)
+        iocs.push_back(std::make_shared<boost::asio::io_context>(1));
+    } else {
+      iocs.push_back(std::make_shared<boost::asio::io_context>(threads));
+    }
+    {
+      std::lock_guard<std::mutex> lg(_iocs_mutex);
+      _iocs = std::move(iocs);
+    }
+
+    // Whatever throws from here on leaves the service stopped, so it can be started again
+    try {
+      // On a hot restart, take over the listening sockets of the running process instead of binding new ones
+      std::vector<handoff::descriptor> inherited;
+      if(!settings_.handoff_path.empty() && handoff::request(settings_.handoff_path, inherited))
+        BOOST_LOG_TRIVIAL(info) << "Received " << inherited.size() << " listening sockets from " << settings_.handoff_path;
+      auto const take = [&inherited](auto&& matches) {
+        std::vector<int> fds;
+        for(auto& d : inherited)
+          if(d.fd >= 0 && matches(d)) {
+            fds.push_back(d.fd);
+            d.fd = -1;
+          }
+        return fds;
+      };
+
+      // Create every listening port on each io_context
+      for(auto& [endpoint, type] : endpoints) {
+        auto const first = _listeners.size();
+        listen(_listeners, endpoint,
+            take([&endpoint](const handoff::descriptor& d) { return d.type == "tcp" && d.tcp_endpoint == endpoint; }),
+            limit, type, sharded, true);
+        _endpoints.push_back(_listeners[first]->endpoint());
+      }
+
+      // A unix domain socket path can only be bound once
+      for(auto& endpoint : local_endpoints)
+        listen(_local_listeners, endpoint,
+            take([&endpoint](const handoff::descriptor& d) { return d.type == "unix" && d.path == endpoint.path(); }),
+            limit, transport::plain, sharded, false);
+
+      // Sockets of listeners that are no longer configured
+      for(auto& d : inherited)
+        if(d.fd >= 0)
+          ::close(d.fd);
+
+      for(auto& l : _listeners)
+        l->run();
+      for(auto& l : _local_listeners)
+        l->run();
+
+      if(!settings_.handoff_path.empty())
+        serve_handoff(limit);
+
+      auto const current = source_.load();
+      buffer_pool::cache_limit(current->limit_buffer_cache);
+      recycler::limit(current->limit_session_cache);
+      file_cache::global().limit(current->limit_file_cache, current->limit_file_cache_entry);
+      open_file_cache::global().limit(current->limit_open_files, std::chrono::milliseconds(current->limit_open_file_ttl));
+      compressed_cache::global().limit(current->limit_compressed_cache, current->limit_compressed_file, current->compression_level);
+      if(settings_.log_buffers != 0)
+        report_buffers(std::make_shared<boost::asio::steady_timer>(*_iocs.front()));
+      if(settings_.ssl_tickets)
+        rotate_tickets(std::make_shared<boost::asio::steady_timer>(*_iocs.front()));
+      if(_certificates && settings_.ssl_certificate_check != 0)
+        watch_certificates(std::make_shared<boost::asio::steady_timer>(*_iocs.front()));
+      if(started_)
+        boost::asio::post(*_iocs.front(), started_);
+    } catch(...) {
+      teardown(*limit);
+      throw;
+    }
+
+    // A listener paused at the connection limit has no pending work, keep its io_context running until stop()
+    std::vector<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> work;
+    for(auto& ioc : _iocs)
+      work.push_back(boost::asio::make_work_guard(*ioc));
+
+    // The signal sets below are destroyed on return, after _iocs is cleared
+    auto const signal_ioc = _iocs.front();
 
     // Capture SIGINT and SIGTERM to perform a clean shutdown
-    boost::asio::signal_set signals(*_ioc, SIGINT, SIGTERM);
+    boost::asio::signal_set signals(*signal_ioc, SIGINT, SIGTERM);
     signals.async_wait(
         [&](beast::error_code const&, int)
         {
-          // Stop the `io_context`. This will cause `run()`
+          // Stop the `io_context`s. This will cause `run()`
           // to return immediately, eventually destroying the
-          // `io_context` and all of the sockets in it.
-          _ioc->stop();
+          // `io_context`s and all of the sockets in them.
+          stop();
         });
+    boost::asio::signal_set hangup(*signal_ioc);
+    if(reloader_) {
+      hangup.add(SIGHUP);
+      await_hangup(hangup);
+    }
 
     // Run the I/O service on the requested number of threads
     std::vector<std::thread> v;
     v.reserve(threads - 1);
     for(auto i = threads - 1; i > 0; --i)
       v.emplace_back(
-        [this]
+        [ioc = _iocs[sharded ? i : 0]]
         {
-          this->_ioc->run();
+          recycler::io_thread io;
+          ioc->run();
         }
       );
-    _ioc->run();
+    {
+      recycler::io_thread io;
+      _iocs.front()->run();
+    }
 
     // (If we get here, it means we got a SIGINT or SIGTERM)
 
     // Block until all the threads exit
     for(auto& t : v)
       t.join();
+    work.clear();
+    teardown(*limit);
 
-    // Reset our io context so we can be started again
-    _ioc.reset();
+    auto const handshakes = tls_resumption::handshakes();
+    BOOST_LOG_TRIVIAL(info) << "TLS handshakes: " << handshakes.full << " full, " << handshakes.resumed << " resumed";
+    if(settings_.ssl_ktls) {
+      auto const ktls = kernel_tls::sessions();
+      BOOST_LOG_TRIVIAL(info) << "Kernel TLS: " << ktls.enabled << " sessions, " << ktls.fallback << " in user space";
+    }
 
     return EXIT_SUCCESS;
   }
 
-
-
   /**
    * Return true if the service is running and handling requests, false otherwise.
    * @return
    */
   bool running() {
-    if(!_ioc)
+    std::lock_guard<std::mutex> lg(_iocs_mutex);
+    if(_iocs.empty())
       return false;
-    return !_ioc->stopped();
+    return !_iocs.front()->stopped();
   }
 
   /**
-   * Calls stop on the io context.  Returns no value, does not block.  Success or failure is returned from the service::start() method
+   * Calls stop on the io contexts.  Returns no value, does not block.  Success or failure is returned from the service::start() method
    * @see: boost::asio::io_context::stop
    */
   void stop() {
-    _ioc->stop();
+    std::lock_guard<std::mutex> lg(_iocs_mutex);
+    for(auto& ioc : _iocs)
+      ioc->stop();
   }
 };
 }
+
+#endif // SYSTEMICAI_HTTP_SERVER_SERVICE_HPP
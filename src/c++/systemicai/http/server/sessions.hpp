@@ -14,24 +14,46 @@
 //
 //------------------------------------------------------------------------------
 
+#ifndef SYSTEMICAI_HTTP_SERVER_SESSIONS_HPP
+#define SYSTEMICAI_HTTP_SERVER_SESSIONS_HPP
+
 #include <algorithm>
 #include <cstdlib>
 #include <functional>
 #include <iostream>
+#include <limits>
 #include <memory>
 #include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
+#include <sys/sendfile.h>
+#include <unistd.h>
+
 #include <systemicai/http/server/namespace.h>
 #include <systemicai/common/certificate.h>
 #include <systemicai/http/server/settings.h>
 #include <systemicai/http/server/handlers.hpp>
+#include <systemicai/http/server/connection_limit.h>
+#include <systemicai/http/server/arena.h>
+#include <systemicai/http/server/buffer_pool.h>
+#include <systemicai/http/server/timer_wheel.h>
+#include <systemicai/http/server/handler_watchdog.h>
+#include <systemicai/http/server/recycler.h>
+#include <systemicai/http/server/shared_file_body.h>
+#include <systemicai/http/server/mmap_body.h>
+#include <systemicai/http/server/handshake_pool.h>
+#include <systemicai/http/server/kernel_tls.h>
+#include <systemicai/http/server/tls_resumption.h>
 
 #include "functions.h"
 
 namespace systemicai::http::server {
 
+    // A stream over a unix domain socket, with the same timeouts as beast::tcp_stream
+    using local_stream = beast::basic_stream<net::local::stream_protocol>;
+
     // Echoes back all received WebSocket messages.
     // This uses the Curiously Recurring Template Pattern so that
     // the same code works with both SSL streams and regular sockets.
@@ -46,7 +68,11 @@ namespace systemicai::http::server {
             return static_cast<Derived&>(*this);
         }
 
-        beast::flat_buffer buffer_;
+        session_buffer buffer_;
+        connection_token token_;
+        // The first byte of a message, read into the session so an idle
+        // connection does not hold a buffer from the pool
+        char first_ = 0;
 
         // Start the asynchronous operation
         template<class Body, class Allocator>
@@ -86,10 +112,31 @@ namespace systemicai::http::server {
             do_read();
         }
 
+        // Wait for the next message with a read of its first byte, a TLS
+        // stream may have it decrypted already so this is also how
+        // readability is waited for
         void
         do_read()
         {
-            // Read a message into our buffer
+            derived().ws().async_read_some(
+                    net::buffer(&first_, 1),
+                    beast::bind_front_handler(
+                            &websocket_session::on_read_first,
+                            derived().shared_from_this()));
+        }
+
+        void
+        on_read_first(
+                beast::error_code ec,
+                std::size_t bytes_transferred)
+        {
+            if(ec)
+                return on_read(ec, 0);
+
+            // Then the rest of the message into our buffer
+            buffer_.commit(net::buffer_copy(buffer_.prepare(bytes_transferred), net::buffer(&first_, bytes_transferred)));
+            if(derived().ws().is_message_done())
+                return on_read(ec, bytes_transferred);
             derived().ws().async_read(
                     buffer_,
                     beast::bind_front_handler(
@@ -130,14 +177,21 @@ namespace systemicai::http::server {
             if(ec)
                 return fail(ec, "write");
 
-            // Clear the buffer
+            // Clear the buffer, its memory goes back to the pool until the next message
             buffer_.consume(buffer_.size());
+            buffer_.shrink_to_fit();
 
             // Do another read
             do_read();
         }
 
     public:
+        explicit
+        websocket_session(connection_token&& token)
+                : token_(std::move(token))
+        {
+        }
+
         // Start the asynchronous operation
         template<class Body, class Allocator>
         void
@@ -150,30 +204,36 @@ namespace systemicai::http::server {
 
     //------------------------------------------------------------------------------
 
-    // Handles a plain WebSocket connection
-    class plain_websocket_session
-            : public websocket_session<plain_websocket_session>
-                    , public std::enable_shared_from_this<plain_websocket_session>
+    // Handles a plain WebSocket connection over a tcp_stream or a local_stream
+    template<class Stream>
+    class basic_plain_websocket_session
+            : public websocket_session<basic_plain_websocket_session<Stream>>
+                    , public std::enable_shared_from_this<basic_plain_websocket_session<Stream>>
     {
-        websocket::stream<beast::tcp_stream> ws_;
+        websocket::stream<Stream> ws_;
 
     public:
         // Create the session
         explicit
-        plain_websocket_session(
-                beast::tcp_stream&& stream)
-                : ws_(std::move(stream))
+        basic_plain_websocket_session(
+                Stream&& stream,
+                connection_token&& token)
+                : websocket_session<basic_plain_websocket_session>(std::move(token))
+                , ws_(std::move(stream))
         {
         }
 
         // Called by the base class
-        websocket::stream<beast::tcp_stream>&
+        websocket::stream<Stream>&
         ws()
         {
             return ws_;
         }
     };
 
+    using plain_websocket_session = basic_plain_websocket_session<beast::tcp_stream>;
+    using local_websocket_session = basic_plain_websocket_session<local_stream>;
+
     //------------------------------------------------------------------------------
 
     // Handles an SSL WebSocket connection
@@ -188,8 +248,10 @@ namespace systemicai::http::server {
         // Create the ssl_websocket_session
         explicit
         ssl_websocket_session(
-                beast::ssl_stream<beast::tcp_stream>&& stream)
-                : ws_(std::move(stream))
+                beast::ssl_stream<beast::tcp_stream>&& stream,
+                connection_token&& token)
+                : websocket_session<ssl_websocket_session>(std::move(token))
+                , ws_(std::move(stream))
         {
         }
 
@@ -208,20 +270,33 @@ namespace systemicai::http::server {
     void
     make_websocket_session(
             beast::tcp_stream stream,
+            connection_token&& token,
             beast::http::request<Body, beast::http::basic_fields<Allocator>> req)
     {
-        std::make_shared<plain_websocket_session>(
-                std::move(stream))->run(std::move(req));
+        make_recycled<plain_websocket_session>(
+                std::move(stream), std::move(token))->run(std::move(req));
+    }
+
+    template<class Body, class Allocator>
+    void
+    make_websocket_session(
+            local_stream stream,
+            connection_token&& token,
+            beast::http::request<Body, beast::http::basic_fields<Allocator>> req)
+    {
+        make_recycled<local_websocket_session>(
+                std::move(stream), std::move(token))->run(std::move(req));
     }
 
     template<class Body, class Allocator>
     void
     make_websocket_session(
             beast::ssl_stream<beast::tcp_stream> stream,
+            connection_token&& token,
             beast::http::request<Body, beast::http::basic_fields<Allocator>> req)
     {
-        std::make_shared<ssl_websocket_session>(
-                std::move(stream))->run(std::move(req));
+        make_recycled<ssl_websocket_session>(
+                std::move(stream), std::move(token))->run(std::move(req));
     }
 
     //------------------------------------------------------------------------------
@@ -230,7 +305,7 @@ namespace systemicai::http::server {
     // This uses the Curiously Recurring Template Pattern so that
     // the same code works with both SSL streams and regular sockets.
     template<class Derived>
-    class http_session
+    class http_session : public handlers::body_source
     {
         // Access the derived class, this is part of
         // the Curiously Recurring Template Pattern idiom.
@@ -240,55 +315,136 @@ namespace systemicai::http::server {
             return static_cast<Derived&>(*this);
         }
 
-        // This queue is used for HTTP pipelining.
+        // The buffers of one gather write
+        using buffers_type = std::vector<net::const_buffer,
+                std::allocator_traits<arena_allocator<char>>::rebind_alloc<net::const_buffer>>;
+
+        enum
+        {
+            // The most buffers gathered in one write, which is also
+            // the most asio hands to the kernel in a single call
+            max_gather = 64,
+
+            // The size of the chunks a streamed request body is read in
+            body_chunk = 65536,
+
+            // The buffer borrowed for the first read of a request,
+            // enough for most headers
+            request_read = 4096,
+
+            // The most bytes of a file one sendfile call is asked for
+            sendfile_chunk = 1 << 20,
+
+            // The most bytes sent from a file before the other sessions
+            // of the io thread get their turn
+            sendfile_turn = 4 << 20,
+
+            // Milliseconds the rest of a refused body is read and
+            // discarded before the connection is closed
+            drain_time = 2000
+        };
+
+        // The part of a file left to send of a response body
+        struct file_range
+        {
+            int fd;
+            std::uint64_t offset;
+            std::uint64_t size;
+        };
+
+        // This queue is used for HTTP pipelining.  The responses are
+        // held in a ring, its capacity is settings::limit_pipeline.
         class queue
         {
-            enum
+            // The type-erased, saved work item: a response and its serializer
+            struct work
             {
-                // Maximum number of responses we will queue
-                limit = 8
+                virtual ~work() = default;
+                // Append the next buffers of the serialized response to
+                // `buffers`.  Returns `true` if they hold all of the rest.
+                virtual bool prepare(buffers_type& buffers, beast::error_code& ec) = 0;
+                // Mark up to `n` bytes as written, returns how many were used
+                virtual std::size_t consume(std::size_t n) = 0;
+                // The rest of a body sent with sendfile, once the header is
+                // written, null when the serializer writes it
+                virtual file_range* file() = 0;
+                // Mark `n` bytes of file() as sent
+                virtual void sent(std::size_t n) = 0;
+                virtual bool is_done() = 0;
+                virtual bool need_eof() const = 0;
+                // Destroy the item and return its memory to the arena
+                virtual void destroy() = 0;
             };
 
-            // The type-erased, saved work item
-            struct work
+            struct destroy_work
             {
-                virtual ~work() = default;
-                virtual void operator()() = 0;
+                void operator()(work* w) const
+                {
+                    w->destroy();
+                }
             };
 
+            using item = std::unique_ptr<work, destroy_work>;
+
             http_session& self_;
-            std::vector<std::unique_ptr<work>> items_;
+            std::vector<item, std::allocator_traits<arena_allocator<char>>::rebind_alloc<item>> items_;
+            std::size_t head_ = 0;
+            std::size_t size_ = 0;
 
         public:
-            explicit
-            queue(http_session& self)
+            queue(http_session& self, std::size_t limit)
                     : self_(self)
+                    , items_(std::max<std::size_t>(limit, 1), self.get_allocator())
             {
-                static_assert(limit > 0, "queue limit must be positive");
-                items_.reserve(limit);
             }
 
             // Returns `true` if we have reached the queue limit
             bool
             is_full() const
             {
-                return items_.size() >= limit;
+                return size_ >= items_.size();
             }
 
-            // Called when a message finishes sending
-            // Returns `true` if the caller should initiate a read
             bool
-            on_write()
+            empty() const
+            {
+                return size_ == 0;
+            }
+
+            std::size_t
+            size() const
+            {
+                return size_;
+            }
+
+            // The i-th oldest response
+            work&
+            operator[](std::size_t i)
             {
-                BOOST_ASSERT(! items_.empty());
-                auto const was_full = is_full();
-                items_.erase(items_.begin());
-                if(! items_.empty())
-                    (*items_.front())();
-                return was_full;
+                BOOST_ASSERT(i < size_);
+                return *items_[(head_ + i) % items_.size()];
             }
 
-            // Called by the HTTP handler to send a response.
+            // Destroy the oldest response, once it is written
+            void
+            pop()
+            {
+                BOOST_ASSERT(! empty());
+                items_[head_].reset();
+                head_ = (head_ + 1) % items_.size();
+                --size_;
+            }
+
+            // Whether the session sends file bodies with sendfile rather
+            // than through the serializer, the handler maps no file for it
+            bool
+            sends_files() const
+            {
+                return self_.derived().sends_files();
+            }
+
+            // Called by the HTTP handler to send a response.  It is
+            // written by http_session::flush() once the handler returns.
             template<bool isRequest, class Body, class Fields>
             void
             operator()(beast::http::message<isRequest, Body, Fields>&& msg)
@@ -296,166 +452,845 @@ namespace systemicai::http::server {
                 // This holds a work item
                 struct work_impl : work
                 {
-                    http_session& self_;
+                    using allocator_type = typename std::allocator_traits<
+                            arena_allocator<char>>::template rebind_alloc<work_impl>;
+
                     beast::http::message<isRequest, Body, Fields> msg_;
+                    beast::http::serializer<isRequest, Body, Fields> sr_;
+                    allocator_type alloc_;
+                    // Bytes of the last prepare() not consumed yet
+                    std::size_t prepared_ = 0;
+                    // Bytes left to write, when they are known
+                    boost::optional<std::uint64_t> left_;
+                    // The body is sent from its file, the serializer only writes the header
+                    bool sendfile_ = false;
+                    file_range range_{};
 
                     work_impl(
-                            http_session& self,
-                            beast::http::message<isRequest, Body, Fields>&& msg)
-                            : self_(self)
-                            , msg_(std::move(msg))
+                            beast::http::message<isRequest, Body, Fields>&& msg,
+                            const allocator_type& alloc,
+                            bool sendfile)
+                            : msg_(std::move(msg))
+                            , sr_(msg_)
+                            , alloc_(alloc)
                     {
+                        auto const payload = msg_.payload_size();
+                        if(payload && ! msg_.chunked())
+                            left_ = header_size() + *payload;
+
+                        if constexpr(std::is_same_v<Body, beast::http::file_body>)
+                        {
+                            beast::error_code ec;
+                            auto const pos = msg_.body().file().pos(ec);
+                            if(sendfile && left_ && ! ec)
+                            {
+                                sendfile_ = true;
+                                range_ = {msg_.body().file().native_handle(), pos, msg_.body().size()};
+                                sr_.split(true);
+                            }
+                        }
+                        else if constexpr(std::is_same_v<Body, shared_file_body>)
+                        {
+                            if(sendfile && left_)
+                            {
+                                sendfile_ = true;
+                                range_ = {msg_.body().file->fd, msg_.body().offset, msg_.body().size};
+                                sr_.split(true);
+                            }
+                        }
+                        else if constexpr(std::is_same_v<Body, mmap_body>)
+                        {
+                            if(sendfile && left_ && msg_.body().file)
+                            {
+                                sendfile_ = true;
+                                range_ = {msg_.body().file->fd, msg_.body().offset, msg_.body().size};
+                                sr_.split(true);
+                            }
+                        }
+                    }
+
+                    std::size_t
+                    header_size() const
+                    {
+                        if constexpr(isRequest)
+                            return beast::buffer_bytes(typename Fields::writer(
+                                    msg_, msg_.version(), msg_.method()).get());
+                        else
+                            return beast::buffer_bytes(typename Fields::writer(
+                                    msg_, msg_.version(), msg_.result_int()).get());
+                    }
+
+                    bool
+                    prepare(buffers_type& buffers, beast::error_code& ec)
+                    {
+                        if(sendfile_ && sr_.is_header_done())
+                            return false;
+                        sr_.next(ec,
+                                [&](beast::error_code&, auto const& b)
+                                {
+                                    prepared_ = 0;
+                                    for(auto const buffer : beast::buffers_range_ref(b))
+                                    {
+                                        buffers.push_back(buffer);
+                                        prepared_ += buffer.size();
+                                    }
+                                });
+                        return ! ec && left_ && *left_ == prepared_;
+                    }
+
+                    std::size_t
+                    consume(std::size_t n)
+                    {
+                        n = std::min(n, prepared_);
+                        if(n == 0)
+                            return 0;
+                        sr_.consume(n);
+                        prepared_ -= n;
+                        if(left_)
+                            *left_ -= n;
+                        return n;
+                    }
+
+                    file_range*
+                    file()
+                    {
+                        if(sendfile_ && sr_.is_header_done() && range_.size != 0)
+                            return &range_;
+                        return nullptr;
                     }
 
                     void
-                    operator()()
+                    sent(std::size_t n)
                     {
-                        beast::http::async_write(
-                                self_.derived().stream(),
-                                msg_,
-                                beast::bind_front_handler(
-                                        &http_session::on_write,
-                                        self_.derived().shared_from_this(),
-                                        msg_.need_eof()));
+                        range_.offset += n;
+                        range_.size -= n;
+                        *left_ -= n;
+                    }
+
+                    bool
+                    is_done()
+                    {
+                        if(sendfile_)
+                            return sr_.is_header_done() && range_.size == 0;
+                        return sr_.is_done();
+                    }
+
+                    bool
+                    need_eof() const
+                    {
+                        return msg_.need_eof();
+                    }
+
+                    void
+                    destroy()
+                    {
+                        auto alloc = alloc_;
+                        this->~work_impl();
+                        std::allocator_traits<allocator_type>::deallocate(alloc, this, 1);
                     }
                 };
 
-                // Allocate and store the work
-                items_.push_back(
-                        boost::make_unique<work_impl>(self_, std::move(msg)));
+                BOOST_ASSERT(! is_full());
 
-                // If there was no previous work, start this one
-                if(items_.size() == 1)
-                    (*items_.front())();
+                // Allocate and store the work
+                typename work_impl::allocator_type alloc(self_.get_allocator());
+                auto const p = std::allocator_traits<decltype(alloc)>::allocate(alloc, 1);
+                try
+                {
+                    ::new(static_cast<void*>(p)) work_impl(std::move(msg), alloc, self_.derived().sends_files());
+                }
+                catch(...)
+                {
+                    std::allocator_traits<decltype(alloc)>::deallocate(alloc, p, 1);
+                    throw;
+                }
+                items_[(head_ + size_) % items_.size()].reset(p);
+                ++size_;
             }
         };
 
-        std::shared_ptr<std::string const> doc_root_;
+    public:
+        // Requests, responses and pending operations of the
+        // session are allocated from its arena
+        using allocator_type = arena_allocator<char>;
+        // What body handlers send their response with
+        using send_type = queue;
+        using request_body = beast::http::basic_string_body<
+                char, std::char_traits<char>, allocator_type>;
+
+    private:
+        std::shared_ptr<arena> arena_;
         queue queue_;
-        const settings& settings_;
+        buffers_type buffers_;
+        // A gather write is in progress
+        bool writing_ = false;
+        // Our slot in the service's connection limit
+        connection_token token_;
+        // A request was served, the next one is awaited with the keep-alive timeout
+        bool served_ = false;
+        // A response closing the connection is queued and no more requests are read
+        bool closing_ = false;
+        // The closing response refused a body, the rest of the body is drained after it
+        bool draining_ = false;
 
         // The parser is stored in an optional container so we can
         // construct it from scratch it at the beginning of each new message.
-        boost::optional<beast::http::request_parser<beast::http::string_body>> parser_;
+        boost::optional<beast::http::request_parser<request_body, allocator_type>> parser_;
+
+        // A request body streamed to a body handler takes over the
+        // parser once the header is parsed, one chunk at a time
+        boost::optional<beast::http::request_parser<beast::http::buffer_body, allocator_type>> body_parser_;
+        std::unique_ptr<handlers::body_handler<queue>> body_handler_;
+        std::unique_ptr<char[]> chunk_;
+        // Keeps the session alive while the body handler paused reading, no operation is pending meanwhile
+        std::shared_ptr<Derived> paused_;
 
     protected:
-        beast::flat_buffer buffer_;
+        // The settings the connection was accepted with, a reload does not affect them
+        const settings_ptr settings_;
+        session_buffer buffer_;
+        // Close the connection when reading a request, or writing responses, takes too long
+        session_deadline<Derived> read_deadline_;
+        session_deadline<Derived> write_deadline_;
+        handler_deadline handler_deadline_;
+        // When the last read completed, the first byte of a request left in buffer_ arrived then
+        std::chrono::steady_clock::time_point received_;
 
     public:
         // Construct the session
         http_session(
-                beast::flat_buffer buffer,
-                std::shared_ptr<std::string const> const& doc_root,
-                const settings& s)
-                : doc_root_(doc_root)
-                , queue_(*this)
-                , settings_(s)
+                session_buffer buffer,
+                settings_ptr s,
+                connection_token&& token)
+                : arena_(recycler::make_arena())
+                , queue_(*this, s->limit_pipeline)
+                , buffers_(get_allocator())
+                , token_(std::move(token))
+                , settings_(std::move(s))
                 , buffer_(std::move(buffer))
+                , read_deadline_(derived())
+                , write_deadline_(derived())
         {
+            buffers_.reserve(max_gather);
+        }
+
+        allocator_type
+        get_allocator() const
+        {
+            return allocator_type(arena_);
+        }
+
+        // What is written to the socket itself reaches the client as it is
+        bool
+        writes_socket()
+        {
+            using stream_type = std::decay_t<decltype(derived().stream())>;
+            using socket_type = std::decay_t<decltype(beast::get_lowest_layer(derived().stream()))>;
+            return std::is_same_v<stream_type, socket_type> || derived().kernel_tls_enabled();
         }
 
         void
         do_read()
         {
-            // Construct a new parser for each message
-            parser_.emplace();
+            // Construct a new parser for each message, its
+            // fields and body draw from the arena
+            parser_.emplace(
+                    std::piecewise_construct,
+                    std::make_tuple(get_allocator()),
+                    std::make_tuple(get_allocator()));
+
+            // The body limit depends on the route of the request,
+            // it is applied once the header is parsed
+            parser_->body_limit((std::numeric_limits<std::uint64_t>::max)());
+
+            // Requests pipelined behind the previous one may be buffered
+            // already.  They are handled right away, so their responses
+            // are all queued before flush() and share one write.
+            beast::error_code ec;
+            if(parse_buffered(ec, true) || ec)
+                return on_read_header(ec, 0);
 
-            // Apply a reasonable limit to the allowed size
-            // of the body in bytes to prevent abuse.
-            parser_->body_limit(10000);
+            if(buffer_.size() != 0)
+                return do_read_header();
 
-            // Set the timeout.
-            beast::get_lowest_layer(
-                    derived().stream()).expires_after(std::chrono::seconds(30));
+            // Wait for the first bytes of the request, a connection
+            // kept alive gets the idle timeout until they arrive
+            read_deadline_.expires_after(std::chrono::milliseconds(
+                    served_ ? settings_->timeout_idle : settings_->timeout_header));
+            do_wait();
+        }
+
+        // The buffer goes back to the pool while the connection is idle.
+        // Plain connections borrow it again once the request arrives.
+        // TLS ones are the exception, they keep request_read bytes of it
+        // for the read in progress: OpenSSL may have decrypted the next
+        // request already, which readability of the socket would miss.
+        void
+        do_wait()
+        {
+            buffer_.shrink_to_fit();
+            if constexpr(Derived::wait_readable)
+            {
+                beast::get_lowest_layer(derived().stream()).socket().async_wait(
+                        net::socket_base::wait_read,
+                        bind_allocator(
+                                get_allocator(),
+                                beast::bind_front_handler(
+                                        &http_session::on_readable,
+                                        derived().shared_from_this())));
+            }
+            else
+            {
+                derived().stream().async_read_some(
+                        buffer_.prepare(request_read),
+                        bind_allocator(
+                                get_allocator(),
+                                beast::bind_front_handler(
+                                        &http_session::on_read_some,
+                                        derived().shared_from_this())));
+            }
+        }
+
+        void
+        on_readable(beast::error_code ec)
+        {
+            if(ec)
+                return on_read(ec, 0);
+
+            // The socket is non-blocking, this only reads what already arrived
+            auto const n = beast::get_lowest_layer(derived().stream()).socket().read_some(
+                    buffer_.prepare(request_read), ec);
+            if(ec == net::error::would_block || ec == net::error::try_again)
+                return do_wait();
+            on_read_some(ec, n);
+        }
 
-            // Read a request using the parser-oriented interface
+        void
+        on_read_some(beast::error_code ec, std::size_t bytes_transferred)
+        {
+            // They closed the connection between requests
+            if(ec == net::error::eof)
+                return on_read(beast::http::error::end_of_stream, 0);
+
+            if(ec)
+                return on_read(ec, 0);
+
+            // The whole request usually came at once
+            buffer_.commit(bytes_transferred);
+            on_received(bytes_transferred);
+            if(parse_buffered(ec, true) || ec)
+                return on_read_header(ec, 0);
+
+            do_read_header();
+        }
+
+        // A read of the request completed, the next request pipelined
+        // behind it is in the buffer since then
+        void
+        on_received(std::size_t bytes_transferred)
+        {
+            if(bytes_transferred != 0)
+                received_ = std::chrono::steady_clock::now();
+        }
+
+        // The header must be complete within its timeout from the first
+        // byte, however slowly it trickles in
+        void
+        do_read_header()
+        {
+            read_deadline_.expires_at(received_ + std::chrono::milliseconds(settings_->timeout_header));
+            beast::http::async_read_header(
+                    derived().stream(),
+                    buffer_,
+                    *parser_,
+                    bind_allocator(
+                            get_allocator(),
+                            beast::bind_front_handler(
+                                    &http_session::on_read_header,
+                                    derived().shared_from_this())));
+        }
+
+        void
+        on_read_header(beast::error_code ec, std::size_t bytes_transferred)
+        {
+            if(ec)
+                return on_read(ec, bytes_transferred);
+            on_received(bytes_transferred);
+
+            // A declared body over the limit is refused before any of it is read
+            auto const limit = settings_->body_limit(parser_->get().target());
+            if(parser_->content_length() && *parser_->content_length() > limit)
+                return refuse_body();
+
+            if(! parser_->is_done())
+                if(auto handler = handlers::select_body_handler<queue>(parser_->get(), *settings_))
+                    return start_body(std::move(handler), limit);
+
+            parser_->body_limit(limit);
+            if(parse_buffered(ec) || ec)
+                return on_read(ec, 0);
+
+            // Then the body, within the timeout of the method
+            read_deadline_.expires_after(body_timeout(parser_->get().method()));
             beast::http::async_read(
                     derived().stream(),
                     buffer_,
                     *parser_,
+                    bind_allocator(
+                            get_allocator(),
+                            beast::bind_front_handler(
+                                    &http_session::on_read,
+                                    derived().shared_from_this())));
+        }
+
+        std::chrono::milliseconds
+        body_timeout(beast::http::verb method) const
+        {
+            switch(method)
+            {
+            case beast::http::verb::put:
+                return std::chrono::milliseconds(settings_->timeout_put);
+            case beast::http::verb::post:
+            case beast::http::verb::patch:
+                return std::chrono::milliseconds(settings_->timeout_post);
+            default:
+                return std::chrono::milliseconds(settings_->timeout_get);
+            }
+        }
+
+        // Feed the parser from the bytes already in the buffer, returns `true`
+        // once it holds a complete request, or only its header if `header_only`
+        bool
+        parse_buffered(beast::error_code& ec, bool header_only = false)
+        {
+            auto const done = [&]
+                    {
+                        return header_only ? parser_->is_header_done() : parser_->is_done();
+                    };
+            while(buffer_.size() != 0 && ! done())
+            {
+                auto const n = parser_->put(buffer_.data(), ec);
+                buffer_.consume(n);
+                if(ec == beast::http::error::need_more)
+                {
+                    ec = {};
+                    return false;
+                }
+                if(ec || n == 0)
+                    return false;
+            }
+            return done();
+        }
+
+        // Answer a request with a body over its limit and close the connection, the body is not read
+        void
+        refuse_body()
+        {
+            read_deadline_.expires_never();
+            closing_ = true;
+            draining_ = true;
+            auto res = handlers::text_response(
+                    parser_->get(), beast::http::status::payload_too_large, {"The request body is too large"}, *settings_);
+            res.keep_alive(false);
+            queue_(std::move(res));
+            flush();
+        }
+
+        // Answer a WebSocket upgrade this session cannot make and close the connection
+        void
+        refuse_upgrade()
+        {
+            read_deadline_.expires_never();
+            closing_ = true;
+            auto res = handlers::text_response(
+                    parser_->get(), beast::http::status::not_implemented,
+                    {"WebSocket is not available on this connection"}, *settings_);
+            res.keep_alive(false);
+            queue_(std::move(res));
+            flush();
+        }
+
+        void
+        start_body(std::unique_ptr<handlers::body_handler<queue>> handler, std::size_t limit)
+        {
+            body_handler_ = std::move(handler);
+            body_handler_->attach(*this);
+            body_parser_.emplace(std::move(*parser_));
+            body_parser_->body_limit(limit);
+            if(! chunk_)
+                chunk_ = std::make_unique<char[]>(body_chunk);
+            do_read_body();
+        }
+
+        // Read the next chunk of a streamed body, each one is due within the timeout of the method
+        void
+        do_read_body()
+        {
+            auto& body = body_parser_->get().body();
+            body.data = chunk_.get();
+            body.size = body_chunk;
+
+            read_deadline_.expires_after(body_timeout(body_parser_->get().method()));
+            beast::http::async_read_some(
+                    derived().stream(),
+                    buffer_,
+                    *body_parser_,
+                    bind_allocator(
+                            get_allocator(),
+                            beast::bind_front_handler(
+                                    &http_session::on_read_body,
+                                    derived().shared_from_this())));
+        }
+
+        void
+        on_read_body(beast::error_code ec, std::size_t bytes_transferred)
+        {
+            on_received(bytes_transferred);
+
+            // The chunk is full
+            if(ec == beast::http::error::need_buffer)
+                ec = {};
+
+            // Over the limit, the handler answers
+            if(ec == beast::http::error::body_limit)
+                return finish_body(ec);
+
+            if(ec)
+            {
+                // The handler abandons the body
+                body_handler_.reset();
+                return fail(ec, "read");
+            }
+
+            auto const size = body_chunk - body_parser_->get().body().size;
+            auto ready = true;
+            if(size != 0)
+                ready = body_handler_->on_body(net::const_buffer(chunk_.get(), size), ec);
+
+            if(ec || body_parser_->is_done())
+                return finish_body(ec);
+
+            // Otherwise the handler resumes reading once it is ready
+            if(ready)
+                return do_read_body();
+            read_deadline_.expires_never();
+            paused_ = derived().shared_from_this();
+        }
+
+        // Called by the body handler, paused_ keeps us alive until then
+        void
+        resume() override
+        {
+            net::post(
+                    derived().stream().get_executor(),
                     beast::bind_front_handler(
-                            &http_session::on_read,
+                            &http_session::on_resume,
                             derived().shared_from_this()));
         }
 
+        void
+        on_resume()
+        {
+            // A handler resuming from on_body() posts this before the pause is recorded
+            auto const self = std::move(paused_);
+            if(self)
+                do_read_body();
+        }
+
+        void
+        finish_body(beast::error_code ec)
+        {
+            read_deadline_.expires_never();
+            paused_.reset();
+            body_handler_->on_complete(queue_, ec);
+            // Over the limit or abandoned by the handler, the client may
+            // still be sending the rest
+            draining_ = ec && ! body_parser_->is_done();
+            body_handler_.reset();
+            body_parser_.reset();
+            served_ = true;
+
+            // After an error the response closes the connection, the rest of the body is not read
+            closing_ = bool(ec);
+            if(! closing_ && ! queue_.is_full())
+                do_read();
+
+            flush();
+        }
+
         void
         on_read(beast::error_code ec, std::size_t bytes_transferred)
         {
-            boost::ignore_unused(bytes_transferred);
+            on_received(bytes_transferred);
 
             // This means they closed the connection
             if(ec == beast::http::error::end_of_stream)
                 return derived().do_eof();
 
+            // A chunked body went over the limit
+            if(ec == beast::http::error::body_limit)
+                return refuse_body();
+
             if(ec)
                 return fail(ec, "read");
 
             // See if it is a WebSocket Upgrade
             if(websocket::is_upgrade(parser_->get()))
             {
-                // Disable the timeout.
+                // Its stream would write through OpenSSL, which no longer
+                // has the session's write key
+                if(derived().kernel_tls_enabled())
+                    return refuse_upgrade();
+
+                // Disable the timeouts.
                 // The websocket::stream uses its own timeout settings.
-                beast::get_lowest_layer(derived().stream()).expires_never();
+                read_deadline_.expires_never();
+                write_deadline_.expires_never();
 
                 // Create a websocket session, transferring ownership
                 // of both the socket and the HTTP request.
                 return make_websocket_session(
                         derived().release_stream(),
+                        std::move(token_),
                         parser_->release());
             }
 
-            // Send the response
-            handlers::handle_request(*doc_root_, parser_->release(), queue_, settings_);
+            // Handlers run inline, the watchdog answers for one that
+            // overruns its timeout and its late response is dropped
+            read_deadline_.expires_never();
+            handler_deadline_.start(
+                    beast::get_lowest_layer(derived().stream()).socket().native_handle(),
+                    writes_socket() && ! writing_ && queue_.empty(),
+                    std::chrono::milliseconds(settings_->timeout_handler));
+
+            // Queue the response
+            handlers::handle_request(settings_->document_root, parser_->release(), queue_, *settings_);
+            served_ = true;
+
+            if(handler_deadline_.finish())
+            {
+                fail(beast::error::timeout, "handler");
+                beast::error_code ec;
+                beast::get_lowest_layer(derived().stream()).socket().close(ec);
+                return;
+            }
 
             // If we aren't at the queue limit, try to pipeline another request
             if(! queue_.is_full())
                 do_read();
+
+            flush();
+        }
+
+        // A client still sending the body we refused must get to read our
+        // response before the connection is closed, closing with its bytes
+        // unread would reset the connection and may discard the response.
+        // Our side is shut down and the rest is read and discarded for a
+        // while.  OpenSSL still has to decrypt it, a TLS session is closed
+        // once the client stops.
+        void
+        drain()
+        {
+            if(writes_socket())
+                derived().do_eof();
+            read_deadline_.expires_after(std::chrono::milliseconds(drain_time));
+            do_drain();
+        }
+
+        void
+        do_drain()
+        {
+            buffer_.clear();
+            derived().stream().async_read_some(
+                    buffer_.prepare(request_read),
+                    bind_allocator(
+                            get_allocator(),
+                            beast::bind_front_handler(
+                                    &http_session::on_drain,
+                                    derived().shared_from_this())));
         }
 
         void
-        on_write(bool close, beast::error_code ec, std::size_t bytes_transferred)
+        on_drain(beast::error_code ec, std::size_t bytes_transferred)
         {
             boost::ignore_unused(bytes_transferred);
 
+            // The client closed, or the deadline closed the socket
             if(ec)
-                return fail(ec, "write");
+                return read_deadline_.expires_never();
+            do_drain();
+        }
 
-            if(close)
+        // Write the queued responses, unless a write is in progress
+        void
+        flush()
+        {
+            if(! writing_ && ! queue_.empty())
+                do_write();
+        }
+
+        // Gather the buffers of as many queued responses as possible into one write
+        void
+        do_write()
+        {
+            writing_ = true;
+
+            // A file body goes out by itself once its header is written
+            if(auto const range = queue_[0].file())
+                return do_sendfile(*range);
+
+            buffers_.clear();
+            for(std::size_t i = 0; i < queue_.size() && buffers_.size() < max_gather; ++i)
             {
-                // This means we should close the connection, usually because
-                // the response indicated the "Connection: close" semantic.
-                return derived().do_eof();
+                beast::error_code ec;
+                auto const whole = queue_[i].prepare(buffers_, ec);
+                if(ec)
+                    return fail(ec, "write");
+
+                // The next response may only follow one sent in full,
+                // and nothing follows a response closing the connection
+                if(! whole || queue_[i].need_eof())
+                    break;
+            }
+
+            write_deadline_.expires_after(std::chrono::milliseconds(settings_->timeout_write));
+            auto handler = bind_allocator(
+                    get_allocator(),
+                    beast::bind_front_handler(
+                            &http_session::on_write,
+                            derived().shared_from_this()));
+
+            // The kernel encrypts what is written to the socket itself
+            if(derived().kernel_tls_enabled())
+                net::async_write(beast::get_lowest_layer(derived().stream()), buffers_, std::move(handler));
+            else
+                net::async_write(derived().stream(), buffers_, std::move(handler));
+        }
+
+        // Send the rest of the oldest response's file until it is done,
+        // the socket is full or the turn is over, the socket is non-blocking
+        void
+        do_sendfile(file_range& range)
+        {
+            write_deadline_.expires_after(std::chrono::milliseconds(settings_->timeout_write));
+            auto& socket = beast::get_lowest_layer(derived().stream()).socket();
+            std::size_t turn = 0;
+            while(range.size != 0)
+            {
+                // A fast client would otherwise keep the io thread to itself
+                if(turn >= sendfile_turn)
+                    return net::post(
+                            socket.get_executor(),
+                            bind_allocator(
+                                    get_allocator(),
+                                    beast::bind_front_handler(
+                                            &http_session::on_sendfile,
+                                            derived().shared_from_this(),
+                                            beast::error_code{})));
+                auto offset = static_cast<off_t>(range.offset);
+                auto const n = ::sendfile(socket.native_handle(), range.fd, &offset,
+                        std::min<std::uint64_t>(range.size, sendfile_chunk));
+                if(n > 0)
+                {
+                    queue_[0].sent(static_cast<std::size_t>(n));
+                    turn += static_cast<std::size_t>(n);
+                    continue;
+                }
+                if(n < 0 && errno == EINTR)
+                    continue;
+                if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                    return socket.async_wait(
+                            net::socket_base::wait_write,
+                            bind_allocator(
+                                    get_allocator(),
+                                    beast::bind_front_handler(
+                                            &http_session::on_sendfile,
+                                            derived().shared_from_this())));
+
+                // The file was truncated since it was opened
+                return on_write(n == 0
+                        ? beast::errc::make_error_code(beast::errc::io_error)
+                        : beast::error_code(errno, beast::system_category()), 0);
             }
+            on_write({}, 0);
+        }
 
-            // Inform the queue that a write completed
-            if(queue_.on_write())
+        void
+        on_sendfile(beast::error_code ec)
+        {
+            if(ec)
+                return on_write(ec, 0);
+            do_sendfile(*queue_[0].file());
+        }
+
+        void
+        on_write(beast::error_code ec, std::size_t bytes_transferred)
+        {
+            writing_ = false;
+
+            if(ec)
+                return fail(ec, "write");
+
+            auto const was_full = queue_.is_full();
+            while(! queue_.empty())
             {
-                // Read another request
-                do_read();
+                bytes_transferred -= queue_[0].consume(bytes_transferred);
+                if(! queue_[0].is_done())
+                    break;
+
+                auto const close = queue_[0].need_eof();
+                queue_.pop();
+                if(close)
+                {
+                    if(draining_)
+                        return drain();
+
+                    // This means we should close the connection, usually because
+                    // the response indicated the "Connection: close" semantic.
+                    return derived().do_eof();
+                }
             }
+
+            // Send the rest of a partly written response and
+            // the responses queued in the meantime
+            if(! queue_.empty())
+                do_write();
+            else
+                write_deadline_.expires_never();
+
+            // Read another request if the queue was holding us back
+            if(was_full && ! queue_.is_full() && ! closing_)
+                do_read();
         }
     };
 
     //------------------------------------------------------------------------------
 
-    // Handles a plain HTTP connection
-    class plain_http_session
-            : public http_session<plain_http_session>
-                    , public std::enable_shared_from_this<plain_http_session>
+    // Handles a plain HTTP connection over a tcp_stream or a local_stream
+    //
+    // enable_shared_from_this is the first base so it is destroyed last: the deadlines of http_session call
+    // weak_from_this() from the wheel's thread until their destructors have cancelled them.
+    template<class Stream>
+    class basic_plain_http_session
+            : public std::enable_shared_from_this<basic_plain_http_session<Stream>>
+                    , public http_session<basic_plain_http_session<Stream>>
     {
-        beast::tcp_stream stream_;
+        Stream stream_;
 
     public:
+        // Idle connections wait for the socket to be readable without holding a buffer
+        static constexpr bool wait_readable = true;
+
         // Create the session
-        plain_http_session(
-                beast::tcp_stream&& stream,
-                beast::flat_buffer&& buffer,
-                std::shared_ptr<std::string const> const& doc_root,
-                const settings& s)
-                : http_session<plain_http_session>(
+        basic_plain_http_session(
+                Stream&& stream,
+                session_buffer&& buffer,
+                settings_ptr s,
+                connection_token&& token)
+                : http_session<basic_plain_http_session>(
                 std::move(buffer),
-                doc_root,
-                s)
+                std::move(s),
+                std::move(token))
                 , stream_(std::move(stream))
         {
         }
@@ -464,75 +1299,153 @@ namespace systemicai::http::server {
         void
         run()
         {
-            this->do_read();
+            // Reads after waiting for the socket to be readable must not block
+            beast::error_code ec;
+            stream_.socket().non_blocking(true, ec);
+
+            // Sessions created by a plain listener are not on their strand yet
+            net::dispatch(
+                    stream_.get_executor(),
+                    beast::bind_front_handler(
+                            &basic_plain_http_session::do_read,
+                            this->shared_from_this()));
         }
 
         // Called by the base class
-        beast::tcp_stream&
+        Stream&
         stream()
         {
             return stream_;
         }
 
         // Called by the base class
-        beast::tcp_stream
+        Stream
         release_stream()
         {
             return std::move(stream_);
         }
 
+        // Called by the base class
+        bool
+        kernel_tls_enabled() const
+        {
+            return false;
+        }
+
+        // Called by the base class, the socket is non-blocking already
+        bool
+        sends_files() const
+        {
+            return this->settings_->sendfile;
+        }
+
         // Called by the base class
         void
         do_eof()
         {
-            // Send a TCP shutdown
+            // Send a shutdown
             beast::error_code ec;
-            stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
+            stream_.socket().shutdown(net::socket_base::shutdown_send, ec);
 
             // At this point the connection is closed gracefully
         }
     };
 
+    using plain_http_session = basic_plain_http_session<beast::tcp_stream>;
+    using local_http_session = basic_plain_http_session<local_stream>;
+
     //------------------------------------------------------------------------------
 
     // Handles an SSL HTTP connection
+    //
+    // enable_shared_from_this comes first for the same reason as in basic_plain_http_session
     class ssl_http_session
-            : public http_session<ssl_http_session>
-                    , public std::enable_shared_from_this<ssl_http_session>
+            : public std::enable_shared_from_this<ssl_http_session>
+                    , public http_session<ssl_http_session>
     {
         beast::ssl_stream<beast::tcp_stream> stream_;
+        // The strand of a handshake_pool the handshake runs on, the stream stays on the io thread
+        net::any_io_executor pool_;
+        // The kernel encrypts what the session sends
+        bool ktls_ = false;
 
     public:
+        // OpenSSL may hold decrypted bytes the socket no longer shows as
+        // readable, so idle connections keep a small read in progress
+        static constexpr bool wait_readable = false;
+
         // Create the http_session
         ssl_http_session(
                 beast::tcp_stream&& stream,
                 ssl::context& ctx,
-                beast::flat_buffer&& buffer,
-                std::shared_ptr<std::string const> const& doc_root,
-                const settings& s)
+                session_buffer&& buffer,
+                settings_ptr s,
+                connection_token&& token)
                 : http_session<ssl_http_session>(
                 std::move(buffer),
-                doc_root,
-                s)
+                std::move(s),
+                std::move(token))
                 , stream_(std::move(stream), ctx)
         {
+            // And OpenSSL frees its own record buffers while idle
+            SSL_set_mode(stream_.native_handle(), SSL_MODE_RELEASE_BUFFERS);
         }
 
         // Start the session
         void
         run()
         {
-            // Set the timeout.
-            beast::get_lowest_layer(stream_).expires_after(std::chrono::seconds(30));
+            // Sessions created by a tls listener are not on their strand yet
+            net::dispatch(
+                    stream_.get_executor(),
+                    beast::bind_front_handler(
+                            &ssl_http_session::on_run,
+                            shared_from_this()));
+        }
+
+        void
+        on_run()
+        {
+            // With a handshake pool, even the ClientHello already
+            // buffered by a detect_session is processed there
+            if(auto const pool = handshake_pool::of(stream_.native_handle()))
+            {
+                pool_ = pool->executor();
+                return net::post(
+                        pool_,
+                        beast::bind_front_handler(
+                                &ssl_http_session::do_handshake,
+                                shared_from_this()));
+            }
+            do_handshake();
+        }
+
+        void
+        do_handshake()
+        {
+            // The handshake is held to the timeout of a request header
+            read_deadline_.expires_after(std::chrono::milliseconds(settings_->timeout_header));
 
             // Perform the SSL handshake
             // Note, this is the buffered version of the handshake.
-            stream_.async_handshake(
-                    ssl::stream_base::server,
-                    buffer_.data(),
-                    beast::bind_front_handler(
-                            &ssl_http_session::on_handshake,
-                            shared_from_this()));
+            auto handler = beast::bind_front_handler(
+                    &ssl_http_session::on_handshake,
+                    shared_from_this());
+
+            // On a pool the socket's operations still complete on the io
+            // thread, OpenSSL runs where the handler is bound to.  Nothing
+            // else uses the stream meanwhile, the deadline only shuts the
+            // socket down.
+            if(pool_)
+                stream_.async_handshake(
+                        ssl::stream_base::server,
+                        buffer_.data(),
+                        net::bind_executor(pool_, std::move(handler)));
+            else
+                stream_.async_handshake(
+                        ssl::stream_base::server,
+                        buffer_.data(),
+                        std::move(handler));
         }
 
         // Called by the base class
@@ -549,12 +1462,36 @@ namespace systemicai::http::server {
             return std::move(stream_);
         }
 
+        // Called by the base class
+        bool
+        kernel_tls_enabled() const
+        {
+            return ktls_;
+        }
+
+        // Called by the base class, the kernel encrypts sendfile(2) too
+        bool
+        sends_files() const
+        {
+            return ktls_;
+        }
+
         // Called by the base class
         void
         do_eof()
         {
+            // OpenSSL cannot write the alert any more
+            if(ktls_)
+            {
+                auto& socket = beast::get_lowest_layer(stream_).socket();
+                kernel_tls::close_notify(socket.native_handle());
+                beast::error_code ec;
+                socket.shutdown(net::socket_base::shutdown_send, ec);
+                return;
+            }
+
             // Set the timeout.
-            beast::get_lowest_layer(stream_).expires_after(std::chrono::seconds(30));
+            write_deadline_.expires_after(std::chrono::milliseconds(settings_->timeout_write));
 
             // Perform the SSL shutdown
             stream_.async_shutdown(
@@ -572,9 +1509,31 @@ namespace systemicai::http::server {
             if(ec)
                 return fail(ec, "handshake");
 
+            tls_resumption::count(stream_.native_handle());
+
+            // The handshake's output is all written, the kernel may take over sending
+            if(settings_->ssl_ktls)
+            {
+                auto& socket = beast::get_lowest_layer(stream_).socket();
+                ktls_ = kernel_tls::enable(stream_.native_handle(), socket.native_handle());
+                if(ktls_)
+                    socket.non_blocking(true, ec);
+            }
+
             // Consume the portion of the buffer used by the handshake
             buffer_.consume(bytes_used);
 
+            // Back to the strand of the io thread for the requests
+            if(pool_)
+            {
+                pool_ = {};
+                return net::post(
+                        stream_.get_executor(),
+                        beast::bind_front_handler(
+                                &ssl_http_session::do_read,
+                                shared_from_this()));
+            }
+
             do_read();
         }
 
@@ -588,4 +1547,6 @@ namespace systemicai::http::server {
         }
     };
 
-} // namespace systemicai::http::server
\ No newline at end of file
+} // namespace systemicai::http::server
+
+#endif // SYSTEMICAI_HTTP_SERVER_SESSIONS_HPP
@@ -1,6 +1,12 @@
 #ifndef SYSTEMICAI_HTTP_SERVER_SETTINGS_H
 #define SYSTEMICAI_HTTP_SERVER_SETTINGS_H
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
 #include <systemicai/http/server/namespace.h>
 
 namespace systemicai::http::server {
@@ -9,20 +15,133 @@ using std::string;
 using std::size_t;
 namespace pt = boost::property_tree;
 
+// One listening endpoint of the service
+struct listener_settings {
+    string address;
+    unsigned short port;
+    // "plain": HTTP only, "tls": HTTPS only, "auto": detect TLS on every connection,
+    // "unix": plain HTTP on the unix domain socket at `path` (address and port are unused)
+    string type;
+    string path;
+};
+
+// A certificate served to the clients asking for one of its subjectAltName DNS names, or its common name
+struct certificate_settings {
+    string certificate;
+    string key;
+};
+
+// Requests whose target starts with `prefix` have their own body limit, and may have their body streamed to a file
+struct route_settings {
+    string prefix;
+    // Maximum size of a request body in bytes
+    size_t body_limit;
+    // PUT and POST bodies are written as they arrive to the file named by the rest of the target under this
+    // directory, instead of buffered in the request.  Empty to buffer them.
+    string upload;
+};
+
 struct settings {
     string interface_address;
     unsigned short interface_port;
+    // From service.listeners, when that is absent a single "auto" listener on the interface address and port
+    std::vector<listener_settings> listeners;
     string document_root;
     string log_level;
+    // Seconds between reports of the buffer memory of every io thread, 0 to disable
+    size_t log_buffers;
     string service_version;
     string ssl_certificate;
     string ssl_key;
+    // Certificates selected by the server name (SNI) a client asks for, ssl_certificate serves every other name
+    std::vector<certificate_settings> ssl_certificates;
+    // Seconds between checks of the certificate and key files, reloaded for new handshakes when one changes.  0 to
+    // only reload them on SIGHUP.  With neither this nor ssl_certificates set, the certificate loaded into the
+    // context at startup is served as it is.
+    size_t ssl_certificate_check;
+    // Finite field DH parameters, only used by DHE cipher suites.  Empty for none.
     string ssl_dh;
+    // Lowest and highest protocol version negotiated: "1.0", "1.1", "1.2" or "1.3"
+    string ssl_min_version;
+    string ssl_max_version;
+    // OpenSSL cipher list of TLS 1.2 and earlier, and cipher suites of TLS 1.3, in order of preference
+    string ssl_ciphers;
+    string ssl_ciphersuites;
+    // Key exchange groups (curves) in order of preference
+    string ssl_groups;
+    // Sessions kept in the server side cache for resumption by session id, 0 to disable the cache
+    size_t ssl_session_cache;
+    // Seconds a session, cached or in a ticket, may be resumed for
+    size_t ssl_session_timeout;
+    // Hand sessions to clients as RFC 5077 tickets
+    bool ssl_tickets;
+    // File of 80 byte ticket keys shared with other processes, the first one encrypts new tickets.  Empty to
+    // generate the keys in this process.
+    string ssl_ticket_keys;
+    // Seconds between ticket key rotations, or rereads of ssl_ticket_keys
+    size_t ssl_ticket_rotate;
+    // Threads running the TLS handshakes, so their key exchange and signature do not hold up the io threads.  0 to
+    // handshake on the io threads.
+    size_t ssl_handshake_threads;
+    // Hand the sending side of TLS sessions to the kernel after the handshake, and send their files with sendfile.
+    // Sessions stay in user space when the kernel has no "tls" module or the cipher is not AES-GCM.
+    bool ssl_ktls;
     int thread_io;
+    // "shared": one io_context run by every io thread.
+    // "sharded": one io_context and SO_REUSEPORT listener per io thread.
+    string thread_mode;
+    // Maximum number of open connections, 0 for no limit
+    size_t limit_connections;
+    // Maximum number of connections accepted per listener wakeup
+    size_t limit_accept_batch;
+    // Maximum number of pipelined responses queued per connection before it stops reading requests
+    size_t limit_pipeline;
+    // Maximum size of a request body in bytes outside of the routes
+    size_t limit_body;
+    // Bytes of idle read buffers each io thread keeps for reuse
+    size_t limit_buffer_cache;
+    // Session objects of each type, and their arenas, each io thread keeps for reuse by new connections
+    size_t limit_session_cache;
+    // Bytes of document root files kept in memory, shared by every io thread, and the largest file kept.  0 to read
+    // every file from disk.
+    size_t limit_file_cache;
+    size_t limit_file_cache_entry;
+    // Document root files kept open with their size and modification time, and missing files remembered, shared by
+    // every io thread.  0 to open every file per request.  Each is trusted for limit_open_file_ttl milliseconds,
+    // then checked with a stat on its next request.
+    size_t limit_open_files;
+    size_t limit_open_file_ttl;
+    // Send the files of plain connections with sendfile(2), from the page cache to the socket without a copy
+    // through user space.  TLS connections only do with ssl_ktls.
+    bool sendfile;
+    // Largest document root file sent from a memory mapping shared by its responses, larger ones are read as they are
+    // sent.  0 to map none, the default.  Only sessions without sendfile map files, and only with limit_open_files.
+    // A mapped file must be replaced by a rename, never truncated in place.
+    size_t limit_mmap_file;
+    // Answer requests accepting gzip with the .gz sibling of a text file, or with the file compressed on demand at
+    // compression_level, and tell caches the response varies by Accept-Encoding
+    bool compression;
+    int compression_level;
+    // Bytes of files compressed on demand kept in memory, shared by every io thread, and the largest file compressed.
+    // 0 to serve only precompressed siblings.
+    size_t limit_compressed_cache;
+    size_t limit_compressed_file;
+    // From service.routes, the longest matching prefix applies
+    std::vector<route_settings> routes;
+    // Unix domain socket used to hand the listening sockets to the next process on a hot restart, empty to disable
+    string handoff_path;
+    // Seconds the previous process is given to finish its open sessions after a handoff
+    size_t handoff_drain;
+    // Timeouts in milliseconds.  The header of a request, from its first byte (from the connection for the first
+    // request, and the TLS handshake), then its body by method: PUT, POST and PATCH, otherwise GET
     size_t timeout_header;
     size_t timeout_get;
     size_t timeout_put;
     size_t timeout_post;
+    // The handler producing a response, each write of responses, and a keep-alive connection waiting for a request
+    size_t timeout_handler;
+    size_t timeout_write;
+    size_t timeout_idle;
 
     /**
      * @param tr Property Tree with settings.  An empty tree is provided as the
@@ -35,17 +154,87 @@ struct settings {
     void load(const pt::ptree &tr) {
         interface_address = tr.get<string>("service.interface.address", "127.0.0.1");
         interface_port = tr.get<unsigned short>("service.interface.port", 8080);
+        listeners.clear();
+        if(auto l = tr.get_child_optional("service.listeners")) {
+            for(auto& c : *l) {
+                listener_settings ls;
+                ls.address = c.second.get<string>("address", interface_address);
+                ls.port = c.second.get<unsigned short>("port", interface_port);
+                ls.type = c.second.get<string>("type", "auto");
+                boost::algorithm::to_lower(ls.type);
+                ls.path = c.second.get<string>("path", "");
+                listeners.push_back(ls);
+            }
+        }
+        if(listeners.empty())
+            listeners.push_back(listener_settings{interface_address, interface_port, "auto", ""});
         document_root = tr.get<string>("document.root", "html");
         log_level = tr.get<string>("service.log.level", "info");
         boost::algorithm::to_lower(log_level);
+        log_buffers = tr.get<size_t>("service.log.buffers", 0);
         ssl_certificate = tr.get<string>("service.ssl.certificate", "cfg/dumb.cert");
         ssl_key = tr.get<string>("service.ssl.key", "cfg/dumb.key");
-        ssl_dh = tr.get<string>("service.ssl.dh", "cfg/dumb.dh");
+        ssl_certificates.clear();
+        if(auto c = tr.get_child_optional("service.ssl.certificates")) {
+            for(auto& e : *c)
+                ssl_certificates.push_back(certificate_settings{e.second.get<string>("certificate"), e.second.get<string>("key")});
+        }
+        ssl_certificate_check = tr.get<size_t>("service.ssl.certificate_check", 0);
+        ssl_dh = tr.get<string>("service.ssl.dh", "");
+        ssl_min_version = tr.get<string>("service.ssl.min_version", "1.2");
+        ssl_max_version = tr.get<string>("service.ssl.max_version", "1.3");
+        ssl_ciphers = tr.get<string>("service.ssl.ciphers",
+                "ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:"
+                "ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305:"
+                "ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384");
+        ssl_ciphersuites = tr.get<string>("service.ssl.ciphersuites",
+                "TLS_AES_128_GCM_SHA256:TLS_CHACHA20_POLY1305_SHA256:TLS_AES_256_GCM_SHA384");
+        ssl_groups = tr.get<string>("service.ssl.groups", "X25519:P-256:P-384");
+        ssl_session_cache = tr.get<size_t>("service.ssl.session_cache", 20480);
+        ssl_session_timeout = std::max<size_t>(1, tr.get<size_t>("service.ssl.session_timeout", 3600));
+        ssl_tickets = tr.get<bool>("service.ssl.tickets", true);
+        ssl_ticket_keys = tr.get<string>("service.ssl.ticket_keys", "");
+        ssl_ticket_rotate = std::max<size_t>(1, tr.get<size_t>("service.ssl.ticket_rotate", 3600));
+        ssl_handshake_threads = tr.get<size_t>("service.ssl.handshake_threads", 0);
+        ssl_ktls = tr.get<bool>("service.ssl.ktls", false);
         thread_io = tr.get<int>("service.thread.io", 1);
-        timeout_header = tr.get<>("service.timeout.header", 5);
-        timeout_get = tr.get<size_t>("service.timeout.get", 300);
-        timeout_put = tr.get<size_t>("service.timeout.put", 300);
-        timeout_post = tr.get<size_t>("service.timeout.post", 300);
+        thread_mode = tr.get<string>("service.thread.mode", "shared");
+        boost::algorithm::to_lower(thread_mode);
+        limit_connections = tr.get<size_t>("service.limit.connections", 0);
+        limit_accept_batch = std::max<size_t>(1, tr.get<size_t>("service.limit.accept_batch", 16));
+        limit_pipeline = std::max<size_t>(1, tr.get<size_t>("service.limit.pipeline", 8));
+        limit_body = tr.get<size_t>("service.limit.body", 10000);
+        limit_buffer_cache = tr.get<size_t>("service.limit.buffer_cache", 1048576);
+        limit_session_cache = tr.get<size_t>("service.limit.session_cache", 64);
+        limit_file_cache = tr.get<size_t>("service.limit.file_cache", 0);
+        limit_file_cache_entry = tr.get<size_t>("service.limit.file_cache_entry", 1048576);
+        limit_open_files = tr.get<size_t>("service.limit.open_files", 0);
+        limit_open_file_ttl = tr.get<size_t>("service.limit.open_file_ttl", 1000);
+        sendfile = tr.get<bool>("service.sendfile", true);
+        limit_mmap_file = tr.get<size_t>("service.limit.mmap_file", 0);
+        compression = tr.get<bool>("service.compression.gzip", true);
+        compression_level = std::clamp(tr.get<int>("service.compression.level", 6), 1, 9);
+        limit_compressed_cache = tr.get<size_t>("service.limit.compressed_cache", 0);
+        limit_compressed_file = tr.get<size_t>("service.limit.compressed_file", 1048576);
+        routes.clear();
+        if(auto r = tr.get_child_optional("service.routes")) {
+            for(auto& c : *r) {
+                route_settings rs;
+                rs.prefix = c.second.get<string>("prefix", "/");
+                rs.body_limit = c.second.get<size_t>("body_limit", limit_body);
+                rs.upload = c.second.get<string>("upload", "");
+                routes.push_back(rs);
+            }
+        }
+        handoff_path = tr.get<string>("service.handoff.path", "");
+        handoff_drain = tr.get<size_t>("service.handoff.drain", 30);
+        timeout_header = tr.get<size_t>("service.timeout.header", 5000);
+        timeout_get = tr.get<size_t>("service.timeout.get", 300000);
+        timeout_put = tr.get<size_t>("service.timeout.put", 300000);
+        timeout_post = tr.get<size_t>("service.timeout.post", 300000);
+        timeout_handler = tr.get<size_t>("service.timeout.handler", 30000);
+        timeout_write = tr.get<size_t>("service.timeout.write", 30000);
+        timeout_idle = tr.get<size_t>("service.timeout.idle", 15000);
         service_version = tr.get<string>("service.version", "alpha");
     };
 
@@ -53,26 +242,147 @@ struct settings {
         pt::ptree tr;
         tr.put("service.interface.address", interface_address);
         tr.put("service.interface.port", interface_port);
+        pt::ptree l;
+        for(auto& ls : listeners) {
+            pt::ptree c;
+            c.put("address", ls.address);
+            c.put("port", ls.port);
+            c.put("type", ls.type);
+            if(!ls.path.empty())
+                c.put("path", ls.path);
+            l.push_back(std::make_pair("", c));
+        }
+        tr.add_child("service.listeners", l);
         tr.put("document.root", document_root);
         tr.put("service.log.level", log_level);
+        tr.put("service.log.buffers", log_buffers);
         tr.put("service.ssl.certificate", ssl_certificate);
         tr.put("service.ssl.key", ssl_key);
+        pt::ptree c;
+        for(auto& e : ssl_certificates) {
+            pt::ptree p;
+            p.put("certificate", e.certificate);
+            p.put("key", e.key);
+            c.push_back(std::make_pair("", p));
+        }
+        tr.add_child("service.ssl.certificates", c);
+        tr.put("service.ssl.certificate_check", ssl_certificate_check);
         tr.put("service.ssl.dh", ssl_dh);
+        tr.put("service.ssl.min_version", ssl_min_version);
+        tr.put("service.ssl.max_version", ssl_max_version);
+        tr.put("service.ssl.ciphers", ssl_ciphers);
+        tr.put("service.ssl.ciphersuites", ssl_ciphersuites);
+        tr.put("service.ssl.groups", ssl_groups);
+        tr.put("service.ssl.session_cache", ssl_session_cache);
+        tr.put("service.ssl.session_timeout", ssl_session_timeout);
+        tr.put("service.ssl.tickets", ssl_tickets);
+        tr.put("service.ssl.ticket_keys", ssl_ticket_keys);
+        tr.put("service.ssl.ticket_rotate", ssl_ticket_rotate);
+        tr.put("service.ssl.handshake_threads", ssl_handshake_threads);
+        tr.put("service.ssl.ktls", ssl_ktls);
         tr.put("service.thread.io", thread_io);
+        tr.put("service.thread.mode", thread_mode);
+        tr.put("service.limit.connections", limit_connections);
+        tr.put("service.limit.accept_batch", limit_accept_batch);
+        tr.put("service.limit.pipeline", limit_pipeline);
+        tr.put("service.limit.body", limit_body);
+        tr.put("service.limit.buffer_cache", limit_buffer_cache);
+        tr.put("service.limit.session_cache", limit_session_cache);
+        tr.put("service.limit.file_cache", limit_file_cache);
+        tr.put("service.limit.file_cache_entry", limit_file_cache_entry);
+        tr.put("service.limit.open_files", limit_open_files);
+        tr.put("service.limit.open_file_ttl", limit_open_file_ttl);
+        tr.put("service.sendfile", sendfile);
+        tr.put("service.limit.mmap_file", limit_mmap_file);
+        tr.put("service.compression.gzip", compression);
+        tr.put("service.compression.level", compression_level);
+        tr.put("service.limit.compressed_cache", limit_compressed_cache);
+        tr.put("service.limit.compressed_file", limit_compressed_file);
+        if(!routes.empty()) {
+            pt::ptree r;
+            for(auto& rs : routes) {
+                pt::ptree c;
+                c.put("prefix", rs.prefix);
+                c.put("body_limit", rs.body_limit);
+                if(!rs.upload.empty())
+                    c.put("upload", rs.upload);
+                r.push_back(std::make_pair("", c));
+            }
+            tr.add_child("service.routes", r);
+        }
+        tr.put("service.handoff.path", handoff_path);
+        tr.put("service.handoff.drain", handoff_drain);
         tr.put("service.timeout.header", timeout_header);
         tr.put("service.timeout.get", timeout_get);
         tr.put("service.timeout.put", timeout_put);
         tr.put("service.timeout.post", timeout_post);
+        tr.put("service.timeout.handler", timeout_handler);
+        tr.put("service.timeout.write", timeout_write);
+        tr.put("service.timeout.idle", timeout_idle);
         tr.put("service.version", service_version);
         return tr;
     }
 
+    // The route of a request target, nullptr when none matches
+    const route_settings* route(beast::string_view target) const {
+        const route_settings* match = nullptr;
+        for(auto& r : routes)
+            if(target.substr(0, r.prefix.size()) == r.prefix && (match == nullptr || r.prefix.size() > match->prefix.size()))
+                match = &r;
+        return match;
+    }
+
+    // The body limit of a request target
+    size_t body_limit(beast::string_view target) const {
+        auto r = route(target);
+        return r != nullptr ? r->body_limit : limit_body;
+    }
+
     static settings& globals() {
         static struct settings s;
         return s;
     }
 };
 
+// The settings of the connections accepted since it was published, a snapshot never changes
+using settings_ptr = std::shared_ptr<const settings>;
+
+/**
+ * The settings in effect while the service runs.  Listeners pin the current snapshot in every session they start, so
+ * a connection keeps the settings it was accepted with, and reload() publishes a new one for the next connections.
+ * Readers compare version() with the one they last loaded and only take the lock when it changed.
+ */
+class settings_source {
+public:
+    explicit settings_source(const settings& s)
+            : current_(std::make_shared<const settings>(s)) {
+    }
+
+    settings_ptr load() const {
+        std::lock_guard<std::mutex> lg(mutex_);
+        return current_;
+    }
+
+    void store(const settings& s) {
+        auto next = std::make_shared<const settings>(s);
+        {
+            std::lock_guard<std::mutex> lg(mutex_);
+            current_.swap(next);
+        }
+        // Published after the snapshot, so a reader seeing the new version loads it
+        version_.fetch_add(1, std::memory_order_release);
+    }
+
+    std::uint64_t version() const {
+        return version_.load(std::memory_order_acquire);
+    }
+
+private:
+    mutable std::mutex mutex_;
+    settings_ptr current_;
+    std::atomic<std::uint64_t> version_{0};
+};
+
 }
 
 #endif // SYSTEMICAI_HTTP_SERVER_SETTINGS_H
@@ -0,0 +1,62 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_SHARED_BUFFER_BODY_H
+#define SYSTEMICAI_HTTP_SERVER_SHARED_BUFFER_BODY_H
+
+/**
+  A response body over immutable memory owned elsewhere.
+
+  The body holds a reference to the owner of its bytes, a cached file for instance, and the serializer hands those
+  bytes to the gather write as they are: any number of concurrent responses share them without a copy.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include <boost/optional.hpp>
+
+#include <systemicai/http/server/namespace.h>
+
+namespace systemicai::http::server {
+
+struct shared_buffer_body {
+  struct value_type {
+    // Keeps the bytes alive while the response is queued
+    std::shared_ptr<const void> owner;
+    const char* data = nullptr;
+    std::size_t size = 0;
+  };
+
+  static std::uint64_t size(const value_type& body) {
+    return body.size;
+  }
+
+  class writer {
+  public:
+    using const_buffers_type = net::const_buffer;
+
+    template<bool isRequest, class Fields>
+    writer(const beast::http::header<isRequest, Fields>&, const value_type& body)
+            : body_(body)
+    {
+    }
+
+    void init(beast::error_code& ec) {
+      ec = {};
+    }
+
+    boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec) {
+      ec = {};
+      if(body_.size == 0)
+        return boost::none;
+      return {{const_buffers_type(body_.data, body_.size), false}};
+    }
+
+  private:
+    const value_type& body_;
+  };
+};
+
+} // namespace systemicai::http::server
+
+#endif // SYSTEMICAI_HTTP_SERVER_SHARED_BUFFER_BODY_H
@@ -0,0 +1,86 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_SHARED_FILE_BODY_H
+#define SYSTEMICAI_HTTP_SERVER_SHARED_FILE_BODY_H
+
+/**
+  A response body sent from a range of an open_file shared with other responses.
+
+  The writer reads with pread at the body's own offset, never moving a file position, so a descriptor of the
+  open_file_cache serves any number of responses at once.  Sessions sending files with sendfile take the range
+  instead of the writer's buffers.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include <unistd.h>
+
+#include <boost/optional.hpp>
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/open_file_cache.h>
+
+namespace systemicai::http::server {
+
+struct shared_file_body {
+  struct value_type {
+    std::shared_ptr<const open_file> file;
+    std::uint64_t offset = 0;
+    std::uint64_t size = 0;
+  };
+
+  static std::uint64_t size(const value_type& body) {
+    return body.size;
+  }
+
+  class writer {
+  public:
+    using const_buffers_type = net::const_buffer;
+
+    template<bool isRequest, class Fields>
+    writer(const beast::http::header<isRequest, Fields>&, const value_type& body)
+            : body_(body)
+            , offset_(body.offset)
+            , left_(body.size)
+    {
+    }
+
+    void init(beast::error_code& ec) {
+      ec = {};
+    }
+
+    boost::optional<std::pair<const_buffers_type, bool>> get(beast::error_code& ec) {
+      ec = {};
+      if(left_ == 0)
+        return boost::none;
+      auto const n = ::pread(body_.file->fd, buffer_.data(), std::min<std::uint64_t>(left_, buffer_.size()), off_t(offset_));
+      if(n < 0) {
+        ec.assign(errno, beast::system_category());
+        return boost::none;
+      }
+      // The file was truncated since it was opened
+      if(n == 0) {
+        ec = beast::http::error::short_read;
+        return boost::none;
+      }
+      offset_ += std::uint64_t(n);
+      left_ -= std::uint64_t(n);
+      return {{const_buffers_type(buffer_.data(), std::size_t(n)), left_ != 0}};
+    }
+
+  private:
+    const value_type& body_;
+    std::uint64_t offset_;
+    std::uint64_t left_;
+    // As beast::http::file_body, small enough for the work item holding the writer to come from the session arena
+    std::array<char, 4096> buffer_;
+  };
+};
+
+} // namespace systemicai::http::server
+
+#endif // SYSTEMICAI_HTTP_SERVER_SHARED_FILE_BODY_H
@@ -0,0 +1,270 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_TIMER_WHEEL_H
+#define SYSTEMICAI_HTTP_SERVER_TIMER_WHEEL_H
+
+/**
+  Deadlines of the sessions.
+
+  Every io_context has one timer_wheel service that owns the deadlines of all the sessions running on it.  Sessions
+  re-arm their deadline for every request, with an Asio timer each of those is a heap operation and a cancelled wait,
+  on the wheel they are O(1) list operations and a single steady_timer ticks for all of them.
+
+  A sharded io_context is run by one thread, so its wheel is per thread.  A shared io_context has a single wheel for
+  all of its threads.  Request handlers run inline on those threads, their deadlines are kept by the
+  handler_watchdog instead.
+ */
+
+#include <array>
+#include <chrono>
+#include <mutex>
+
+#include <systemicai/http/server/namespace.h>
+
+namespace systemicai::http::server {
+
+/**
+ * A hashed timing wheel with `slots` lists of entries, one per `tick`.  An entry due further than a full turn ahead
+ * waits in its slot for the number of turns in `rounds_`.
+ */
+class timer_wheel : public net::io_context::service {
+public:
+  using clock = std::chrono::steady_clock;
+
+  static constexpr clock::duration tick = std::chrono::milliseconds(100);
+  static constexpr std::size_t slots = 512;
+
+  inline static net::io_context::id id;
+
+  /**
+   * A deadline on a wheel, embedded in the object it times out.  Once the deadline passes the entry is removed from
+   * the wheel, marked expired and on_expire() is called.  Derived classes cancel() in their own destructor, the wheel
+   * may be expiring the entry concurrently.
+   */
+  class entry {
+  public:
+    entry() = default;
+    entry(const entry&) = delete;
+    entry& operator=(const entry&) = delete;
+
+    virtual ~entry() {
+      cancel();
+    }
+
+    // The wheel must be attached before the first arm()
+    void attach(timer_wheel& wheel) {
+      wheel_ = &wheel;
+    }
+
+    timer_wheel* wheel() const {
+      return wheel_;
+    }
+
+    // Expire `d` from now, replacing the current deadline
+    void arm(clock::duration d) {
+      wheel_->arm(*this, d);
+    }
+
+    void cancel() {
+      if(wheel_ != nullptr)
+        wheel_->cancel(*this);
+    }
+
+    // True once the deadline passed, until the entry is armed or cancelled again
+    bool expired() const {
+      if(wheel_ == nullptr)
+        return false;
+      std::lock_guard<std::mutex> lg(wheel_->mutex_);
+      return expired_;
+    }
+
+  protected:
+    // Called on one of the wheel's threads with the wheel locked, it should only post work
+    virtual void on_expire() = 0;
+
+  private:
+    friend class timer_wheel;
+
+    timer_wheel* wheel_ = nullptr;
+    entry* prev_ = nullptr;
+    entry* next_ = nullptr;
+    std::size_t slot_ = 0;
+    std::size_t rounds_ = 0;
+    bool linked_ = false;
+    bool expired_ = false;
+  };
+
+  explicit timer_wheel(net::io_context& ioc) : net::io_context::service(ioc), timer_(ioc), start_(clock::now()) {
+  }
+
+  // The wheel of the io_context running `ex`, all the executors of our sessions belong to one
+  template<class Executor>
+  static timer_wheel& of(const Executor& ex) {
+    return net::use_service<timer_wheel>(static_cast<net::io_context&>(net::query(ex, net::execution::context)));
+  }
+
+  // The number of armed entries
+  std::size_t size() const {
+    std::lock_guard<std::mutex> lg(mutex_);
+    return size_;
+  }
+
+private:
+  void shutdown() override {
+    std::lock_guard<std::mutex> lg(mutex_);
+    stopped_ = true;
+    timer_.cancel();
+  }
+
+  // The tick `t` falls in
+  std::size_t ticks(clock::time_point t) const {
+    return t <= start_ ? 0 : static_cast<std::size_t>((t - start_) / tick);
+  }
+
+  void arm(entry& e, clock::duration d) {
+    std::lock_guard<std::mutex> lg(mutex_);
+    auto const now = clock::now();
+    if(e.linked_)
+      unlink(e);
+    // An idle wheel skips the ticks it had nothing to do in
+    if(size_ == 0)
+      next_ = std::max(next_, ticks(now));
+    // Round up, an entry never expires early
+    auto const due = std::max(next_, ticks(now + d) + 1);
+    e.slot_ = due % slots;
+    e.rounds_ = (due - next_) / slots;
+    e.expired_ = false;
+    link(e);
+    if(!ticking_ && !stopped_) {
+      ticking_ = true;
+      schedule();
+    }
+  }
+
+  void cancel(entry& e) {
+    std::lock_guard<std::mutex> lg(mutex_);
+    if(e.linked_)
+      unlink(e);
+    e.expired_ = false;
+  }
+
+  void link(entry& e) {
+    auto& head = heads_[e.slot_];
+    e.prev_ = nullptr;
+    e.next_ = head;
+    if(head != nullptr)
+      head->prev_ = &e;
+    head = &e;
+    e.linked_ = true;
+    ++size_;
+  }
+
+  void unlink(entry& e) {
+    if(e.prev_ != nullptr)
+      e.prev_->next_ = e.next_;
+    else
+      heads_[e.slot_] = e.next_;
+    if(e.next_ != nullptr)
+      e.next_->prev_ = e.prev_;
+    e.prev_ = e.next_ = nullptr;
+    e.linked_ = false;
+    --size_;
+  }
+
+  // Wait for the next tick to be due, called locked
+  void schedule() {
+    timer_.expires_at(start_ + tick * (next_ + 1));
+    timer_.async_wait([this](beast::error_code ec) { on_tick(ec); });
+  }
+
+  void on_tick(beast::error_code ec) {
+    std::lock_guard<std::mutex> lg(mutex_);
+    if(ec == net::error::operation_aborted || stopped_) {
+      ticking_ = false;
+      return;
+    }
+
+    // Catch up with every tick that passed
+    for(auto const now = ticks(clock::now()); next_ <= now && size_ != 0; ++next_) {
+      for(entry* e = heads_[next_ % slots]; e != nullptr;) {
+        auto const next = e->next_;
+        if(e->rounds_ == 0) {
+          unlink(*e);
+          e->expired_ = true;
+          e->on_expire();
+        } else {
+          --e->rounds_;
+        }
+        e = next;
+      }
+    }
+
+    if(size_ == 0) {
+      ticking_ = false;
+      return;
+    }
+    schedule();
+  }
+
+  mutable std::mutex mutex_;
+  net::steady_timer timer_;
+  const clock::time_point start_;
+  // The next tick to process, ticks are counted from start_
+  std::size_t next_ = 0;
+  std::array<entry*, slots> heads_{};
+  std::size_t size_ = 0;
+  bool ticking_ = false;
+  bool stopped_ = false;
+};
+
+/**
+ * The deadline of a session, it shuts the session's connection down when it expires.  It has the same interface as the
+ * timeouts of beast::basic_stream, which the sessions do not use.
+ *
+ * `Session` is owned by a shared_ptr and provides stream().
+ */
+template<class Session>
+class session_deadline : public timer_wheel::entry {
+public:
+  explicit session_deadline(Session& session) : session_(session) {
+  }
+
+  ~session_deadline() override {
+    cancel();
+  }
+
+  void expires_after(timer_wheel::clock::duration d) {
+    if(wheel() == nullptr)
+      attach(timer_wheel::of(session_.stream().get_executor()));
+    arm(d);
+  }
+
+  void expires_at(timer_wheel::clock::time_point t) {
+    expires_after(t - timer_wheel::clock::now());
+  }
+
+  void expires_never() {
+    cancel();
+  }
+
+protected:
+  void on_expire() override {
+    // The session may be on another thread, or being destroyed
+    auto self = session_.weak_from_this().lock();
+    if(!self)
+      return;
+    net::post(self->stream().get_executor(), [self, this] {
+      // It may have been re-armed since.  The socket is shut down rather than closed, the operation in progress
+      // may be running on another strand: a TLS handshake on a handshake_pool.  It fails and the session ends.
+      if(expired()) {
+        beast::error_code ec;
+        beast::get_lowest_layer(self->stream()).socket().shutdown(net::socket_base::shutdown_both, ec);
+      }
+    });
+  }
+
+private:
+  Session& session_;
+};
+
+} // namespace systemicai::http::server
+
+#endif // SYSTEMICAI_HTTP_SERVER_TIMER_WHEEL_H
@@ -0,0 +1,64 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_TLS_PROFILE_H
+#define SYSTEMICAI_HTTP_SERVER_TLS_PROFILE_H
+
+/**
+  The TLS profile of the service: the protocol versions it negotiates, its cipher suites and its key exchange groups.
+
+  The defaults offer TLS 1.2 and 1.3 with ephemeral elliptic curve key exchanges only, X25519 first.  TLS 1.3 takes
+  one round trip less than 1.2 and an X25519 key agreement costs a fraction of a 2048 bit finite field DH one, so
+  the DH parameters are only needed when a DHE cipher suite is configured for old clients.
+ */
+
+#include <string>
+
+#include <openssl/ssl.h>
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/settings.h>
+#include <systemicai/common/exception.h>
+
+namespace systemicai::http::server {
+
+/**
+ * Parse a protocol version of the settings
+ * @param version One of "1.0", "1.1", "1.2" or "1.3"
+ * @return The OpenSSL version constant
+ * @throws systemicai::common::exception on any other value
+ */
+inline int parse_tls_version(const std::string& version) {
+  if(version == "1.0")
+    return TLS1_VERSION;
+  if(version == "1.1")
+    return TLS1_1_VERSION;
+  if(version == "1.2")
+    return TLS1_2_VERSION;
+  if(version == "1.3")
+    return TLS1_3_VERSION;
+  throw systemicai::common::exception("Invalid TLS version: [" + version + "] must be one of 1.0, 1.1, 1.2 or 1.3");
+}
+
+/**
+ * Restrict `ctx` to the versions, cipher suites and groups of `s`, preferring the server's order to the client's.
+ * Empty cipher or group lists keep OpenSSL's defaults.
+ * @throws systemicai::common::exception on an invalid version range, or a list OpenSSL has nothing usable in
+ */
+inline void apply_tls_profile(ssl::context& ctx, const settings& s) {
+  auto const native = ctx.native_handle();
+  auto const min = parse_tls_version(s.ssl_min_version);
+  auto const max = parse_tls_version(s.ssl_max_version);
+  if(min > max)
+    throw systemicai::common::exception("Invalid TLS versions: minimum [" + s.ssl_min_version + "] is above maximum [" + s.ssl_max_version + "]");
+  if(SSL_CTX_set_min_proto_version(native, min) != 1 || SSL_CTX_set_max_proto_version(native, max) != 1)
+    throw systemicai::common::exception("TLS versions not supported: [" + s.ssl_min_version + "] to [" + s.ssl_max_version + "]");
+  if(!s.ssl_ciphers.empty() && SSL_CTX_set_cipher_list(native, s.ssl_ciphers.c_str()) != 1)
+    throw systemicai::common::exception("No usable cipher in service.ssl.ciphers: [" + s.ssl_ciphers + "]");
+  if(!s.ssl_ciphersuites.empty() && SSL_CTX_set_ciphersuites(native, s.ssl_ciphersuites.c_str()) != 1)
+    throw systemicai::common::exception("No usable cipher suite in service.ssl.ciphersuites: [" + s.ssl_ciphersuites + "]");
+  if(!s.ssl_groups.empty() && SSL_CTX_set1_groups_list(native, s.ssl_groups.c_str()) != 1)
+    throw systemicai::common::exception("No usable group in service.ssl.groups: [" + s.ssl_groups + "]");
+  SSL_CTX_set_options(native, SSL_OP_CIPHER_SERVER_PREFERENCE | SSL_OP_NO_RENEGOTIATION);
+}
+
+} // namespace systemicai::http::server
+
+#endif // SYSTEMICAI_HTTP_SERVER_TLS_PROFILE_H
@@ -0,0 +1,242 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_TLS_RESUMPTION_H
+#define SYSTEMICAI_HTTP_SERVER_TLS_RESUMPTION_H
+
+/**
+  TLS session resumption.
+
+  A client reconnecting with a session it was given before skips the certificate exchange and key agreement of a full
+  handshake.  Sessions are kept in OpenSSL's server side cache, for clients resuming by session id, and handed to the
+  clients as RFC 5077 tickets encrypted with keys rotated on a timer.  The keys can be read from a file instead, so
+  every process serving the same clients accepts the tickets issued by the others.
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/ssl.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#else
+#include <openssl/hmac.h>
+#endif
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/settings.h>
+#include <systemicai/common/exception.h>
+
+namespace systemicai::http::server {
+
+// The keys of a ticket, laid out as in a key file: name, HMAC-SHA256 key and AES-256-CBC key
+struct ticket_key {
+  static constexpr std::size_t size = 80;
+
+  std::array<unsigned char, 16> name;
+  std::array<unsigned char, 32> hmac;
+  std::array<unsigned char, 32> aes;
+};
+
+class tls_resumption {
+public:
+  struct counters {
+    std::uint64_t full;
+    std::uint64_t resumed;
+  };
+
+  /**
+   * Enable session resumption on `ctx` as configured by `s`.  The ticket keys are read from settings::ssl_ticket_keys
+   * when set, otherwise one is generated.
+   * @throws systemicai::common::exception when the key file cannot be read
+   */
+  tls_resumption(ssl::context& ctx, const settings& s)
+          : ctx_(ctx.native_handle())
+          , path_(s.ssl_ticket_keys)
+  {
+    SSL_CTX_set_session_id_context(ctx_, session_id_context, sizeof(session_id_context) - 1);
+    SSL_CTX_set_timeout(ctx_, static_cast<long>(s.ssl_session_timeout));
+    if(s.ssl_session_cache == 0) {
+      SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_OFF);
+    } else {
+      SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_SERVER);
+      SSL_CTX_sess_set_cache_size(ctx_, static_cast<long>(s.ssl_session_cache));
+    }
+
+    if(!s.ssl_tickets) {
+      SSL_CTX_set_options(ctx_, SSL_OP_NO_TICKET);
+      return;
+    }
+    SSL_CTX_clear_options(ctx_, SSL_OP_NO_TICKET);
+    if(path_.empty())
+      keys_.push_back(generate());
+    else
+      keys_ = read_keys(path_);
+    SSL_CTX_set_ex_data(ctx_, index(), this);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx_, &tls_resumption::on_ticket);
+#else
+    SSL_CTX_set_tlsext_ticket_key_cb(ctx_, &tls_resumption::on_ticket);
+#endif
+  }
+
+  tls_resumption(const tls_resumption&) = delete;
+  tls_resumption& operator=(const tls_resumption&) = delete;
+
+  // The context may outlive us, its tickets are not issued or accepted any more
+  ~tls_resumption() {
+    if(SSL_CTX_get_ex_data(ctx_, index()) == this)
+      SSL_CTX_set_ex_data(ctx_, index(), nullptr);
+  }
+
+  /**
+   * Switch to a new ticket key.  The previous one still decrypts the tickets issued before, so a ticket lives for
+   * one to two rotations.  With a key file the file is read again instead, keeping the current keys when that fails.
+   * @return False when the key file could not be read
+   */
+  bool rotate() {
+    if(!path_.empty()) {
+      try {
+        auto keys = read_keys(path_);
+        std::lock_guard<std::mutex> lg(mutex_);
+        keys_.swap(keys);
+        return true;
+      } catch(const std::exception&) {
+        return false;
+      }
+    }
+    auto const key = generate();
+    std::lock_guard<std::mutex> lg(mutex_);
+    keys_.insert(keys_.begin(), key);
+    keys_.resize(std::min<std::size_t>(keys_.size(), 2));
+    return true;
+  }
+
+  // Count a completed server handshake as full or resumed
+  static void count(SSL* ssl) {
+    (SSL_session_reused(ssl) ? resumed_ : full_).fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // The handshakes completed by every TLS session of the process
+  static counters handshakes() {
+    return {full_.load(std::memory_order_relaxed), resumed_.load(std::memory_order_relaxed)};
+  }
+
+  /**
+   * Read a ticket key file, made of one or more 80 byte keys as produced by `openssl rand 80`.  The first key
+   * encrypts new tickets, all of them decrypt tickets.
+   * @throws systemicai::common::exception when the file is missing or not a whole number of keys
+   */
+  static std::vector<ticket_key> read_keys(const std::string& path) {
+    std::ifstream f(path, std::ios::binary);
+    std::string const data((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    if(!f || data.empty() || data.size() % ticket_key::size != 0)
+      throw systemicai::common::exception("Invalid ticket key file: [" + path + "] it must hold one or more 80 byte keys");
+    std::vector<ticket_key> keys(data.size() / ticket_key::size);
+    for(std::size_t i = 0; i < keys.size(); ++i) {
+      auto p = reinterpret_cast<const unsigned char*>(data.data()) + i * ticket_key::size;
+      std::copy_n(p, keys[i].name.size(), keys[i].name.begin());
+      std::copy_n(p + 16, keys[i].hmac.size(), keys[i].hmac.begin());
+      std::copy_n(p + 48, keys[i].aes.size(), keys[i].aes.begin());
+    }
+    return keys;
+  }
+
+private:
+  static constexpr unsigned char session_id_context[] = "systemicai-httpd";
+
+  static int index() {
+    static int const i = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return i;
+  }
+
+  static ticket_key generate() {
+    ticket_key key;
+    if(RAND_bytes(key.name.data(), key.name.size()) != 1 ||
+       RAND_bytes(key.hmac.data(), key.hmac.size()) != 1 ||
+       RAND_bytes(key.aes.data(), key.aes.size()) != 1)
+      throw systemicai::common::exception("Generating a ticket key failed");
+    return key;
+  }
+
+  /**
+   * Set up the cipher for a new ticket (`enc` 1) or for the ticket presented by a client, and copy out its keys.
+   * @return 1 with the current key, 2 with an older one so the client is sent a new ticket, 0 when the ticket's
+   * key is unknown and a full handshake follows, -1 on error
+   */
+  int select(unsigned char* name, unsigned char* iv, EVP_CIPHER_CTX* cipher, int enc, ticket_key& key) {
+    std::size_t i = 0;
+    {
+      std::lock_guard<std::mutex> lg(mutex_);
+      if(enc == 1) {
+        if(keys_.empty())
+          return 0;
+        key = keys_.front();
+      } else {
+        while(i < keys_.size() && !std::equal(keys_[i].name.begin(), keys_[i].name.end(), name))
+          ++i;
+        if(i == keys_.size())
+          return 0;
+        key = keys_[i];
+      }
+    }
+    if(enc == 1) {
+      std::copy(key.name.begin(), key.name.end(), name);
+      if(RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1 ||
+         EVP_EncryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key.aes.data(), iv) != 1)
+        return -1;
+      return 1;
+    }
+    if(EVP_DecryptInit_ex(cipher, EVP_aes_256_cbc(), nullptr, key.aes.data(), iv) != 1)
+      return -1;
+    return i == 0 ? 1 : 2;
+  }
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  static int on_ticket(SSL* ssl, unsigned char* name, unsigned char* iv, EVP_CIPHER_CTX* cipher, EVP_MAC_CTX* mac, int enc) {
+    auto const self = static_cast<tls_resumption*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), index()));
+    if(self == nullptr)
+      return 0;
+    ticket_key key;
+    auto const r = self->select(name, iv, cipher, enc, key);
+    if(r <= 0)
+      return r;
+    char digest[] = "SHA256";
+    OSSL_PARAM params[] = {
+            OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, key.hmac.data(), key.hmac.size()),
+            OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+            OSSL_PARAM_construct_end()};
+    return EVP_MAC_CTX_set_params(mac, params) == 1 ? r : -1;
+  }
+#else
+  static int on_ticket(SSL* ssl, unsigned char* name, unsigned char* iv, EVP_CIPHER_CTX* cipher, HMAC_CTX* mac, int enc) {
+    auto const self = static_cast<tls_resumption*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), index()));
+    if(self == nullptr)
+      return 0;
+    ticket_key key;
+    auto const r = self->select(name, iv, cipher, enc, key);
+    if(r <= 0)
+      return r;
+    return HMAC_Init_ex(mac, key.hmac.data(), static_cast<int>(key.hmac.size()), EVP_sha256(), nullptr) == 1 ? r : -1;
+  }
+#endif
+
+  SSL_CTX* ctx_;
+  std::string path_;
+  std::mutex mutex_;
+  // The first key encrypts new tickets
+  std::vector<ticket_key> keys_;
+
+  inline static std::atomic<std::uint64_t> full_{0};
+  inline static std::atomic<std::uint64_t> resumed_{0};
+};
+
+} // namespace systemicai::http::server
+
+#endif // SYSTEMICAI_HTTP_SERVER_TLS_RESUMPTION_H
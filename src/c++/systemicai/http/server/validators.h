@@ -0,0 +1,134 @@
+#ifndef SYSTEMICAI_HTTP_SERVER_VALIDATORS_H
+#define SYSTEMICAI_HTTP_SERVER_VALIDATORS_H
+
+/**
+  The validators of a document root file, and the evaluation of the conditional requests made with them.
+
+  The strong entity tag is made of the inode, size and modification time of the file, all known to the open_file_cache
+  and file_cache without opening it, with a suffix for its gzip encoding so the two representations never share a
+  tag.  Last-Modified is the modification time in seconds.  Both are formatted into the object itself, a response
+  does not allocate for them.
+ */
+
+#include <cinttypes>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+
+#include <systemicai/http/server/namespace.h>
+
+namespace systemicai::http::server {
+
+class validators {
+public:
+  /**
+   * @param mtime Modification time in nanoseconds since the epoch
+   * @param encoded True for the gzip encoding of the file
+   */
+  validators(std::uint64_t inode, std::uint64_t size, std::int64_t mtime, bool encoded)
+          : seconds_(mtime / 1000000000)
+  {
+    etag_size_ = std::size_t(std::snprintf(etag_, sizeof(etag_), "\"%" PRIx64 "-%" PRIx64 "-%" PRIx64 "%s\"",
+            inode, size, std::uint64_t(mtime), encoded ? "-gz" : ""));
+    last_modified_size_ = format_http_date(seconds_, last_modified_);
+  }
+
+  beast::string_view etag() const {
+    return {etag_, etag_size_};
+  }
+
+  beast::string_view last_modified() const {
+    return {last_modified_, last_modified_size_};
+  }
+
+  /**
+   * True when the preconditions of a GET or HEAD say the client's copy is current, as RFC 7232 evaluates them:
+   * If-None-Match by weak comparison when present, otherwise If-Modified-Since when it is a valid date.
+   */
+  template<class Fields>
+  bool not_modified(const Fields& request) const {
+    auto const if_none_match = request[beast::http::field::if_none_match];
+    if(!if_none_match.empty())
+      return matches(if_none_match);
+    std::int64_t since;
+    auto const if_modified_since = request[beast::http::field::if_modified_since];
+    return !if_modified_since.empty() && parse_http_date(if_modified_since, since) && seconds_ <= since;
+  }
+
+  // True when the list of entity tags of an If-None-Match holds ours, or is "*"
+  bool matches(beast::string_view list) const {
+    auto const tag = etag();
+    while(!list.empty()) {
+      auto const comma = list.find(',');
+      auto element = list.substr(0, comma);
+      list = comma == beast::string_view::npos ? beast::string_view{} : list.substr(comma + 1);
+      while(!element.empty() && (element.front() == ' ' || element.front() == '\t'))
+        element.remove_prefix(1);
+      while(!element.empty() && (element.back() == ' ' || element.back() == '\t'))
+        element.remove_suffix(1);
+      if(element == "*")
+        return true;
+      // The weak comparison ignores the weakness of the client's tag
+      if(element.starts_with("W/"))
+        element.remove_prefix(2);
+      if(element == tag)
+        return true;
+    }
+    return false;
+  }
+
+  // Writes `seconds` since the epoch as an IMF-fixdate, "Sun, 06 Nov 1994 08:49:37 GMT", returns its size
+  static std::size_t format_http_date(std::int64_t seconds, char (&out)[32]) {
+    std::time_t const t = std::time_t(seconds);
+    std::tm tm;
+    ::gmtime_r(&t, &tm);
+    return std::size_t(std::snprintf(out, sizeof(out), "%s, %02d %s %04d %02d:%02d:%02d GMT", days[tm.tm_wday],
+            tm.tm_mday, months[tm.tm_mon], tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec));
+  }
+
+  // Reads an IMF-fixdate into `seconds` since the epoch, false when `date` is not one
+  static bool parse_http_date(beast::string_view date, std::int64_t& seconds) {
+    // "Sun, 06 Nov 1994 08:49:37 GMT"
+    if(date.size() != 29 || date.substr(3, 2) != ", " || date.substr(25) != " GMT")
+      return false;
+    auto const number = [&date](std::size_t at, std::size_t digits, int& value) {
+      value = 0;
+      for(std::size_t i = at; i < at + digits; ++i) {
+        if(date[i] < '0' || date[i] > '9')
+          return false;
+        value = value * 10 + (date[i] - '0');
+      }
+      return true;
+    };
+    std::tm tm{};
+    int year;
+    if(!number(5, 2, tm.tm_mday) || !number(12, 4, year) || !number(17, 2, tm.tm_hour) ||
+       !number(20, 2, tm.tm_min) || !number(23, 2, tm.tm_sec))
+      return false;
+    tm.tm_year = year - 1900;
+    tm.tm_mon = -1;
+    for(int m = 0; m < 12; ++m)
+      if(date.substr(8, 3) == months[m])
+        tm.tm_mon = m;
+    if(tm.tm_mon < 0 || date[7] != ' ' || date[11] != ' ' || date[16] != ' ' || date[19] != ':' || date[22] != ':')
+      return false;
+    seconds = std::int64_t(::timegm(&tm));
+    return true;
+  }
+
+private:
+  static constexpr const char* days[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+  static constexpr const char* months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                           "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+  std::int64_t seconds_;
+  char etag_[64];
+  std::size_t etag_size_;
+  char last_modified_[32];
+  std::size_t last_modified_size_;
+};
+
+} // namespace systemicai::http::server
+
+#endif // SYSTEMICAI_HTTP_SERVER_VALIDATORS_H
@@ -0,0 +1,61 @@
+//
+// Counts every allocation made through the global operator new, so tests can assert how many allocations a
+// piece of code performs.  Replacing the global operators affects the whole executable, this file is included
+// once from tst/c++/systemicai/unit_tests.cpp, outside of any test suite.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// GCC pairs the replaced operator delete with the inlined new it can see and warns about free()
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+namespace test::systemicai {
+
+inline std::atomic<std::size_t>& allocations() {
+  static std::atomic<std::size_t> count(0);
+  return count;
+}
+
+}
+
+void* operator new(std::size_t size) {
+  test::systemicai::allocations().fetch_add(1, std::memory_order_relaxed);
+  if(void* p = std::malloc(size == 0 ? 1 : size))
+    return p;
+  throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+  return ::operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  test::systemicai::allocations().fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& nt) noexcept {
+  return ::operator new(size, nt);
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+  std::free(p);
+}
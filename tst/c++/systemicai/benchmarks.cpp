@@ -0,0 +1,68 @@
+//
+// Benchmarks is the mono file for every benchmark, in the same way unit_tests.cpp is for the unit tests.
+// Each benchmark registers itself by name, running the executable without arguments runs all of them.
+//
+// Usage: benchmarks [-s seconds] [name ...]
+//
+
+#define BOOST_BIND_GLOBAL_PLACEHOLDERS 1
+#include <boost/property_tree/json_parser.hpp>
+#undef BOOST_BIND_GLOBAL_PLACEHOLDERS
+
+#include <boost/log/trivial.hpp>
+#include <boost/log/expressions.hpp>
+
+#include <cstddef>
+#include <systemicai/http/server/settings.h>
+#include <systemicai/http/server/service.hpp>
+#include <systemicai/http/server/server.h>
+
+#include <systemicai/http/server/benchmark.hpp>
+#include <systemicai/http/server/sharding_bench.cpp>
+#include <systemicai/http/server/listener_bench.cpp>
+#include <systemicai/http/server/unix_socket_bench.cpp>
+#include <systemicai/http/server/pipelining_bench.cpp>
+#include <systemicai/http/server/deadlines_bench.cpp>
+#include <systemicai/http/server/recycling_bench.cpp>
+#include <systemicai/http/server/tls_handshake_bench.cpp>
+#include <systemicai/http/server/handshake_storm_bench.cpp>
+#include <systemicai/http/server/ktls_bench.cpp>
+#include <systemicai/http/server/file_cache_bench.cpp>
+#include <systemicai/http/server/sendfile_bench.cpp>
+#include <systemicai/http/server/open_files_bench.cpp>
+#include <systemicai/http/server/compression_bench.cpp>
+#include <systemicai/http/server/conditional_bench.cpp>
+#include <systemicai/http/server/range_bench.cpp>
+#include <systemicai/http/server/mmap_bench.cpp>
+
+int main(int argc, char* argv[])
+{
+  namespace bm = test::systemicai::http::server::benchmark;
+  boost::log::core::get()->set_filter( boost::log::trivial::severity >= boost::log::trivial::warning );
+
+  bm::options o;
+  std::vector<std::string> names;
+  for(int i = 1; i < argc; ++i) {
+    std::string a(argv[i]);
+    if(a == "-s" && i + 1 < argc) {
+      o.seconds = std::stod(argv[++i]);
+    } else {
+      names.push_back(a);
+    }
+  }
+
+  if(names.empty())
+    for(auto& b : bm::registry())
+      names.push_back(b.first);
+
+  for(auto& n : names) {
+    auto b = bm::registry().find(n);
+    if(b == bm::registry().end()) {
+      std::cerr << "Unknown benchmark: [" << n << "]" << std::endl;
+      return EXIT_FAILURE;
+    }
+    std::cout << "== " << n << std::endl;
+    b->second(o);
+  }
+  return EXIT_SUCCESS;
+}
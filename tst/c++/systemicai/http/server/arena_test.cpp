@@ -0,0 +1,78 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+#include <systemicai/http/server/fixture.hpp>
+#include <boost/test/included/unit_test.hpp>
+
+// Keep-alive requests on an established connection should not go through the global heap
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_keep_alive_allocations )
+{
+  using namespace ::systemicai::http::server;
+  namespace fixture = test::systemicai::http::server::fixture;
+
+  auto const root = std::filesystem::temp_directory_path() / "afs-arena-test";
+  std::filesystem::create_directories(root);
+  std::ofstream(root / "index.html", std::ios::trunc) << std::string(256, 'x');
+
+  auto tree = fixture::make_settings(root);
+  // Shared io_contexts wrap every connection's strand in a type-erased executor, which is heap allocated whenever
+  // an operation tracks work on it.  A sharded io_context's executor is stored inline.
+  tree.put("service.thread.mode", "sharded");
+  tree.put("service.thread.io", 1);
+  fixture::running r(tree);
+
+  net::io_context ioc;
+  auto sock = fixture::connect(ioc, r.endpoint());
+  beast::error_code ec;
+
+  // The client side must not allocate either: a fixed request, and responses read into a fixed buffer
+  static const char request[] = "GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  char response[4096];
+  size_t response_size = 0;
+  auto const exchange = [&]() -> size_t {
+    net::write(sock, net::buffer(request, sizeof(request) - 1), ec);
+    if(ec)
+      return 0;
+    size_t got = 0;
+    // The first response tells us the size of all the following ones
+    do {
+      got += sock.read_some(net::buffer(response + got, sizeof(response) - got), ec);
+      if(ec)
+        return 0;
+    } while(response_size == 0 ? std::string_view(response, got).find(std::string(256, 'x')) == std::string_view::npos : got < response_size);
+    return got;
+  };
+
+  // Warm up the connection, its buffers and the allocator caches
+  response_size = exchange();
+  BOOST_REQUIRE(response_size > 0);
+  for(int i = 0; i < 16; ++i)
+    BOOST_REQUIRE(exchange() == response_size);
+
+  auto const requests = 200;
+  auto const before = ::test::systemicai::allocations().load();
+  for(int i = 0; i < requests; ++i)
+    BOOST_REQUIRE(exchange() == response_size);
+  auto const per_request = double(::test::systemicai::allocations().load() - before) / requests;
+  BOOST_TEST_MESSAGE("Allocations per keep-alive request: " << per_request);
+
+  sock.close();
+
+  BOOST_TEST(per_request < 0.5);
+}
+
+// Over-aligned requests get their alignment from the global heap, and are returned to it with the same alignment
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_arena_over_aligned )
+{
+  using namespace ::systemicai::http::server;
+
+  arena a;
+  constexpr std::size_t alignment = 4 * alignof(std::max_align_t);
+  for(std::size_t bytes : {std::size_t(24), std::size_t(20000)}) {
+    void* const p = a.allocate(bytes, alignment);
+    BOOST_TEST(reinterpret_cast<std::uintptr_t>(p) % alignment == 0u);
+    a.deallocate(p, bytes, alignment);
+  }
+}
@@ -0,0 +1,256 @@
+//
+// Shared helpers for the benchmarks, this file is included from tst/c++/systemicai/benchmarks.cpp
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <time.h>
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+
+// The cfg/ directory of the source tree, the build passes it, otherwise it is looked for in the working directory
+#ifndef AFS_CFG_DIR
+#define AFS_CFG_DIR "cfg"
+#endif
+
+namespace test::systemicai::http::server::benchmark {
+
+using namespace ::systemicai::http::server;
+namespace pt = boost::property_tree;
+using clock = std::chrono::steady_clock;
+
+struct options {
+  // How long each measured configuration runs for
+  double seconds = 2.0;
+};
+
+using benchmark_function = void(*)(const options&);
+
+inline std::map<std::string, benchmark_function>& registry() {
+  static std::map<std::string, benchmark_function> r;
+  return r;
+}
+
+// Registers a benchmark by name at static initialization time
+struct registrar {
+  registrar(const std::string& name, benchmark_function f) {
+    registry()[name] = f;
+  }
+};
+
+struct result {
+  size_t count = 0;
+  size_t errors = 0;
+  double per_second = 0;
+  double p50_ms = 0;
+  double p99_ms = 0;
+};
+
+inline void report_header(std::ostream& o, const std::string& what) {
+  o << std::left << std::setw(28) << what
+    << std::right << std::setw(14) << "ops/sec"
+    << std::setw(12) << "p50 ms"
+    << std::setw(12) << "p99 ms"
+    << std::setw(10) << "errors" << std::endl;
+}
+
+inline void report(std::ostream& o, const std::string& what, const result& r) {
+  o << std::left << std::setw(28) << what << std::right << std::fixed
+    << std::setw(14) << std::setprecision(0) << r.per_second
+    << std::setw(12) << std::setprecision(3) << r.p50_ms
+    << std::setw(12) << std::setprecision(3) << r.p99_ms
+    << std::setw(10) << r.errors << std::endl;
+}
+
+/**
+ * Run `op` in a loop on `clients` threads for `seconds` and collect the latency of every call.
+ * @param op Callable returning true on success, it is called with the index of the client thread
+ */
+template<class Op>
+result measure(int clients, double seconds, Op op) {
+  std::atomic<bool> done(false);
+  std::vector<std::vector<double>> latencies(clients);
+  std::vector<size_t> errors(clients, 0);
+  std::vector<std::thread> v;
+  auto const begin = clock::now();
+  for(int c = 0; c < clients; ++c) {
+    v.emplace_back([&, c] {
+      latencies[c].reserve(1 << 16);
+      while(!done) {
+        auto const t0 = clock::now();
+        if(!op(c)) {
+          ++errors[c];
+          continue;
+        }
+        latencies[c].push_back(std::chrono::duration<double, std::milli>(clock::now() - t0).count());
+      }
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  done = true;
+  for(auto& t : v)
+    t.join();
+  auto const elapsed = std::chrono::duration<double>(clock::now() - begin).count();
+
+  result r;
+  std::vector<double> all;
+  for(int c = 0; c < clients; ++c) {
+    all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+    r.errors += errors[c];
+  }
+  r.count = all.size();
+  r.per_second = r.count / elapsed;
+  if(!all.empty()) {
+    std::sort(all.begin(), all.end());
+    r.p50_ms = all[all.size() / 2];
+    r.p99_ms = all[std::min(all.size() - 1, all.size() * 99 / 100)];
+  }
+  return r;
+}
+
+// User and system CPU time of the process in seconds
+inline double cpu_seconds() {
+  rusage u{};
+  getrusage(RUSAGE_SELF, &u);
+  return u.ru_utime.tv_sec + u.ru_stime.tv_sec + (u.ru_utime.tv_usec + u.ru_stime.tv_usec) / 1e6;
+}
+
+// CPU time of the calling thread in seconds
+inline double thread_cpu_seconds() {
+  timespec t{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+// Create a document root in the temp directory with an index.html of `bytes` size
+inline std::string make_document_root(size_t bytes) {
+  auto const root = std::filesystem::temp_directory_path() / "afs-benchmark-root";
+  std::filesystem::create_directories(root);
+  std::ofstream f(root / "index.html", std::ios::trunc);
+  f << std::string(bytes, 'x');
+  return root.string();
+}
+
+// Load the certificate and key of cfg/, with its DH parameters when `dh` is set
+inline ssl::context& load_certificate(ssl::context& ctx, bool dh) {
+  std::filesystem::path const cfg(AFS_CFG_DIR);
+  ::systemicai::common::certificate::load(ctx, cfg / "dumb.cert", cfg / "dumb.key", dh ? cfg / "dumb.dh" : std::filesystem::path());
+  return ctx;
+}
+
+// Baseline settings for a benchmarked service, callers put their own overrides on top
+inline pt::ptree make_settings(unsigned short port, int threads, const std::string& root) {
+  pt::ptree tr;
+  tr.put("service.interface.address", "127.0.0.1");
+  tr.put("service.interface.port", port);
+  tr.put("service.thread.io", threads);
+  tr.put("service.log.level", "warning");
+  tr.put("document.root", root);
+  return tr;
+}
+
+// Runs a service on a background thread for the lifetime of this object
+class running_service {
+  settings settings_;
+  ssl::context& ssl_ctx_;
+  service service_;
+  std::thread thread_;
+
+public:
+  running_service(const pt::ptree& tr, ssl::context& ctx)
+    : settings_(tr), ssl_ctx_(ctx), service_(settings_, ssl_ctx_) {
+    thread_ = std::thread([this] { service_.start(); });
+    wait_until_accepting();
+  }
+
+  ~running_service() {
+    service_.stop();
+    thread_.join();
+  }
+
+  const settings& config() const {
+    return settings_;
+  }
+
+  // The endpoint of the first listener
+  tcp::endpoint endpoint() const {
+    auto& ls = settings_.listeners.front();
+    return tcp::endpoint(net::ip::make_address(ls.address), ls.port);
+  }
+
+private:
+  void wait_until_accepting() {
+    net::io_context ioc;
+    auto const deadline = clock::now() + std::chrono::seconds(5);
+    while(clock::now() < deadline) {
+      tcp::socket s(ioc);
+      beast::error_code ec;
+      s.connect(endpoint(), ec);
+      if(!ec)
+        return;
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    throw std::runtime_error("service did not start accepting connections");
+  }
+};
+
+// Read a full response from `s` into `buffer`, returns false on error or a non 200 response
+template<class Stream>
+bool read_response(Stream& s, beast::flat_buffer& buffer) {
+  beast::error_code ec;
+  beast::http::response<beast::http::string_body> res;
+  beast::http::read(s, buffer, res, ec);
+  return !ec && res.result() == beast::http::status::ok;
+}
+
+// GET `target` on an open keep-alive connection and read the response
+template<class Stream>
+bool get(Stream& s, beast::flat_buffer& buffer, const char* target) {
+  beast::error_code ec;
+  std::string req = std::string("GET ") + target + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  net::write(s, net::buffer(req), ec);
+  if(ec)
+    return false;
+  return read_response(s, buffer);
+}
+
+// One connection, one request: connect, GET `target` with "Connection: close", read the response, close.
+template<class Protocol>
+bool get_and_close(net::io_context& ioc, const typename Protocol::endpoint& ep, const char* target) {
+  typename Protocol::socket s(ioc);
+  beast::error_code ec;
+  s.connect(ep, ec);
+  if(ec)
+    return false;
+  std::string req = std::string("GET ") + target + " HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+  net::write(s, net::buffer(req), ec);
+  if(ec)
+    return false;
+  beast::flat_buffer buffer;
+  return read_response(s, buffer);
+}
+
+// One connection, one full handshake: connect, handshake and close without a request
+inline bool handshake_and_close(net::io_context& ioc, ssl::context& ctx, const tcp::endpoint& ep) {
+  beast::ssl_stream<tcp::socket> s(ioc, ctx);
+  beast::error_code ec;
+  s.next_layer().connect(ep, ec);
+  if(ec)
+    return false;
+  s.handshake(ssl::stream_base::client, ec);
+  return !ec;
+}
+
+}
@@ -0,0 +1,161 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+#include <systemicai/http/server/fixture.hpp>
+#include <systemicai/http/server/buffer_pool.h>
+#include <boost/test/included/unit_test.hpp>
+
+namespace test::systemicai::http::server::buffer_pool {
+
+using ::systemicai::http::server::buffer_pool;
+
+// The usage of the calling thread
+inline buffer_pool::usage this_thread() {
+  for(auto& u : buffer_pool::report())
+    if(u.running && u.thread == std::this_thread::get_id())
+      return u;
+  return {};
+}
+
+// Bytes lent by every thread
+inline size_t lent() {
+  size_t n = 0;
+  for(auto& u : buffer_pool::report())
+    n += u.lent;
+  return n;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_buffer_pool )
+{
+  using ::systemicai::http::server::buffer_pool;
+  using ::systemicai::http::server::recycler;
+  using namespace test::systemicai::http::server::buffer_pool;
+
+  // Only io threads keep blocks
+  recycler::io_thread io;
+  auto& pool = buffer_pool::local();
+  auto const before = this_thread();
+
+  // Sizes are rounded up to their block
+  void* small = pool.allocate(100);
+  void* large = pool.allocate(5000);
+  BOOST_TEST(this_thread().lent == before.lent + buffer_pool::min_block + 8192);
+
+  // Given back blocks are cached and reused
+  buffer_pool::deallocate(small, 100);
+  BOOST_TEST(this_thread().lent == before.lent + 8192);
+  BOOST_TEST(this_thread().cached == before.cached + buffer_pool::min_block);
+  BOOST_TEST(pool.allocate(900) == small);
+  buffer_pool::deallocate(small, 900);
+
+  // Beyond the largest block nothing is cached
+  void* huge = pool.allocate(buffer_pool::max_block + 1);
+  buffer_pool::deallocate(huge, buffer_pool::max_block + 1);
+  buffer_pool::deallocate(large, 5000);
+  BOOST_TEST(this_thread().lent == before.lent);
+  BOOST_TEST(this_thread().cached == before.cached + buffer_pool::min_block + 8192);
+
+  // A block given back on a thread that is not an io thread goes to the heap, and is no longer counted as lent here
+  void* moved = pool.allocate(2000);
+  size_t kept = 1;
+  std::thread([moved, &kept] {
+    buffer_pool::deallocate(moved, 2000);
+    kept = this_thread().cached;
+  }).join();
+  BOOST_TEST(kept == 0u);
+  BOOST_TEST(this_thread().lent == before.lent);
+}
+
+// Connections waiting for their next request hold no buffer
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_idle_buffers )
+{
+  using namespace ::systemicai::http::server;
+  using test::systemicai::http::server::buffer_pool::lent;
+  namespace fixture = test::systemicai::http::server::fixture;
+
+  auto const root = std::filesystem::temp_directory_path() / "afs-buffer-pool-test";
+  std::filesystem::create_directories(root);
+  std::ofstream(root / "index.html", std::ios::trunc) << std::string(256, 'b');
+
+  auto tree = fixture::make_settings(root);
+  fixture::add_listener(tree, "auto");
+  fixture::running r(tree);
+
+  auto const idle = lent();
+  net::io_context ioc;
+  beast::error_code ec;
+  std::vector<tcp::socket> sockets;
+  auto const connect = [&](const tcp::endpoint& ep) { sockets.push_back(fixture::connect(ioc, ep)); };
+  auto const settle = [&](auto done) {
+    for(int i = 0; i < 200 && !done(); ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  };
+
+  // Connections that have not sent anything yet, or are kept alive after a request
+  for(int i = 0; i < 16; ++i)
+    connect(r.endpoint(i % 2 ? 0 : 1));
+  std::string const request = "GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  for(size_t i = 0; i < 8; ++i) {
+    net::write(sockets[i], net::buffer(request), ec);
+    beast::flat_buffer buffer;
+    beast::http::response<beast::http::string_body> res;
+    beast::http::read(sockets[i], buffer, res, ec);
+    BOOST_REQUIRE(!ec);
+  }
+  settle([&] { return lent() == idle; });
+  BOOST_TEST(lent() == idle);
+
+  // A request being read holds one
+  std::string const partial = "GET /index.html HTTP/1.1\r\n";
+  for(size_t i = 0; i < 4; ++i)
+    net::write(sockets[i], net::buffer(partial), ec);
+  settle([&] { return lent() >= idle + 4 * buffer_pool::min_block; });
+  BOOST_TEST(lent() >= idle + 4 * buffer_pool::min_block);
+
+  // And gives it back once answered
+  for(size_t i = 0; i < 4; ++i) {
+    net::write(sockets[i], net::buffer("Host: localhost\r\n\r\n", 19), ec);
+    beast::flat_buffer buffer;
+    beast::http::response<beast::http::string_body> res;
+    beast::http::read(sockets[i], buffer, res, ec);
+    BOOST_REQUIRE(!ec);
+  }
+  settle([&] { return lent() == idle; });
+  BOOST_TEST(lent() == idle);
+}
+
+// Nor do WebSocket connections waiting for their next message
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_idle_websocket_buffers )
+{
+  using namespace ::systemicai::http::server;
+  using test::systemicai::http::server::buffer_pool::lent;
+  namespace fixture = test::systemicai::http::server::fixture;
+
+  auto const root = std::filesystem::temp_directory_path() / "afs-buffer-pool-test";
+  std::filesystem::create_directories(root);
+  fixture::running r(fixture::make_settings(root));
+
+  auto const idle = lent();
+  net::io_context ioc;
+  websocket::stream<tcp::socket> ws(fixture::connect(ioc, r.endpoint()));
+  ws.handshake("localhost", "/");
+
+  // Messages sent at once are all echoed, empty ones too
+  std::string const messages[] = {"one", "", std::string(20000, 'w')};
+  for(auto& m : messages)
+    ws.write(net::buffer(m));
+  for(auto& m : messages) {
+    beast::flat_buffer buffer;
+    ws.read(buffer);
+    BOOST_TEST(beast::buffers_to_string(buffer.data()) == m);
+  }
+
+  for(int i = 0; i < 200 && lent() != idle; ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  BOOST_TEST(lent() == idle);
+  ws.close(websocket::close_code::normal);
+}
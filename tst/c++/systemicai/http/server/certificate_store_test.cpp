@@ -0,0 +1,184 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+#include <systemicai/http/server/certificate_store.h>
+#include <systemicai/http/server/fixture.hpp>
+#include <boost/test/included/unit_test.hpp>
+
+namespace test::systemicai::http::server::certificate_store {
+
+using namespace ::systemicai::http::server;
+
+// Write a self signed P-256 certificate for `common_name` and `dns` (a subjectAltName list, empty for none) and its key
+inline void write_certificate(const std::filesystem::path& certificate, const std::filesystem::path& key,
+                              const std::string& common_name, const std::string& dns) {
+  EVP_PKEY* pkey = nullptr;
+  auto const kctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+  EVP_PKEY_keygen_init(kctx);
+  EVP_PKEY_CTX_set_ec_paramgen_curve_nid(kctx, NID_X9_62_prime256v1);
+  EVP_PKEY_keygen(kctx, &pkey);
+  EVP_PKEY_CTX_free(kctx);
+
+  auto const x = X509_new();
+  X509_set_version(x, 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(x), 1);
+  X509_gmtime_adj(X509_getm_notBefore(x), -3600);
+  X509_gmtime_adj(X509_getm_notAfter(x), 86400);
+  X509_set_pubkey(x, pkey);
+  auto const subject = X509_get_subject_name(x);
+  X509_NAME_add_entry_by_NID(subject, NID_commonName, MBSTRING_ASC,
+                             reinterpret_cast<const unsigned char*>(common_name.c_str()), -1, -1, 0);
+  X509_set_issuer_name(x, subject);
+  if(!dns.empty()) {
+    X509V3_CTX v3;
+    X509V3_set_ctx(&v3, x, x, nullptr, nullptr, 0);
+    auto const ext = X509V3_EXT_conf_nid(nullptr, &v3, NID_subject_alt_name, dns.c_str());
+    X509_add_ext(x, ext, -1);
+    X509_EXTENSION_free(ext);
+  }
+  X509_sign(x, pkey, EVP_sha256());
+
+  auto const c = std::unique_ptr<BIO, decltype(&BIO_free)>(BIO_new(BIO_s_mem()), &BIO_free);
+  PEM_write_bio_X509(c.get(), x);
+  auto const k = std::unique_ptr<BIO, decltype(&BIO_free)>(BIO_new(BIO_s_mem()), &BIO_free);
+  PEM_write_bio_PrivateKey(k.get(), pkey, nullptr, nullptr, 0, nullptr, nullptr);
+  for(auto [bio, path] : {std::pair{c.get(), certificate}, {k.get(), key}}) {
+    char* data;
+    auto const n = BIO_get_mem_data(bio, &data);
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << std::string(data, std::size_t(n));
+  }
+  X509_free(x);
+  EVP_PKEY_free(pkey);
+}
+
+// Handshake asking for `name`, or no name when empty, and return the common name of the certificate served
+inline std::string served(const tcp::endpoint& ep, const std::string& name) {
+  net::io_context ioc;
+  ssl::context ctx{ssl::context::tls_client};
+  beast::ssl_stream<beast::tcp_stream> stream(ioc, ctx);
+  if(!name.empty())
+    SSL_set_tlsext_host_name(stream.native_handle(), name.c_str());
+  beast::error_code ec;
+  beast::get_lowest_layer(stream).connect(ep, ec);
+  BOOST_REQUIRE(!ec);
+  stream.handshake(ssl::stream_base::client, ec);
+  if(ec)
+    return "";
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+  auto const peer = SSL_get1_peer_certificate(stream.native_handle());
+#else
+  auto const peer = SSL_get_peer_certificate(stream.native_handle());
+#endif
+  char cn[256] = {};
+  X509_NAME_get_text_by_NID(X509_get_subject_name(peer), NID_commonName, cn, sizeof(cn));
+  X509_free(peer);
+  stream.shutdown(ec);
+  return cn;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_certificate_store )
+{
+  using namespace ::systemicai::http::server;
+  using test::systemicai::http::server::certificate_store::served;
+  using test::systemicai::http::server::certificate_store::write_certificate;
+  using test::systemicai::http::server::fixture::make_settings;
+  using test::systemicai::http::server::fixture::running;
+  using store = ::systemicai::http::server::certificate_store;
+
+  auto const root = std::filesystem::temp_directory_path() / "afs-certificate-store-test";
+  std::filesystem::create_directories(root);
+  std::ofstream(root / "index.html", std::ios::trunc) << "certified";
+  write_certificate(root / "default.cert", root / "default.key", "default.example", "");
+  write_certificate(root / "a.cert", root / "a.key", "a.example", "DNS:a.example,DNS:*.B.example");
+
+  auto tree = make_settings(root, "tls");
+  tree.put("service.ssl.certificate", (root / "default.cert").string());
+  tree.put("service.ssl.key", (root / "default.key").string());
+  pt::ptree list, a;
+  a.put("certificate", (root / "a.cert").string());
+  a.put("key", (root / "a.key").string());
+  list.push_back(std::make_pair("", a));
+  tree.add_child("service.ssl.certificates", list);
+
+  // Names come from the subjectAltName, the common name stands in without one
+  {
+    auto const e = store::read((root / "a.cert").string(), (root / "a.key").string());
+    BOOST_TEST((e->names == std::vector<std::string>{"a.example", "*.b.example"}));
+    BOOST_TEST((store::read((root / "default.cert").string(), (root / "default.key").string())->names == std::vector<std::string>{"default.example"}));
+    BOOST_CHECK_THROW(store::read((root / "a.cert").string(), (root / "default.key").string()), ::systemicai::common::exception);
+    BOOST_CHECK_THROW(store::read((root / "missing.cert").string(), (root / "a.key").string()), ::systemicai::common::exception);
+  }
+
+  // A failed reload keeps the current table, a background one swaps the next table in
+  {
+    ::systemicai::http::server::settings s(tree);
+    ssl::context ctx{ssl::context::tls_server};
+    store certificates(ctx, s);
+    BOOST_TEST(certificates.generation() == 1u);
+    BOOST_TEST(!certificates.changed());
+    auto broken = s;
+    broken.ssl_certificates.front().key = (root / "default.key").string();
+    BOOST_CHECK_THROW(certificates.reload(broken), ::systemicai::common::exception);
+    BOOST_TEST(certificates.generation() == 1u);
+    BOOST_TEST(certificates.select("x.b.example")->names.front() == "a.example");
+    BOOST_TEST(certificates.reload_async(s));
+    for(int i = 0; i < 100 && certificates.generation() == 1u; ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    BOOST_TEST(certificates.generation() == 2u);
+  }
+
+  // Bad certificates are refused before the service starts
+  {
+    auto bad = tree;
+    bad.put("service.ssl.key", (root / "a.key").string());
+    ::systemicai::http::server::settings const s(bad);
+    ssl::context ctx{ssl::context::tls_server};
+    service svc(s, ctx);
+    BOOST_CHECK_THROW(svc.start(), ::systemicai::common::exception);
+  }
+
+  tree.put("service.ssl.certificate_check", 1);
+  running r(tree);
+
+  // Selected by the server name, exact or one wildcard level, with the default for any other name or none
+  BOOST_TEST(served(r.endpoint(), "a.example") == "a.example");
+  BOOST_TEST(served(r.endpoint(), "A.Example") == "a.example");
+  BOOST_TEST(served(r.endpoint(), "x.b.example") == "a.example");
+  BOOST_TEST(served(r.endpoint(), "b.example") == "default.example");
+  BOOST_TEST(served(r.endpoint(), "y.x.b.example") == "default.example");
+  BOOST_TEST(served(r.endpoint(), "other.example") == "default.example");
+  BOOST_TEST(served(r.endpoint(), "") == "default.example");
+
+  // A connection open across the renewal keeps being served
+  net::io_context ioc;
+  ssl::context ctx{ssl::context::tls_client};
+  beast::ssl_stream<beast::tcp_stream> open(ioc, ctx);
+  beast::get_lowest_layer(open).connect(r.endpoint());
+  open.handshake(ssl::stream_base::client);
+  auto const get = [&open] {
+    beast::http::request<beast::http::empty_body> req{beast::http::verb::get, "/index.html", 11};
+    req.set(beast::http::field::host, "localhost");
+    beast::http::write(open, req);
+    beast::flat_buffer buffer;
+    beast::http::response<beast::http::string_body> res;
+    beast::error_code ec;
+    beast::http::read(open, buffer, res, ec);
+    return !ec && res.body() == "certified";
+  };
+  BOOST_TEST(get());
+
+  // Renewed files are served to new handshakes within a check, without a restart
+  write_certificate(root / "default.cert", root / "default.key", "renewed.example", "");
+  std::string renewed;
+  for(int i = 0; i < 150 && renewed != "renewed.example"; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    renewed = served(r.endpoint(), "other.example");
+  }
+  BOOST_TEST(renewed == "renewed.example");
+  BOOST_TEST(served(r.endpoint(), "a.example") == "a.example");
+  BOOST_TEST(get());
+}
@@ -0,0 +1,79 @@
+//
+// This file is included from tst/c++/systemicai/benchmarks.cpp
+//
+// Compressed assets: keep-alive clients GET a 256 KiB script as it is, compressed on demand and kept in the
+// compressed cache, or from its precompressed .gz sibling.  The size of the response body is shown with each run.
+//
+
+#include <systemicai/http/server/benchmark.hpp>
+#include <systemicai/http/server/compressed_cache.h>
+
+namespace test::systemicai::http::server::benchmark {
+
+// GET `target` accepting `accept_encoding`, the size of the response body is stored in `size`
+template<class Stream>
+bool get_encoded(Stream& s, beast::flat_buffer& buffer, const char* target, const char* accept_encoding, size_t& size) {
+  beast::error_code ec;
+  std::string req = std::string("GET ") + target + " HTTP/1.1\r\nHost: localhost\r\nAccept-Encoding: " +
+                    accept_encoding + "\r\n\r\n";
+  net::write(s, net::buffer(req), ec);
+  if(ec)
+    return false;
+  beast::http::response_parser<beast::http::string_body> parser;
+  parser.body_limit(1 << 20);
+  beast::http::read(s, buffer, parser, ec);
+  size = parser.get().body().size();
+  return !ec && parser.get().result() == beast::http::status::ok;
+}
+
+inline void compression(const options& o) {
+  auto const root = std::filesystem::path(make_document_root(512));
+  std::string script;
+  for(int i = 0; script.size() < (256 << 10); ++i)
+    script += "function handler" + std::to_string(i) + "(event) { return event.target.value + " + std::to_string(i) + "; }\n";
+  std::ofstream(root / "app.js", std::ios::binary | std::ios::trunc) << script;
+  std::ofstream(root / "static.js", std::ios::binary | std::ios::trunc) << script;
+  std::ofstream(root / "static.js.gz", std::ios::binary | std::ios::trunc)
+          << ::systemicai::http::server::compressed_cache::gzip(script, 9);
+  ssl::context ctx{ssl::context::tlsv12};
+
+  struct run {
+    const char* name;
+    const char* target;
+    const char* accept_encoding;
+  };
+  static const run runs[] = {
+          {"identity", "/app.js", "identity"},
+          {"gzip on demand", "/app.js", "gzip"},
+          {"gzip precompressed", "/static.js", "gzip"}};
+
+  report_header(std::cout, "256 KiB script");
+  for(auto& r : runs) {
+    auto tr = make_settings(18330, 2, root.string());
+    tr.put("service.limit.compressed_cache", 16 << 20);
+    pt::ptree l, plain;
+    plain.put("port", 18330);
+    plain.put("type", "plain");
+    l.push_back(std::make_pair("", plain));
+    tr.add_child("service.listeners", l);
+    running_service rs(tr, ctx);
+
+    auto const clients = 4;
+    net::io_context ioc;
+    std::vector<tcp::socket> sockets;
+    std::vector<beast::flat_buffer> buffers(clients);
+    std::vector<size_t> sizes(clients);
+    for(int c = 0; c < clients; ++c) {
+      sockets.emplace_back(ioc);
+      sockets.back().connect(rs.endpoint());
+    }
+    auto const res = measure(clients, o.seconds, [&](int c) {
+      return get_encoded(sockets[c], buffers[c], r.target, r.accept_encoding, sizes[c]);
+    });
+    report(std::cout, std::string(r.name) + ", " + std::to_string(sizes[0] >> 10) + " KiB", res);
+  }
+}
+
+static registrar compression_registrar("compression", compression);
+
+}
@@ -0,0 +1,195 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+#include <systemicai/http/server/compressed_cache.h>
+#include <systemicai/http/server/functions.h>
+#include <systemicai/http/server/fixture.hpp>
+#include <boost/test/included/unit_test.hpp>
+#include <zlib.h>
+
+namespace test::systemicai::http::server::compression {
+
+// `data` decompressed from the gzip format, empty on failure
+inline std::string gunzip(std::string_view data) {
+  z_stream z{};
+  if(::inflateInit2(&z, 15 + 16) != Z_OK)
+    return {};
+  std::string out(1 << 20, '\0');
+  z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  z.avail_in = uInt(data.size());
+  z.next_out = reinterpret_cast<Bytef*>(out.data());
+  z.avail_out = uInt(out.size());
+  auto const status = ::inflate(&z, Z_FINISH);
+  out.resize(z.total_out);
+  ::inflateEnd(&z);
+  return status == Z_STREAM_END ? out : std::string();
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_compression )
+{
+  using namespace ::systemicai::http::server;
+  using test::systemicai::http::server::compression::gunzip;
+  namespace fixture = test::systemicai::http::server::fixture;
+
+  // Negotiation
+  BOOST_TEST(accepts_gzip("gzip"));
+  BOOST_TEST(accepts_gzip("deflate, GZIP;q=0.5, br"));
+  BOOST_TEST(accepts_gzip("x-gzip"));
+  BOOST_TEST(accepts_gzip("*"));
+  BOOST_TEST(!accepts_gzip(""));
+  BOOST_TEST(!accepts_gzip("deflate, br"));
+  BOOST_TEST(!accepts_gzip("gzip;q=0"));
+  BOOST_TEST(!accepts_gzip("gzip ; q=0.000"));
+  BOOST_TEST(!accepts_gzip("*, gzip;q=0"));
+  BOOST_TEST(!accepts_gzip("identity, *;q=0"));
+  BOOST_TEST(accepts_gzip("*;q=0, gzip"));
+  BOOST_TEST(compressible("/a/app.js"));
+  BOOST_TEST(compressible("/style.CSS"));
+  BOOST_TEST(compressible("/logo.svg"));
+  BOOST_TEST(!compressible("/logo.svgz"));
+  BOOST_TEST(!compressible("/logo.png"));
+
+  auto const root = std::filesystem::temp_directory_path() / "afs-compression-test";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root);
+  std::string script;
+  for(int i = 0; i < 200; ++i)
+    script += "function f" + std::to_string(i) + "() { return " + std::to_string(i) + "; }\n";
+  for(auto name : {"app.js", "static.js", "other.js"})
+    std::ofstream(root / name, std::ios::binary | std::ios::trunc) << script;
+  std::ofstream(root / "static.js.gz", std::ios::binary | std::ios::trunc) << compressed_cache::gzip("precompressed", 9);
+  std::ofstream(root / "tiny.txt", std::ios::binary | std::ios::trunc) << "x";
+  std::ofstream(root / "image.png", std::ios::binary | std::ios::trunc) << script;
+  auto const path = [&root](const char* name) { return (root / name).string(); };
+
+  {
+    ::systemicai::http::server::compressed_cache cache;
+    beast::error_code ec;
+    auto const app = open_file::open(path("app.js").c_str(), ec);
+    auto const other = open_file::open(path("other.js").c_str(), ec);
+
+    // Disabled without a budget
+    BOOST_TEST(!cache.get(path("app.js"), *app));
+
+    cache.limit(1 << 20, 1 << 20, 6);
+    auto const a = cache.get(path("app.js"), *app);
+    BOOST_REQUIRE(a);
+    BOOST_TEST(!a->useless());
+    BOOST_TEST(a->data.size() < script.size());
+    BOOST_TEST(gunzip(a->data) == script);
+    BOOST_TEST(cache.get(path("app.js"), *app) == a);
+    BOOST_TEST(cache.stats().hits == 1u);
+
+    // A file changed since it was compressed is compressed again
+    std::ofstream(root / "app.js", std::ios::app) << "// more\n";
+    auto const changed = open_file::open(path("app.js").c_str(), ec);
+    auto const b = cache.get(path("app.js"), *changed);
+    BOOST_TEST(b != a);
+    BOOST_TEST(gunzip(b->data) == script + "// more\n");
+    BOOST_TEST(cache.stats().files == 1u);
+
+    // A smaller budget evicts the least recently used
+    cache.get(path("other.js"), *other);
+    cache.get(path("app.js"), *changed);
+    cache.limit(b->data.size(), 1 << 20, 6);
+    BOOST_TEST(cache.stats().files == 1u);
+    BOOST_TEST(cache.stats().evictions == 1u);
+    BOOST_TEST(cache.get(path("app.js"), *changed) == b);
+
+    // Nothing is compressed over the file limit
+    cache.limit(1 << 20, 100, 6);
+    BOOST_TEST(!cache.get(path("other.js"), *other));
+
+    // Concurrent misses of a file compress it once, the others go without in the meantime
+    std::string large;
+    while(large.size() < (4 << 20))
+      large += script;
+    std::ofstream(root / "large.js", std::ios::binary | std::ios::trunc) << large;
+    auto const file = open_file::open(path("large.js").c_str(), ec);
+    cache.limit(16 << 20, 16 << 20, 6);
+    std::vector<std::shared_ptr<const ::systemicai::http::server::compressed_cache::entry>> got(8);
+    std::vector<std::thread> threads;
+    for(auto& e : got)
+      threads.emplace_back([&] { e = cache.get(path("large.js"), *file); });
+    for(auto& t : threads)
+      t.join();
+    auto const compressed = cache.get(path("large.js"), *file);
+    BOOST_REQUIRE(compressed);
+    for(auto& e : got)
+      BOOST_TEST((e == nullptr || e == compressed));
+
+    // Concurrent misses of different files, each inserted into and erased from the set of files being compressed
+    // while the others compress theirs
+    std::vector<std::string> names;
+    for(int i = 0; i < 64; ++i) {
+      names.push_back("many" + std::to_string(i) + ".js");
+      std::ofstream(root / names.back(), std::ios::binary | std::ios::trunc) << script << i;
+    }
+    std::vector<std::shared_ptr<const open_file>> files;
+    for(auto& name : names)
+      files.push_back(open_file::open(path(name.c_str()).c_str(), ec));
+    threads.clear();
+    for(std::size_t t = 0; t < 8; ++t)
+      threads.emplace_back([&, t] {
+        for(auto i = t; i < names.size(); i += 8)
+          cache.get(path(names[i].c_str()), *files[i]);
+      });
+    for(auto& t : threads)
+      t.join();
+    for(std::size_t i = 0; i < names.size(); ++i) {
+      auto const e = cache.get(path(names[i].c_str()), *files[i]);
+      BOOST_REQUIRE(e);
+      BOOST_TEST(gunzip(e->data) == script + std::to_string(i));
+    }
+  }
+
+  auto tree = fixture::make_settings(root);
+  tree.put("service.limit.compressed_cache", 1048576);
+  fixture::running r(tree);
+  auto const request = [&r](beast::http::verb verb, const char* target, const char* accept_encoding) {
+    if(accept_encoding == nullptr)
+      return fixture::request(r.endpoint(), verb, target);
+    return fixture::request(r.endpoint(), verb, target, {{beast::http::field::accept_encoding, accept_encoding}});
+  };
+
+  auto const get = beast::http::verb::get;
+
+  // The precompressed sibling
+  auto res = request(get, "/static.js", "gzip, deflate");
+  BOOST_TEST(res[beast::http::field::content_encoding] == "gzip");
+  BOOST_TEST(res[beast::http::field::vary] == "Accept-Encoding");
+  BOOST_TEST(res[beast::http::field::content_type] == "application/javascript");
+  BOOST_TEST(gunzip(res.body()) == "precompressed");
+
+  // Compressed on demand, as a GET and a HEAD
+  res = request(get, "/other.js", "gzip");
+  BOOST_TEST(res[beast::http::field::content_encoding] == "gzip");
+  BOOST_TEST(gunzip(res.body()) == script);
+  auto const head = request(beast::http::verb::head, "/other.js", "gzip");
+  BOOST_TEST(head[beast::http::field::content_encoding] == "gzip");
+  BOOST_TEST(head[beast::http::field::content_length] == std::to_string(res.body().size()));
+
+  // Not accepted, refused, or saving nothing: sent as it is, still varying
+  for(auto accept : {static_cast<const char*>(nullptr), "br", "gzip;q=0"}) {
+    res = request(get, "/static.js", accept);
+    BOOST_TEST(res[beast::http::field::content_encoding].empty());
+    BOOST_TEST(res[beast::http::field::vary] == "Accept-Encoding");
+    BOOST_TEST(res.body() == script);
+  }
+  res = request(get, "/tiny.txt", "gzip");
+  BOOST_TEST(res[beast::http::field::content_encoding].empty());
+  BOOST_TEST(res.body() == "x");
+
+  // Not text: never negotiated
+  res = request(get, "/image.png", "gzip");
+  BOOST_TEST(res[beast::http::field::content_encoding].empty());
+  BOOST_TEST(res[beast::http::field::vary].empty());
+  BOOST_TEST(res.body() == script);
+
+  // Missing either way
+  BOOST_TEST(request(get, "/missing.js", "gzip").result() == beast::http::status::not_found);
+}
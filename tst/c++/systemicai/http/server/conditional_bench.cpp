@@ -0,0 +1,69 @@
+//
+// This file is included from tst/c++/systemicai/benchmarks.cpp
+//
+// Revalidation: keep-alive clients GET a 64 KiB asset they already have, unconditionally or with the entity tag
+// of their copy, answered with 304 Not Modified.
+//
+
+#include <systemicai/http/server/benchmark.hpp>
+
+namespace test::systemicai::http::server::benchmark {
+
+inline void conditional(const options& o) {
+  auto const root = std::filesystem::path(make_document_root(512));
+  std::ofstream(root / "asset.js", std::ios::binary | std::ios::trunc) << std::string(64 << 10, 'a');
+  auto tr = make_settings(18340, 2, root.string());
+  tr.put("service.limit.open_files", 1024);
+  pt::ptree l, plain;
+  plain.put("port", 18340);
+  plain.put("type", "plain");
+  l.push_back(std::make_pair("", plain));
+  tr.add_child("service.listeners", l);
+  ssl::context ctx{ssl::context::tlsv12};
+  running_service rs(tr, ctx);
+
+  // The tag of the copy the clients have
+  std::string etag;
+  {
+    net::io_context ioc;
+    tcp::socket s(ioc);
+    s.connect(rs.endpoint());
+    beast::http::request<beast::http::empty_body> req{beast::http::verb::get, "/asset.js", 11};
+    req.set(beast::http::field::host, "localhost");
+    beast::http::write(s, req);
+    beast::flat_buffer buffer;
+    beast::http::response<beast::http::string_body> res;
+    beast::http::read(s, buffer, res);
+    etag = std::string(res[beast::http::field::etag]);
+  }
+
+  report_header(std::cout, "64 KiB asset");
+  for(bool revalidate : {false, true}) {
+    auto const request = std::string("GET /asset.js HTTP/1.1\r\nHost: localhost\r\n") +
+                         (revalidate ? "If-None-Match: " + etag + "\r\n" : std::string()) + "\r\n";
+    auto const expected = revalidate ? beast::http::status::not_modified : beast::http::status::ok;
+    auto const clients = 4;
+    net::io_context ioc;
+    std::vector<tcp::socket> sockets;
+    std::vector<beast::flat_buffer> buffers(clients);
+    for(int c = 0; c < clients; ++c) {
+      sockets.emplace_back(ioc);
+      sockets.back().connect(rs.endpoint());
+    }
+    auto const r = measure(clients, o.seconds, [&](int c) {
+      beast::error_code ec;
+      net::write(sockets[c], net::buffer(request), ec);
+      if(ec)
+        return false;
+      beast::http::response_parser<beast::http::string_body> parser;
+      parser.body_limit(1 << 20);
+      beast::http::read(sockets[c], buffers[c], parser, ec);
+      return !ec && parser.get().result() == expected;
+    });
+    report(std::cout, revalidate ? "If-None-Match, 304" : "unconditional, 200", r);
+  }
+}
+
+static registrar conditional_registrar("conditional", conditional);
+
+}
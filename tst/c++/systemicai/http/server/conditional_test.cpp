@@ -0,0 +1,95 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+#include <systemicai/http/server/validators.h>
+#include <systemicai/http/server/fixture.hpp>
+#include <boost/test/included/unit_test.hpp>
+
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_conditional )
+{
+  using namespace ::systemicai::http::server;
+  namespace fixture = test::systemicai::http::server::fixture;
+  using field = beast::http::field;
+
+  // Validators
+  validators const v(0x1234, 10, std::int64_t(784111777) * 1000000000 + 5, false);
+  BOOST_TEST(v.etag() == "\"1234-a-ae1b981bc490a05\"");
+  BOOST_TEST(v.last_modified() == "Sun, 06 Nov 1994 08:49:37 GMT");
+  BOOST_TEST(validators(0x1234, 10, 0, true).etag() == "\"1234-a-0-gz\"");
+  BOOST_TEST(v.matches("\"other\", \"1234-a-ae1b981bc490a05\""));
+  BOOST_TEST(v.matches("W/\"1234-a-ae1b981bc490a05\""));
+  BOOST_TEST(v.matches("*"));
+  BOOST_TEST(!v.matches("\"1234-a-ae1b981bc490a05-gz\""));
+  std::int64_t seconds;
+  BOOST_TEST(validators::parse_http_date("Sun, 06 Nov 1994 08:49:37 GMT", seconds));
+  BOOST_TEST(seconds == 784111777);
+  BOOST_TEST(!validators::parse_http_date("Sunday, 06-Nov-94 08:49:37 GMT", seconds));
+  BOOST_TEST(!validators::parse_http_date("Sun, 06 Nox 1994 08:49:37 GMT", seconds));
+
+  auto const root = std::filesystem::temp_directory_path() / "afs-conditional-test";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root);
+  std::ofstream(root / "page.html", std::ios::binary | std::ios::trunc) << std::string(2000, 'p');
+  std::ofstream(root / "large.bin", std::ios::binary | std::ios::trunc) << std::string(200000, 'l');
+  std::ofstream(root / "tiny.html", std::ios::binary | std::ios::trunc) << "t";
+
+  auto tree = fixture::make_settings(root);
+  tree.put("service.limit.file_cache", 65536);
+  tree.put("service.limit.open_files", 16);
+  tree.put("service.limit.open_file_ttl", 60000);
+  tree.put("service.limit.compressed_cache", 1048576);
+  fixture::running r(tree);
+  auto const request = [&r](const char* target, std::initializer_list<std::pair<field, std::string>> fields) {
+    return fixture::request(r.endpoint(), beast::http::verb::get, target, fields);
+  };
+
+  // Validators of a file served from memory, and of one sent from its descriptor
+  for(auto target : {"/page.html", "/large.bin"}) {
+    auto const full = request(target, {});
+    BOOST_TEST(full.result() == beast::http::status::ok);
+    auto const etag = std::string(full[field::etag]);
+    auto const last_modified = std::string(full[field::last_modified]);
+    BOOST_TEST(etag.size() > 2u);
+    BOOST_TEST(last_modified.size() == 29u);
+
+    // Revalidated without opening the file again
+    auto const opened = open_file_cache::global().stats();
+    auto const by_tag = request(target, {{field::if_none_match, "\"stale\", " + etag}});
+    BOOST_TEST(by_tag.result() == beast::http::status::not_modified);
+    BOOST_TEST(by_tag.body().empty());
+    BOOST_TEST(by_tag[field::etag] == etag);
+    BOOST_TEST(by_tag[field::last_modified] == last_modified);
+    BOOST_TEST(request(target, {{field::if_none_match, "W/" + etag}}).result() == beast::http::status::not_modified);
+    BOOST_TEST(request(target, {{field::if_modified_since, last_modified}}).result() == beast::http::status::not_modified);
+    BOOST_TEST(open_file_cache::global().stats().misses == opened.misses);
+
+    // Changed copies are sent whole, If-None-Match taking precedence over If-Modified-Since
+    BOOST_TEST(request(target, {{field::if_none_match, "\"stale\""}}).result() == beast::http::status::ok);
+    BOOST_TEST(request(target, {{field::if_none_match, "\"stale\""}, {field::if_modified_since, last_modified}}).result()
+               == beast::http::status::ok);
+    BOOST_TEST(request(target, {{field::if_modified_since, "Sun, 06 Nov 1994 08:49:37 GMT"}}).result()
+               == beast::http::status::ok);
+    BOOST_TEST(request(target, {{field::if_modified_since, "yesterday"}}).result() == beast::http::status::ok);
+  }
+
+  // The gzip encoding has a tag of its own
+  auto const identity = request("/page.html", {});
+  auto const encoded = request("/page.html", {{field::accept_encoding, "gzip"}});
+  BOOST_TEST(encoded[field::content_encoding] == "gzip");
+  BOOST_TEST(encoded[field::etag] != identity[field::etag]);
+  BOOST_TEST(request("/page.html", {{field::accept_encoding, "gzip"}, {field::if_none_match, std::string(encoded[field::etag])}}).result()
+             == beast::http::status::not_modified);
+  BOOST_TEST(request("/page.html", {{field::if_none_match, std::string(encoded[field::etag])}}).result()
+             == beast::http::status::ok);
+
+  // A file whose encoding saves nothing is sent as it is, and revalidated as such
+  auto const plain = request("/tiny.html", {{field::accept_encoding, "gzip"}});
+  BOOST_TEST(plain[field::content_encoding].empty());
+  auto const revalidated = request("/tiny.html", {{field::accept_encoding, "gzip"},
+                                                  {field::if_modified_since, std::string(plain[field::last_modified])}});
+  BOOST_TEST(revalidated.result() == beast::http::status::not_modified);
+  BOOST_TEST(revalidated[field::etag] == plain[field::etag]);
+  BOOST_TEST(std::string(revalidated[field::etag]).find("-gz") == std::string::npos);
+}
@@ -0,0 +1,104 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/connection_limit.h>
+#include <systemicai/http/server/fixture.hpp>
+#include <boost/test/included/unit_test.hpp>
+
+#include <poll.h>
+
+namespace test::systemicai::http::server::connection_limit {
+
+using namespace ::systemicai::http::server;
+
+// Whether a response to `sock` starts arriving within `timeout`
+inline bool answered(tcp::socket& sock, std::chrono::milliseconds timeout) {
+  pollfd p{sock.native_handle(), POLLIN, 0};
+  return ::poll(&p, 1, int(timeout.count())) == 1;
+}
+
+inline std::string response(tcp::socket& sock) {
+  beast::flat_buffer buffer;
+  beast::http::response<beast::http::string_body> res;
+  beast::error_code ec;
+  beast::http::read(sock, buffer, res, ec);
+  return ec ? ec.message() : res.body();
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_connection_limit )
+{
+  auto limit = std::make_shared<systemicai::http::server::connection_limit>(2);
+  BOOST_TEST(limit->try_acquire());
+  BOOST_TEST(limit->try_acquire());
+  // At the cap no further slots are handed out
+  BOOST_TEST(!limit->try_acquire());
+  BOOST_TEST(limit->count() == 2);
+
+  int resumed = 0;
+  limit->wait([&resumed] { ++resumed; });
+  BOOST_TEST(resumed == 0);
+
+  {
+    // Releasing a slot resumes the waiting listener exactly once
+    systemicai::http::server::connection_token token(limit);
+    systemicai::http::server::connection_token moved(std::move(token));
+  }
+  BOOST_TEST(resumed == 1);
+  BOOST_TEST(limit->count() == 1);
+
+  // A slot that is free when waiting resumes immediately
+  limit->wait([&resumed] { ++resumed; });
+  BOOST_TEST(resumed == 2);
+
+  // No limit
+  systemicai::http::server::connection_limit unlimited;
+  for(int i = 0; i < 1000; ++i)
+    BOOST_TEST(unlimited.try_acquire());
+  BOOST_TEST(unlimited.count() == 1000);
+}
+
+// Connections over the cap wait in the backlog, and a batch of pending accepts takes no more than the free slots
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_connection_cap )
+{
+  using namespace ::systemicai::http::server;
+  using namespace test::systemicai::http::server::connection_limit;
+  namespace fixture = test::systemicai::http::server::fixture;
+  using std::chrono::milliseconds;
+
+  auto const root = std::filesystem::temp_directory_path() / "afs-connection-cap-test";
+  std::filesystem::create_directories(root);
+  std::ofstream(root / "index.html", std::ios::trunc) << "capped";
+
+  auto tree = fixture::make_settings(root);
+  tree.put("service.limit.connections", 2);
+  tree.put("service.limit.accept_batch", 8);
+  fixture::running r(tree);
+
+  // Connected together, so the listener finds them pending in one wakeup
+  net::io_context ioc;
+  std::vector<tcp::socket> sockets;
+  for(int i = 0; i < 4; ++i)
+    sockets.push_back(fixture::connect(ioc, r.endpoint()));
+  std::string const request = "GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  for(auto& sock : sockets)
+    net::write(sock, net::buffer(request));
+
+  // The first two are served and kept alive, the others are not accepted while they are open
+  BOOST_TEST(answered(sockets[0], milliseconds(2000)));
+  BOOST_TEST(answered(sockets[1], milliseconds(2000)));
+  BOOST_TEST(response(sockets[0]) == "capped");
+  BOOST_TEST(response(sockets[1]) == "capped");
+  BOOST_TEST(!answered(sockets[2], milliseconds(300)));
+  BOOST_TEST(!answered(sockets[3], milliseconds(10)));
+
+  // Each connection closed lets one more in
+  sockets[0].close();
+  BOOST_TEST(answered(sockets[2], milliseconds(2000)));
+  BOOST_TEST(response(sockets[2]) == "capped");
+  BOOST_TEST(!answered(sockets[3], milliseconds(300)));
+  sockets[1].close();
+  BOOST_TEST(answered(sockets[3], milliseconds(2000)));
+  BOOST_TEST(response(sockets[3]) == "capped");
+}
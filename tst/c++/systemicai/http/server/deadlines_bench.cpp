@@ -0,0 +1,138 @@
+//
+// This file is included from tst/c++/systemicai/benchmarks.cpp
+//
+// Session deadlines.  First the cost of re-arming one of N armed deadlines on the timer wheel and on Asio timers,
+// then the CPU time the whole process spends per keep-alive request while N idle connections hold a deadline.
+//
+
+#include <random>
+
+#include <systemicai/http/server/benchmark.hpp>
+#include <systemicai/http/server/timer_wheel.h>
+
+namespace test::systemicai::http::server::benchmark {
+
+struct idle_entry : public timer_wheel::entry {
+  ~idle_entry() override {
+    cancel();
+  }
+
+protected:
+  void on_expire() override {
+  }
+};
+
+// Re-arm random deadlines among `n` armed ones for `seconds`, `rearm(i)` re-arms the i-th
+template<class Rearm, class Poll>
+result rearm_run(size_t n, double seconds, Rearm rearm, Poll poll) {
+  std::mt19937 random(n);
+  std::uniform_int_distribution<size_t> pick(0, n - 1);
+  result r;
+  auto const begin = clock::now();
+  auto const end = begin + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(seconds));
+  while(clock::now() < end) {
+    for(int i = 0; i < 1024; ++i)
+      rearm(pick(random));
+    poll();
+    r.count += 1024;
+  }
+  r.per_second = r.count / std::chrono::duration<double>(clock::now() - begin).count();
+  return r;
+}
+
+inline void deadlines_rearm(const options& o) {
+  report_header(std::cout, "re-arm one of");
+  for(size_t n : {1000, 10000, 100000}) {
+    {
+      net::io_context ioc;
+      auto& wheel = net::use_service<timer_wheel>(ioc);
+      std::vector<idle_entry> entries(n);
+      for(auto& e : entries) {
+        e.attach(wheel);
+        e.arm(std::chrono::seconds(30));
+      }
+      auto r = rearm_run(n, o.seconds / 2, [&](size_t i) { entries[i].arm(std::chrono::seconds(30)); }, [&] { ioc.poll(); });
+      report(std::cout, std::to_string(n) + " wheel", r);
+    }
+    {
+      // What basic_stream::expires_after does: a new wait, cancelling the pending one
+      net::io_context ioc;
+      std::vector<net::steady_timer> timers;
+      timers.reserve(n);
+      for(size_t i = 0; i < n; ++i) {
+        timers.emplace_back(ioc);
+        timers.back().expires_after(std::chrono::seconds(30));
+        timers.back().async_wait([](beast::error_code) {});
+      }
+      auto r = rearm_run(n, o.seconds / 2, [&](size_t i) {
+        timers[i].expires_after(std::chrono::seconds(30));
+        timers[i].async_wait([](beast::error_code) {});
+      }, [&] { ioc.poll(); });
+      report(std::cout, std::to_string(n) + " asio timers", r);
+      for(auto& t : timers)
+        t.cancel();
+      ioc.poll();
+    }
+  }
+}
+
+inline void deadlines_idle(const options& o) {
+  auto const root = make_document_root(512);
+  ssl::context ctx{ssl::context::tlsv12};
+  auto tr = make_settings(18150, 1, root);
+  tr.put("service.limit.accept_batch", 64);
+  pt::ptree l, plain;
+  plain.put("port", 18150);
+  plain.put("type", "plain");
+  l.push_back(std::make_pair("", plain));
+  tr.add_child("service.listeners", l);
+  running_service rs(tr, ctx);
+
+  // Each idle connection takes a descriptor on both ends
+  rlimit nofile{};
+  getrlimit(RLIMIT_NOFILE, &nofile);
+  auto const most = nofile.rlim_cur == RLIM_INFINITY ? 100000 : (nofile.rlim_cur - 256) / 2;
+
+  std::cout << std::left << std::setw(28) << "idle connections" << std::right << std::setw(14) << "requests/sec"
+            << std::setw(18) << "cpu us/request" << std::endl;
+  net::io_context ioc;
+  std::vector<tcp::socket> idle;
+  beast::flat_buffer buffer;
+  for(size_t n : {0, 1000, 5000, 20000}) {
+    if(n > most) {
+      std::cout << std::left << std::setw(28) << n << "skipped, the descriptor limit is " << nofile.rlim_cur << std::endl;
+      continue;
+    }
+    // Every idle connection made a request, so the server holds a deadline for it
+    while(idle.size() < n) {
+      idle.emplace_back(ioc);
+      idle.back().connect(rs.endpoint());
+      get(idle.back(), buffer, "/index.html");
+    }
+
+    auto const clients = 4;
+    std::vector<tcp::socket> sockets;
+    std::vector<beast::flat_buffer> buffers(clients);
+    for(int c = 0; c < clients; ++c) {
+      sockets.emplace_back(ioc);
+      sockets.back().connect(rs.endpoint());
+    }
+    auto const cpu = cpu_seconds();
+    auto r = measure(clients, o.seconds, [&](int c) {
+      return get(sockets[c], buffers[c], "/index.html");
+    });
+    auto const used = cpu_seconds() - cpu;
+    std::cout << std::left << std::setw(28) << n << std::right << std::fixed
+              << std::setw(14) << std::setprecision(0) << r.per_second
+              << std::setw(18) << std::setprecision(2) << (r.count == 0 ? 0.0 : used * 1e6 / r.count) << std::endl;
+  }
+}
+
+inline void deadlines(const options& o) {
+  deadlines_rearm(o);
+  deadlines_idle(o);
+}
+
+static registrar deadlines_registrar("deadlines", deadlines);
+
+}
@@ -0,0 +1,54 @@
+//
+// This file is included from tst/c++/systemicai/benchmarks.cpp
+//
+// Static assets: keep-alive clients GET a set of 256 small files in turn, each read from disk per request
+// (service.limit.file_cache 0) or served from the in-memory file cache.
+//
+
+#include <systemicai/http/server/benchmark.hpp>
+
+namespace test::systemicai::http::server::benchmark {
+
+inline void file_caching(const options& o) {
+  auto const root = std::filesystem::path(make_document_root(512)) / "assets";
+  std::filesystem::create_directories(root);
+  std::vector<std::string> targets;
+  for(int i = 0; i < 256; ++i) {
+    auto const name = "asset-" + std::to_string(i) + ".css";
+    std::ofstream(root / name, std::ios::trunc) << std::string(4096 + i * 16, 'c');
+    targets.push_back("/assets/" + name);
+  }
+  ssl::context ctx{ssl::context::tlsv12};
+
+  report_header(std::cout, "files");
+  for(size_t cache : {size_t(0), size_t(64) << 20}) {
+    auto tr = make_settings(18300, 2, root.parent_path().string());
+    tr.put("service.limit.file_cache", cache);
+    pt::ptree l, plain;
+    plain.put("port", 18300);
+    plain.put("type", "plain");
+    l.push_back(std::make_pair("", plain));
+    tr.add_child("service.listeners", l);
+    running_service rs(tr, ctx);
+
+    auto const clients = 4;
+    net::io_context ioc;
+    std::vector<tcp::socket> sockets;
+    std::vector<beast::flat_buffer> buffers(clients);
+    std::vector<size_t> next(clients);
+    for(int c = 0; c < clients; ++c) {
+      sockets.emplace_back(ioc);
+      sockets.back().connect(rs.endpoint());
+      next[c] = c * 64;
+    }
+    auto const r = measure(clients, o.seconds, [&](int c) {
+      auto const& target = targets[next[c]++ % targets.size()];
+      return get(sockets[c], buffers[c], target.c_str());
+    });
+    report(std::cout, cache == 0 ? "from disk" : "cached", r);
+  }
+}
+
+static registrar file_caching_registrar("file_cache", file_caching);
+
+}
@@ -0,0 +1,146 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+#include <systemicai/http/server/file_cache.h>
+#include <systemicai/http/server/fixture.hpp>
+#include <boost/test/included/unit_test.hpp>
+
+namespace test::systemicai::http::server::file_cache {
+
+using namespace ::systemicai::http::server;
+
+// Cache `path` as default_handle_request does
+inline std::shared_ptr<const ::systemicai::http::server::file_cache::entry> put(
+    ::systemicai::http::server::file_cache& cache, const std::filesystem::path& path) {
+  std::ifstream in(path, std::ios::binary);
+  std::string const content(std::istreambuf_iterator<char>{in}, {});
+  beast::error_code ec;
+  auto const file = open_file::open(path.c_str(), ec);
+  return cache.insert(path.string(), *file, content);
+}
+
+// Wait up to a second for the watcher to drop `path`
+inline bool dropped(::systemicai::http::server::file_cache& cache, const std::filesystem::path& path) {
+  for(int i = 0; i < 100; ++i) {
+    if(!cache.find(path.string()))
+      return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_file_cache )
+{
+  using namespace ::systemicai::http::server;
+  using test::systemicai::http::server::file_cache::dropped;
+  using test::systemicai::http::server::file_cache::put;
+  namespace fixture = test::systemicai::http::server::fixture;
+
+  auto const root = std::filesystem::temp_directory_path() / "afs-file-cache-test";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root / "sub");
+
+  // Written before a directory is watched, so no event of their writing drops them once cached
+  for(auto [name, size] : {std::pair{"a", 40}, {"b", 40}, {"sub/c", 40}, {"d", 40}, {"e", 30}, {"f", 30}, {"large", 70}})
+    std::ofstream(root / name, std::ios::binary | std::ios::trunc) << std::string(size, name[0]);
+
+  {
+    ::systemicai::http::server::file_cache cache;
+    // Disabled without a budget
+    BOOST_TEST(!cache.admits(0));
+    put(cache, root / "a");
+    BOOST_TEST(!cache.find((root / "a").string()));
+
+    cache.limit(100, 60);
+    BOOST_TEST(cache.admits(60));
+    BOOST_TEST(!cache.admits(61));
+    auto const a = put(cache, root / "a");
+    put(cache, root / "b");
+    BOOST_TEST(cache.find((root / "a").string()) == a);
+    BOOST_TEST(cache.stats().bytes == 80u);
+
+    // The hand passes over a, referenced since it was cached, and evicts b
+    put(cache, root / "sub" / "c");
+    BOOST_TEST(cache.find((root / "a").string()));
+    BOOST_TEST(!cache.find((root / "b").string()));
+    BOOST_TEST(cache.find((root / "sub" / "c").string()));
+    BOOST_TEST(cache.stats().evictions == 1u);
+    BOOST_TEST(cache.stats().files == 2u);
+
+    // Too large a file is served from the entry returned without being cached
+    auto const large = put(cache, root / "large");
+    BOOST_TEST(large->data.size() == 70u);
+    BOOST_TEST(!cache.find((root / "large").string()));
+
+    // A file changed since it was read is not cached either
+    beast::error_code ec;
+    auto const d = open_file::open((root / "d").c_str(), ec);
+    std::ofstream(root / "d", std::ios::trunc) << std::string(41, 'd');
+    cache.insert((root / "d").string(), *d, std::string(40, 'd'));
+    BOOST_TEST(!cache.find((root / "d").string()));
+
+    // Entries held by responses outlive their invalidation: writes, replacements and removals
+    std::ofstream(root / "a", std::ios::app) << "more";
+    BOOST_TEST(dropped(cache, root / "a"));
+    BOOST_TEST(a->data == std::string(40, 'a'));
+    std::ofstream(root / "sub" / "c.new") << "renamed";
+    std::filesystem::rename(root / "sub" / "c.new", root / "sub" / "c");
+    BOOST_TEST(dropped(cache, root / "sub" / "c"));
+    put(cache, root / "b");
+    std::filesystem::remove(root / "b");
+    BOOST_TEST(dropped(cache, root / "b"));
+    BOOST_TEST(cache.stats().invalidations == 3u);
+    BOOST_TEST(cache.stats().bytes == 0u);
+
+    // A smaller budget evicts down to it
+    put(cache, root / "e");
+    put(cache, root / "f");
+    BOOST_TEST(cache.stats().files == 2u);
+    cache.limit(40, 60);
+    BOOST_TEST(cache.stats().files == 1u);
+    cache.limit(0, 60);
+    BOOST_TEST(cache.stats().files == 0u);
+
+    // Nor is a file inserted while the budget shrinks below it cached over it
+    std::atomic<bool> done{false};
+    std::thread limiter([&] {
+      for(int i = 0; i < 2000; ++i)
+        cache.limit(i % 2 == 0 ? 0 : 100, 60);
+      done = true;
+    });
+    while(!done)
+      BOOST_TEST(put(cache, root / "e")->data.size() == 30u);
+    limiter.join();
+    cache.limit(0, 60);
+    BOOST_TEST(cache.stats().bytes == 0u);
+  }
+
+  // Served by the service from the global cache, then from the changed file
+  std::ofstream(root / "index.html", std::ios::trunc) << "cached";
+  auto tree = fixture::make_settings(root);
+  tree.put("service.limit.file_cache", 1048576);
+  fixture::running r(tree);
+  auto const request = [&r](beast::http::verb verb) { return fixture::request(r.endpoint(), verb, "/index.html"); };
+
+  auto const before = ::systemicai::http::server::file_cache::global().stats();
+  BOOST_TEST(request(beast::http::verb::get).body() == "cached");
+  BOOST_TEST(request(beast::http::verb::get).body() == "cached");
+  auto const head = request(beast::http::verb::head);
+  BOOST_TEST(head.result() == beast::http::status::ok);
+  BOOST_TEST(head[beast::http::field::content_length] == "6");
+  auto const after = ::systemicai::http::server::file_cache::global().stats();
+  BOOST_TEST(after.hits - before.hits == 2u);
+  BOOST_TEST(after.files == 1u);
+
+  std::ofstream(root / "index.html", std::ios::trunc) << "changed";
+  std::string body;
+  for(int i = 0; i < 100 && body != "changed"; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    body = request(beast::http::verb::get).body();
+  }
+  BOOST_TEST(body == "changed");
+}
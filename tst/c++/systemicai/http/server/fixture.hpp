@@ -0,0 +1,146 @@
+//
+// Shared helpers for the tests running a service, this file is included from the tests of
+// tst/c++/systemicai/unit_tests.cpp after server_test.cpp, which defines the dummy certificate
+//
+
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <initializer_list>
+#include <limits>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+#include <boost/test/included/unit_test.hpp>
+
+namespace test::systemicai::http::server::fixture {
+
+namespace srv = ::systemicai::http::server;
+
+// Add a listener of `type` on a port of the loopback interface picked by the system
+inline void add_listener(pt::ptree& tree, const std::string& type) {
+  pt::ptree listener;
+  listener.put("address", "127.0.0.1");
+  listener.put("port", 0);
+  listener.put("type", type);
+  if(auto l = tree.get_child_optional("service.listeners")) {
+    l->push_back(std::make_pair("", listener));
+    return;
+  }
+  pt::ptree l;
+  l.push_back(std::make_pair("", listener));
+  tree.add_child("service.listeners", l);
+}
+
+// Settings of a service of `root` with one listener of `type`, callers put their own overrides on top
+inline pt::ptree make_settings(const std::filesystem::path& root, const std::string& type = "plain") {
+  pt::ptree tree;
+  tree.put("service.log.level", "warning");
+  tree.put("document.root", root.string());
+  add_listener(tree, type);
+  return tree;
+}
+
+inline ssl::context& load_certificate(ssl::context& ctx) {
+  std::istringstream c(::test_systemicai_http::dummy_ssl_certificate);
+  std::istringstream k(::test_systemicai_http::dummy_ssl_key);
+  std::istringstream d(::test_systemicai_http::dummy_ssl_dh);
+  ::systemicai::common::certificate::load(ctx, c, k, d);
+  return ctx;
+}
+
+/**
+ * Runs a service for the lifetime of this object, constructed once every listener accepts.  `prepare` is called on
+ * the TLS context after the dummy certificate is loaded, before the service starts.
+ */
+class running {
+  srv::settings settings_;
+  ssl::context ctx_{ssl::context::tlsv12};
+  srv::service service_;
+  // Set once the service accepts, or to the exception start() threw
+  std::promise<void> started_;
+  std::thread thread_;
+
+public:
+  explicit running(const pt::ptree& tree, std::function<void(ssl::context&)> const& prepare = nullptr)
+          : settings_(tree)
+          , service_(settings_, load_certificate(ctx_)) {
+    if(prepare)
+      prepare(ctx_);
+    auto accepting = started_.get_future();
+    service_.on_started([this] { started_.set_value(); });
+    thread_ = std::thread([this] {
+      try {
+        service_.start();
+      } catch(...) {
+        started_.set_exception(std::current_exception());
+      }
+    });
+    try {
+      accepting.get();
+    } catch(...) {
+      thread_.join();
+      throw;
+    }
+  }
+
+  ~running() {
+    service_.stop();
+    thread_.join();
+  }
+
+  srv::service& service() {
+    return service_;
+  }
+
+  // The thread the service was started on, the first io thread
+  std::thread::id thread_id() const {
+    return thread_.get_id();
+  }
+
+  // The endpoint of the `i`th network listener
+  tcp::endpoint endpoint(std::size_t i = 0) const {
+    return service_.endpoints().at(i);
+  }
+};
+
+// Connect to `ep`, the service accepts from its start so a refusal fails the test
+inline tcp::socket connect(net::io_context& ioc, const tcp::endpoint& ep) {
+  tcp::socket sock(ioc);
+  beast::error_code ec;
+  sock.connect(ep, ec);
+  BOOST_REQUIRE_MESSAGE(!ec, ec.message());
+  return sock;
+}
+
+/**
+ * Send a `verb` request of `target` with `fields` on a new connection to `ep` and read its response, of any size
+ * @param fields Set on the request after its Host
+ */
+inline beast::http::response<beast::http::string_body> request(
+    const tcp::endpoint& ep, beast::http::verb verb, const std::string& target,
+    std::initializer_list<std::pair<beast::http::field, std::string>> fields = {}) {
+  net::io_context ioc;
+  auto sock = connect(ioc, ep);
+  beast::http::request<beast::http::empty_body> req{verb, target, 11};
+  req.set(beast::http::field::host, "localhost");
+  for(auto& [field, value] : fields)
+    req.set(field, value);
+  beast::error_code ec;
+  beast::http::write(sock, req, ec);
+  BOOST_REQUIRE(!ec);
+  beast::flat_buffer buffer;
+  beast::http::response_parser<beast::http::string_body> parser;
+  parser.body_limit(std::numeric_limits<std::uint64_t>::max());
+  parser.skip(verb == beast::http::verb::head);
+  beast::http::read(sock, buffer, parser, ec);
+  BOOST_REQUIRE_MESSAGE(!ec, ec.message());
+  return parser.release();
+}
+
+}
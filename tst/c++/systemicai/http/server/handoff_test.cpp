@@ -0,0 +1,114 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+#include <systemicai/http/server/fixture.hpp>
+#include <boost/test/included/unit_test.hpp>
+
+namespace test::systemicai::http::server::handoff {
+
+  using namespace ::systemicai::http::server;
+
+  // Connect, GET and close, returns the connect error or the failure of the exchange
+  inline beast::error_code get_and_close(net::io_context& ioc, const tcp::endpoint& ep, bool& refused) {
+    tcp::socket s(ioc);
+    beast::error_code ec;
+    s.connect(ep, ec);
+    refused = static_cast<bool>(ec);
+    if(ec)
+      return ec;
+    std::string req("GET / HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n");
+    net::write(s, net::buffer(req), ec);
+    if(ec)
+      return ec;
+    beast::flat_buffer buffer;
+    beast::http::response<beast::http::string_body> res;
+    beast::http::read(s, buffer, res, ec);
+    return ec;
+  }
+
+}
+
+// Restart a service while a client keeps connecting, no connection may be refused or dropped
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_handoff )
+{
+  namespace t = test::systemicai::http::server::handoff;
+  namespace fixture = test::systemicai::http::server::fixture;
+  using namespace ::systemicai::http::server;
+
+  auto const path = (std::filesystem::temp_directory_path() / "afs-handoff-test.sock").string();
+  auto tree = fixture::make_settings(std::filesystem::temp_directory_path());
+  tree.put("service.handoff.path", path);
+  tree.put("service.handoff.drain", 5);
+  settings const s(tree);
+  ssl::context ssl_ctx{ssl::context::tlsv12};
+
+  service old_service(s, ssl_ctx);
+  std::promise<void> old_started;
+  old_service.on_started([&old_started] { old_started.set_value(); });
+  std::thread old_thread([&] { old_service.start(); });
+  old_started.get_future().get();
+  auto const ep = old_service.endpoints().front();
+
+  // Only our user may connect to the handoff socket
+  BOOST_TEST(((std::filesystem::status(path).permissions() & std::filesystem::perms::all) ==
+              (std::filesystem::perms::owner_read | std::filesystem::perms::owner_write)));
+
+  std::atomic<bool> done(false);
+  std::atomic<size_t> requests(0);
+  size_t refusals = 0, failures = 0;
+  std::thread client([&] {
+    net::io_context ioc;
+    while(!done) {
+      bool r = false;
+      auto const ec = t::get_and_close(ioc, ep, r);
+      ++requests;
+      if(r)
+        ++refusals;
+      else if(ec)
+        ++failures;
+    }
+  });
+  auto const served = [&requests](size_t n) {
+    for(auto const until = requests + n; requests < until;)
+      std::this_thread::yield();
+  };
+
+  // The new process is configured with the port the old one got, so it takes over its socket
+  served(10);
+  auto next = tree;
+  next.put("service.listeners..port", ep.port());
+  settings const n(next);
+  BOOST_REQUIRE(n.listeners.front().port == ep.port());
+  service new_service(n, ssl_ctx);
+  std::promise<void> new_started;
+  new_service.on_started([&new_started] { new_started.set_value(); });
+  std::thread new_thread([&] { new_service.start(); });
+  new_started.get_future().get();
+
+  // The old service drains and returns from start() on its own, the new one keeps serving on the inherited socket
+  old_thread.join();
+  served(10);
+  done = true;
+  client.join();
+  BOOST_TEST(new_service.running());
+  new_service.stop();
+  new_thread.join();
+
+  BOOST_TEST(refusals == 0);
+  BOOST_TEST(failures == 0);
+
+  // A process that connects but never hands anything over is given up on
+  {
+    auto const silent = (std::filesystem::temp_directory_path() / "afs-handoff-silent.sock").string();
+    std::filesystem::remove(silent);
+    net::io_context ioc;
+    net::local::stream_protocol::acceptor acceptor(ioc, net::local::stream_protocol::endpoint(silent));
+    std::vector<handoff::descriptor> received;
+    auto const start = std::chrono::steady_clock::now();
+    BOOST_TEST(!handoff::request(silent, received, std::chrono::milliseconds(200)));
+    BOOST_TEST((std::chrono::steady_clock::now() - start < std::chrono::seconds(2)));
+    std::filesystem::remove(silent);
+  }
+}
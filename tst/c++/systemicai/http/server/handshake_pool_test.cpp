@@ -0,0 +1,95 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+#include <systemicai/http/server/handshake_pool.h>
+#include <systemicai/http/server/fixture.hpp>
+#include <boost/test/included/unit_test.hpp>
+
+namespace test::systemicai::http::server::handshake_pool {
+
+using namespace ::systemicai::http::server;
+
+// The thread of the last server handshake completed
+inline std::mutex handshake_mutex;
+inline std::thread::id handshake_thread;
+
+inline void on_info(const SSL*, int where, int) {
+  if(where & SSL_CB_HANDSHAKE_DONE) {
+    std::lock_guard<std::mutex> lg(handshake_mutex);
+    handshake_thread = std::this_thread::get_id();
+  }
+}
+
+inline std::thread::id last_handshake() {
+  std::lock_guard<std::mutex> lg(handshake_mutex);
+  return handshake_thread;
+}
+
+// Connect, handshake and GET twice on the connection
+inline void get_twice(const tcp::endpoint& ep) {
+  net::io_context ioc;
+  ssl::context ctx{ssl::context::tls_client};
+  beast::ssl_stream<beast::tcp_stream> stream(ioc, ctx);
+  beast::error_code ec;
+  beast::get_lowest_layer(stream).connect(ep, ec);
+  BOOST_REQUIRE(!ec);
+  stream.handshake(ssl::stream_base::client, ec);
+  BOOST_REQUIRE_MESSAGE(!ec, ec.message());
+  for(int i = 0; i < 2; ++i) {
+    std::string const request = "GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    net::write(stream, net::buffer(request), ec);
+    beast::flat_buffer buffer;
+    beast::http::response<beast::http::string_body> res;
+    beast::http::read(stream, buffer, res, ec);
+    BOOST_REQUIRE(!ec);
+    BOOST_TEST(res.body() == "pooled");
+  }
+  stream.shutdown(ec);
+}
+
+}
+
+// Handshakes run on the pool, the requests that follow on the io thread, for TLS and auto listeners alike
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_handshake_pool )
+{
+  using namespace ::systemicai::http::server;
+  using namespace test::systemicai::http::server::handshake_pool;
+  namespace fixture = test::systemicai::http::server::fixture;
+
+  auto const root = std::filesystem::temp_directory_path() / "afs-handshake-pool-test";
+  std::filesystem::create_directories(root);
+  std::ofstream(root / "index.html", std::ios::trunc) << "pooled";
+
+  for(std::size_t threads : {0, 2}) {
+    auto tree = fixture::make_settings(root, "tls");
+    fixture::add_listener(tree, "auto");
+    tree.put("service.thread.io", 1);
+    tree.put("service.timeout.header", 300);
+    tree.put("service.ssl.handshake_threads", threads);
+    fixture::running r(tree, [](ssl::context& ctx) { SSL_CTX_set_info_callback(ctx.native_handle(), &on_info); });
+
+    for(std::size_t i : {0, 1}) {
+      get_twice(r.endpoint(i));
+      BOOST_TEST((last_handshake() == r.thread_id()) == (threads == 0));
+    }
+
+    // A client that never says hello is still timed out
+    net::io_context ioc;
+    tcp::socket silent(ioc);
+    silent.connect(r.endpoint());
+    char c;
+    beast::error_code ec;
+    auto const start = std::chrono::steady_clock::now();
+    silent.read_some(net::buffer(&c, 1), ec);
+    BOOST_TEST(ec == net::error::eof);
+    BOOST_TEST((std::chrono::steady_clock::now() - start < std::chrono::seconds(2)));
+
+    // The service stops with handshakes waiting for their ClientHello
+    std::vector<tcp::socket> waiting;
+    for(std::size_t i : {0, 1, 0, 1})
+      waiting.push_back(fixture::connect(ioc, r.endpoint(i)));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+}
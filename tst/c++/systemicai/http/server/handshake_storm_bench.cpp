@@ -0,0 +1,104 @@
+//
+// This file is included from tst/c++/systemicai/benchmarks.cpp
+//
+// Latency of established TLS connections while new clients storm the server with full handshakes.  Four keep-alive
+// connections GET a small file in a loop, and the p99 of their requests is compared without a storm, with the storm
+// handshaking on the io threads, and with it handshaking on a pool of service.ssl.handshake_threads.  The storm
+// rate is reported with each run.
+//
+
+#include <systemicai/http/server/benchmark.hpp>
+
+namespace test::systemicai::http::server::benchmark {
+
+// Full handshakes on `clients` threads until destroyed
+class handshake_storm {
+  std::atomic<bool> done_{false};
+  std::atomic<size_t> count_{0};
+  std::vector<std::thread> threads_;
+
+public:
+  handshake_storm(int clients, const tcp::endpoint& ep) {
+    for(int c = 0; c < clients; ++c)
+      threads_.emplace_back([this, ep] {
+        net::io_context ioc;
+        ssl::context ctx{ssl::context::tls_client};
+        while(!done_)
+          if(handshake_and_close(ioc, ctx, ep))
+            ++count_;
+      });
+  }
+
+  ~handshake_storm() {
+    done_ = true;
+    for(auto& t : threads_)
+      t.join();
+  }
+
+  size_t count() const {
+    return count_;
+  }
+};
+
+// A keep-alive TLS connection of its own io_context
+struct established {
+  net::io_context ioc;
+  ssl::context ctx{ssl::context::tls_client};
+  beast::ssl_stream<tcp::socket> stream{ioc, ctx};
+  beast::flat_buffer buffer;
+
+  explicit established(const tcp::endpoint& ep) {
+    stream.next_layer().connect(ep);
+    stream.handshake(ssl::stream_base::client);
+  }
+};
+
+inline void handshake_storm_latency(const options& o) {
+  auto const root = make_document_root(512);
+
+  struct run {
+    const char* name;
+    int storm;
+    size_t pool;
+  };
+  static const run runs[] = {
+          {"no storm", 0, 0},
+          {"storm, io threads", 8, 0},
+          {"storm, pool of 2", 8, 2}};
+
+  report_header(std::cout, "established GETs");
+  for(auto& r : runs) {
+    auto tr = make_settings(18250, 2, root);
+    tr.put("service.ssl.session_cache", 0);
+    tr.put("service.ssl.tickets", false);
+    tr.put("service.ssl.handshake_threads", r.pool);
+    pt::ptree l, tls;
+    tls.put("address", "127.0.0.1");
+    tls.put("port", 18250);
+    tls.put("type", "tls");
+    l.push_back(std::make_pair("", tls));
+    tr.add_child("service.listeners", l);
+    ssl::context ctx{ssl::context::tls_server};
+    running_service rs(tr, load_certificate(ctx, false));
+
+    auto const ep = rs.endpoint();
+    std::vector<std::unique_ptr<established>> connections;
+    for(int c = 0; c < 4; ++c)
+      connections.push_back(std::make_unique<established>(ep));
+
+    handshake_storm storm(r.storm, ep);
+    auto const begin = clock::now();
+    auto const res = measure(4, o.seconds, [&connections](int c) {
+      auto& e = *connections[c];
+      return get(e.stream, e.buffer, "/index.html");
+    });
+    auto const rate = storm.count() / std::chrono::duration<double>(clock::now() - begin).count();
+    report(std::cout, r.name, res);
+    if(r.storm != 0)
+      std::cout << "  " << std::fixed << std::setprecision(0) << rate << " handshakes/sec" << std::endl;
+  }
+}
+
+static registrar handshake_storm_registrar("handshake_storm", handshake_storm_latency);
+
+}
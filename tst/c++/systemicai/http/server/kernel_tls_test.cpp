@@ -0,0 +1,169 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+#include <systemicai/http/server/kernel_tls.h>
+#include <systemicai/http/server/fixture.hpp>
+#include <boost/test/included/unit_test.hpp>
+
+namespace test::systemicai::http::server::kernel_tls {
+
+using namespace ::systemicai::http::server;
+
+/**
+ * Encrypt `data` as the next application data record of the sender `k` describes, as the kernel would.  A peer
+ * decrypting it proves the key, nonce and sequence number right.
+ */
+inline std::string seal(const ::systemicai::http::server::kernel_tls::send_key& k, const std::string& data) {
+  auto const tls13 = k.version == TLS1_3_VERSION;
+  std::string const plain = tls13 ? data + '\x17' : data;
+  std::string const explicit_nonce = tls13 ? "" : std::string(k.iv.begin(), k.iv.end());
+  auto const length = explicit_nonce.size() + plain.size() + 16;
+  std::string header = {'\x17', '\x03', '\x03', char(length >> 8), char(length & 0xff)};
+
+  std::array<unsigned char, 12> nonce;
+  std::copy(k.salt.begin(), k.salt.end(), nonce.begin());
+  std::copy(k.iv.begin(), k.iv.end(), nonce.begin() + 4);
+  std::string aad = header;
+  if(tls13) {
+    for(size_t i = 0; i < 8; ++i)
+      nonce[4 + i] ^= k.seq[i];
+  } else {
+    aad = std::string(k.seq.begin(), k.seq.end()) + "\x17\x03\x03" + char(plain.size() >> 8) + char(plain.size() & 0xff);
+  }
+
+  auto const ctx = EVP_CIPHER_CTX_new();
+  std::string out(plain.size(), 0);
+  unsigned char tag[16];
+  int n = 0;
+  EVP_EncryptInit_ex(ctx, k.key_size == 16 ? EVP_aes_128_gcm() : EVP_aes_256_gcm(), nullptr, k.key.data(), nonce.data());
+  EVP_EncryptUpdate(ctx, nullptr, &n, reinterpret_cast<const unsigned char*>(aad.data()), int(aad.size()));
+  EVP_EncryptUpdate(ctx, reinterpret_cast<unsigned char*>(out.data()), &n, reinterpret_cast<const unsigned char*>(plain.data()), int(plain.size()));
+  EVP_EncryptFinal_ex(ctx, nullptr, &n);
+  EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, 16, tag);
+  EVP_CIPHER_CTX_free(ctx);
+  return header + explicit_nonce + out + std::string(reinterpret_cast<char*>(tag), 16);
+}
+
+// Handshake a client limited to `version` and `cipher` with a server prepared for kTLS, and seal a record for it
+inline bool derive_and_seal(int version, const char* cipher) {
+  net::io_context ioc;
+  ssl::context server_ctx{ssl::context::tls_server};
+  test::systemicai::http::server::fixture::load_certificate(server_ctx);
+  ::systemicai::http::server::kernel_tls::prepare(server_ctx);
+  ssl::context client_ctx{ssl::context::tls_client};
+  SSL_CTX_set_min_proto_version(client_ctx.native_handle(), version);
+  SSL_CTX_set_max_proto_version(client_ctx.native_handle(), version);
+  if(version == TLS1_3_VERSION)
+    SSL_CTX_set_ciphersuites(client_ctx.native_handle(), cipher);
+  else
+    SSL_CTX_set_cipher_list(client_ctx.native_handle(), cipher);
+
+  tcp::acceptor acceptor(ioc, tcp::endpoint(net::ip::make_address("127.0.0.1"), 0));
+  beast::ssl_stream<tcp::socket> server(ioc, server_ctx);
+  beast::ssl_stream<tcp::socket> client(ioc, client_ctx);
+  client.next_layer().connect(acceptor.local_endpoint());
+  acceptor.accept(server.next_layer());
+  beast::error_code client_ec;
+  std::thread t([&] { client.handshake(ssl::stream_base::client, client_ec); });
+  server.handshake(ssl::stream_base::server);
+  t.join();
+  BOOST_REQUIRE(!client_ec);
+
+  ::systemicai::http::server::kernel_tls::send_key k;
+  if(!::systemicai::http::server::kernel_tls::derive(server.native_handle(), k))
+    return false;
+  BOOST_TEST(k.version == version);
+  net::write(server.next_layer(), net::buffer(seal(k, "sealed by the kernel")));
+  std::string got(64, 0);
+  beast::error_code ec;
+  got.resize(client.read_some(net::buffer(got), ec));
+  BOOST_TEST(!ec);
+  BOOST_TEST(got == "sealed by the kernel");
+  return true;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_kernel_tls )
+{
+  using namespace ::systemicai::http::server;
+  using test::systemicai::http::server::kernel_tls::derive_and_seal;
+
+  // The derived keys and sequence numbers encrypt records the client accepts, after the TLS 1.3 tickets too
+  BOOST_TEST(derive_and_seal(TLS1_2_VERSION, "ECDHE-RSA-AES128-GCM-SHA256"));
+  BOOST_TEST(derive_and_seal(TLS1_2_VERSION, "ECDHE-RSA-AES256-GCM-SHA384"));
+  BOOST_TEST(derive_and_seal(TLS1_3_VERSION, "TLS_AES_128_GCM_SHA256"));
+  BOOST_TEST(derive_and_seal(TLS1_3_VERSION, "TLS_AES_256_GCM_SHA384"));
+  // Other ciphers stay in user space
+  BOOST_TEST(!derive_and_seal(TLS1_2_VERSION, "ECDHE-RSA-CHACHA20-POLY1305"));
+
+  // Sessions are served whether the kernel takes them or not
+  auto const root = std::filesystem::temp_directory_path() / "afs-kernel-tls-test";
+  std::filesystem::create_directories(root);
+  std::string const content(300000, 'k');
+  std::ofstream(root / "index.html", std::ios::trunc) << content;
+  auto tree = test::systemicai::http::server::fixture::make_settings(root, "tls");
+  tree.put("service.ssl.ktls", true);
+  test::systemicai::http::server::fixture::running r(tree);
+  auto const before = kernel_tls::sessions();
+  for(auto version : {TLS1_2_VERSION, TLS1_3_VERSION}) {
+    net::io_context ioc;
+    ssl::context ctx{ssl::context::tls_client};
+    SSL_CTX_set_max_proto_version(ctx.native_handle(), version);
+    beast::ssl_stream<beast::tcp_stream> stream(ioc, ctx);
+    beast::error_code ec;
+    beast::get_lowest_layer(stream).connect(r.endpoint());
+    stream.handshake(ssl::stream_base::client);
+    for(auto close : {false, true}) {
+      std::string const request = std::string("GET /index.html HTTP/1.1\r\nHost: localhost\r\n") +
+                                  (close ? "Connection: close\r\n" : "") + "\r\n";
+      net::write(stream, net::buffer(request));
+      beast::flat_buffer buffer;
+      beast::http::response_parser<beast::http::string_body> parser;
+      parser.body_limit(content.size());
+      beast::http::read(stream, buffer, parser, ec);
+      BOOST_REQUIRE(!ec);
+      BOOST_TEST(parser.get().body() == content);
+    }
+    // And closed with a close_notify
+    char c;
+    stream.read_some(net::buffer(&c, 1), ec);
+    BOOST_TEST(ec == net::error::eof);
+  }
+  auto const after = kernel_tls::sessions();
+  BOOST_TEST(after.enabled + after.fallback - before.enabled - before.fallback == 2u);
+  BOOST_TEST_MESSAGE("Kernel TLS sessions: " << after.enabled - before.enabled << ", in user space: " << after.fallback - before.fallback);
+
+  // A session given to the kernel refuses a WebSocket upgrade with a response, and closes the connection rather than
+  // answer a KeyUpdate through OpenSSL.  One left in user space does both.
+  for(auto update : {false, true}) {
+    net::io_context ioc;
+    ssl::context ctx{ssl::context::tls_client};
+    SSL_CTX_set_min_proto_version(ctx.native_handle(), TLS1_3_VERSION);
+    beast::ssl_stream<beast::tcp_stream> stream(ioc, ctx);
+    beast::get_lowest_layer(stream).connect(r.endpoint());
+    auto const enabled = kernel_tls::sessions().enabled;
+    stream.handshake(ssl::stream_base::client);
+    if(update)
+      BOOST_REQUIRE(SSL_key_update(stream.native_handle(), SSL_KEY_UPDATE_REQUESTED) == 1);
+    std::string const request = update
+            ? "GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n"
+            : "GET / HTTP/1.1\r\nHost: localhost\r\nConnection: Upgrade\r\nUpgrade: websocket\r\n"
+              "Sec-WebSocket-Version: 13\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n\r\n";
+    net::write(stream, net::buffer(request));
+    beast::flat_buffer buffer;
+    beast::http::response_parser<beast::http::string_body> parser;
+    parser.body_limit(content.size());
+    beast::error_code ec;
+    beast::http::read(stream, buffer, parser, ec);
+    auto const ktls = kernel_tls::sessions().enabled != enabled;
+    if(update) {
+      BOOST_TEST(bool(ec) == ktls);
+      continue;
+    }
+    BOOST_REQUIRE(!ec);
+    BOOST_TEST(parser.get().result() == (ktls ? beast::http::status::not_implemented : beast::http::status::switching_protocols));
+  }
+}
@@ -0,0 +1,108 @@
+//
+// This file is included from tst/c++/systemicai/benchmarks.cpp
+//
+// CPU per GB served: two keep-alive clients GET an 8 MiB file over loopback, from a plain listener, a TLS listener
+// encrypting with OpenSSL and one with service.ssl.ktls, which sends the file with sendfile once the kernel holds
+// the key.  The server's CPU is the process's less that of the client threads.  On a kernel without the "tls"
+// module the kTLS run falls back to OpenSSL, and says so.
+//
+
+#include <systemicai/http/server/benchmark.hpp>
+
+namespace test::systemicai::http::server::benchmark {
+
+// GET `target` on a keep-alive connection and read a response of up to `size` bytes
+template<class Stream>
+bool get_large(Stream& s, beast::flat_buffer& buffer, const char* target, std::uint64_t size) {
+  beast::error_code ec;
+  std::string req = std::string("GET ") + target + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  net::write(s, net::buffer(req), ec);
+  if(ec)
+    return false;
+  beast::http::response_parser<beast::http::string_body> parser;
+  parser.body_limit(size);
+  beast::http::read(s, buffer, parser, ec);
+  return !ec && parser.get().result() == beast::http::status::ok;
+}
+
+inline void ktls(const options& o) {
+  std::uint64_t const file_size = 8 << 20;
+  auto const root = make_document_root(512);
+  std::ofstream(std::filesystem::path(root) / "large.bin", std::ios::trunc) << std::string(file_size, 'k');
+
+  struct run {
+    const char* name;
+    const char* type;
+    bool ktls;
+  };
+  static const run runs[] = {
+          {"plain", "plain", false},
+          {"TLS, OpenSSL", "tls", false},
+          {"TLS, kTLS", "tls", true}};
+
+  std::cout << std::left << std::setw(28) << "8 MiB GETs" << std::right << std::setw(14) << "GB/sec"
+            << std::setw(16) << "CPU sec/GB" << std::endl;
+  for(auto& r : runs) {
+    auto tr = make_settings(18270, 1, root);
+    tr.put("service.ssl.ktls", r.ktls);
+    pt::ptree l, ls;
+    ls.put("address", "127.0.0.1");
+    ls.put("port", 18270);
+    ls.put("type", r.type);
+    l.push_back(std::make_pair("", ls));
+    tr.add_child("service.listeners", l);
+    ssl::context ctx{ssl::context::tls_server};
+    running_service rs(tr, load_certificate(ctx, false));
+    auto const ep = rs.endpoint();
+    auto const before = kernel_tls::sessions();
+
+    std::atomic<double> client_cpu{0};
+    auto const add = [&client_cpu](double t) {
+      auto v = client_cpu.load();
+      while(!client_cpu.compare_exchange_weak(v, v + t))
+        ;
+    };
+    auto const cpu = cpu_seconds();
+    result res;
+    if(std::string(r.type) == "plain") {
+      res = measure(2, o.seconds, [&](int) {
+        thread_local net::io_context ioc;
+        thread_local tcp::socket s(ioc);
+        thread_local beast::flat_buffer buffer;
+        auto const t0 = thread_cpu_seconds();
+        if(!s.is_open())
+          s.connect(ep);
+        auto const ok = get_large(s, buffer, "/large.bin", file_size);
+        add(thread_cpu_seconds() - t0);
+        return ok;
+      });
+    } else {
+      res = measure(2, o.seconds, [&](int) {
+        thread_local net::io_context ioc;
+        thread_local ssl::context client{ssl::context::tls_client};
+        thread_local std::unique_ptr<beast::ssl_stream<tcp::socket>> s;
+        thread_local beast::flat_buffer buffer;
+        auto const t0 = thread_cpu_seconds();
+        if(!s) {
+          s = std::make_unique<beast::ssl_stream<tcp::socket>>(ioc, client);
+          s->next_layer().connect(ep);
+          s->handshake(ssl::stream_base::client);
+        }
+        auto const ok = get_large(*s, buffer, "/large.bin", file_size);
+        add(thread_cpu_seconds() - t0);
+        return ok;
+      });
+    }
+    auto const server_cpu = cpu_seconds() - cpu - client_cpu.load();
+    auto const gb = double(res.count) * file_size / 1e9;
+    std::cout << std::left << std::setw(28) << r.name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(14) << gb / o.seconds << std::setw(16) << (gb > 0 ? server_cpu / gb : 0.0);
+    if(r.ktls && kernel_tls::sessions().enabled == before.enabled)
+      std::cout << "  (no kernel TLS, served by OpenSSL)";
+    std::cout << std::endl;
+  }
+}
+
+static registrar ktls_registrar("ktls", ktls);
+
+}
@@ -0,0 +1,40 @@
+//
+// This file is included from tst/c++/systemicai/benchmarks.cpp
+//
+// Compares the accept-to-response latency of a plain listener, which hands the connection straight to
+// plain_http_session, with an auto listener, which runs detect_session first.
+//
+
+#include <systemicai/http/server/benchmark.hpp>
+
+namespace test::systemicai::http::server::benchmark {
+
+inline void listeners(const options& o) {
+  auto const root = make_document_root(512);
+  ssl::context ctx{ssl::context::tlsv12};
+
+  auto tr = make_settings(18090, 1, root);
+  pt::ptree l, plain, detect;
+  plain.put("port", 18090);
+  plain.put("type", "plain");
+  detect.put("port", 18091);
+  detect.put("type", "auto");
+  l.push_back(std::make_pair("", plain));
+  l.push_back(std::make_pair("", detect));
+  tr.add_child("service.listeners", l);
+  running_service rs(tr, ctx);
+
+  report_header(std::cout, "listener type");
+  for(auto& ls : rs.config().listeners) {
+    tcp::endpoint const ep(net::ip::make_address(ls.address), ls.port);
+    auto const r = measure(2, o.seconds, [&ep](int) {
+      thread_local net::io_context ioc;
+      return get_and_close<tcp>(ioc, ep, "/index.html");
+    });
+    report(std::cout, ls.type, r);
+  }
+}
+
+static registrar listeners_registrar("listeners", listeners);
+
+}
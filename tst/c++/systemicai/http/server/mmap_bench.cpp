@@ -0,0 +1,65 @@
+//
+// This file is included from tst/c++/systemicai/benchmarks.cpp
+//
+// Mapped assets: keep-alive TLS clients GET a 1 MiB asset, read into a buffer per chunk (service.limit.mmap_file 0)
+// or encrypted straight from its shared mapping.  Throughput and the server's CPU time per GB.
+//
+
+#include <systemicai/http/server/benchmark.hpp>
+
+namespace test::systemicai::http::server::benchmark {
+
+inline void mapped_files(const options& o) {
+  std::uint64_t const file_size = 1 << 20;
+  auto const root = make_document_root(512);
+  std::ofstream(std::filesystem::path(root) / "asset.bin", std::ios::trunc) << std::string(file_size, 'm');
+
+  std::cout << std::left << std::setw(28) << "1 MiB GETs over TLS" << std::right << std::setw(14) << "GB/sec"
+            << std::setw(16) << "CPU sec/GB" << std::endl;
+  for(size_t mmap : {size_t(0), size_t(16) << 20}) {
+    auto tr = make_settings(18370, 1, root);
+    tr.put("service.limit.open_files", 1024);
+    tr.put("service.limit.mmap_file", mmap);
+    pt::ptree l, ls;
+    ls.put("address", "127.0.0.1");
+    ls.put("port", 18370);
+    ls.put("type", "tls");
+    l.push_back(std::make_pair("", ls));
+    tr.add_child("service.listeners", l);
+    ssl::context ctx{ssl::context::tls_server};
+    running_service rs(tr, load_certificate(ctx, false));
+    auto const ep = rs.endpoint();
+
+    std::atomic<double> client_cpu{0};
+    auto const add = [&client_cpu](double t) {
+      auto v = client_cpu.load();
+      while(!client_cpu.compare_exchange_weak(v, v + t))
+        ;
+    };
+    auto const cpu = cpu_seconds();
+    auto const res = measure(2, o.seconds, [&](int) {
+      thread_local net::io_context ioc;
+      thread_local ssl::context client{ssl::context::tls_client};
+      thread_local std::unique_ptr<beast::ssl_stream<tcp::socket>> s;
+      thread_local beast::flat_buffer buffer;
+      auto const t0 = thread_cpu_seconds();
+      if(!s) {
+        s = std::make_unique<beast::ssl_stream<tcp::socket>>(ioc, client);
+        s->next_layer().connect(ep);
+        s->handshake(ssl::stream_base::client);
+      }
+      auto const ok = get_large(*s, buffer, "/asset.bin", file_size);
+      add(thread_cpu_seconds() - t0);
+      return ok;
+    });
+    auto const server_cpu = cpu_seconds() - cpu - client_cpu.load();
+    auto const gb = double(res.count) * file_size / 1e9;
+    std::cout << std::left << std::setw(28) << (mmap == 0 ? "read per chunk" : "shared mapping") << std::right
+              << std::fixed << std::setprecision(2) << std::setw(14) << gb / o.seconds << std::setw(16)
+              << (gb > 0 ? server_cpu / gb : 0.0) << std::endl;
+  }
+}
+
+static registrar mapped_files_registrar("mmap", mapped_files);
+
+}
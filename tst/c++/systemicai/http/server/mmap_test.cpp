@@ -0,0 +1,101 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+#include <systemicai/http/server/mmap_body.h>
+#include <systemicai/http/server/fixture.hpp>
+#include <boost/test/included/unit_test.hpp>
+
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_mmap_body )
+{
+  using namespace ::systemicai::http::server;
+  namespace fixture = test::systemicai::http::server::fixture;
+
+  auto const root = std::filesystem::temp_directory_path() / "afs-mmap-test";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root);
+  std::string content(300000, '\0');
+  for(std::size_t i = 0; i < content.size(); ++i)
+    content[i] = char('A' + i % 23);
+  std::ofstream(root / "asset.bin", std::ios::binary | std::ios::trunc) << content;
+  std::ofstream(root / "large.bin", std::ios::binary | std::ios::trunc) << content << content;
+  std::ofstream(root / "empty.bin", std::ios::binary | std::ios::trunc);
+
+  {
+    pt::ptree limits;
+    limits.put("service.limit.mmap_file", 300000);
+    settings const s(limits);
+
+    // One mapping per open file, shared by its bodies
+    beast::error_code ec;
+    auto const file = open_file::open((root / "asset.bin").c_str(), ec);
+    auto const first = mmap_body::map(*file, ec);
+    BOOST_REQUIRE(!ec);
+    BOOST_TEST(mmap_body::map(*file, ec) == first);
+    BOOST_TEST(std::string_view(first->data, first->size) == content);
+
+    // Handed to the write as the mapped pages
+    mmap_body::value_type body;
+    body.assign(file, 1000, 50, s, ec);
+    BOOST_REQUIRE(!ec);
+    BOOST_TEST(body.mapping == first);
+    beast::http::response<mmap_body> res{beast::http::status::ok, 11, std::move(body)};
+    mmap_body::writer w(res.base(), res.body());
+    auto const buffers = w.get(ec);
+    BOOST_REQUIRE(buffers);
+    BOOST_TEST(buffers->first.data() == static_cast<const void*>(first->data + 1000));
+    BOOST_TEST(buffers->first.size() == 50u);
+    BOOST_TEST(!buffers->second);
+
+    // As file_body is opened, for custom handlers
+    mmap_body::value_type opened;
+    opened.open((root / "empty.bin").c_str(), s, ec);
+    BOOST_TEST(!ec);
+    BOOST_TEST(opened.size == 0u);
+    opened.open((root / "missing.bin").c_str(), s, ec);
+    BOOST_TEST(ec == beast::errc::no_such_file_or_directory);
+
+    // Over the threshold, or with mapping off, the file is left to be streamed
+    mmap_body::value_type refused;
+    refused.open((root / "large.bin").c_str(), s, ec);
+    BOOST_TEST(ec == beast::errc::file_too_large);
+    BOOST_TEST(!refused.mapping);
+    refused.open((root / "asset.bin").c_str(), settings(pt::ptree()), ec);
+    BOOST_TEST(ec == beast::errc::file_too_large);
+    BOOST_TEST(!refused.mapping);
+  }
+
+  // Served by the default handler from the mapping of the cached open file, over the threshold streamed
+  auto tree = fixture::make_settings(root);
+  tree.put("service.sendfile", false);
+  tree.put("service.limit.open_files", 16);
+  tree.put("service.limit.open_file_ttl", 60000);
+  tree.put("service.limit.mmap_file", 400000);
+  fixture::running r(tree);
+  auto const request = [&r](const char* target, const char* range) {
+    if(range == nullptr)
+      return fixture::request(r.endpoint(), beast::http::verb::get, target);
+    return fixture::request(r.endpoint(), beast::http::verb::get, target, {{beast::http::field::range, range}});
+  };
+
+  BOOST_TEST(request("/asset.bin", nullptr).body() == content);
+  beast::error_code ec;
+  auto const asset = open_file_cache::global().open((root / "asset.bin").c_str(), ec);
+  BOOST_REQUIRE(asset->mapping);
+  auto const mapped = asset->mapping;
+  BOOST_TEST(request("/asset.bin", "bytes=10-19").body() == content.substr(10, 10));
+  BOOST_TEST(request("/asset.bin", "bytes=0-0,-1").body().find(content.substr(content.size() - 1)) != std::string::npos);
+  BOOST_TEST(asset->mapping == mapped);
+
+  BOOST_TEST(request("/large.bin", nullptr).body() == content + content);
+  BOOST_TEST(!open_file_cache::global().open((root / "large.bin").c_str(), ec)->mapping);
+  BOOST_TEST(request("/empty.bin", nullptr).body().empty());
+
+  // Nor mapped for a session sending it with sendfile
+  std::ofstream(root / "sent.bin", std::ios::binary | std::ios::trunc) << content;
+  tree.put("service.sendfile", true);
+  fixture::running sending(tree);
+  BOOST_TEST(fixture::request(sending.endpoint(), beast::http::verb::get, "/sent.bin").body() == content);
+  BOOST_TEST(!open_file_cache::global().open((root / "sent.bin").c_str(), ec)->mapping);
+}
@@ -0,0 +1,103 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+#include <systemicai/http/server/open_file_cache.h>
+#include <systemicai/http/server/fixture.hpp>
+#include <boost/test/included/unit_test.hpp>
+
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_open_file_cache )
+{
+  using namespace ::systemicai::http::server;
+  namespace fixture = test::systemicai::http::server::fixture;
+
+  auto const root = std::filesystem::temp_directory_path() / "afs-open-file-cache-test";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root / "dir");
+  for(auto name : {"a", "b", "c"})
+    std::ofstream(root / name, std::ios::trunc) << name;
+  auto const path = [&root](const char* name) { return (root / name).string(); };
+
+  ::systemicai::http::server::open_file_cache cache;
+  beast::error_code ec;
+
+  // Disabled, every lookup opens the file
+  auto const first = cache.open(path("a").c_str(), ec);
+  BOOST_TEST(!ec);
+  BOOST_TEST(first->size == 1u);
+  BOOST_TEST(cache.open(path("a").c_str(), ec) != first);
+  BOOST_TEST(cache.stats().files == 0u);
+
+  // Retry `done` until it holds or 5 s have passed, entries expire after 100 ms
+  auto const poll = [](auto done) {
+    auto const deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while(!done() && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  };
+
+  cache.limit(2, std::chrono::milliseconds(100));
+  auto const a = cache.open(path("a").c_str(), ec);
+  BOOST_TEST(cache.open(path("a").c_str(), ec) == a);
+  BOOST_TEST(cache.stats().hits == 1u);
+  BOOST_TEST(cache.stats().misses == 1u);
+
+  // Missing files are remembered for the time to live, directories are not files
+  BOOST_TEST(!cache.open(path("missing").c_str(), ec));
+  BOOST_TEST(ec == beast::errc::no_such_file_or_directory);
+  std::ofstream(root / "missing", std::ios::trunc) << "created";
+  BOOST_TEST(!cache.open(path("missing").c_str(), ec));
+  BOOST_TEST(ec == beast::errc::no_such_file_or_directory);
+  BOOST_TEST(cache.stats().hits == 2u);
+  BOOST_TEST(!cache.open(path("dir").c_str(), ec));
+  BOOST_TEST(ec == beast::errc::is_a_directory);
+
+  // Once expired an unchanged file keeps its descriptor, a changed one is opened again
+  std::shared_ptr<const open_file> created;
+  poll([&] { return (created = cache.open(path("missing").c_str(), ec)) != nullptr; });
+  BOOST_TEST((created && created->size == 7u));
+  BOOST_TEST(cache.open(path("a").c_str(), ec) == a);
+  BOOST_TEST(cache.stats().revalidations == 2u);
+  std::ofstream(root / "a", std::ios::trunc) << "changed";
+  std::shared_ptr<const open_file> changed;
+  poll([&] { return (changed = cache.open(path("a").c_str(), ec)) != a; });
+  BOOST_TEST(changed != a);
+  BOOST_TEST((changed && changed->size == 7u));
+  // Responses holding the previous descriptor still read from it
+  char c;
+  BOOST_TEST(::pread(a->fd, &c, 1, 0) == 1);
+
+  // The least recently used is evicted
+  cache.open(path("b").c_str(), ec);
+  cache.open(path("a").c_str(), ec);
+  cache.open(path("c").c_str(), ec);
+  BOOST_TEST(cache.stats().files == 2u);
+  auto const misses = cache.stats().misses;
+  cache.open(path("a").c_str(), ec);
+  BOOST_TEST(cache.stats().misses == misses);
+  cache.open(path("b").c_str(), ec);
+  BOOST_TEST(cache.stats().misses == misses + 1);
+  cache.limit(0, std::chrono::milliseconds(100));
+  BOOST_TEST(cache.stats().files == 0u);
+
+  // HEAD and 404 responses of the service come from its cache
+  std::ofstream(root / "index.html", std::ios::trunc) << "indexed";
+  auto tree = fixture::make_settings(root);
+  tree.put("service.limit.open_files", 16);
+  tree.put("service.limit.open_file_ttl", 60000);
+  fixture::running r(tree);
+  auto const request = [&r](beast::http::verb verb) { return fixture::request(r.endpoint(), verb, "/index.html"); };
+
+  auto const before = ::systemicai::http::server::open_file_cache::global().stats();
+  for(int i = 0; i < 2; ++i) {
+    auto const head = request(beast::http::verb::head);
+    BOOST_TEST(head[beast::http::field::content_length] == "7");
+    BOOST_TEST(request(beast::http::verb::get).body() == "indexed");
+  }
+  std::filesystem::remove(root / "index.html");
+  auto const after = ::systemicai::http::server::open_file_cache::global().stats();
+  BOOST_TEST(after.misses - before.misses == 1u);
+  BOOST_TEST(after.hits - before.hits == 3u);
+  // Still served from the open descriptor until it is revalidated
+  BOOST_TEST(request(beast::http::verb::get).body() == "indexed");
+}
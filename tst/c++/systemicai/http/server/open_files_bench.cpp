@@ -0,0 +1,68 @@
+//
+// This file is included from tst/c++/systemicai/benchmarks.cpp
+//
+// Requests answered from file metadata alone: keep-alive clients send HEADs of an existing file and GETs of a
+// missing one, with every file opened per request (service.limit.open_files 0) and with descriptors, sizes and
+// missing files kept by the open file cache.  Loopback throughput is bound by the clients, the server's CPU per
+// request is the process's less that of the client threads.
+//
+
+#include <numeric>
+
+#include <systemicai/http/server/benchmark.hpp>
+
+namespace test::systemicai::http::server::benchmark {
+
+inline void open_files(const options& o) {
+  auto const root = make_document_root(512);
+  ssl::context ctx{ssl::context::tlsv12};
+
+  std::cout << std::left << std::setw(28) << "metadata" << std::right << std::setw(14) << "ops/sec"
+            << std::setw(16) << "server us/op" << std::endl;
+  for(size_t files : {size_t(0), size_t(1024)}) {
+    auto tr = make_settings(18320, 1, root);
+    tr.put("service.limit.open_files", files);
+    pt::ptree l, plain;
+    plain.put("port", 18320);
+    plain.put("type", "plain");
+    l.push_back(std::make_pair("", plain));
+    tr.add_child("service.listeners", l);
+    running_service rs(tr, ctx);
+
+    for(auto [what, request] : {std::pair{"HEAD", "HEAD /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n"},
+                                {"404", "GET /missing.html HTTP/1.1\r\nHost: localhost\r\n\r\n"}}) {
+      auto const clients = 4;
+      net::io_context ioc;
+      std::vector<tcp::socket> sockets;
+      std::vector<beast::flat_buffer> buffers(clients);
+      for(int c = 0; c < clients; ++c) {
+        sockets.emplace_back(ioc);
+        sockets.back().connect(rs.endpoint());
+      }
+      auto const head = std::string(what) == "HEAD";
+      std::vector<double> client_cpu(clients);
+      auto const cpu = cpu_seconds();
+      auto const r = measure(clients, o.seconds, [&, request = request](int c) {
+        auto const t0 = thread_cpu_seconds();
+        beast::error_code ec;
+        net::write(sockets[c], net::buffer(std::string(request)), ec);
+        if(ec)
+          return false;
+        beast::http::response_parser<beast::http::string_body> parser;
+        parser.skip(head);
+        beast::http::read(sockets[c], buffers[c], parser, ec);
+        client_cpu[c] += thread_cpu_seconds() - t0;
+        return !ec;
+      });
+      auto const server_cpu = cpu_seconds() - cpu - std::accumulate(client_cpu.begin(), client_cpu.end(), 0.0);
+      std::cout << std::left << std::setw(28) << std::string(what) + (files == 0 ? " opened" : " cached")
+                << std::right << std::setw(14) << std::size_t(r.per_second) << std::fixed
+                << std::setprecision(2) << std::setw(16) << (r.count ? server_cpu * 1e6 / double(r.count) : 0.0)
+                << std::endl;
+    }
+  }
+}
+
+static registrar open_files_registrar("open_files", open_files);
+
+}
@@ -0,0 +1,76 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+#include <systemicai/http/server/fixture.hpp>
+#include <boost/test/included/unit_test.hpp>
+
+// Pipelined requests deeper than the queue are answered in order, whole, however their responses are gathered
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_pipelining )
+{
+  using namespace ::systemicai::http::server;
+  namespace fixture = test::systemicai::http::server::fixture;
+
+  auto const root = std::filesystem::temp_directory_path() / "afs-pipeline-test";
+  std::filesystem::create_directories(root);
+  std::string const small(256, 's');
+  std::string large(20000, 0);
+  for(size_t i = 0; i < large.size(); ++i)
+    large[i] = char('a' + i % 26);
+  std::ofstream(root / "index.html", std::ios::trunc) << small;
+  std::ofstream(root / "large.txt", std::ios::trunc | std::ios::binary) << large;
+
+  auto tree = fixture::make_settings(root);
+  tree.put("service.limit.pipeline", 3);
+  settings s(tree);
+  BOOST_TEST(s.limit_pipeline == 3);
+  fixture::running r(tree);
+
+  net::io_context ioc;
+  auto sock = fixture::connect(ioc, r.endpoint());
+  beast::error_code ec;
+
+  // Every request is sent before any response is read, the last one closes the connection
+  struct expected {
+    beast::http::verb method;
+    const char* target;
+    beast::http::status status;
+    const std::string* body;
+  };
+  std::vector<expected> requests;
+  for(int i = 0; i < 8; ++i) {
+    requests.push_back({beast::http::verb::get, "/index.html", beast::http::status::ok, &small});
+    requests.push_back({beast::http::verb::head, "/index.html", beast::http::status::ok, nullptr});
+    requests.push_back({beast::http::verb::get, "/missing.html", beast::http::status::not_found, nullptr});
+    requests.push_back({beast::http::verb::get, "/large.txt", beast::http::status::ok, &large});
+  }
+  std::string batch;
+  for(size_t i = 0; i < requests.size(); ++i) {
+    batch += std::string(beast::http::to_string(requests[i].method)) + " " + requests[i].target + " HTTP/1.1\r\nHost: localhost\r\n";
+    if(i + 1 == requests.size())
+      batch += "Connection: close\r\n";
+    batch += "\r\n";
+  }
+  net::write(sock, net::buffer(batch), ec);
+  BOOST_REQUIRE(!ec);
+
+  beast::flat_buffer buffer;
+  for(auto& r : requests) {
+    beast::http::response_parser<beast::http::string_body> p;
+    p.body_limit(1 << 20);
+    p.skip(r.method == beast::http::verb::head);
+    beast::http::read(sock, buffer, p, ec);
+    BOOST_REQUIRE(!ec);
+    BOOST_TEST(p.get().result() == r.status);
+    if(r.body)
+      BOOST_TEST(p.get().body() == *r.body);
+    if(r.method == beast::http::verb::head)
+      BOOST_TEST(p.get()[beast::http::field::content_length] == std::to_string(small.size()));
+  }
+
+  // Nothing follows the response to the request closing the connection
+  char c;
+  sock.read_some(net::buffer(&c, 1), ec);
+  BOOST_TEST(ec == net::error::eof);
+}
@@ -0,0 +1,57 @@
+//
+// This file is included from tst/c++/systemicai/benchmarks.cpp
+//
+// Pipelined clients sending batches of requests in one write, for several service.limit.pipeline depths.
+// An op is a whole batch, its latency is the time until the last response of the batch is read.
+//
+
+#include <systemicai/http/server/benchmark.hpp>
+
+namespace test::systemicai::http::server::benchmark {
+
+inline void pipelining_run(const options& o, const std::string& root, size_t depth, size_t batch) {
+  ssl::context ctx{ssl::context::tlsv12};
+  auto tr = make_settings(18140, 1, root);
+  tr.put("service.limit.pipeline", depth);
+  pt::ptree l, plain;
+  plain.put("port", 18140);
+  plain.put("type", "plain");
+  l.push_back(std::make_pair("", plain));
+  tr.add_child("service.listeners", l);
+  running_service rs(tr, ctx);
+
+  std::string requests;
+  for(size_t i = 0; i < batch; ++i)
+    requests += "GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+  auto const clients = 4;
+  net::io_context ioc;
+  std::vector<tcp::socket> sockets;
+  std::vector<beast::flat_buffer> buffers(clients);
+  for(int c = 0; c < clients; ++c) {
+    sockets.emplace_back(ioc);
+    sockets.back().connect(rs.endpoint());
+  }
+  auto r = measure(clients, o.seconds, [&](int c) {
+    beast::error_code ec;
+    net::write(sockets[c], net::buffer(requests), ec);
+    if(ec)
+      return false;
+    for(size_t i = 0; i < batch; ++i)
+      if(!read_response(sockets[c], buffers[c]))
+        return false;
+    return true;
+  });
+  report(std::cout, "depth " + std::to_string(depth) + ", batch " + std::to_string(batch), r);
+}
+
+inline void pipelining(const options& o) {
+  auto const root = make_document_root(512);
+  report_header(std::cout, "pipeline");
+  for(size_t depth : {1, 8, 32})
+    pipelining_run(o, root, depth, 16);
+}
+
+static registrar pipelining_registrar("pipelining", pipelining);
+
+}
@@ -0,0 +1,80 @@
+//
+// This file is included from tst/c++/systemicai/benchmarks.cpp
+//
+// Media seeks: keep-alive clients fetch 64 KiB at a random offset of an 8 MiB file, as one range, as four 16 KiB
+// ranges of a multipart/byteranges body, or by downloading the whole file as a server without Range support made
+// them do.
+//
+
+#include <systemicai/http/server/benchmark.hpp>
+#include <random>
+
+namespace test::systemicai::http::server::benchmark {
+
+inline void ranges(const options& o) {
+  std::uint64_t const file_size = 8 << 20;
+  auto const root = std::filesystem::path(make_document_root(512));
+  std::ofstream(root / "media.bin", std::ios::binary | std::ios::trunc) << std::string(file_size, 'm');
+  auto tr = make_settings(18350, 2, root.string());
+  tr.put("service.limit.open_files", 1024);
+  pt::ptree l, plain;
+  plain.put("port", 18350);
+  plain.put("type", "plain");
+  l.push_back(std::make_pair("", plain));
+  tr.add_child("service.listeners", l);
+  ssl::context ctx{ssl::context::tlsv12};
+  running_service rs(tr, ctx);
+
+  enum class kind { whole, single, multiple };
+  struct run {
+    const char* name;
+    kind k;
+  };
+  static const run runs[] = {
+          {"whole file", kind::whole},
+          {"one 64 KiB range", kind::single},
+          {"four 16 KiB ranges", kind::multiple}};
+
+  report_header(std::cout, "8 MiB file seeks");
+  for(auto& run : runs) {
+    auto const clients = 4;
+    net::io_context ioc;
+    std::vector<tcp::socket> sockets;
+    std::vector<beast::flat_buffer> buffers(clients);
+    std::vector<std::mt19937_64> random;
+    for(int c = 0; c < clients; ++c) {
+      sockets.emplace_back(ioc);
+      sockets.back().connect(rs.endpoint());
+      random.emplace_back(c);
+    }
+    auto const r = measure(clients, o.seconds, [&](int c) {
+      auto const at = random[c]() % (file_size - (64 << 10));
+      std::string request = "GET /media.bin HTTP/1.1\r\nHost: localhost\r\n";
+      if(run.k == kind::single) {
+        request += "Range: bytes=" + std::to_string(at) + "-" + std::to_string(at + (64 << 10) - 1) + "\r\n";
+      } else if(run.k == kind::multiple) {
+        request += "Range: bytes=";
+        for(int i = 0; i < 4; ++i) {
+          auto const first = at + i * (16 << 10) + i;
+          request += (i == 0 ? "" : ",") + std::to_string(first) + "-" + std::to_string(first + (16 << 10) - 1);
+        }
+        request += "\r\n";
+      }
+      request += "\r\n";
+      beast::error_code ec;
+      net::write(sockets[c], net::buffer(request), ec);
+      if(ec)
+        return false;
+      beast::http::response_parser<beast::http::string_body> parser;
+      parser.body_limit(file_size + 4096);
+      beast::http::read(sockets[c], buffers[c], parser, ec);
+      auto const expected = run.k == kind::whole ? beast::http::status::ok : beast::http::status::partial_content;
+      return !ec && parser.get().result() == expected;
+    });
+    report(std::cout, run.name, r);
+  }
+}
+
+static registrar ranges_registrar("ranges", ranges);
+
+}
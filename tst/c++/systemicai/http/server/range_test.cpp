@@ -0,0 +1,119 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+#include <systemicai/http/server/byte_ranges.h>
+#include <systemicai/http/server/fixture.hpp>
+#include <boost/test/included/unit_test.hpp>
+
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_range )
+{
+  using namespace ::systemicai::http::server;
+  namespace fixture = test::systemicai::http::server::fixture;
+  using field = beast::http::field;
+  using status = beast::http::status;
+  using outcome = byte_ranges::outcome;
+
+  // Parsing
+  byte_ranges ranges;
+  BOOST_TEST((ranges.parse("bytes=0-9", 100) == outcome::partial));
+  BOOST_TEST((ranges.size() == 1u && ranges[0].first == 0u && ranges[0].last == 9u));
+  BOOST_TEST((ranges.parse("bytes=-10", 100) == outcome::partial));
+  BOOST_TEST((ranges[0].first == 90u && ranges[0].last == 99u));
+  BOOST_TEST((ranges.parse("bytes=-1000", 100) == outcome::partial));
+  BOOST_TEST((ranges[0].first == 0u && ranges[0].last == 99u));
+  BOOST_TEST((ranges.parse("bytes=50-", 100) == outcome::partial));
+  BOOST_TEST((ranges[0].first == 50u && ranges[0].last == 99u));
+  BOOST_TEST((ranges.parse("bytes=90-99999999999999999999999", 100) == outcome::partial));
+  BOOST_TEST(ranges[0].last == 99u);
+  // Sorted, overlapping and adjacent ranges merged, unsatisfiable ones dropped
+  BOOST_TEST((ranges.parse("Bytes=40-49, 0-4,3-9 ,10-19, 500-", 100) == outcome::partial));
+  BOOST_TEST((ranges.size() == 2u && ranges[0].first == 0u && ranges[0].last == 19u && ranges[1].first == 40u));
+  BOOST_TEST((ranges.parse("bytes=100-, -0", 100) == outcome::unsatisfiable));
+  BOOST_TEST((ranges.parse("bytes=-1", 0) == outcome::unsatisfiable));
+  // Malformed, or too many ranges: the whole representation
+  BOOST_TEST((ranges.parse("bytes=9-0", 100) == outcome::whole));
+  BOOST_TEST((ranges.parse("bytes=a-b", 100) == outcome::whole));
+  BOOST_TEST((ranges.parse("items=0-9", 100) == outcome::whole));
+  BOOST_TEST((ranges.parse("bytes=", 100) == outcome::whole));
+  std::string many = "bytes=0-0";
+  for(int i = 1; i <= int(byte_ranges::max_ranges); ++i)
+    many += "," + std::to_string(i * 2) + "-" + std::to_string(i * 2);
+  BOOST_TEST((ranges.parse(many, 100) == outcome::whole));
+
+  auto const root = std::filesystem::temp_directory_path() / "afs-range-test";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root);
+  std::string media(200000, '\0');
+  for(std::size_t i = 0; i < media.size(); ++i)
+    media[i] = char('a' + i % 26);
+  std::ofstream(root / "media.bin", std::ios::binary | std::ios::trunc) << media;
+  std::ofstream(root / "page.html", std::ios::binary | std::ios::trunc) << media.substr(0, 1000);
+
+  auto tree = fixture::make_settings(root);
+  tree.put("service.limit.file_cache", 65536);
+  tree.put("service.limit.open_files", 16);
+  fixture::running r(tree);
+  auto const request = [&r](beast::http::verb verb, const char* target, std::initializer_list<std::pair<field, std::string>> fields) {
+    return fixture::request(r.endpoint(), verb, target, fields);
+  };
+
+  auto const get = beast::http::verb::get;
+
+  // A file sent from its descriptor, and one from memory
+  for(auto [target, content] : {std::pair{"/media.bin", media}, {"/page.html", media.substr(0, 1000)}}) {
+    auto const size = std::to_string(content.size());
+    auto const whole = request(get, target, {});
+    BOOST_TEST(whole.result() == status::ok);
+    BOOST_TEST(whole[field::accept_ranges] == "bytes");
+    BOOST_TEST(whole.body() == content);
+
+    auto res = request(get, target, {{field::range, "bytes=100-199"}});
+    BOOST_TEST(res.result() == status::partial_content);
+    BOOST_TEST(res[field::content_range] == "bytes 100-199/" + size);
+    BOOST_TEST(res.body() == content.substr(100, 100));
+
+    res = request(get, target, {{field::range, "bytes=-7"}});
+    BOOST_TEST(res[field::content_range] == "bytes " + std::to_string(content.size() - 7) + "-" +
+                                            std::to_string(content.size() - 1) + "/" + size);
+    BOOST_TEST(res.body() == content.substr(content.size() - 7));
+
+    // Several ranges in a multipart/byteranges body
+    res = request(get, target, {{field::range, "bytes=0-2,10-12"}});
+    BOOST_TEST(res.result() == status::partial_content);
+    auto const type = std::string(res[field::content_type]);
+    BOOST_REQUIRE(type.find("multipart/byteranges; boundary=") == 0);
+    auto const boundary = type.substr(type.find('=') + 1);
+    auto const part = [&](const char* range, const std::string& bytes) {
+      return "\r\n--" + boundary + "\r\nContent-Type: " + (target == std::string("/page.html") ? "text/html" : "application/text") +
+             "\r\nContent-Range: bytes " + range + "/" + size + "\r\n\r\n" + bytes;
+    };
+    BOOST_TEST(res.body() == part("0-2", content.substr(0, 3)) + part("10-12", content.substr(10, 3)) +
+                             "\r\n--" + boundary + "--\r\n");
+    // Under a boundary no other response has
+    BOOST_TEST(boundary.size() == 32u);
+    auto const next = request(get, target, {{field::range, "bytes=0-2,10-12"}});
+    BOOST_TEST(std::string(next[field::content_type]) != type);
+
+    // Beyond the end
+    res = request(get, target, {{field::range, "bytes=" + size + "-"}});
+    BOOST_TEST(res.result() == status::range_not_satisfiable);
+    BOOST_TEST(res[field::content_range] == "bytes */" + size);
+    BOOST_TEST(res.body().empty());
+
+    // If-Range names the representation by its strong tag or its date, otherwise all of it is sent
+    auto const etag = std::string(whole[field::etag]);
+    BOOST_TEST(request(get, target, {{field::range, "bytes=0-0"}, {field::if_range, etag}}).result() == status::partial_content);
+    BOOST_TEST(request(get, target, {{field::range, "bytes=0-0"}, {field::if_range, std::string(whole[field::last_modified])}}).result()
+               == status::partial_content);
+    BOOST_TEST(request(get, target, {{field::range, "bytes=0-0"}, {field::if_range, "\"stale\""}}).body() == content);
+    BOOST_TEST(request(get, target, {{field::range, "bytes=0-0"}, {field::if_range, "W/" + etag}}).body() == content);
+
+    // Ignored by HEAD, and when malformed
+    auto const head = request(beast::http::verb::head, target, {{field::range, "bytes=0-0"}});
+    BOOST_TEST(head.result() == status::ok);
+    BOOST_TEST(head[field::content_length] == size);
+    BOOST_TEST(request(get, target, {{field::range, "bytes=5-1"}}).body() == content);
+  }
+}
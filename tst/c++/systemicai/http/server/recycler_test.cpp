@@ -0,0 +1,112 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+#include <systemicai/http/server/fixture.hpp>
+#include <systemicai/http/server/recycler.h>
+#include <boost/test/included/unit_test.hpp>
+
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_recycler )
+{
+  using namespace ::systemicai::http::server;
+
+  recycler::limit(2);
+  recycler::io_thread io;
+  auto const before = recycler::cached();
+
+  // Storage goes back to the thread's free list of its size
+  void* a = recycler::allocate(200);
+  void* b = recycler::allocate(200);
+  void* c = recycler::allocate(200);
+  recycler::deallocate(a, 200);
+  recycler::deallocate(b, 200);
+  recycler::deallocate(c, 200);
+  BOOST_TEST(recycler::cached() == before + 2);
+  void* d = recycler::allocate(200);
+  BOOST_TEST((d == a || d == b));
+  BOOST_TEST(recycler::allocate(300) != a);
+  recycler::deallocate(d, 200);
+
+  // Arenas come back reset, with one chunk ready
+  arena* first = nullptr;
+  {
+    auto p = recycler::make_arena();
+    first = p.get();
+    for(int i = 0; i < 8; ++i)
+      p->allocate(4096);
+    BOOST_TEST(p->capacity() > arena::chunk_size);
+  }
+  {
+    auto p = recycler::make_arena();
+    BOOST_TEST(p.get() == first);
+    BOOST_TEST(p->capacity() == arena::chunk_size);
+    // An allocator keeps it from being recycled
+    arena_allocator<char> alloc(p);
+    p.reset();
+    BOOST_TEST(recycler::make_arena().get() != first);
+  }
+  BOOST_TEST(recycler::make_arena().get() == first);
+
+  // Released on another thread, a session's storage and arena go back to the heap
+  std::thread([] {
+    recycler::deallocate(recycler::allocate(200), 200);
+    recycler::make_arena();
+    BOOST_TEST(recycler::cached() == 0u);
+  }).join();
+
+  recycler::limit(64);
+}
+
+// Accepting a connection reuses the sessions of the connections closed before it
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_recycled_sessions )
+{
+  using namespace ::systemicai::http::server;
+  namespace fixture = test::systemicai::http::server::fixture;
+
+  auto const root = std::filesystem::temp_directory_path() / "afs-recycler-test";
+  std::filesystem::create_directories(root);
+  std::ofstream(root / "index.html", std::ios::trunc) << std::string(256, 'r');
+
+  auto tree = fixture::make_settings(root);
+  tree.put("service.thread.mode", "sharded");
+  tree.put("service.thread.io", 1);
+  auto r = std::make_unique<fixture::running>(tree);
+
+  net::io_context ioc;
+  auto const ep = r->endpoint();
+  static const char request[] = "GET /index.html HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+  char response[4096];
+  // Connect, GET and read until the server closes
+  auto const churn = [&]() {
+    tcp::socket sock(ioc);
+    beast::error_code ec;
+    sock.connect(ep, ec);
+    if(ec)
+      return false;
+    net::write(sock, net::buffer(request, sizeof(request) - 1), ec);
+    size_t got = 0;
+    while(!ec)
+      got += sock.read_some(net::buffer(response, sizeof(response)), ec);
+    return ec == net::error::eof && got > 256;
+  };
+  // The io thread's lists were empty when the service started, and stay so without recycling
+  auto const connections = 200;
+  auto const measure = [&](size_t limit) {
+    recycler::limit(limit);
+    for(int i = 0; i < 16; ++i)
+      BOOST_REQUIRE(churn());
+    auto const before = ::test::systemicai::allocations().load();
+    for(int i = 0; i < connections; ++i)
+      BOOST_REQUIRE(churn());
+    return double(::test::systemicai::allocations().load() - before) / connections;
+  };
+  auto const fresh = measure(0);
+  auto const recycled = measure(64);
+  BOOST_TEST_MESSAGE("Allocations per connection: " << fresh << " fresh, " << recycled << " recycled");
+
+  r.reset();
+
+  // The session, its control block, and its arena's chunk at least
+  BOOST_TEST(recycled + 3 <= fresh);
+}
@@ -0,0 +1,45 @@
+//
+// This file is included from tst/c++/systemicai/benchmarks.cpp
+//
+// Connection churn: every operation connects, GETs a small file with "Connection: close" and waits for the server
+// to close.  Compares sessions created from the heap (service.limit.session_cache 0) with recycled ones, on a
+// plain listener and on an auto listener, which runs a detect_session first.
+//
+
+#include <systemicai/http/server/benchmark.hpp>
+
+namespace test::systemicai::http::server::benchmark {
+
+inline void recycling(const options& o) {
+  auto const root = make_document_root(512);
+  ssl::context ctx{ssl::context::tlsv12};
+
+  report_header(std::cout, "sessions");
+  for(size_t cache : {size_t(0), size_t(64)}) {
+    auto tr = make_settings(18200, 1, root);
+    tr.put("service.thread.mode", "sharded");
+    tr.put("service.limit.session_cache", cache);
+    pt::ptree l, plain, detect;
+    plain.put("port", 18200);
+    plain.put("type", "plain");
+    detect.put("port", 18201);
+    detect.put("type", "auto");
+    l.push_back(std::make_pair("", plain));
+    l.push_back(std::make_pair("", detect));
+    tr.add_child("service.listeners", l);
+    running_service rs(tr, ctx);
+
+    for(auto& ls : rs.config().listeners) {
+      tcp::endpoint const ep(net::ip::make_address(ls.address), ls.port);
+      auto const r = measure(2, o.seconds, [&ep](int) {
+        thread_local net::io_context ioc;
+        return get_and_close<tcp>(ioc, ep, "/index.html");
+      });
+      report(std::cout, ls.type + (cache == 0 ? " fresh" : " recycled"), r);
+    }
+  }
+}
+
+static registrar recycling_registrar("recycling", recycling);
+
+}
@@ -0,0 +1,80 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+#include <systemicai/http/server/fixture.hpp>
+#include <boost/test/included/unit_test.hpp>
+
+#include <poll.h>
+
+namespace test::systemicai::http::server::reload {
+
+using namespace ::systemicai::http::server;
+
+inline std::string get(tcp::socket& sock) {
+  beast::error_code ec;
+  std::string const request = "GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  net::write(sock, net::buffer(request), ec);
+  beast::flat_buffer buffer;
+  beast::http::response<beast::http::string_body> res;
+  beast::http::read(sock, buffer, res, ec);
+  return ec ? ec.message() : res.body();
+}
+
+// Whether the service closes `sock` within `timeout`
+inline bool closed(tcp::socket& sock, std::chrono::milliseconds timeout) {
+  pollfd p{sock.native_handle(), POLLIN, 0};
+  if(::poll(&p, 1, int(timeout.count())) != 1)
+    return false;
+  char c;
+  beast::error_code ec;
+  sock.read_some(net::buffer(&c, 1), ec);
+  return ec == net::error::eof || ec == net::error::connection_reset;
+}
+
+}
+
+// A reload applies to the connections accepted after it, open ones keep the settings they were accepted with
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_reload )
+{
+  using namespace ::systemicai::http::server;
+  using test::systemicai::http::server::reload::get;
+  using test::systemicai::http::server::reload::closed;
+  namespace fixture = test::systemicai::http::server::fixture;
+
+  auto const root = std::filesystem::temp_directory_path() / "afs-reload-test";
+  for(auto name : {"first", "second"}) {
+    std::filesystem::create_directories(root / name);
+    std::ofstream(root / name / "index.html", std::ios::trunc) << name;
+  }
+
+  auto tree = fixture::make_settings(root / "first");
+  settings s(tree);
+  fixture::running r(tree);
+  auto& svc = r.service();
+
+  net::io_context ioc;
+  auto const connect = [&] { return fixture::connect(ioc, r.endpoint()); };
+
+  auto before = connect();
+  BOOST_TEST(get(before) == "first");
+
+  tree.put("document.root", (root / "second").string());
+  svc.reload(settings(tree));
+  BOOST_TEST(svc.current_settings()->document_root == (root / "second").string());
+  // The configuration given to the service is left alone
+  BOOST_TEST(s.document_root == (root / "first").string());
+
+  auto after = connect();
+  BOOST_TEST(get(after) == "second");
+  BOOST_TEST(get(before) == "first");
+
+  // Timeouts are pinned the same way
+  tree.put("service.timeout.idle", 100);
+  svc.reload(settings(tree));
+  auto idle = connect();
+  BOOST_TEST(get(idle) == "second");
+  BOOST_TEST(closed(idle, std::chrono::seconds(5)));
+  BOOST_TEST(get(after) == "second");
+}
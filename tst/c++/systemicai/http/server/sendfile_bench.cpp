@@ -0,0 +1,60 @@
+//
+// This file is included from tst/c++/systemicai/benchmarks.cpp
+//
+// CPU per GB served on a plain listener: two keep-alive clients GET an 8 MiB file with service.sendfile off, the
+// serializer reading the file into a buffer and writing it to the socket, and on, the kernel sending it from the
+// page cache.  The server's CPU is the process's less that of the client threads.
+//
+
+#include <systemicai/http/server/benchmark.hpp>
+
+namespace test::systemicai::http::server::benchmark {
+
+inline void sendfile(const options& o) {
+  std::uint64_t const file_size = 8 << 20;
+  auto const root = make_document_root(512);
+  std::ofstream(std::filesystem::path(root) / "large.bin", std::ios::trunc) << std::string(file_size, 's');
+
+  std::cout << std::left << std::setw(28) << "8 MiB GETs" << std::right << std::setw(14) << "GB/sec"
+            << std::setw(16) << "CPU sec/GB" << std::endl;
+  for(auto sendfile : {false, true}) {
+    auto tr = make_settings(18310, 1, root);
+    tr.put("service.sendfile", sendfile);
+    pt::ptree l, ls;
+    ls.put("address", "127.0.0.1");
+    ls.put("port", 18310);
+    ls.put("type", "plain");
+    l.push_back(std::make_pair("", ls));
+    tr.add_child("service.listeners", l);
+    ssl::context ctx{ssl::context::tlsv12};
+    running_service rs(tr, ctx);
+    auto const ep = rs.endpoint();
+
+    std::atomic<double> client_cpu{0};
+    auto const cpu = cpu_seconds();
+    auto const res = measure(2, o.seconds, [&](int) {
+      thread_local net::io_context ioc;
+      thread_local std::unique_ptr<tcp::socket> s;
+      thread_local beast::flat_buffer buffer;
+      auto const t0 = thread_cpu_seconds();
+      if(!s) {
+        s = std::make_unique<tcp::socket>(ioc);
+        s->connect(ep);
+      }
+      auto const ok = get_large(*s, buffer, "/large.bin", file_size);
+      auto v = client_cpu.load();
+      while(!client_cpu.compare_exchange_weak(v, v + thread_cpu_seconds() - t0))
+        ;
+      return ok;
+    });
+    auto const server_cpu = cpu_seconds() - cpu - client_cpu.load();
+    auto const gb = double(res.count) * file_size / 1e9;
+    std::cout << std::left << std::setw(28) << (sendfile ? "sendfile" : "read and write") << std::right << std::fixed
+              << std::setprecision(2) << std::setw(14) << gb / o.seconds << std::setw(16)
+              << (gb > 0 ? server_cpu / gb : 0.0) << std::endl;
+  }
+}
+
+static registrar sendfile_registrar("sendfile", sendfile);
+
+}
@@ -0,0 +1,73 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+#include <systemicai/http/server/fixture.hpp>
+#include <boost/test/included/unit_test.hpp>
+
+namespace test::systemicai::http::server::sendfile {
+
+using namespace ::systemicai::http::server;
+
+// Pipeline a GET of a large file, a HEAD of it and a GET of a small one in one write, from a client with a small
+// receive buffer, so the socket fills up and sending resumes once it drains
+inline void pipelined(const tcp::endpoint& ep, const std::string& large, const std::string& small) {
+  net::io_context ioc;
+  tcp::socket sock(ioc);
+  sock.open(tcp::v4());
+  sock.set_option(net::socket_base::receive_buffer_size(16384));
+  beast::error_code ec;
+  sock.connect(ep, ec);
+  BOOST_REQUIRE(!ec);
+  std::string const requests =
+          "GET /large.bin HTTP/1.1\r\nHost: localhost\r\n\r\n"
+          "HEAD /large.bin HTTP/1.1\r\nHost: localhost\r\n\r\n"
+          "GET /small.txt HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  net::write(sock, net::buffer(requests));
+
+  beast::flat_buffer buffer;
+  beast::http::response_parser<beast::http::string_body> get;
+  get.body_limit(large.size());
+  beast::http::read(sock, buffer, get, ec);
+  BOOST_REQUIRE(!ec);
+  BOOST_TEST((get.get().body() == large));
+
+  beast::http::response_parser<beast::http::string_body> head;
+  head.skip(true);
+  beast::http::read(sock, buffer, head, ec);
+  BOOST_REQUIRE(!ec);
+  BOOST_TEST(head.get()[beast::http::field::content_length] == std::to_string(large.size()));
+
+  beast::http::response_parser<beast::http::string_body> next;
+  beast::http::read(sock, buffer, next, ec);
+  BOOST_REQUIRE(!ec);
+  BOOST_TEST(next.get().body() == small);
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_sendfile )
+{
+  using namespace ::systemicai::http::server;
+
+  auto const root = std::filesystem::temp_directory_path() / "afs-sendfile-test";
+  std::filesystem::create_directories(root);
+  // Larger than one sendfile call and one turn of the io thread, and not a multiple of a page
+  std::string large(9 * 1048576 + 12345, 0);
+  for(size_t i = 0; i < large.size(); ++i)
+    large[i] = char('a' + i % 26);
+  std::ofstream(root / "large.bin", std::ios::binary | std::ios::trunc) << large;
+  std::ofstream(root / "small.txt", std::ios::trunc) << "small";
+
+  // With sendfile, and through the serializer as before
+  for(auto sendfile : {true, false}) {
+    auto tree = test::systemicai::http::server::fixture::make_settings(root);
+    tree.put("service.sendfile", sendfile);
+    test::systemicai::http::server::fixture::running r(tree);
+    test::systemicai::http::server::sendfile::pipelined(r.endpoint(), large, "small");
+    // A client reading as fast as it is sent to
+    auto const res = test::systemicai::http::server::fixture::request(r.endpoint(), beast::http::verb::get, "/large.bin");
+    BOOST_TEST((res.body() == large));
+  }
+}
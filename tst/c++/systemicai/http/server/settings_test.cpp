@@ -48,10 +48,69 @@ BOOST_AUTO_TEST_CASE( test_systemicai_http_server_settings_json_parsing )
   BOOST_TEST(settings.ssl_certificate == "cfg/dumb.cert");
   BOOST_TEST(settings.ssl_key == "cfg/dumb.key");
   BOOST_TEST(settings.ssl_dh == "cfg/dumb.dh");
+  BOOST_TEST(settings.ssl_min_version == "1.3");
+  BOOST_TEST(settings.ssl_max_version == "1.3");
+  BOOST_TEST(settings.ssl_groups == "X25519");
   BOOST_TEST(settings.timeout_header == 15000);
   BOOST_TEST(settings.timeout_put == 3000);
   BOOST_TEST(settings.timeout_post == 3000);
   BOOST_TEST(settings.timeout_get == 10000);
+  BOOST_TEST(settings.timeout_handler == 30000);
+  BOOST_TEST(settings.timeout_write == 30000);
+  BOOST_TEST(settings.timeout_idle == 15000);
   BOOST_TEST(settings.thread_io == 22);
+  BOOST_TEST(settings.thread_mode == "shared");
+  BOOST_TEST(settings.limit_connections == 0);
+  BOOST_TEST(settings.limit_accept_batch == 16);
+  BOOST_TEST(settings.limit_pipeline == 8);
+  BOOST_TEST(settings.handoff_path == "");
+  BOOST_TEST(settings.handoff_drain == 30);
 }
 
+// The test case must be registered with the test runner
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_settings_listeners )
+{
+  // Without service.listeners the interface address and port are a single auto listener
+  systemicai::http::server::settings defaults;
+  BOOST_TEST(defaults.listeners.size() == 1);
+  BOOST_TEST(defaults.listeners[0].address == "127.0.0.1");
+  BOOST_TEST(defaults.listeners[0].port == 8080);
+  BOOST_TEST(defaults.listeners[0].type == "auto");
+
+  std::stringstream s_json(R"(
+    {
+      "service": {
+        "interface": { "address": "0.0.0.0" },
+        "listeners": [
+          { "port": 8080, "type": "plain" },
+          { "address": "127.0.0.1", "port": 8443, "type": "TLS" },
+          { "port": 9000 },
+          { "type": "unix", "path": "/tmp/afs.sock" }
+        ]
+      }
+    }
+  )");
+  pt::ptree tree;
+  pt::json_parser::read_json(s_json, tree);
+  systemicai::http::server::settings settings(tree);
+  BOOST_TEST(settings.listeners.size() == 4);
+  BOOST_TEST(settings.listeners[0].address == "0.0.0.0");
+  BOOST_TEST(settings.listeners[0].type == "plain");
+  BOOST_TEST(settings.listeners[1].address == "127.0.0.1");
+  BOOST_TEST(settings.listeners[1].port == 8443);
+  BOOST_TEST(settings.listeners[1].type == "tls");
+  BOOST_TEST(settings.listeners[2].type == "auto");
+  BOOST_TEST(settings.listeners[3].type == "unix");
+  BOOST_TEST(settings.listeners[3].path == "/tmp/afs.sock");
+
+  // Round trips through the property tree
+  systemicai::http::server::settings copy(static_cast<pt::ptree>(settings));
+  BOOST_TEST(copy.listeners.size() == 4);
+  BOOST_TEST(copy.listeners[1].port == 8443);
+  BOOST_TEST(copy.listeners[3].path == "/tmp/afs.sock");
+
+  BOOST_TEST((systemicai::http::server::parse_transport("plain") == systemicai::http::server::transport::plain));
+  BOOST_TEST((systemicai::http::server::parse_transport("tls") == systemicai::http::server::transport::tls));
+  BOOST_TEST((systemicai::http::server::parse_transport("auto") == systemicai::http::server::transport::detect));
+  BOOST_CHECK_THROW(systemicai::http::server::parse_transport("quic"), systemicai::common::exception);
+}
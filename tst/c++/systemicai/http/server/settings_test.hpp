@@ -19,13 +19,18 @@ static const char* json(R"(
       "ssl": {
         "certificate": "cfg/dumb.cert",
         "key": "cfg/dumb.key",
-        "dh": "cfg/dumb.dh"
+        "dh": "cfg/dumb.dh",
+        "min_version": "1.3",
+        "groups": "X25519"
       },
       "timeout": {
         "header": "15000",
         "put": "3000",
         "post": "3000",
-        "get": "10000"
+        "get": "10000",
+        "handler": "30000",
+        "write": "30000",
+        "idle": "15000"
       },
       "thread": {
         "io": "22"
@@ -0,0 +1,36 @@
+//
+// This file is included from tst/c++/systemicai/benchmarks.cpp
+//
+// Compares the "shared" and "sharded" thread modes by new connections per second and p99 latency of a
+// connect, GET, close cycle while the number of io threads grows.
+//
+
+#include <systemicai/http/server/benchmark.hpp>
+
+namespace test::systemicai::http::server::benchmark {
+
+inline void sharding(const options& o) {
+  auto const root = make_document_root(512);
+  auto const cores = std::max<int>(1, std::thread::hardware_concurrency());
+  ssl::context ctx{ssl::context::tlsv12};
+
+  report_header(std::cout, "mode / io threads");
+  for(auto threads = 1; threads <= cores; threads *= 2) {
+    for(auto mode : {"shared", "sharded"}) {
+      auto tr = make_settings(18080, threads, root);
+      tr.put("service.thread.mode", mode);
+      running_service rs(tr, ctx);
+      auto const ep = rs.endpoint();
+      // Two clients per io thread keeps every thread busy while waiting on the network
+      auto const r = measure(threads * 2, o.seconds, [&ep](int) {
+        thread_local net::io_context ioc;
+        return get_and_close<tcp>(ioc, ep, "/index.html");
+      });
+      report(std::cout, std::string(mode) + " / " + std::to_string(threads), r);
+    }
+  }
+}
+
+static registrar sharding_registrar("sharding", sharding);
+
+}
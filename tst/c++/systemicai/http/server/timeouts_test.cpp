@@ -0,0 +1,133 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+#include <systemicai/http/server/fixture.hpp>
+#include <boost/test/included/unit_test.hpp>
+
+namespace test::systemicai::http::server::timeouts {
+
+using namespace ::systemicai::http::server;
+using std::chrono::milliseconds;
+
+// How long the server takes to close the connection, skipping whatever it sends first
+inline milliseconds closed_after(tcp::socket& sock, std::chrono::steady_clock::time_point since) {
+  char buffer[4096];
+  beast::error_code ec;
+  while(!ec)
+    sock.read_some(net::buffer(buffer), ec);
+  return std::chrono::duration_cast<milliseconds>(std::chrono::steady_clock::now() - since);
+}
+
+}
+
+// Each phase of a request is held to its own timeout, however the client stalls
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_timeouts )
+{
+  using namespace ::systemicai::http::server;
+  using namespace test::systemicai::http::server::timeouts;
+  namespace fixture = test::systemicai::http::server::fixture;
+  using clock = std::chrono::steady_clock;
+
+  auto const root = std::filesystem::temp_directory_path() / "afs-timeouts-test";
+  std::filesystem::create_directories(root);
+  std::ofstream(root / "index.html", std::ios::trunc) << "timeouts";
+
+  auto tree = fixture::make_settings(root);
+  tree.put("service.log.level", "fatal");
+  tree.put("service.timeout.header", 300);
+  tree.put("service.timeout.post", 600);
+  tree.put("service.timeout.idle", 900);
+  tree.put("service.timeout.handler", 400);
+  fixture::running r(tree);
+
+  // The wheel may expire a deadline up to two ticks late
+  auto const late = 2 * timer_wheel::tick + milliseconds(100);
+  net::io_context ioc;
+  beast::error_code ec;
+
+  // A connection that never sends anything gets the header timeout
+  {
+    auto sock = fixture::connect(ioc, r.endpoint());
+    auto const d = closed_after(sock, clock::now());
+    BOOST_TEST(d.count() >= 300);
+    BOOST_TEST((d < milliseconds(300) + late));
+  }
+
+  // A header trickling in keeps the connection busy, but is due in full from its first byte
+  {
+    auto sock = fixture::connect(ioc, r.endpoint());
+    sock.non_blocking(true);
+    auto const start = clock::now();
+    std::string const header = "GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    char c;
+    for(size_t i = 0; i < header.size() && !ec; ++i) {
+      net::write(sock, net::buffer(&header[i], 1), ec);
+      std::this_thread::sleep_for(milliseconds(20));
+      if(!ec && sock.read_some(net::buffer(&c, 1), ec) == 0 && ec == net::error::would_block)
+        ec = {};
+    }
+    BOOST_TEST(ec);
+    auto const d = std::chrono::duration_cast<milliseconds>(clock::now() - start);
+    BOOST_TEST(d.count() >= 300);
+    BOOST_TEST((d < milliseconds(300) + late));
+  }
+
+  // A stalled body gets the timeout of its method, counted from the end of the header
+  {
+    auto sock = fixture::connect(ioc, r.endpoint());
+    std::string const partial = "POST /index.html HTTP/1.1\r\nHost: localhost\r\nContent-Length: 100\r\n\r\n0123456789";
+    net::write(sock, net::buffer(partial), ec);
+    BOOST_REQUIRE(!ec);
+    auto const d = closed_after(sock, clock::now());
+    BOOST_TEST(d.count() >= 600);
+    BOOST_TEST((d < milliseconds(600) + late));
+  }
+
+  // After a response the connection is kept alive for the idle timeout
+  {
+    auto sock = fixture::connect(ioc, r.endpoint());
+    std::string const request = "GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    net::write(sock, net::buffer(request), ec);
+    BOOST_REQUIRE(!ec);
+    beast::flat_buffer buffer;
+    beast::http::response<beast::http::string_body> res;
+    beast::http::read(sock, buffer, res, ec);
+    BOOST_REQUIRE(!ec);
+    BOOST_TEST(res.body() == "timeouts");
+    auto const d = closed_after(sock, clock::now());
+    BOOST_TEST(d.count() >= 900);
+    BOOST_TEST((d < milliseconds(900) + late));
+  }
+
+  // A handler overrunning its timeout is answered for with a 503, while it still runs.  A FIFO holds the default
+  // handler in open() until a writer comes.
+  {
+    auto const fifo = root / "fifo";
+    std::filesystem::remove(fifo);
+    BOOST_REQUIRE(::mkfifo(fifo.c_str(), 0600) == 0);
+    auto sock = fixture::connect(ioc, r.endpoint());
+    std::string const request = "GET /fifo HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    auto const start = clock::now();
+    net::write(sock, net::buffer(request), ec);
+    BOOST_REQUIRE(!ec);
+    beast::flat_buffer buffer;
+    beast::http::response<beast::http::string_body> res;
+    beast::http::read(sock, buffer, res, ec);
+    auto const d = std::chrono::duration_cast<milliseconds>(clock::now() - start);
+    BOOST_TEST(!ec);
+    BOOST_TEST(res.result_int() == 503);
+    BOOST_TEST(d.count() >= 400);
+    BOOST_TEST((d < milliseconds(400) + late));
+
+    // Once the handler returns its response is dropped with the connection
+    int const writer = ::open(fifo.c_str(), O_WRONLY | O_NONBLOCK);
+    BOOST_TEST(writer >= 0);
+    ::close(writer);
+    char c;
+    sock.read_some(net::buffer(&c, 1), ec);
+    BOOST_TEST(ec == net::error::eof);
+    BOOST_TEST(fixture::request(r.endpoint(), beast::http::verb::get, "/index.html").body() == "timeouts");
+  }
+}
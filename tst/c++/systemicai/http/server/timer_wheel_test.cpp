@@ -0,0 +1,80 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/timer_wheel.h>
+#include <boost/test/included/unit_test.hpp>
+
+namespace test::systemicai::http::server::timer_wheel {
+
+// Records when it expired
+class recording_entry : public ::systemicai::http::server::timer_wheel::entry {
+public:
+  using clock = ::systemicai::http::server::timer_wheel::clock;
+
+  ~recording_entry() override {
+    cancel();
+  }
+
+  int expirations = 0;
+  clock::time_point when;
+
+protected:
+  void on_expire() override {
+    ++expirations;
+    when = clock::now();
+  }
+};
+
+}
+
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_timer_wheel )
+{
+  using namespace std::chrono_literals;
+  using ::systemicai::http::server::timer_wheel;
+  using entry = test::systemicai::http::server::timer_wheel::recording_entry;
+
+  net::io_context ioc;
+  auto& wheel = net::use_service<timer_wheel>(ioc);
+  BOOST_TEST(&wheel == &timer_wheel::of(ioc.get_executor()));
+  BOOST_TEST(&wheel == &timer_wheel::of(net::make_strand(ioc)));
+
+  entry early, late, cancelled, rearmed;
+  for(auto e : {&early, &late, &cancelled, &rearmed})
+    e->attach(wheel);
+
+  auto const start = entry::clock::now();
+  early.arm(200ms);
+  late.arm(500ms);
+  cancelled.arm(200ms);
+  rearmed.arm(200ms);
+  BOOST_TEST(wheel.size() == 4);
+
+  cancelled.cancel();
+  rearmed.arm(400ms);
+  BOOST_TEST(wheel.size() == 3);
+
+  // The io_context runs out of work once the wheel is empty
+  ioc.run();
+
+  BOOST_TEST(wheel.size() == 0);
+  BOOST_TEST(early.expirations == 1);
+  BOOST_TEST(late.expirations == 1);
+  BOOST_TEST(rearmed.expirations == 1);
+  BOOST_TEST(cancelled.expirations == 0);
+  BOOST_TEST(early.expired());
+  BOOST_TEST(!cancelled.expired());
+
+  // Never early, and no later than a couple of ticks
+  BOOST_TEST((early.when - start >= 200ms));
+  BOOST_TEST((early.when - start < 200ms + 3 * timer_wheel::tick));
+  BOOST_TEST((rearmed.when - start >= 400ms));
+  BOOST_TEST((late.when - start >= 500ms));
+  BOOST_TEST((early.when < rearmed.when && rearmed.when < late.when));
+
+  // Arming an expired entry again clears it
+  early.arm(10s);
+  BOOST_TEST(!early.expired());
+  early.cancel();
+  BOOST_TEST(wheel.size() == 0);
+}
@@ -0,0 +1,61 @@
+//
+// This file is included from tst/c++/systemicai/benchmarks.cpp
+//
+// Handshake cost: every operation connects, completes a full TLS handshake and closes, without a request.  Session
+// resumption is off, so each handshake signs with the RSA 2048 key of cfg/ and agrees on a key with the profile's
+// key exchange: finite field DHE with the 2048 bit parameters of cfg/dumb.dh, or ECDHE over P-256 or X25519, with
+// TLS 1.2 and TLS 1.3.
+//
+
+#include <systemicai/http/server/benchmark.hpp>
+
+namespace test::systemicai::http::server::benchmark {
+
+struct tls_profile_case {
+  const char* name;
+  const char* version;
+  const char* ciphers;
+  const char* groups;
+  bool dh;
+};
+
+inline void tls_handshakes(const options& o) {
+  auto const root = make_document_root(512);
+  static const tls_profile_case profiles[] = {
+          {"TLS 1.2 DHE 2048", "1.2", "DHE-RSA-AES128-GCM-SHA256", "", true},
+          {"TLS 1.2 ECDHE P-256", "1.2", "ECDHE-RSA-AES128-GCM-SHA256", "P-256", false},
+          {"TLS 1.2 ECDHE X25519", "1.2", "ECDHE-RSA-AES128-GCM-SHA256", "X25519", false},
+          {"TLS 1.3 P-256", "1.3", "", "P-256", false},
+          {"TLS 1.3 X25519", "1.3", "", "X25519", false}};
+
+  report_header(std::cout, "handshakes");
+  for(auto& p : profiles) {
+    auto tr = make_settings(18230, 2, root);
+    tr.put("service.ssl.min_version", p.version);
+    tr.put("service.ssl.max_version", p.version);
+    tr.put("service.ssl.ciphers", p.ciphers);
+    tr.put("service.ssl.groups", p.groups);
+    tr.put("service.ssl.session_cache", 0);
+    tr.put("service.ssl.tickets", false);
+    pt::ptree l, tls;
+    tls.put("address", "127.0.0.1");
+    tls.put("port", 18230);
+    tls.put("type", "tls");
+    l.push_back(std::make_pair("", tls));
+    tr.add_child("service.listeners", l);
+    ssl::context ctx{ssl::context::tls_server};
+    running_service rs(tr, load_certificate(ctx, p.dh));
+
+    auto const ep = rs.endpoint();
+    auto const r = measure(4, o.seconds, [&ep](int) {
+      thread_local net::io_context ioc;
+      thread_local ssl::context client{ssl::context::tls_client};
+      return handshake_and_close(ioc, client, ep);
+    });
+    report(std::cout, p.name, r);
+  }
+}
+
+static registrar tls_handshakes_registrar("tls_handshakes", tls_handshakes);
+
+}
@@ -0,0 +1,86 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+#include <systemicai/http/server/tls_profile.h>
+#include <systemicai/http/server/fixture.hpp>
+#include <boost/test/included/unit_test.hpp>
+
+namespace test::systemicai::http::server::tls_profile {
+
+using namespace ::systemicai::http::server;
+
+struct negotiated {
+  bool ok;
+  std::string version;
+  std::string cipher;
+};
+
+// Handshake with a client limited to the `min` to `max` versions, and report what was agreed on
+inline negotiated handshake(const tcp::endpoint& ep, int min, int max) {
+  net::io_context ioc;
+  ssl::context ctx{ssl::context::tls_client};
+  SSL_CTX_set_min_proto_version(ctx.native_handle(), min);
+  SSL_CTX_set_max_proto_version(ctx.native_handle(), max);
+  beast::ssl_stream<beast::tcp_stream> stream(ioc, ctx);
+  beast::error_code ec;
+  beast::get_lowest_layer(stream).connect(ep, ec);
+  BOOST_REQUIRE(!ec);
+  stream.handshake(ssl::stream_base::client, ec);
+  if(ec)
+    return {false, "", ""};
+  negotiated const n{true, SSL_get_version(stream.native_handle()), SSL_get_cipher_name(stream.native_handle())};
+  stream.shutdown(ec);
+  return n;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_tls_profile )
+{
+  using namespace ::systemicai::http::server;
+  using test::systemicai::http::server::tls_profile::handshake;
+  using test::systemicai::http::server::fixture::make_settings;
+  using test::systemicai::http::server::fixture::running;
+
+  BOOST_TEST(parse_tls_version("1.3") == TLS1_3_VERSION);
+  BOOST_CHECK_THROW(parse_tls_version("1.4"), ::systemicai::common::exception);
+  BOOST_CHECK_THROW(parse_tls_version("tls1.2"), ::systemicai::common::exception);
+
+  auto const root = std::filesystem::temp_directory_path() / "afs-tls-profile-test";
+  std::filesystem::create_directories(root);
+
+  // Bad profiles are refused before the service starts
+  for(auto [key, value] : {std::pair{"service.ssl.min_version", "1.4"}, {"service.ssl.max_version", "1.1"},
+                           {"service.ssl.ciphers", "NO-SUCH-CIPHER"}, {"service.ssl.groups", "P-999"}}) {
+    auto tree = make_settings(root, "tls");
+    tree.put(key, value);
+    ::systemicai::http::server::settings const s(tree);
+    ssl::context ctx{ssl::context::tls_server};
+    service svc(s, ctx);
+    BOOST_CHECK_THROW(svc.start(), ::systemicai::common::exception);
+  }
+
+  // The defaults negotiate TLS 1.3, and an ECDHE suite with TLS 1.2 clients
+  {
+    running r(make_settings(root, "tls"));
+    auto const tls13 = handshake(r.endpoint(), TLS1_2_VERSION, TLS1_3_VERSION);
+    BOOST_TEST(tls13.ok);
+    BOOST_TEST(tls13.version == "TLSv1.3");
+    auto const tls12 = handshake(r.endpoint(), TLS1_2_VERSION, TLS1_2_VERSION);
+    BOOST_TEST(tls12.ok);
+    BOOST_TEST(tls12.version == "TLSv1.2");
+    BOOST_TEST(tls12.cipher.rfind("ECDHE-", 0) == 0u);
+    BOOST_TEST(!handshake(r.endpoint(), TLS1_VERSION, TLS1_1_VERSION).ok);
+  }
+
+  // A TLS 1.3 only profile turns TLS 1.2 clients away
+  {
+    auto tree = make_settings(root, "tls");
+    tree.put("service.ssl.min_version", "1.3");
+    running r(tree);
+    BOOST_TEST(handshake(r.endpoint(), TLS1_2_VERSION, TLS1_3_VERSION).ok);
+    BOOST_TEST(!handshake(r.endpoint(), TLS1_2_VERSION, TLS1_2_VERSION).ok);
+  }
+}
@@ -0,0 +1,148 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+#include <systemicai/http/server/tls_resumption.h>
+#include <systemicai/http/server/fixture.hpp>
+#include <boost/test/included/unit_test.hpp>
+
+namespace test::systemicai::http::server::tls_resumption {
+
+using namespace ::systemicai::http::server;
+
+// A TLS client that keeps the session of its last connection to resume it on the next one
+class client {
+  net::io_context ioc_;
+  ssl::context ctx_{ssl::context::tlsv12_client};
+  SSL_SESSION* session_ = nullptr;
+
+public:
+  ~client() {
+    forget();
+  }
+
+  void forget() {
+    if(session_ != nullptr)
+      SSL_SESSION_free(session_);
+    session_ = nullptr;
+  }
+
+  // Connect, GET with "Connection: close" and shut down, returns whether the session was resumed
+  bool get(const tcp::endpoint& ep) {
+    beast::ssl_stream<beast::tcp_stream> stream(ioc_, ctx_);
+    beast::error_code ec;
+    beast::get_lowest_layer(stream).connect(ep, ec);
+    BOOST_REQUIRE(!ec);
+    if(session_ != nullptr)
+      SSL_set_session(stream.native_handle(), session_);
+    stream.handshake(ssl::stream_base::client, ec);
+    BOOST_REQUIRE_MESSAGE(!ec, ec.message());
+    auto const resumed = SSL_session_reused(stream.native_handle()) == 1;
+
+    std::string const request = "GET /index.html HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    net::write(stream, net::buffer(request), ec);
+    beast::flat_buffer buffer;
+    beast::http::response<beast::http::string_body> res;
+    beast::http::read(stream, buffer, res, ec);
+    BOOST_REQUIRE(!ec);
+    BOOST_TEST(res.body() == "resumed");
+
+    forget();
+    session_ = SSL_get1_session(stream.native_handle());
+    stream.shutdown(ec);
+    return resumed;
+  }
+};
+
+}
+
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_tls_resumption )
+{
+  using namespace ::systemicai::http::server;
+  using namespace test::systemicai::http::server::tls_resumption;
+  using test::systemicai::http::server::fixture::make_settings;
+  using test::systemicai::http::server::fixture::running;
+
+  auto const root = std::filesystem::temp_directory_path() / "afs-tls-resumption-test";
+  std::filesystem::create_directories(root);
+  std::ofstream(root / "index.html", std::ios::trunc) << "resumed";
+
+  // Tickets, and the session cache when they are disabled, resume the session of the previous connection
+  for(auto tickets : {true, false}) {
+    auto tree = make_settings(root, "tls");
+    tree.put("service.ssl.tickets", tickets);
+    running r(tree);
+    client c;
+    auto const before = ::systemicai::http::server::tls_resumption::handshakes();
+    BOOST_TEST(!c.get(r.endpoint()));
+    BOOST_TEST(c.get(r.endpoint()));
+    BOOST_TEST(c.get(r.endpoint()));
+    auto const after = ::systemicai::http::server::tls_resumption::handshakes();
+    BOOST_TEST(after.full - before.full == 1u);
+    BOOST_TEST(after.resumed - before.resumed == 2u);
+  }
+
+  // Without either every handshake is a full one
+  {
+    auto tree = make_settings(root, "tls");
+    tree.put("service.ssl.tickets", false);
+    tree.put("service.ssl.session_cache", 0);
+    running r(tree);
+    client c;
+    BOOST_TEST(!c.get(r.endpoint()));
+    BOOST_TEST(!c.get(r.endpoint()));
+  }
+
+  // Services sharing a key file accept each other's tickets, with no cache to fall back on
+  {
+    auto const keys = root / "ticket.keys";
+    std::string key(2 * ticket_key::size, 0);
+    for(size_t i = 0; i < key.size(); ++i)
+      key[i] = char(i * 7 + 3);
+    std::ofstream(keys, std::ios::binary | std::ios::trunc) << key;
+    auto const read = ::systemicai::http::server::tls_resumption::read_keys(keys.string());
+    BOOST_TEST(read.size() == 2u);
+    BOOST_TEST(read[1].name[0] == (unsigned char)(ticket_key::size * 7 + 3));
+
+    auto first = make_settings(root, "tls");
+    auto second = make_settings(root, "tls");
+    for(auto t : {&first, &second}) {
+      t->put("service.ssl.session_cache", 0);
+      t->put("service.ssl.ticket_keys", keys.string());
+    }
+    running a(first);
+    running b(second);
+    client c;
+    BOOST_TEST(!c.get(a.endpoint()));
+    BOOST_TEST(c.get(b.endpoint()));
+    BOOST_TEST(c.get(a.endpoint()));
+
+    // Missing and truncated key files are refused
+    BOOST_CHECK_THROW(::systemicai::http::server::tls_resumption::read_keys((root / "missing.keys").string()), ::systemicai::common::exception);
+    std::ofstream(root / "short.keys", std::ios::binary | std::ios::trunc) << key.substr(0, 100);
+    BOOST_CHECK_THROW(::systemicai::http::server::tls_resumption::read_keys((root / "short.keys").string()), ::systemicai::common::exception);
+  }
+
+  // A ticket outlives one key rotation, not two
+  {
+    auto tree = make_settings(root, "tls");
+    tree.put("service.ssl.session_cache", 0);
+    running r(tree);
+    client c;
+    BOOST_TEST(!c.get(r.endpoint()));
+    BOOST_TEST(r.service().rotate_ticket_keys());
+    BOOST_TEST(c.get(r.endpoint()));
+    c.forget();
+    BOOST_TEST(!c.get(r.endpoint()));
+    BOOST_TEST(r.service().rotate_ticket_keys());
+    BOOST_TEST(r.service().rotate_ticket_keys());
+    BOOST_TEST(!c.get(r.endpoint()));
+
+    // Not without tickets
+    auto off = make_settings(root, "tls");
+    off.put("service.ssl.tickets", false);
+    running o(off);
+    BOOST_TEST(!o.service().rotate_ticket_keys());
+  }
+}
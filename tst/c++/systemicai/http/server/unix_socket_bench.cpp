@@ -0,0 +1,57 @@
+//
+// This file is included from tst/c++/systemicai/benchmarks.cpp
+//
+// Compares a plain listener on loopback TCP with a unix domain socket listener, both for a connect, GET,
+// close cycle and for requests on keep-alive connections.
+//
+
+#include <systemicai/http/server/benchmark.hpp>
+
+namespace test::systemicai::http::server::benchmark {
+
+template<class Protocol>
+void unix_socket_run(const options& o, const std::string& what, const typename Protocol::endpoint& ep) {
+  auto const clients = 4;
+  auto r = measure(clients, o.seconds, [&ep](int) {
+    thread_local net::io_context ioc;
+    return get_and_close<Protocol>(ioc, ep, "/index.html");
+  });
+  report(std::cout, what + " connect", r);
+
+  net::io_context ioc;
+  std::vector<typename Protocol::socket> sockets;
+  std::vector<beast::flat_buffer> buffers(clients);
+  for(int c = 0; c < clients; ++c) {
+    sockets.emplace_back(ioc);
+    sockets.back().connect(ep);
+  }
+  r = measure(clients, o.seconds, [&](int c) {
+    return get(sockets[c], buffers[c], "/index.html");
+  });
+  report(std::cout, what + " keep-alive", r);
+}
+
+inline void unix_socket(const options& o) {
+  auto const root = make_document_root(512);
+  auto const path = (std::filesystem::temp_directory_path() / "afs-benchmark.sock").string();
+  ssl::context ctx{ssl::context::tlsv12};
+
+  auto tr = make_settings(18100, 1, root);
+  pt::ptree l, plain, local;
+  plain.put("port", 18100);
+  plain.put("type", "plain");
+  local.put("type", "unix");
+  local.put("path", path);
+  l.push_back(std::make_pair("", plain));
+  l.push_back(std::make_pair("", local));
+  tr.add_child("service.listeners", l);
+  running_service rs(tr, ctx);
+
+  report_header(std::cout, "transport");
+  unix_socket_run<tcp>(o, "tcp", rs.endpoint());
+  unix_socket_run<net::local::stream_protocol>(o, "unix", net::local::stream_protocol::endpoint(path));
+}
+
+static registrar unix_socket_registrar("unix_socket", unix_socket);
+
+}
@@ -0,0 +1,81 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+#include <systemicai/http/server/fixture.hpp>
+#include <boost/test/included/unit_test.hpp>
+
+namespace test::systemicai::http::server::unix_socket {
+
+using namespace ::systemicai::http::server;
+
+inline pt::ptree make_settings(const std::filesystem::path& root, const std::string& path) {
+  pt::ptree tree;
+  tree.put("service.log.level", "fatal");
+  tree.put("document.root", root.string());
+  pt::ptree l, local;
+  local.put("type", "unix");
+  local.put("path", path);
+  l.push_back(std::make_pair("", local));
+  tree.add_child("service.listeners", l);
+  return tree;
+}
+
+}
+
+// A unix listener removes a stale socket file before it binds and its own when it stops, and nothing else
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_unix_socket )
+{
+  using namespace ::systemicai::http::server;
+  using test::systemicai::http::server::unix_socket::make_settings;
+  namespace fixture = test::systemicai::http::server::fixture;
+  using local = net::local::stream_protocol;
+
+  auto const root = std::filesystem::temp_directory_path() / "afs-unix-socket-test";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root);
+  std::ofstream(root / "index.html", std::ios::trunc) << "local";
+  auto const path = (root / "afs.sock").string();
+
+  // Left behind by a previous run
+  {
+    net::io_context ioc;
+    local::acceptor stale(ioc, local::endpoint(path));
+  }
+  BOOST_TEST(std::filesystem::is_socket(path));
+  {
+    fixture::running r(make_settings(root, path));
+    net::io_context ioc;
+    local::socket sock(ioc);
+    sock.connect(local::endpoint(path));
+    std::string const request = "GET /index.html HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+    net::write(sock, net::buffer(request));
+    beast::flat_buffer buffer;
+    beast::http::response<beast::http::string_body> res;
+    beast::http::read(sock, buffer, res);
+    BOOST_TEST(res.body() == "local");
+  }
+  BOOST_TEST(!std::filesystem::exists(path));
+
+  // A file that is not a socket is not replaced
+  std::ofstream(path, std::ios::trunc) << "keep";
+  {
+    fixture::running r(make_settings(root, path));
+    net::io_context ioc;
+    local::socket sock(ioc);
+    beast::error_code ec;
+    sock.connect(local::endpoint(path), ec);
+    BOOST_TEST(ec);
+  }
+  std::ifstream in(path);
+  std::string kept;
+  in >> kept;
+  BOOST_TEST(kept == "keep");
+
+  // Nor is a listener without a path started
+  ::systemicai::http::server::settings const s(make_settings(root, ""));
+  ssl::context ctx{ssl::context::tlsv12};
+  service svc(s, ctx);
+  BOOST_CHECK_THROW(svc.start(), ::systemicai::common::exception);
+}
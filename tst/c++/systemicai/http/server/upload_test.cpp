@@ -0,0 +1,364 @@
+//
+// This file is included from tst/c++/systemicai/unit_tests.cpp
+
+#include <systemicai/http/server/namespace.h>
+#include <systemicai/http/server/service.hpp>
+#include <systemicai/http/server/sessions.hpp>
+#include <systemicai/http/server/fixture.hpp>
+#include <boost/test/included/unit_test.hpp>
+
+namespace test::systemicai::http::server::upload {
+
+using namespace ::systemicai::http::server;
+
+// Send a request with a body of `size` bytes, it must not be read beyond the header
+inline beast::http::response<beast::http::string_body> refused(tcp::socket& sock, const std::string& start, size_t size) {
+  beast::error_code ec;
+  std::string const header = start + " HTTP/1.1\r\nHost: localhost\r\nContent-Length: " + std::to_string(size) + "\r\n\r\n";
+  net::write(sock, net::buffer(header), ec);
+  BOOST_REQUIRE(!ec);
+  beast::flat_buffer buffer;
+  beast::http::response<beast::http::string_body> res;
+  beast::http::read(sock, buffer, res, ec);
+  BOOST_REQUIRE(!ec);
+  return res;
+}
+
+// The temporary files of the uploads of `name` in progress in `dir`
+inline std::vector<std::filesystem::path> parts(const std::filesystem::path& dir, const std::string& name) {
+  std::vector<std::filesystem::path> out;
+  for(auto& e : std::filesystem::directory_iterator(dir))
+    if(e.path().filename().string().rfind("." + name + ".", 0) == 0)
+      out.push_back(e.path());
+  return out;
+}
+
+// Keeps what it receives in `body`, pausing after every chunk and resuming from another thread
+class pausing : public handlers::body_handler<http_session<plain_http_session>::send_type> {
+public:
+  pausing(std::string& body, std::atomic<int>& pauses) : body_(body), pauses_(pauses) {
+  }
+
+  ~pausing() override {
+    for(auto& t : resumers_)
+      t.join();
+  }
+
+  bool on_body(net::const_buffer chunk, beast::error_code&) override {
+    body_.append(static_cast<const char*>(chunk.data()), chunk.size());
+    ++pauses_;
+    resumers_.emplace_back([this] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      source().resume();
+    });
+    return false;
+  }
+
+  void on_complete(http_session<plain_http_session>::send_type& send, beast::error_code ec) override {
+    beast::http::response<beast::http::string_body> res{ec ? beast::http::status::bad_request : beast::http::status::ok, 11};
+    res.body() = std::to_string(body_.size());
+    res.prepare_payload();
+    send(std::move(res));
+  }
+
+private:
+  std::string& body_;
+  std::atomic<int>& pauses_;
+  std::vector<std::thread> resumers_;
+};
+
+}
+
+// Bodies are streamed to disk on upload routes, and held to the body limit of their route everywhere else
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_upload )
+{
+  using namespace ::systemicai::http::server;
+  using test::systemicai::http::server::upload::parts;
+  using test::systemicai::http::server::upload::refused;
+  namespace fixture = test::systemicai::http::server::fixture;
+
+  auto const root = std::filesystem::temp_directory_path() / "afs-upload-test";
+  auto const uploads = root / "uploads";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(uploads);
+  std::ofstream(root / "index.html", std::ios::trunc) << "upload";
+
+  auto tree = fixture::make_settings(root);
+  tree.put("service.log.level", "fatal");
+  tree.put("service.limit.body", 1000);
+  pt::ptree routes, upload, limited, small;
+  upload.put("prefix", "/upload/");
+  upload.put("body_limit", 64 << 20);
+  upload.put("upload", uploads.string());
+  routes.push_back(std::make_pair("", upload));
+  // A prefix without the slash before the file name
+  limited.put("prefix", "/limited");
+  limited.put("body_limit", 1000);
+  limited.put("upload", uploads.string());
+  routes.push_back(std::make_pair("", limited));
+  small.put("prefix", "/small/");
+  small.put("body_limit", 100);
+  routes.push_back(std::make_pair("", small));
+  tree.add_child("service.routes", routes);
+  settings s(tree);
+  BOOST_TEST(s.body_limit("/upload/a.bin") == size_t(64 << 20));
+  BOOST_TEST(s.body_limit("/small/") == 100);
+  BOOST_TEST(s.body_limit("/index.html") == 1000);
+  fixture::running r(tree);
+
+  net::io_context ioc;
+  beast::error_code ec;
+  auto const connect = [&] { return fixture::connect(ioc, r.endpoint()); };
+
+  // A body far over the default limit reaches the disk while it is being sent
+  {
+    auto sock = connect();
+    size_t const size = 16 << 20;
+    std::string body(size, 0);
+    for(size_t i = 0; i < size; ++i)
+      body[i] = char('a' + i % 23);
+    std::string const header = "PUT /upload/big.bin HTTP/1.1\r\nHost: localhost\r\nContent-Length: " + std::to_string(size) + "\r\n\r\n";
+    net::write(sock, net::buffer(header), ec);
+    net::write(sock, net::buffer(body.data(), size / 2), ec);
+    BOOST_REQUIRE(!ec);
+
+    for(int i = 0; i < 200 && !(parts(uploads, "big.bin").size() == 1 && std::filesystem::file_size(parts(uploads, "big.bin")[0]) == size / 2); ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    BOOST_REQUIRE(parts(uploads, "big.bin").size() == 1u);
+    BOOST_TEST(std::filesystem::file_size(parts(uploads, "big.bin")[0]) == size / 2);
+    BOOST_TEST(!std::filesystem::exists(uploads / "big.bin"));
+
+    net::write(sock, net::buffer(body.data() + size / 2, size - size / 2), ec);
+    BOOST_REQUIRE(!ec);
+    beast::flat_buffer buffer;
+    beast::http::response<beast::http::string_body> res;
+    beast::http::read(sock, buffer, res, ec);
+    BOOST_REQUIRE(!ec);
+    BOOST_TEST(res.result_int() == 201);
+    BOOST_TEST(parts(uploads, "big.bin").empty());
+    std::ifstream in(uploads / "big.bin", std::ios::binary);
+    std::string const written((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    BOOST_TEST((written == body));
+
+    // The connection is still good for the next request
+    std::string const get = "GET /index.html HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    net::write(sock, net::buffer(get), ec);
+    beast::http::response<beast::http::string_body> next;
+    beast::http::read(sock, buffer, next, ec);
+    BOOST_REQUIRE(!ec);
+    BOOST_TEST(next.body() == "upload");
+  }
+
+  // Overlapping uploads of one name each write a file of their own, the last to complete replaces the other
+  {
+    size_t const size = 1 << 20;
+    std::string const first(size, '1'), second(size, '2');
+    std::string const header = "PUT /upload/shared.bin HTTP/1.1\r\nHost: localhost\r\nContent-Length: " + std::to_string(size) + "\r\n\r\n";
+    auto a = connect();
+    auto b = connect();
+    net::write(a, net::buffer(header), ec);
+    net::write(a, net::buffer(first.data(), size / 2), ec);
+    net::write(b, net::buffer(header), ec);
+    net::write(b, net::buffer(second.data(), size / 2), ec);
+    BOOST_REQUIRE(!ec);
+    auto const complete = [&](tcp::socket& sock, const std::string& body) {
+      net::write(sock, net::buffer(body.data() + size / 2, size - size / 2), ec);
+      BOOST_REQUIRE(!ec);
+      beast::flat_buffer buffer;
+      beast::http::response<beast::http::string_body> res;
+      beast::http::read(sock, buffer, res, ec);
+      BOOST_REQUIRE(!ec);
+      BOOST_TEST(res.result_int() == 201);
+      std::ifstream in(uploads / "shared.bin", std::ios::binary);
+      std::string const written((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+      BOOST_TEST((written == body));
+    };
+    complete(a, first);
+    complete(b, second);
+    BOOST_TEST(parts(uploads, "shared.bin").empty());
+  }
+
+  // A chunked body needs no declared length
+  {
+    auto sock = connect();
+    std::string const request = "POST /upload/chunked.txt HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: chunked\r\n\r\n"
+                                "5\r\nhello\r\n6\r\n world\r\n0\r\n\r\n";
+    net::write(sock, net::buffer(request), ec);
+    beast::flat_buffer buffer;
+    beast::http::response<beast::http::string_body> res;
+    beast::http::read(sock, buffer, res, ec);
+    BOOST_REQUIRE(!ec);
+    BOOST_TEST(res.result_int() == 201);
+    std::ifstream in(uploads / "chunked.txt");
+    std::string written;
+    std::getline(in, written);
+    BOOST_TEST(written == "hello world");
+  }
+
+  // The rest of the target is one file name, without the query and percent-decoded
+  auto const put = [&](const std::string& target) {
+    auto sock = connect();
+    std::string const request = "PUT " + target + " HTTP/1.1\r\nHost: localhost\r\nContent-Length: 4\r\n\r\nname";
+    net::write(sock, net::buffer(request), ec);
+    beast::flat_buffer buffer;
+    beast::http::response<beast::http::string_body> res;
+    beast::http::read(sock, buffer, res, ec);
+    BOOST_REQUIRE(!ec);
+    return res.result_int();
+  };
+  BOOST_TEST(put("/upload/query.txt?overwrite=1") == 201);
+  BOOST_TEST(std::filesystem::exists(uploads / "query.txt"));
+  BOOST_TEST(put("/upload/a%20b.txt") == 201);
+  BOOST_TEST(std::filesystem::exists(uploads / "a b.txt"));
+  BOOST_TEST(put("/upload/%2e%2e%2fescaped.txt") == 400);
+  BOOST_TEST(put("/upload/..%2Fescaped.txt") == 400);
+  BOOST_TEST(put("/upload/sub/file.txt") == 400);
+  BOOST_TEST(put("/upload/.hidden") == 400);
+  BOOST_TEST(put("/upload/bad%zz") == 400);
+  BOOST_TEST(put("/upload/") == 400);
+  BOOST_TEST(!std::filesystem::exists(root / "escaped.txt"));
+  BOOST_TEST(!std::filesystem::exists(uploads / ".hidden"));
+
+  // A body sent to an upload route that it cannot take is refused, not buffered up to the route's limit
+  for(auto [start, status] : {std::pair{"PUT /upload/sub/large.bin", 400}, {"PATCH /upload/large.bin", 405}}) {
+    auto sock = connect();
+    size_t const size = 32 << 20;
+    std::string const header = std::string(start) + " HTTP/1.1\r\nHost: localhost\r\nContent-Length: " +
+                               std::to_string(size) + "\r\n\r\n";
+    net::write(sock, net::buffer(header), ec);
+    BOOST_REQUIRE(!ec);
+    std::thread sender([&sock, size] {
+      std::string const body(size, 'l');
+      beast::error_code ec;
+      net::write(sock, net::buffer(body), ec);
+    });
+    beast::flat_buffer buffer;
+    beast::http::response<beast::http::string_body> res;
+    beast::error_code rec;
+    beast::http::read(sock, buffer, res, rec);
+    sender.join();
+    BOOST_TEST(!rec);
+    BOOST_TEST(res.result_int() == status);
+    BOOST_TEST(!res.keep_alive());
+  }
+
+  // A client sending a refused body regardless still reads the response
+  {
+    auto sock = connect();
+    size_t const size = 8 << 20;
+    std::string const header = "PUT /upload/sent.bin HTTP/1.1\r\nHost: localhost\r\nContent-Length: " +
+                               std::to_string(size << 4) + "\r\n\r\n";
+    net::write(sock, net::buffer(header), ec);
+    BOOST_REQUIRE(!ec);
+    std::thread sender([&sock, size] {
+      std::string const body(size, 'b');
+      beast::error_code ec;
+      net::write(sock, net::buffer(body), ec);
+    });
+    beast::flat_buffer buffer;
+    beast::http::response<beast::http::string_body> res;
+    beast::error_code rec;
+    beast::http::read(sock, buffer, res, rec);
+    sender.join();
+    BOOST_TEST(!rec);
+    BOOST_TEST(res.result_int() == 413);
+  }
+
+  // So does one sending a streamed body over the limit of its route
+  {
+    auto sock = connect();
+    std::string const header = "PUT /limited/chunked.bin HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: chunked\r\n\r\n";
+    net::write(sock, net::buffer(header), ec);
+    BOOST_REQUIRE(!ec);
+    std::thread sender([&sock] {
+      std::string const chunk = "10000\r\n" + std::string(0x10000, 'c') + "\r\n";
+      beast::error_code ec;
+      for(int i = 0; i < 128 && !ec; ++i)
+        net::write(sock, net::buffer(chunk), ec);
+    });
+    // Long after the response is sent
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    beast::flat_buffer buffer;
+    beast::http::response<beast::http::string_body> res;
+    beast::error_code rec;
+    beast::http::read(sock, buffer, res, rec);
+    sender.join();
+    BOOST_TEST(!rec);
+    BOOST_TEST(res.result_int() == 413);
+    BOOST_TEST(!res.keep_alive());
+  }
+
+  // Declared bodies over the limit of their route are refused before they are sent, and the connection closed
+  {
+    auto sock = connect();
+    auto res = refused(sock, "PUT /upload/huge.bin", size_t(100) << 20);
+    BOOST_TEST(res.result_int() == 413);
+    BOOST_TEST(!res.keep_alive());
+    BOOST_TEST(parts(uploads, "huge.bin").empty());
+  }
+  {
+    auto sock = connect();
+    BOOST_TEST(refused(sock, "POST /index.html", 2000).result_int() == 413);
+  }
+  {
+    auto sock = connect();
+    BOOST_TEST(refused(sock, "POST /small/x", 150).result_int() == 413);
+  }
+
+  // Under the limit of its route a body is buffered for the handlers, which only serve GET and HEAD
+  {
+    auto sock = connect();
+    std::string const request = "POST /small/x HTTP/1.1\r\nHost: localhost\r\nContent-Length: 50\r\n\r\n" + std::string(50, 'x');
+    net::write(sock, net::buffer(request), ec);
+    beast::flat_buffer buffer;
+    beast::http::response<beast::http::string_body> res;
+    beast::http::read(sock, buffer, res, ec);
+    BOOST_REQUIRE(!ec);
+    BOOST_TEST(res.result_int() == 400);
+  }
+}
+
+// A body handler that pauses is resumed from another thread, and gets the rest of the body
+BOOST_AUTO_TEST_CASE( test_systemicai_http_server_upload_pause )
+{
+  using namespace ::systemicai::http::server;
+  using test::systemicai::http::server::upload::pausing;
+  namespace fixture = test::systemicai::http::server::fixture;
+  using registry = handlers::body_handler_registry<http_session<plain_http_session>::send_type, arena_allocator<char>>;
+
+  auto const root = std::filesystem::temp_directory_path() / "afs-upload-pause-test";
+  std::filesystem::create_directories(root);
+
+  // The registry outlives the test
+  static std::string received;
+  static std::atomic<int> pauses{0};
+  registry::global().add([](const registry::header_type& req, const settings&)
+                                 -> std::unique_ptr<handlers::body_handler<http_session<plain_http_session>::send_type>> {
+    if(req.target() != "/paused")
+      return nullptr;
+    return std::make_unique<pausing>(received, pauses);
+  });
+
+  auto tree = fixture::make_settings(root);
+  tree.put("service.limit.body", 1 << 20);
+  fixture::running r(tree);
+
+  net::io_context ioc;
+  beast::error_code ec;
+  auto sock = fixture::connect(ioc, r.endpoint());
+  std::string body(300000, 0);
+  for(size_t i = 0; i < body.size(); ++i)
+    body[i] = char('a' + i % 19);
+  std::string const request = "POST /paused HTTP/1.1\r\nHost: localhost\r\nContent-Length: " +
+          std::to_string(body.size()) + "\r\n\r\n" + body;
+  net::write(sock, net::buffer(request), ec);
+  BOOST_REQUIRE(!ec);
+  beast::flat_buffer buffer;
+  beast::http::response<beast::http::string_body> res;
+  beast::http::read(sock, buffer, res, ec);
+  BOOST_REQUIRE(!ec);
+  BOOST_TEST(res.result_int() == 200);
+  BOOST_TEST(res.body() == std::to_string(body.size()));
+  BOOST_TEST((received == body));
+  BOOST_TEST(pauses.load() > 1);
+}
@@ -22,6 +22,12 @@
 #include <systemicai/http/server/settings.h>
 #include <systemicai/http/server/service.hpp>
 #include <systemicai/http/server/server.h>
+#include <systemicai/http/server/timer_wheel.h>
+#include <systemicai/http/server/buffer_pool.h>
+#include <systemicai/http/server/recycler.h>
+#include <systemicai/http/server/sessions.hpp>
+
+#include <systemicai/allocation_counter.hpp>
 
 // All of our unit tests must be included between these two macros (and must not use these two macros)
 BOOST_AUTO_TEST_SUITE(test_systemicai_http)
@@ -29,5 +35,28 @@ BOOST_AUTO_TEST_SUITE(test_systemicai_http)
 #include <systemicai/http/server/settings_test.hpp>
 #include <systemicai/http/server/server_test.cpp>
 #include <systemicai/http/server/settings_test.cpp>
+#include <systemicai/http/server/connection_limit_test.cpp>
+#include <systemicai/http/server/handoff_test.cpp>
+#include <systemicai/http/server/unix_socket_test.cpp>
+#include <systemicai/http/server/arena_test.cpp>
+#include <systemicai/http/server/pipeline_test.cpp>
+#include <systemicai/http/server/timer_wheel_test.cpp>
+#include <systemicai/http/server/timeouts_test.cpp>
+#include <systemicai/http/server/upload_test.cpp>
+#include <systemicai/http/server/buffer_pool_test.cpp>
+#include <systemicai/http/server/recycler_test.cpp>
+#include <systemicai/http/server/reload_test.cpp>
+#include <systemicai/http/server/tls_resumption_test.cpp>
+#include <systemicai/http/server/tls_profile_test.cpp>
+#include <systemicai/http/server/handshake_pool_test.cpp>
+#include <systemicai/http/server/kernel_tls_test.cpp>
+#include <systemicai/http/server/certificate_store_test.cpp>
+#include <systemicai/http/server/file_cache_test.cpp>
+#include <systemicai/http/server/sendfile_test.cpp>
+#include <systemicai/http/server/open_file_cache_test.cpp>
+#include <systemicai/http/server/compression_test.cpp>
+#include <systemicai/http/server/conditional_test.cpp>
+#include <systemicai/http/server/range_test.cpp>
+#include <systemicai/http/server/mmap_test.cpp>
 
 BOOST_AUTO_TEST_SUITE_END()